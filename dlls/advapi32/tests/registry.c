@@ -3479,6 +3479,135 @@ static void test_RegNotifyChangeKeyValue(void)
     CloseHandle(event);
 }
 
+static void test_value_changes(void)
+{
+    DWORD len, type, data;
+    HKEY key1, key2;
+    LONG ret;
+    int i;
+
+    ret = RegCreateKeyA( hkey_main, "Changes", &key1 );
+    ok( !ret, "RegCreateKey failed %d\n", ret );
+    ret = RegOpenKeyA( hkey_main, "Changes", &key2 );
+    ok( !ret, "RegOpenKey failed %d\n", ret );
+
+    /* changes made through another handle must be visible immediately */
+    for (i = 0; i < 10; i++)
+    {
+        len = sizeof(data);
+        ret = RegQueryValueExA( key1, "value", NULL, &type, (BYTE *)&data, &len );
+        if (!i) ok( ret == ERROR_FILE_NOT_FOUND, "%d: RegQueryValueEx returned %d\n", i, ret );
+        else
+        {
+            ok( !ret, "%d: RegQueryValueEx failed %d\n", i, ret );
+            ok( data == i - 1, "%d: got %u\n", i, data );
+        }
+        data = i;
+        ret = RegSetValueExA( key2, "value", 0, REG_DWORD, (BYTE *)&data, sizeof(data) );
+        ok( !ret, "%d: RegSetValueEx failed %d\n", i, ret );
+    }
+    ret = RegDeleteValueA( key2, "value" );
+    ok( !ret, "RegDeleteValue failed %d\n", ret );
+    len = sizeof(data);
+    ret = RegQueryValueExA( key1, "VALUE", NULL, &type, (BYTE *)&data, &len );
+    ok( ret == ERROR_FILE_NOT_FOUND, "RegQueryValueEx returned %d\n", ret );
+
+    /* a deleted key can't be queried anymore */
+    ret = RegSetValueExA( key2, "value", 0, REG_DWORD, (BYTE *)&data, sizeof(data) );
+    ok( !ret, "RegSetValueEx failed %d\n", ret );
+    len = sizeof(data);
+    ret = RegQueryValueExA( key1, "value", NULL, &type, (BYTE *)&data, &len );
+    ok( !ret, "RegQueryValueEx failed %d\n", ret );
+    ret = RegDeleteKeyA( key2, "" );
+    ok( !ret, "RegDeleteKey failed %d\n", ret );
+    len = sizeof(data);
+    ret = RegQueryValueExA( key1, "value", NULL, &type, (BYTE *)&data, &len );
+    ok( ret == ERROR_KEY_DELETED, "RegQueryValueEx returned %d\n", ret );
+
+    RegCloseKey( key1 );
+    RegCloseKey( key2 );
+}
+
+static void test_many_keys(void)
+{
+    /* enough entries for the server to index them; 100000 like a real HKCR\CLSID in interactive mode */
+    unsigned int i, j, count = winetest_interactive ? 100000 : 2000;
+    char name[64], prev[64], buffer[64];
+    DWORD start, len, type, data;
+    HKEY key, subkey;
+    LONG ret;
+
+    ret = RegCreateKeyA( hkey_main, "ManyKeys", &key );
+    ok( !ret, "RegCreateKey failed %d\n", ret );
+
+    start = GetTickCount();
+    /* create keys and values in a scrambled order, with GUID-like names */
+    for (i = 0; i < count; i++)
+    {
+        j = (i * 7919) % count;
+        sprintf( name, "{%08X-1234-5678-9ABC-%012u}", j * 2654435761u, j );
+        ret = RegCreateKeyA( key, name, &subkey );
+        ok( !ret, "%u: RegCreateKey failed %d\n", i, ret );
+        RegCloseKey( subkey );
+        ret = RegSetValueExA( key, name, 0, REG_DWORD, (BYTE *)&j, sizeof(j) );
+        ok( !ret, "%u: RegSetValueEx failed %d\n", i, ret );
+    }
+    if (winetest_debug > 1) trace( "create: %u ms\n", GetTickCount() - start );
+
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        /* lookups are case-insensitive */
+        sprintf( name, "{%08x-1234-5678-9abc-%012u}", i * 2654435761u, i );
+        ret = RegOpenKeyExA( key, name, 0, KEY_READ, &subkey );
+        ok( !ret, "%u: RegOpenKeyEx failed %d\n", i, ret );
+        RegCloseKey( subkey );
+        len = sizeof(data);
+        ret = RegQueryValueExA( key, name, NULL, &type, (BYTE *)&data, &len );
+        ok( !ret, "%u: RegQueryValueEx failed %d\n", i, ret );
+        ok( data == i, "%u: got %u\n", i, data );
+    }
+    if (winetest_debug > 1) trace( "open: %u ms\n", GetTickCount() - start );
+
+    /* enumeration is still sorted */
+    start = GetTickCount();
+    prev[0] = 0;
+    for (i = 0; ; i++)
+    {
+        len = sizeof(buffer);
+        ret = RegEnumKeyExA( key, i, buffer, &len, NULL, NULL, NULL, NULL );
+        if (ret) break;
+        ok( lstrcmpiA( prev, buffer ) < 0, "%u: %s before %s\n", i, prev, buffer );
+        strcpy( prev, buffer );
+    }
+    ok( ret == ERROR_NO_MORE_ITEMS, "RegEnumKeyEx failed %d\n", ret );
+    ok( i == count, "got %u keys\n", i );
+    if (winetest_debug > 1) trace( "enum: %u ms\n", GetTickCount() - start );
+
+    for (i = 0; i < count; i += 2)
+    {
+        sprintf( name, "{%08X-1234-5678-9ABC-%012u}", i * 2654435761u, i );
+        ret = RegDeleteKeyA( key, name );
+        ok( !ret, "%u: RegDeleteKey failed %d\n", i, ret );
+        ret = RegDeleteValueA( key, name );
+        ok( !ret, "%u: RegDeleteValue failed %d\n", i, ret );
+    }
+    for (i = 0; i < count; i++)
+    {
+        sprintf( name, "{%08X-1234-5678-9ABC-%012u}", i * 2654435761u, i );
+        ret = RegOpenKeyExA( key, name, 0, KEY_READ, &subkey );
+        ok( ret == (i % 2 ? ERROR_SUCCESS : ERROR_FILE_NOT_FOUND), "%u: RegOpenKeyEx returned %d\n", i, ret );
+        if (!ret) RegCloseKey( subkey );
+        len = sizeof(data);
+        ret = RegQueryValueExA( key, name, NULL, &type, (BYTE *)&data, &len );
+        ok( ret == (i % 2 ? ERROR_SUCCESS : ERROR_FILE_NOT_FOUND), "%u: RegQueryValueEx returned %d\n", i, ret );
+        if (!ret) ok( data == i, "%u: got %u\n", i, data );
+    }
+
+    delete_key( key );
+    RegCloseKey( key );
+}
+
 START_TEST(registry)
 {
     /* Load pointers for functions that are not available in all Windows versions */
@@ -3514,6 +3643,8 @@ START_TEST(registry)
     test_delete_key_value();
     test_RegOpenCurrentUser();
     test_RegNotifyChangeKeyValue();
+    test_value_changes();
+    test_many_keys();
 
     /* cleanup */
     delete_key( hkey_main );
@@ -2233,6 +2233,40 @@ BOOL WINAPI GetQueuedCompletionStatus( HANDLE CompletionPort, LPDWORD lpNumberOf
 }
 
 
+/******************************************************************************
+ *		GetQueuedCompletionStatusEx (KERNEL32.@)
+ */
+BOOL WINAPI GetQueuedCompletionStatusEx( HANDLE port, OVERLAPPED_ENTRY *entries, ULONG count,
+                                         ULONG *written, DWORD timeout, BOOL alertable )
+{
+    FILE_IO_COMPLETION_INFORMATION info[64];
+    LARGE_INTEGER time;
+    NTSTATUS status;
+    ULONG i;
+
+    TRACE( "%p %p %u %p %u %u\n", port, entries, count, written, timeout, alertable );
+
+    status = NtRemoveIoCompletionEx( port, info, min( count, sizeof(info) / sizeof(info[0]) ), written,
+                                     get_nt_timeout( &time, timeout ), alertable );
+    if (status == STATUS_SUCCESS)
+    {
+        for (i = 0; i < *written; i++)
+        {
+            entries[i].lpCompletionKey            = info[i].CompletionKey;
+            entries[i].lpOverlapped               = (OVERLAPPED *)info[i].CompletionValue;
+            entries[i].Internal                   = info[i].IoStatusBlock.u.Status;
+            entries[i].dwNumberOfBytesTransferred = info[i].IoStatusBlock.Information;
+        }
+        return TRUE;
+    }
+
+    if (status == STATUS_TIMEOUT) SetLastError( WAIT_TIMEOUT );
+    else if (status == STATUS_USER_APC) SetLastError( WAIT_IO_COMPLETION );
+    else SetLastError( RtlNtStatusToDosError(status) );
+    return FALSE;
+}
+
+
 /******************************************************************************
  *		PostQueuedCompletionStatus (KERNEL32.@)
  */
@@ -2449,3 +2483,21 @@ BOOL WINAPI SleepConditionVariableSRW( RTL_CONDITION_VARIABLE *variable, RTL_SRW
     }
     return TRUE;
 }
+
+/***********************************************************************
+ *           WaitOnAddress   (KERNEL32.@)
+ */
+BOOL WINAPI WaitOnAddress( volatile void *addr, void *cmp, SIZE_T size, DWORD timeout )
+{
+    NTSTATUS status;
+    LARGE_INTEGER time;
+
+    status = RtlWaitOnAddress( (const void *)addr, cmp, size, get_nt_timeout( &time, timeout ) );
+
+    if (status != STATUS_SUCCESS)
+    {
+        SetLastError( RtlNtStatusToDosError(status) );
+        return FALSE;
+    }
+    return TRUE;
+}
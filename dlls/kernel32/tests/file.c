@@ -60,6 +60,7 @@ static NTSTATUS (WINAPI *pNtCreateFile)(PHANDLE, ACCESS_MASK, POBJECT_ATTRIBUTES
 static BOOL (WINAPI *pRtlDosPathNameToNtPathName_U)(LPCWSTR, PUNICODE_STRING, PWSTR*, CURDIR*);
 static NTSTATUS (WINAPI *pRtlAnsiStringToUnicodeString)(PUNICODE_STRING, PCANSI_STRING, BOOLEAN);
 static BOOL (WINAPI *pSetFileInformationByHandle)(HANDLE, FILE_INFO_BY_HANDLE_CLASS, void*, DWORD);
+static BOOL (WINAPI *pSetFileCompletionNotificationModes)(HANDLE, UCHAR);
 
 static const char filename[] = "testfile.xxx";
 static const char sillytext[] =
@@ -105,6 +106,7 @@ static void InitFunctionPointers(void)
     pGetFinalPathNameByHandleA = (void *) GetProcAddress(hkernel32, "GetFinalPathNameByHandleA");
     pGetFinalPathNameByHandleW = (void *) GetProcAddress(hkernel32, "GetFinalPathNameByHandleW");
     pSetFileInformationByHandle = (void *) GetProcAddress(hkernel32, "SetFileInformationByHandle");
+    pSetFileCompletionNotificationModes = (void *) GetProcAddress(hkernel32, "SetFileCompletionNotificationModes");
 }
 
 static void test__hread( void )
@@ -4292,6 +4294,94 @@ static void test_WriteFileGather(void)
     DeleteFileA( filename );
 }
 
+static void test_SetFileCompletionNotificationModes(void)
+{
+    char temp_path[MAX_PATH], filename[MAX_PATH], buf[16];
+    HANDLE hfile, port;
+    DWORD ret, size;
+    ULONG_PTR key;
+    OVERLAPPED ovl, *povl;
+    int i;
+
+    if (!pSetFileCompletionNotificationModes)
+    {
+        win_skip( "SetFileCompletionNotificationModes not available\n" );
+        return;
+    }
+
+    GetTempPathA( MAX_PATH, temp_path );
+    GetTempFileNameA( temp_path, "fcn", 0, filename );
+    hfile = CreateFileA( filename, GENERIC_READ | GENERIC_WRITE, 0, 0, CREATE_ALWAYS,
+                         FILE_FLAG_OVERLAPPED | FILE_ATTRIBUTE_NORMAL, 0 );
+    ok( hfile != INVALID_HANDLE_VALUE, "CreateFile failed err %u\n", GetLastError() );
+    if (hfile == INVALID_HANDLE_VALUE) return;
+
+    port = CreateIoCompletionPort( hfile, NULL, 0xdead, 0 );
+    ok( port != NULL, "CreateIoCompletionPort failed err %u\n", GetLastError() );
+
+    SetLastError( 0xdeadbeef );
+    ret = pSetFileCompletionNotificationModes( hfile, 0x80 );
+    ok( !ret, "SetFileCompletionNotificationModes succeeded\n" );
+    ok( GetLastError() == ERROR_INVALID_PARAMETER, "wrong error %u\n", GetLastError() );
+
+    ret = pSetFileCompletionNotificationModes( hfile, FILE_SKIP_COMPLETION_PORT_ON_SUCCESS |
+                                                      FILE_SKIP_SET_EVENT_ON_HANDLE );
+    ok( ret, "SetFileCompletionNotificationModes failed err %u\n", GetLastError() );
+
+    for (i = 0; i < 2; i++)
+    {
+        memset( &ovl, 0, sizeof(ovl) );
+        memset( buf, 'a' + i, sizeof(buf) );
+        ret = WriteFile( hfile, buf, sizeof(buf), NULL, &ovl );
+        if (!ret)
+        {
+            /* the write didn't complete immediately, it must be reported */
+            ok( GetLastError() == ERROR_IO_PENDING, "WriteFile failed err %u\n", GetLastError() );
+            ret = GetQueuedCompletionStatus( port, &size, &key, &povl, 1000 );
+            ok( ret, "GetQueuedCompletionStatus failed err %u\n", GetLastError() );
+            ok( povl == &ovl, "wrong ovl %p\n", povl );
+            continue;
+        }
+
+        povl = (void *)0xdeadbeef;
+        SetLastError( 0xdeadbeef );
+        ret = GetQueuedCompletionStatus( port, &size, &key, &povl, 0 );
+        ok( !ret, "GetQueuedCompletionStatus succeeded\n" );
+        ok( GetLastError() == WAIT_TIMEOUT, "wrong error %u\n", GetLastError() );
+        ok( !povl, "wrong ovl %p\n", povl );
+    }
+
+    /* failures of pending operations are still reported */
+    memset( &ovl, 0, sizeof(ovl) );
+    S(U(ovl)).Offset = 0x10000;
+    ret = ReadFile( hfile, buf, sizeof(buf), NULL, &ovl );
+    ok( !ret, "ReadFile succeeded\n" );
+    if (GetLastError() == ERROR_IO_PENDING)
+    {
+        ret = GetOverlappedResult( hfile, &ovl, &size, TRUE );
+        ok( GetLastError() == ERROR_HANDLE_EOF, "wrong error %u\n", GetLastError() );
+        ret = GetQueuedCompletionStatus( port, &size, &key, &povl, 1000 );
+        ok( !ret, "GetQueuedCompletionStatus succeeded\n" );
+        ok( povl == &ovl, "wrong ovl %p\n", povl );
+        ok( GetLastError() == ERROR_HANDLE_EOF, "wrong error %u\n", GetLastError() );
+    }
+    else
+    {
+        /* operations failing immediately don't queue a completion packet */
+        ok( GetLastError() == ERROR_HANDLE_EOF, "wrong error %u\n", GetLastError() );
+        povl = (void *)0xdeadbeef;
+        SetLastError( 0xdeadbeef );
+        ret = GetQueuedCompletionStatus( port, &size, &key, &povl, 0 );
+        ok( !ret, "GetQueuedCompletionStatus succeeded\n" );
+        todo_wine ok( !povl, "wrong ovl %p\n", povl );
+        todo_wine ok( GetLastError() == WAIT_TIMEOUT, "wrong error %u\n", GetLastError() );
+    }
+
+    CloseHandle( hfile );
+    CloseHandle( port );
+    DeleteFileA( filename );
+}
+
 static unsigned file_map_access(unsigned access)
 {
     if (access & GENERIC_READ)    access |= FILE_GENERIC_READ;
@@ -4770,6 +4860,7 @@ START_TEST(file)
     test_OpenFileById();
     test_SetFileValidData();
     test_WriteFileGather();
+    test_SetFileCompletionNotificationModes();
     test_file_access();
     test_GetFinalPathNameByHandleA();
     test_GetFinalPathNameByHandleW();
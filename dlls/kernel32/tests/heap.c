@@ -39,6 +39,7 @@
 #define HEAP_VALIDATE_PARAMS  0x40000000
 
 static BOOL (WINAPI *pHeapQueryInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T, PSIZE_T);
+static BOOL (WINAPI *pHeapSetInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T);
 static BOOL (WINAPI *pGetPhysicallyInstalledSystemMemory)(ULONGLONG *);
 static ULONG (WINAPI *pRtlGetNtGlobalFlags)(void);
 
@@ -854,6 +855,88 @@ static void test_HeapQueryInformation(void)
     ok(info == 0 || info == 1 || info == 2, "expected 0, 1 or 2, got %u\n", info);
 }
 
+static void test_heap_lfh(void)
+{
+    static const SIZE_T sizes[] = { 0, 1, 15, 16, 17, 100, 256, 257, 1000, 4096, 16384 };
+    BYTE *ptrs[sizeof(sizes) / sizeof(sizes[0])][32], *p;
+    ULONG info;
+    SIZE_T size;
+    HANDLE heap;
+    BOOL ret;
+    int i, j, k;
+
+    pHeapQueryInformation = (void *)GetProcAddress(GetModuleHandleA("kernel32.dll"), "HeapQueryInformation");
+    pHeapSetInformation = (void *)GetProcAddress(GetModuleHandleA("kernel32.dll"), "HeapSetInformation");
+    if (!pHeapQueryInformation || !pHeapSetInformation)
+    {
+        win_skip("HeapQueryInformation or HeapSetInformation is not available\n");
+        return;
+    }
+
+    heap = HeapCreate( 0, 0, 0 );
+    ok( heap != NULL, "HeapCreate failed\n" );
+
+    info = 2;
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    if (!ret)
+    {
+        win_skip("low-fragmentation heap is not available\n");
+        HeapDestroy( heap );
+        return;
+    }
+
+    info = 0xdeadbeef;
+    ret = pHeapQueryInformation( heap, HeapCompatibilityInformation, &info, sizeof(info), NULL );
+    ok( ret, "HeapQueryInformation error %u\n", GetLastError() );
+    ok( info == 2, "expected 2, got %u\n", info );
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        for (j = 0; j < 32; j++)
+        {
+            p = ptrs[i][j] = HeapAlloc( heap, HEAP_ZERO_MEMORY, sizes[i] );
+            ok( p != NULL, "HeapAlloc(%lu) failed\n", sizes[i] );
+            for (k = 0; k < sizes[i]; k++) if (p[k]) break;
+            ok( k == sizes[i], "block of size %lu not zeroed at %d\n", sizes[i], k );
+            memset( p, i + j, sizes[i] );
+            size = HeapSize( heap, 0, p );
+            ok( size == sizes[i], "HeapSize returned %lu instead of %lu\n", size, sizes[i] );
+            ok( HeapValidate( heap, 0, p ), "HeapValidate failed for block of size %lu\n", sizes[i] );
+        }
+    }
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        for (j = 0; j < 32; j++)
+        {
+            p = ptrs[i][j];
+            for (k = 0; k < sizes[i]; k++) if (p[k] != (BYTE)(i + j)) break;
+            ok( k == sizes[i], "block of size %lu corrupted at %d\n", sizes[i], k );
+
+            p = HeapReAlloc( heap, 0, p, sizes[i] * 2 + 1 );
+            ok( p != NULL, "HeapReAlloc(%lu) failed\n", sizes[i] * 2 + 1 );
+            for (k = 0; k < sizes[i]; k++) if (p[k] != (BYTE)(i + j)) break;
+            ok( k == sizes[i], "reallocated block of size %lu corrupted at %d\n", sizes[i], k );
+            size = HeapSize( heap, 0, p );
+            ok( size == sizes[i] * 2 + 1, "HeapSize returned %lu instead of %lu\n", size, sizes[i] * 2 + 1 );
+
+            ret = HeapFree( heap, 0, p );
+            ok( ret, "HeapFree failed\n" );
+        }
+    }
+
+    /* blocks that don't belong to the heap are rejected */
+    p = HeapAlloc( GetProcessHeap(), 0, 16 );
+    ok( !HeapValidate( heap, 0, p ), "HeapValidate succeeded for a foreign block\n" );
+    HeapFree( GetProcessHeap(), 0, p );
+    p = HeapAlloc( heap, 0, 16 );
+    ok( !HeapValidate( heap, 0, p + 1 ), "HeapValidate succeeded inside a block\n" );
+    HeapFree( heap, 0, p );
+
+    ok( HeapValidate( heap, 0, NULL ), "HeapValidate failed\n" );
+    HeapDestroy( heap );
+}
+
 static void test_heap_checks( DWORD flags )
 {
     BYTE old, *p, *p2;
@@ -1207,6 +1290,7 @@ START_TEST(heap)
     test_sized_HeapReAlloc((1 << 20), 1);
 
     test_HeapQueryInformation();
+    test_heap_lfh();
     test_GetPhysicallyInstalledSystemMemory();
 
     if (pRtlGetNtGlobalFlags)
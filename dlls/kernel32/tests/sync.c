@@ -59,6 +59,10 @@ static VOID   (WINAPI *pReleaseSRWLockExclusive)(PSRWLOCK);
 static VOID   (WINAPI *pReleaseSRWLockShared)(PSRWLOCK);
 static BOOLEAN (WINAPI *pTryAcquireSRWLockExclusive)(PSRWLOCK);
 static BOOLEAN (WINAPI *pTryAcquireSRWLockShared)(PSRWLOCK);
+static BOOL   (WINAPI *pWaitOnAddress)(volatile void *, void *, SIZE_T, DWORD);
+static VOID   (WINAPI *pWakeByAddressAll)(void *);
+static VOID   (WINAPI *pWakeByAddressSingle)(void *);
+static BOOL   (WINAPI *pGetQueuedCompletionStatusEx)(HANDLE, OVERLAPPED_ENTRY *, ULONG, ULONG *, DWORD, BOOL);
 
 static NTSTATUS (WINAPI *pNtAllocateVirtualMemory)(HANDLE, PVOID *, ULONG, SIZE_T *, ULONG, ULONG);
 static NTSTATUS (WINAPI *pNtFreeVirtualMemory)(HANDLE, PVOID *, SIZE_T *, ULONG);
@@ -574,6 +578,46 @@ static void test_event(void)
     CloseHandle( handle );
 }
 
+static DWORD WINAPI pulse_wait_thread(void *param)
+{
+    return WaitForSingleObject(param, 5000);
+}
+
+static void test_event_pulse(void)
+{
+    HANDLE event, threads[2];
+    DWORD ret, code, signaled;
+    BOOL manual;
+    int i;
+
+    for (manual = 0; manual < 2; manual++)
+    {
+        event = CreateEventA(NULL, manual, FALSE, NULL);
+        ok(event != NULL, "CreateEvent failed with error %u\n", GetLastError());
+        for (i = 0; i < 2; i++)
+            threads[i] = CreateThread(NULL, 0, pulse_wait_thread, event, 0, NULL);
+        Sleep(200);  /* let the threads block on the event */
+
+        ret = PulseEvent(event);
+        ok(ret, "PulseEvent failed with error %u\n", GetLastError());
+        ret = WaitForSingleObject(event, 0);
+        ok(ret == WAIT_TIMEOUT, "%u: event is still signaled\n", manual);
+
+        /* a manual-reset pulse releases all the waiters, an auto-reset one a single waiter */
+        for (i = signaled = 0; i < 2; i++)
+        {
+            ret = WaitForSingleObject(threads[i], 10000);
+            ok(ret == WAIT_OBJECT_0, "%u: wait for thread %d returned %u\n", manual, i, ret);
+            GetExitCodeThread(threads[i], &code);
+            ok(code == WAIT_OBJECT_0 || code == WAIT_TIMEOUT, "%u: thread %d returned %u\n", manual, i, code);
+            if (code == WAIT_OBJECT_0) signaled++;
+            CloseHandle(threads[i]);
+        }
+        ok(signaled == (manual ? 2 : 1), "%u: %u threads were released\n", manual, signaled);
+        CloseHandle(event);
+    }
+}
+
 static void test_semaphore(void)
 {
     HANDLE handle, handle2;
@@ -2467,6 +2511,231 @@ static void test_srwlock_example(void)
     trace("number of total exclusive accesses is %d\n", srwlock_protected_value);
 }
 
+static LONG address_value;
+static LONG address_waiters;
+
+static DWORD WINAPI address_wait_thread(void *param)
+{
+    LONG cmp = 0;
+
+    InterlockedIncrement(&address_waiters);
+    while (address_value == cmp)
+        pWaitOnAddress(&address_value, &cmp, sizeof(cmp), INFINITE);
+    return 0;
+}
+
+static LONG address_woken;
+
+static DWORD WINAPI address_wake_thread(void *param)
+{
+    LONG cmp = 0;
+
+    InterlockedIncrement(&address_waiters);
+    pWaitOnAddress(&address_value, &cmp, sizeof(cmp), INFINITE);
+    InterlockedIncrement(&address_woken);
+    return 0;
+}
+
+static void test_WaitOnAddress(void)
+{
+    HANDLE threads[4];
+    LONGLONG val64, cmp64;
+    SHORT val16, cmp16;
+    BYTE val8, cmp8;
+    DWORD ret, i;
+    LONG cmp;
+
+    if (!pWaitOnAddress)
+    {
+        win_skip("WaitOnAddress is not available\n");
+        return;
+    }
+
+    /* values differ, return immediately */
+    address_value = 1;
+    cmp = 0;
+    ret = pWaitOnAddress(&address_value, &cmp, sizeof(cmp), INFINITE);
+    ok(ret, "WaitOnAddress failed, error %u\n", GetLastError());
+
+    val8 = 1; cmp8 = 2;
+    ret = pWaitOnAddress(&val8, &cmp8, sizeof(cmp8), INFINITE);
+    ok(ret, "WaitOnAddress failed, error %u\n", GetLastError());
+    val16 = 1; cmp16 = 2;
+    ret = pWaitOnAddress(&val16, &cmp16, sizeof(cmp16), INFINITE);
+    ok(ret, "WaitOnAddress failed, error %u\n", GetLastError());
+    val64 = 1; cmp64 = 0x100000001;
+    ret = pWaitOnAddress(&val64, &cmp64, sizeof(cmp64), INFINITE);
+    ok(ret, "WaitOnAddress failed, error %u\n", GetLastError());
+
+    /* values are equal, time out */
+    cmp = 1;
+    SetLastError(0xdeadbeef);
+    ret = pWaitOnAddress(&address_value, &cmp, sizeof(cmp), 0);
+    ok(!ret, "WaitOnAddress succeeded\n");
+    ok(GetLastError() == ERROR_TIMEOUT, "got error %u\n", GetLastError());
+
+    SetLastError(0xdeadbeef);
+    ret = pWaitOnAddress(&address_value, &cmp, sizeof(cmp), 50);
+    ok(!ret, "WaitOnAddress succeeded\n");
+    ok(GetLastError() == ERROR_TIMEOUT, "got error %u\n", GetLastError());
+
+    /* waking without waiters */
+    pWakeByAddressSingle(&address_value);
+    pWakeByAddressAll(&address_value);
+
+    /* single wake */
+    address_value = 0;
+    address_waiters = 0;
+    threads[0] = CreateThread(NULL, 0, address_wait_thread, NULL, 0, NULL);
+    while (!address_waiters) Sleep(1);
+    ret = WaitForSingleObject(threads[0], 100);
+    ok(ret == WAIT_TIMEOUT, "got %u\n", ret);
+    InterlockedExchange(&address_value, 1);
+    pWakeByAddressSingle(&address_value);
+    ret = WaitForSingleObject(threads[0], 5000);
+    ok(!ret, "got %u\n", ret);
+    CloseHandle(threads[0]);
+
+    /* wake all */
+    address_value = 0;
+    address_waiters = 0;
+    for (i = 0; i < 4; i++)
+        threads[i] = CreateThread(NULL, 0, address_wait_thread, NULL, 0, NULL);
+    while (address_waiters < 4) Sleep(1);
+    Sleep(50);
+    InterlockedExchange(&address_value, 1);
+    pWakeByAddressAll(&address_value);
+    ret = WaitForMultipleObjects(4, threads, TRUE, 5000);
+    ok(!ret, "got %u\n", ret);
+    for (i = 0; i < 4; i++) CloseHandle(threads[i]);
+
+    /* a single wake only wakes one waiter */
+    address_value = 0;
+    address_waiters = 0;
+    address_woken = 0;
+    for (i = 0; i < 2; i++)
+        threads[i] = CreateThread(NULL, 0, address_wake_thread, NULL, 0, NULL);
+    while (address_waiters < 2) Sleep(1);
+    Sleep(50);
+    pWakeByAddressSingle(&address_value);
+    ret = WaitForMultipleObjects(2, threads, FALSE, 5000);
+    ok(ret == WAIT_OBJECT_0 || ret == WAIT_OBJECT_0 + 1, "got %u\n", ret);
+    Sleep(50);
+    ok(address_woken == 1, "got %d woken threads\n", address_woken);
+    pWakeByAddressAll(&address_value);
+    ret = WaitForMultipleObjects(2, threads, TRUE, 5000);
+    ok(!ret, "got %u\n", ret);
+    ok(address_woken == 2, "got %d woken threads\n", address_woken);
+    for (i = 0; i < 2; i++) CloseHandle(threads[i]);
+}
+
+static int completion_apc_called;
+
+static void CALLBACK completion_apc(ULONG_PTR param)
+{
+    completion_apc_called++;
+}
+
+static void test_GetQueuedCompletionStatusEx(void)
+{
+    OVERLAPPED_ENTRY entries[16];
+    LARGE_INTEGER freq, start, end;
+    OVERLAPPED *ovl;
+    ULONG_PTR key;
+    ULONG count, i, total, packets;
+    DWORD size;
+    HANDLE port;
+    BOOL ret;
+
+    if (!pGetQueuedCompletionStatusEx)
+    {
+        win_skip("GetQueuedCompletionStatusEx is not available\n");
+        return;
+    }
+
+    port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+    ok(port != NULL, "CreateIoCompletionPort failed, error %u\n", GetLastError());
+
+    for (i = 0; i < 10; i++)
+    {
+        ret = PostQueuedCompletionStatus(port, i * 10, 100 + i, (OVERLAPPED *)(ULONG_PTR)(0x1000 + i));
+        ok(ret, "PostQueuedCompletionStatus failed, error %u\n", GetLastError());
+    }
+
+    count = 0xdeadbeef;
+    ret = pGetQueuedCompletionStatusEx(port, entries, 4, &count, 0, FALSE);
+    ok(ret, "GetQueuedCompletionStatusEx failed, error %u\n", GetLastError());
+    ok(count == 4, "got %u entries\n", count);
+    for (i = 0; i < count; i++)
+    {
+        ok(entries[i].lpCompletionKey == 100 + i, "%u: got key %u\n", i, (DWORD)entries[i].lpCompletionKey);
+        ok(entries[i].lpOverlapped == (OVERLAPPED *)(ULONG_PTR)(0x1000 + i), "%u: got overlapped %p\n",
+           i, entries[i].lpOverlapped);
+        ok(entries[i].dwNumberOfBytesTransferred == i * 10, "%u: got size %u\n",
+           i, entries[i].dwNumberOfBytesTransferred);
+    }
+
+    count = 0xdeadbeef;
+    ret = pGetQueuedCompletionStatusEx(port, entries, 16, &count, 0, FALSE);
+    ok(ret, "GetQueuedCompletionStatusEx failed, error %u\n", GetLastError());
+    ok(count == 6, "got %u entries\n", count);
+    ok(entries[0].lpCompletionKey == 104, "got key %u\n", (DWORD)entries[0].lpCompletionKey);
+    ok(entries[5].lpCompletionKey == 109, "got key %u\n", (DWORD)entries[5].lpCompletionKey);
+
+    SetLastError(0xdeadbeef);
+    ret = pGetQueuedCompletionStatusEx(port, entries, 16, &count, 0, FALSE);
+    ok(!ret, "GetQueuedCompletionStatusEx succeeded\n");
+    ok(GetLastError() == WAIT_TIMEOUT, "got error %u\n", GetLastError());
+    ok(!count, "got %u entries\n", count);
+
+    SetLastError(0xdeadbeef);
+    ret = pGetQueuedCompletionStatusEx(port, entries, 0, &count, 50, FALSE);
+    ok(!ret, "GetQueuedCompletionStatusEx succeeded\n");
+    ok(GetLastError() == ERROR_INVALID_PARAMETER, "got error %u\n", GetLastError());
+
+    SetLastError(0xdeadbeef);
+    ret = pGetQueuedCompletionStatusEx(port, entries, 16, &count, 50, FALSE);
+    ok(!ret, "GetQueuedCompletionStatusEx succeeded\n");
+    ok(GetLastError() == WAIT_TIMEOUT, "got error %u\n", GetLastError());
+
+    /* alertable wait */
+    completion_apc_called = 0;
+    ret = QueueUserAPC(completion_apc, GetCurrentThread(), 0);
+    ok(ret, "QueueUserAPC failed, error %u\n", GetLastError());
+    SetLastError(0xdeadbeef);
+    ret = pGetQueuedCompletionStatusEx(port, entries, 16, &count, 1000, TRUE);
+    ok(!ret, "GetQueuedCompletionStatusEx succeeded\n");
+    ok(GetLastError() == WAIT_IO_COMPLETION, "got error %u\n", GetLastError());
+    ok(completion_apc_called == 1, "APC called %u times\n", completion_apc_called);
+
+    if (winetest_interactive)
+    {
+        /* compare dequeuing throughput with GetQueuedCompletionStatus */
+        packets = 100000;
+        QueryPerformanceFrequency(&freq);
+
+        for (i = 0; i < packets; i++) PostQueuedCompletionStatus(port, 0, i, NULL);
+        QueryPerformanceCounter(&start);
+        for (i = 0; i < packets; i++)
+            if (!GetQueuedCompletionStatus(port, &size, &key, &ovl, 0)) break;
+        QueryPerformanceCounter(&end);
+        ok(i == packets, "got %u packets\n", i);
+        trace("GetQueuedCompletionStatus: %.0f packets/s\n",
+              packets * (double)freq.QuadPart / (end.QuadPart - start.QuadPart));
+
+        for (i = 0; i < packets; i++) PostQueuedCompletionStatus(port, 0, i, NULL);
+        QueryPerformanceCounter(&start);
+        for (total = 0; total < packets; total += count)
+            if (!pGetQueuedCompletionStatusEx(port, entries, 16, &count, 0, FALSE)) break;
+        QueryPerformanceCounter(&end);
+        ok(total == packets, "got %u packets\n", total);
+        trace("GetQueuedCompletionStatusEx: %.0f packets/s\n",
+              packets * (double)freq.QuadPart / (end.QuadPart - start.QuadPart));
+    }
+
+    CloseHandle(port);
+}
+
 static DWORD WINAPI alertable_wait_thread(void *param)
 {
     HANDLE *semaphores = param;
@@ -2680,6 +2949,10 @@ START_TEST(sync)
     pReleaseSRWLockShared = (void *)GetProcAddress(hdll, "ReleaseSRWLockShared");
     pTryAcquireSRWLockExclusive = (void *)GetProcAddress(hdll, "TryAcquireSRWLockExclusive");
     pTryAcquireSRWLockShared = (void *)GetProcAddress(hdll, "TryAcquireSRWLockShared");
+    pWaitOnAddress = (void *)GetProcAddress(hdll, "WaitOnAddress");
+    pWakeByAddressAll = (void *)GetProcAddress(hdll, "WakeByAddressAll");
+    pWakeByAddressSingle = (void *)GetProcAddress(hdll, "WakeByAddressSingle");
+    pGetQueuedCompletionStatusEx = (void *)GetProcAddress(hdll, "GetQueuedCompletionStatusEx");
     pNtAllocateVirtualMemory = (void *)GetProcAddress(hntdll, "NtAllocateVirtualMemory");
     pNtFreeVirtualMemory = (void *)GetProcAddress(hntdll, "NtFreeVirtualMemory");
     pNtWaitForSingleObject = (void *)GetProcAddress(hntdll, "NtWaitForSingleObject");
@@ -2702,6 +2975,7 @@ START_TEST(sync)
     test_mutex();
     test_slist();
     test_event();
+    test_event_pulse();
     test_semaphore();
     test_waitable_timer();
     test_iocp_callback();
@@ -2713,6 +2987,8 @@ START_TEST(sync)
     test_condvars_consumer_producer();
     test_srwlock_base();
     test_srwlock_example();
+    test_WaitOnAddress();
+    test_GetQueuedCompletionStatusEx();
     test_alertable_wait();
     test_apc_deadlock();
 }
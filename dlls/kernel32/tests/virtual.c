@@ -224,6 +224,62 @@ static void test_VirtualAllocEx(void)
     CloseHandle(hProcess);
 }
 
+static void test_VirtualAlloc_many(void)
+{
+    /* a large number of views is only possible in a 64-bit address space */
+    unsigned int i, count = (winetest_interactive && sizeof(void *) > 4) ? 100000 : 4096;
+    MEMORY_BASIC_INFORMATION info;
+    DWORD start = GetTickCount();
+    char **addrs;
+    void *ptr;
+    SIZE_T ret;
+
+    addrs = HeapAlloc( GetProcessHeap(), 0, count * sizeof(*addrs) );
+    for (i = 0; i < count; i++)
+    {
+        addrs[i] = VirtualAlloc( NULL, 0x10000, MEM_RESERVE, PAGE_NOACCESS );
+        ok( addrs[i] != NULL, "%u: VirtualAlloc failed %u\n", i, GetLastError() );
+        if (!addrs[i]) break;
+    }
+    count = i;
+
+    for (i = 1; i < count; i += 2)
+        ok( VirtualFree( addrs[i], 0, MEM_RELEASE ), "%u: VirtualFree failed %u\n", i, GetLastError() );
+
+    for (i = 0; i < count; i++)
+    {
+        ret = VirtualQuery( addrs[i] + 0x1000, &info, sizeof(info) );
+        ok( ret == sizeof(info), "%u: VirtualQuery failed %u\n", i, GetLastError() );
+        ok( info.BaseAddress == addrs[i] + 0x1000, "%u: got %p instead of %p\n",
+            i, info.BaseAddress, addrs[i] + 0x1000 );
+        if (i % 2)
+        {
+            ok( info.State == MEM_FREE, "%u: got state %x\n", i, info.State );
+        }
+        else
+        {
+            ok( info.AllocationBase == addrs[i], "%u: got %p instead of %p\n", i, info.AllocationBase, addrs[i] );
+            ok( info.RegionSize == 0xf000, "%u: got size %lx\n", i, info.RegionSize );
+            ok( info.State == MEM_RESERVE, "%u: got state %x\n", i, info.State );
+        }
+    }
+
+    /* the free slots can be reused at the same address */
+    for (i = 1; i < count; i += 2)
+    {
+        ptr = VirtualAlloc( addrs[i], 0x10000, MEM_RESERVE, PAGE_NOACCESS );
+        ok( ptr == addrs[i], "%u: VirtualAlloc returned %p instead of %p\n", i, ptr, addrs[i] );
+        ptr = VirtualAlloc( addrs[i] + 0x8000, 0x1000, MEM_RESERVE, PAGE_NOACCESS );
+        ok( !ptr, "%u: VirtualAlloc inside an existing view succeeded\n", i );
+    }
+
+    for (i = 0; i < count; i++)
+        ok( VirtualFree( addrs[i], 0, MEM_RELEASE ), "%u: VirtualFree failed %u\n", i, GetLastError() );
+
+    if (winetest_debug > 1) trace( "%u views: %u ms\n", count, GetTickCount() - start );
+    HeapFree( GetProcessHeap(), 0, addrs );
+}
+
 static void test_VirtualAlloc(void)
 {
     void *addr1, *addr2;
@@ -1453,6 +1509,60 @@ static void test_CreateFileMapping(void)
     CloseHandle( handle );
 }
 
+static void test_large_sections(void)
+{
+    SIZE_T (WINAPI *pGetLargePageMinimum)(void);
+    SIZE_T large_page = 0, size = 16 * 1024 * 1024;
+    HANDLE mapping;
+    char *view1, *view2;
+    SIZE_T i;
+
+    /* big anonymous sections must be coherent between views */
+    mapping = CreateFileMappingA( INVALID_HANDLE_VALUE, NULL, SEC_COMMIT | PAGE_READWRITE, 0, size, NULL );
+    ok( mapping != NULL, "CreateFileMapping failed with error %u\n", GetLastError() );
+    view1 = MapViewOfFile( mapping, FILE_MAP_WRITE, 0, 0, 0 );
+    ok( view1 != NULL, "MapViewOfFile failed with error %u\n", GetLastError() );
+    view2 = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+    ok( view2 != NULL, "MapViewOfFile failed with error %u\n", GetLastError() );
+    for (i = 0; i < size; i += 0x1000) view1[i] = i >> 12;
+    for (i = 0; i < size; i += 0x1000) if (view2[i] != (char)(i >> 12)) break;
+    ok( i == size, "wrong data at offset %lx\n", i );
+    UnmapViewOfFile( view1 );
+    UnmapViewOfFile( view2 );
+    CloseHandle( mapping );
+
+    pGetLargePageMinimum = (void *)GetProcAddress( GetModuleHandleA("kernel32.dll"), "GetLargePageMinimum" );
+    if (pGetLargePageMinimum) large_page = pGetLargePageMinimum();
+    if (!large_page)
+    {
+        win_skip( "large pages not supported\n" );
+        return;
+    }
+
+    /* this needs SeLockMemoryPrivilege on Windows */
+    SetLastError( 0xdeadbeef );
+    mapping = CreateFileMappingA( INVALID_HANDLE_VALUE, NULL, SEC_COMMIT | SEC_LARGE_PAGES | PAGE_READWRITE,
+                                  0, large_page, NULL );
+    if (!mapping)
+    {
+        skip( "can't create large page sections, error %u\n", GetLastError() );
+        return;
+    }
+    view1 = MapViewOfFile( mapping, FILE_MAP_WRITE, 0, 0, 0 );
+    ok( view1 != NULL, "MapViewOfFile failed with error %u\n", GetLastError() );
+    view2 = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+    ok( view2 != NULL, "MapViewOfFile failed with error %u\n", GetLastError() );
+    if (view1 && view2)
+    {
+        view1[0] = 0x12;
+        view1[large_page - 1] = 0x34;
+        ok( view2[0] == 0x12 && view2[large_page - 1] == 0x34, "views don't share memory\n" );
+    }
+    UnmapViewOfFile( view1 );
+    UnmapViewOfFile( view2 );
+    CloseHandle( mapping );
+}
+
 static void test_IsBadReadPtr(void)
 {
     BOOL ret;
@@ -3913,10 +4023,12 @@ START_TEST(virtual)
     test_VirtualProtect();
     test_VirtualAllocEx();
     test_VirtualAlloc();
+    test_VirtualAlloc_many();
     test_MapViewOfFile();
     test_NtMapViewOfSection();
     test_NtAreMappedFilesTheSame();
     test_CreateFileMapping();
+    test_large_sections();
     test_IsBadReadPtr();
     test_IsBadWritePtr();
     test_IsBadCodePtr();
@@ -982,6 +982,62 @@ PTP_CLEANUP_GROUP WINAPI CreateThreadpoolCleanupGroup( void )
     return group;
 }
 
+extern NTSTATUS CDECL __wine_tp_alloc_io_completion( TP_IO **out, HANDLE file, PTP_IO_CALLBACK callback,
+                                                     void *userdata, void (CALLBACK *destroy)(void *),
+                                                     TP_CALLBACK_ENVIRON *environment );
+
+/* context of a thread pool I/O object, freed by ntdll along with the object */
+struct tp_io_context
+{
+    PTP_WIN32_IO_CALLBACK callback;
+    void                 *userdata;
+};
+
+static void CALLBACK tp_io_callback( TP_CALLBACK_INSTANCE *instance, void *userdata, void *cvalue,
+                                     IO_STATUS_BLOCK *iosb, TP_IO *io )
+{
+    struct tp_io_context *context = userdata;
+
+    context->callback( instance, context->userdata, cvalue, RtlNtStatusToDosError( iosb->Status ),
+                       iosb->Information, io );
+}
+
+static void CALLBACK tp_io_destroy( void *userdata )
+{
+    HeapFree( GetProcessHeap(), 0, userdata );
+}
+
+/***********************************************************************
+ *              CreateThreadpoolIo (KERNEL32.@)
+ */
+PTP_IO WINAPI CreateThreadpoolIo( HANDLE handle, PTP_WIN32_IO_CALLBACK callback, PVOID userdata,
+                                  TP_CALLBACK_ENVIRON *environment )
+{
+    struct tp_io_context *context;
+    TP_IO *io;
+    NTSTATUS status;
+
+    TRACE( "%p, %p, %p, %p\n", handle, callback, userdata, environment );
+
+    if (!(context = HeapAlloc( GetProcessHeap(), 0, sizeof(*context) )))
+    {
+        SetLastError( ERROR_NOT_ENOUGH_MEMORY );
+        return NULL;
+    }
+    context->callback = callback;
+    context->userdata = userdata;
+
+    status = __wine_tp_alloc_io_completion( &io, handle, tp_io_callback, context, tp_io_destroy, environment );
+    if (status)
+    {
+        HeapFree( GetProcessHeap(), 0, context );
+        SetLastError( RtlNtStatusToDosError(status) );
+        return NULL;
+    }
+
+    return io;
+}
+
 /***********************************************************************
  *              CreateThreadpoolTimer (KERNEL32.@)
  */
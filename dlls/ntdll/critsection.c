@@ -25,7 +25,11 @@
 #include <errno.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/types.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 #ifdef HAVE_SYS_SYSCALL_H
 #include <sys/syscall.h>
 #endif
@@ -34,11 +38,13 @@
 #define WIN32_NO_STATUS
 #include "windef.h"
 #include "winternl.h"
+#include "wine/library.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(ntdll);
 WINE_DECLARE_DEBUG_CHANNEL(relay);
+WINE_DECLARE_DEBUG_CHANNEL(csprof);
 
 static inline LONG interlocked_inc( PLONG dest )
 {
@@ -200,6 +206,330 @@ static inline void close_semaphore( RTL_CRITICAL_SECTION *crit )
 
 #endif
 
+/* Adaptive spinning
+ *
+ * Sections initialized with RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN, or all
+ * sections when WINEADAPTIVESPIN is set, get an entry in a table of spin
+ * states, so that SpinCount keeps the value applications expect.  They are
+ * flagged in their debug info, so that the others don't look it up.  The entry
+ * holds their maximum spin count and an estimate of the spins it took to
+ * acquire them recently.  They spin for about twice the estimate, which
+ * follows the hold times of the section: successful spins move it towards
+ * the spins they needed, failed ones make it decay so that sections held
+ * for long stop spinning.
+ */
+
+#define SPIN_STATES_SIZE     4096  /* must be a power of 2 */
+#define SPIN_MAX             0xfff
+#define SPIN_DEFAULT         4000
+
+#define SPIN_STATE_DELETED   ((RTL_CRITICAL_SECTION *)1)
+
+#define CS_DEBUG_ADAPTIVE_SPIN  0x8000  /* in DebugInfo->CreatorBackTraceIndex */
+
+struct spin_state
+{
+    RTL_CRITICAL_SECTION *crit;
+    ULONG                 max;       /* maximum spin count */
+    ULONG                 estimate;  /* spins recently needed to acquire the section */
+};
+
+static struct spin_state *spin_states;
+static int adaptive_spin = -1;
+
+static inline BOOL has_spin_state( RTL_CRITICAL_SECTION *crit )
+{
+    return crit->DebugInfo && (crit->DebugInfo->CreatorBackTraceIndex & CS_DEBUG_ADAPTIVE_SPIN);
+}
+
+static inline BOOL use_adaptive_spin(void)
+{
+    if (adaptive_spin == -1)
+    {
+        const char *env = getenv( "WINEADAPTIVESPIN" );
+        adaptive_spin = env && atoi( env ) && NtCurrentTeb()->Peb->NumberOfProcessors > 1;
+    }
+    return adaptive_spin;
+}
+
+/* find the spin state of an adaptive section, optionally creating it */
+static struct spin_state *get_spin_state( RTL_CRITICAL_SECTION *crit, BOOL create )
+{
+    struct spin_state *states = spin_states, *state, *free_state = NULL;
+    RTL_CRITICAL_SECTION *free_crit = NULL;
+    unsigned int i, hash = (ULONG_PTR)crit / sizeof(void *);
+
+    if (!states)
+    {
+        void *ptr;
+
+        if (!create) return NULL;
+        ptr = wine_anon_mmap( NULL, SPIN_STATES_SIZE * sizeof(*states), PROT_READ | PROT_WRITE, 0 );
+        if (ptr == (void *)-1) return NULL;
+        if ((states = interlocked_cmpxchg_ptr( (void **)&spin_states, ptr, NULL )))
+            munmap( ptr, SPIN_STATES_SIZE * sizeof(*states) );
+        else
+            states = ptr;
+    }
+
+    for (i = 0; i < SPIN_STATES_SIZE; i++)
+    {
+        state = &states[(hash + i) & (SPIN_STATES_SIZE - 1)];
+        if (state->crit == crit) return state;
+        if (state->crit == SPIN_STATE_DELETED)
+        {
+            if (!free_state)
+            {
+                free_state = state;
+                free_crit = SPIN_STATE_DELETED;
+            }
+            continue;
+        }
+        if (state->crit) continue;
+        if (!create) return NULL;
+        if (!free_state) free_state = state;
+        break;
+    }
+    if (!free_state) return NULL;
+    /* reuse the first deleted entry of the chain, or the free entry that ends it */
+    if (interlocked_cmpxchg_ptr( (void **)&free_state->crit, crit, free_crit ) == free_crit) return free_state;
+    return free_state->crit == crit ? free_state : NULL;
+}
+
+static void set_spin_state( RTL_CRITICAL_SECTION *crit, ULONG max, ULONG estimate )
+{
+    struct spin_state *state;
+
+    /* sections without debug info can't be flagged */
+    if (!crit->DebugInfo || !(state = get_spin_state( crit, TRUE ))) return;
+    if (!max) max = SPIN_DEFAULT;
+    state->max = min( max, SPIN_MAX );
+    state->estimate = min( estimate, SPIN_MAX );
+    crit->DebugInfo->CreatorBackTraceIndex |= CS_DEBUG_ADAPTIVE_SPIN;
+}
+
+static void delete_spin_state( RTL_CRITICAL_SECTION *crit )
+{
+    struct spin_state *state;
+
+    if (crit->DebugInfo) crit->DebugInfo->CreatorBackTraceIndex &= ~CS_DEBUG_ADAPTIVE_SPIN;
+    /* look it up anyway, the section may have been reinitialized without being deleted */
+    if (spin_states && (state = get_spin_state( crit, FALSE ))) state->crit = SPIN_STATE_DELETED;
+}
+
+/* try to grab a free section for up to count iterations;
+ * return the number of iterations it took, 0 if it is still owned */
+static inline ULONG spin_enter( RTL_CRITICAL_SECTION *crit, ULONG count )
+{
+    ULONG i;
+
+    for (i = 1; i <= count; i++)
+    {
+        if (crit->LockCount > 0) break;  /* more than one waiter, don't bother spinning */
+        if (crit->LockCount == -1)       /* try again */
+        {
+            if (interlocked_cmpxchg( &crit->LockCount, 0, -1 ) == -1) return i;
+        }
+        small_pause();
+    }
+    return 0;
+}
+
+static ULONG spin_enter_adaptive( RTL_CRITICAL_SECTION *crit, struct spin_state *state )
+{
+    ULONG estimate = state->estimate;
+    ULONG count = spin_enter( crit, min( state->max, estimate * 2 + 10 ));
+
+    if (count == 1) return count;  /* not contended */
+    if (count) estimate += ((LONG)count - (LONG)estimate) / 8;
+    else estimate -= (estimate + 7) / 8;
+    /* racy, but a lost update doesn't matter */
+    state->estimate = estimate;
+    return count;
+}
+
+
+/* Contention profiler
+ *
+ * With WINEDEBUG=+csprof, each critical section gets a record of its
+ * acquisitions, of the ones that had to spin or wait, of the time spent
+ * waiting and of the call sites owning the section while others waited.
+ * The records are printed at process exit, or on demand through
+ * __wine_dump_cs_profile.
+ */
+
+#define CS_PROFILE_SIZE     4096  /* must be a power of 2 */
+#define CS_PROFILE_CALLERS  4
+
+#define CS_PROFILE_DELETED  ((RTL_CRITICAL_SECTION *)1)
+
+struct cs_profile
+{
+    RTL_CRITICAL_SECTION *crit;
+    const char           *name;
+    LONG                  entries;      /* acquisitions, not counting recursion */
+    LONG                  spins;        /* contended acquisitions that succeeded by spinning */
+    LONG                  waits;        /* acquisitions that had to block */
+    LONGLONG              wait_time;    /* total time spent blocking, in 100ns units */
+    LONGLONG              max_wait;     /* longest single wait */
+    void                 *owner;        /* call site of the current owner */
+    struct
+    {
+        void *addr;
+        LONG  count;
+    } callers[CS_PROFILE_CALLERS];      /* owner call sites that made threads wait */
+};
+
+static struct cs_profile *cs_profiles;
+
+/* find the profile of a section, optionally creating it */
+static struct cs_profile *get_cs_profile( RTL_CRITICAL_SECTION *crit, BOOL create )
+{
+    struct cs_profile *profiles = cs_profiles, *prof, *free_prof = NULL;
+    RTL_CRITICAL_SECTION *free_crit = NULL;
+    unsigned int i, hash = (ULONG_PTR)crit / sizeof(void *);
+
+    if (!profiles)
+    {
+        void *ptr;
+
+        if (!create) return NULL;
+        ptr = wine_anon_mmap( NULL, CS_PROFILE_SIZE * sizeof(*profiles), PROT_READ | PROT_WRITE, 0 );
+        if (ptr == (void *)-1) return NULL;
+        if ((profiles = interlocked_cmpxchg_ptr( (void **)&cs_profiles, ptr, NULL )))
+            munmap( ptr, CS_PROFILE_SIZE * sizeof(*profiles) );
+        else
+            profiles = ptr;
+    }
+
+    for (i = 0; i < CS_PROFILE_SIZE; i++)
+    {
+        prof = &profiles[(hash + i) & (CS_PROFILE_SIZE - 1)];
+        if (prof->crit == crit) return prof;
+        if (prof->crit == CS_PROFILE_DELETED)
+        {
+            if (!free_prof)
+            {
+                free_prof = prof;
+                free_crit = CS_PROFILE_DELETED;
+            }
+            continue;
+        }
+        if (prof->crit) continue;
+        if (!create) return NULL;
+        if (!free_prof) free_prof = prof;
+        break;
+    }
+    if (!free_prof) return NULL;
+    /* reuse the first deleted entry of the chain, or the free entry that ends it */
+    if (interlocked_cmpxchg_ptr( (void **)&free_prof->crit, crit, free_crit ) == free_crit) return free_prof;
+    return free_prof->crit == crit ? free_prof : NULL;  /* somebody beat us to it */
+}
+
+static void delete_cs_profile( RTL_CRITICAL_SECTION *crit )
+{
+    struct cs_profile *prof;
+
+    if (!(prof = get_cs_profile( crit, FALSE ))) return;
+    /* clear the record before it can be reused */
+    memset( (char *)prof + sizeof(prof->crit), 0, sizeof(*prof) - sizeof(prof->crit) );
+    prof->crit = CS_PROFILE_DELETED;
+}
+
+static void add_wait_time( LONGLONG *dest, LONGLONG time, BOOL max )
+{
+    LONGLONG old, new;
+
+    do
+    {
+        old = *dest;
+        new = max ? (time > old ? time : old) : old + time;
+    } while (old != new && interlocked_cmpxchg64( dest, new, old ) != old);
+}
+
+static void add_wait_caller( struct cs_profile *prof, void *addr )
+{
+    unsigned int i, victim = 0;
+
+    if (!addr) return;
+    for (i = 0; i < CS_PROFILE_CALLERS; i++)
+    {
+        if (prof->callers[i].addr == addr)
+        {
+            interlocked_inc( &prof->callers[i].count );
+            return;
+        }
+        if (prof->callers[i].count < prof->callers[victim].count) victim = i;
+    }
+    /* replace the least frequent call site, the counts are only indicative */
+    prof->callers[victim].addr = addr;
+    prof->callers[victim].count = 1;
+}
+
+static NTSTATUS profile_wait( RTL_CRITICAL_SECTION *crit, struct cs_profile *prof )
+{
+    LARGE_INTEGER start, end;
+    void *owner = prof->owner;
+    NTSTATUS ret;
+
+    if (!prof->name && crit->DebugInfo) prof->name = (const char *)crit->DebugInfo->Spare[0];
+    NtQueryPerformanceCounter( &start, NULL );
+    ret = RtlpWaitForCriticalSection( crit );
+    NtQueryPerformanceCounter( &end, NULL );
+
+    interlocked_inc( &prof->waits );
+    add_wait_time( &prof->wait_time, end.QuadPart - start.QuadPart, FALSE );
+    add_wait_time( &prof->max_wait, end.QuadPart - start.QuadPart, TRUE );
+    add_wait_caller( prof, owner );
+    return ret;
+}
+
+static int cs_profile_compare( const void *p1, const void *p2 )
+{
+    const struct cs_profile *prof1 = *(const struct cs_profile * const *)p1;
+    const struct cs_profile *prof2 = *(const struct cs_profile * const *)p2;
+
+    if (prof1->wait_time != prof2->wait_time) return prof1->wait_time < prof2->wait_time ? 1 : -1;
+    return prof2->spins - prof1->spins;
+}
+
+/***********************************************************************
+ *           __wine_dump_cs_profile   (NTDLL.@)
+ *
+ * Print the contention profile of the critical sections that were
+ * contended at least once, most waited on first.
+ */
+void CDECL __wine_dump_cs_profile(void)
+{
+    struct cs_profile **sorted;
+    unsigned int i, j, count = 0;
+
+    if (!cs_profiles || !TRACE_ON(csprof)) return;
+    if (!(sorted = RtlAllocateHeap( GetProcessHeap(), 0, CS_PROFILE_SIZE * sizeof(*sorted) ))) return;
+
+    for (i = 0; i < CS_PROFILE_SIZE; i++)
+        if (cs_profiles[i].crit && cs_profiles[i].crit != CS_PROFILE_DELETED &&
+            (cs_profiles[i].waits || cs_profiles[i].spins))
+            sorted[count++] = &cs_profiles[i];
+    qsort( sorted, count, sizeof(*sorted), cs_profile_compare );
+
+    TRACE_(csprof)( "%u contended critical sections\n", count );
+    for (i = 0; i < count; i++)
+    {
+        struct cs_profile *prof = sorted[i];
+
+        TRACE_(csprof)( "%p %s: %u entries, %u spun, %u waited, wait %s us total %s us max\n",
+                        prof->crit, debugstr_a(prof->name ? prof->name : "?"), prof->entries,
+                        prof->spins, prof->waits, wine_dbgstr_longlong( prof->wait_time / 10 ),
+                        wine_dbgstr_longlong( prof->max_wait / 10 ));
+        for (j = 0; j < CS_PROFILE_CALLERS; j++)
+            if (prof->callers[j].addr)
+                TRACE_(csprof)( "    owned from %p while waited on %u times\n",
+                                prof->callers[j].addr, prof->callers[j].count );
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, sorted );
+}
+
 /***********************************************************************
  *           get_semaphore
  */
@@ -311,7 +641,7 @@ NTSTATUS WINAPI RtlInitializeCriticalSectionAndSpinCount( RTL_CRITICAL_SECTION *
  */
 NTSTATUS WINAPI RtlInitializeCriticalSectionEx( RTL_CRITICAL_SECTION *crit, ULONG spincount, ULONG flags )
 {
-    if (flags & (RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN|RTL_CRITICAL_SECTION_FLAG_STATIC_INIT))
+    if (flags & RTL_CRITICAL_SECTION_FLAG_STATIC_INIT)
         FIXME("(%p,%u,0x%08x) semi-stub\n", crit, spincount, flags);
 
     /* FIXME: if RTL_CRITICAL_SECTION_FLAG_STATIC_INIT is given, we should use
@@ -340,8 +670,19 @@ NTSTATUS WINAPI RtlInitializeCriticalSectionEx( RTL_CRITICAL_SECTION *crit, ULON
     crit->RecursionCount = 0;
     crit->OwningThread   = 0;
     crit->LockSemaphore  = 0;
-    if (NtCurrentTeb()->Peb->NumberOfProcessors <= 1) spincount = 0;
+    if (NtCurrentTeb()->Peb->NumberOfProcessors <= 1)
+    {
+        crit->SpinCount = 0;
+        delete_spin_state( crit );
+        return STATUS_SUCCESS;
+    }
     crit->SpinCount = spincount & ~0x80000000;
+    if ((flags & RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN) || use_adaptive_spin())
+    {
+        spincount &= ~RTL_CRITICAL_SECTION_ALL_FLAG_BITS;
+        set_spin_state( crit, spincount, spincount / 4 );
+    }
+    else delete_spin_state( crit );
     return STATUS_SUCCESS;
 }
 
@@ -369,8 +710,15 @@ NTSTATUS WINAPI RtlInitializeCriticalSectionEx( RTL_CRITICAL_SECTION *crit, ULON
 ULONG WINAPI RtlSetCriticalSectionSpinCount( RTL_CRITICAL_SECTION *crit, ULONG spincount )
 {
     ULONG oldspincount = crit->SpinCount;
+    struct spin_state *state;
+
     if (NtCurrentTeb()->Peb->NumberOfProcessors <= 1) spincount = 0;
     crit->SpinCount = spincount;
+    if (has_spin_state( crit ))
+    {
+        if (!spincount) delete_spin_state( crit );
+        else if ((state = get_spin_state( crit, FALSE ))) state->max = min( spincount, SPIN_MAX );
+    }
     return oldspincount;
 }
 
@@ -396,6 +744,8 @@ NTSTATUS WINAPI RtlDeleteCriticalSection( RTL_CRITICAL_SECTION *crit )
     crit->LockCount      = -1;
     crit->RecursionCount = 0;
     crit->OwningThread   = 0;
+    delete_spin_state( crit );
+    delete_cs_profile( crit );
     if (crit->DebugInfo)
     {
         /* only free the ones we made in here */
@@ -477,6 +827,9 @@ NTSTATUS WINAPI RtlpWaitForCriticalSection( RTL_CRITICAL_SECTION *crit )
         RtlRaiseException( &rec );
     }
     if (crit->DebugInfo) crit->DebugInfo->ContentionCount++;
+    /* sections without a spin count start spinning once contended */
+    if (!crit->SpinCount && use_adaptive_spin() && !has_spin_state( crit ))
+        set_spin_state( crit, 0, 0 );
     return STATUS_SUCCESS;
 }
 
@@ -538,19 +891,21 @@ NTSTATUS WINAPI RtlpUnWaitCriticalSection( RTL_CRITICAL_SECTION *crit )
  */
 NTSTATUS WINAPI RtlEnterCriticalSection( RTL_CRITICAL_SECTION *crit )
 {
-    if (crit->SpinCount)
+    struct cs_profile *prof = TRACE_ON(csprof) ? get_cs_profile( crit, TRUE ) : NULL;
+    BOOL adaptive = has_spin_state( crit );
+
+    if ((crit->SpinCount || adaptive) && crit->OwningThread != ULongToHandle(GetCurrentThreadId()))
     {
-        ULONG count;
+        struct spin_state *state = adaptive ? get_spin_state( crit, FALSE ) : NULL;
+        ULONG count = 0;
 
-        if (RtlTryEnterCriticalSection( crit )) return STATUS_SUCCESS;
-        for (count = crit->SpinCount; count > 0; count--)
+        if (state) count = spin_enter_adaptive( crit, state );
+        else if (crit->SpinCount) count = spin_enter( crit, crit->SpinCount );
+
+        if (count)
         {
-            if (crit->LockCount > 0) break;  /* more than one waiter, don't bother spinning */
-            if (crit->LockCount == -1)       /* try again */
-            {
-                if (interlocked_cmpxchg( &crit->LockCount, 0, -1 ) == -1) goto done;
-            }
-            small_pause();
+            if (prof && count > 1) interlocked_inc( &prof->spins );
+            goto done;
         }
     }
 
@@ -563,11 +918,19 @@ NTSTATUS WINAPI RtlEnterCriticalSection( RTL_CRITICAL_SECTION *crit )
         }
 
         /* Now wait for it */
-        RtlpWaitForCriticalSection( crit );
+        if (prof) profile_wait( crit, prof );
+        else RtlpWaitForCriticalSection( crit );
     }
 done:
     crit->OwningThread   = ULongToHandle(GetCurrentThreadId());
     crit->RecursionCount = 1;
+    if (prof)
+    {
+        interlocked_inc( &prof->entries );
+#ifdef __GNUC__
+        prof->owner = __builtin_return_address(0);
+#endif
+    }
     return STATUS_SUCCESS;
 }
 
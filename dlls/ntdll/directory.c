@@ -88,6 +88,9 @@
 #ifdef HAVE_SYS_STATFS_H
 #include <sys/statfs.h>
 #endif
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
 #include <time.h>
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
@@ -180,21 +183,34 @@ struct dir_data_names
 
 struct dir_data
 {
+    LONG                    ref;     /* reference count, listings can be shared between handles */
     unsigned int            size;    /* size of the names array */
     unsigned int            count;   /* count of used entries in the names array */
-    unsigned int            pos;     /* current reading position in the names array */
     struct file_identity    id;      /* directory file identity */
     struct dir_data_names  *names;   /* directory file names */
     struct dir_data_buffer *buffer;  /* head of data buffers list */
+    struct list             entry;   /* entry in the shared listings of a dir_cache */
+    UNICODE_STRING          mask;    /* mask of a shared listing */
+    DWORD                   time;    /* tick count when the directory was read */
+};
+
+struct dir_data_ref
+{
+    struct dir_data        *data;    /* directory contents */
+    unsigned int            pos;     /* current reading position in the names array */
 };
 
 static const unsigned int dir_data_buffer_initial_size = 4096;
 static const unsigned int dir_data_cache_initial_size  = 256;
 static const unsigned int dir_data_names_initial_size  = 64;
 
-static struct dir_data **dir_data_cache;
+static struct dir_data_ref *dir_data_cache;
 static unsigned int dir_data_cache_size;
 
+static struct dir_data *get_shared_dir_data( int fd, const UNICODE_STRING *mask, unsigned int *serial );
+static void add_shared_dir_data( struct dir_data *data, int fd, const UNICODE_STRING *mask,
+                                 unsigned int serial );
+
 static BOOL show_dot_files;
 static RTL_RUN_ONCE init_once = RTL_RUN_ONCE_INIT;
 
@@ -378,9 +394,16 @@ static void free_dir_data( struct dir_data *data )
         RtlFreeHeap( GetProcessHeap(), 0, buffer );
     }
     RtlFreeHeap( GetProcessHeap(), 0, data->names );
+    RtlFreeHeap( GetProcessHeap(), 0, data->mask.Buffer );
     RtlFreeHeap( GetProcessHeap(), 0, data );
 }
 
+/* release a reference to the directory data */
+static void release_dir_data( struct dir_data *data )
+{
+    if (data && interlocked_xchg_add( &data->ref, -1 ) == 1) free_dir_data( data );
+}
+
 
 /* support for a directory queue for filesystem searches */
 
@@ -1535,16 +1558,17 @@ static BOOL append_entry( struct dir_data *data, const char *long_name,
  *
  * Return a directory entry from the cached data.
  */
-static NTSTATUS get_dir_data_entry( struct dir_data *dir_data, void *info_ptr, IO_STATUS_BLOCK *io,
-                                    ULONG max_length, FILE_INFORMATION_CLASS class,
+static NTSTATUS get_dir_data_entry( struct dir_data *dir_data, unsigned int pos, void *info_ptr,
+                                    IO_STATUS_BLOCK *io, ULONG max_length, FILE_INFORMATION_CLASS class,
                                     union file_directory_info **last_info )
 {
-    const struct dir_data_names *names = &dir_data->names[dir_data->pos];
+    const struct dir_data_names *names = &dir_data->names[pos];
     union file_directory_info *info;
     struct stat st;
     ULONG name_len, start, dir_size, attributes;
 
-    if (get_file_info( names->unix_name, &st, &attributes ) == -1)
+    /* names only need the file identity, to check that it still exists and isn't ignored */
+    if (get_dir_entry_info( names->unix_name, &st, &attributes, class == FileNamesInformation ) == -1)
     {
         TRACE( "file no longer exists %s\n", names->unix_name );
         return STATUS_SUCCESS;
@@ -1878,6 +1902,9 @@ static NTSTATUS init_cached_dir_data( struct dir_data **data_ret, int fd, const
 
     if (!(data = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*data) )))
         return STATUS_NO_MEMORY;
+    data->ref = 1;
+    data->time = NtGetTickCount();
+    list_init( &data->entry );
 
     if ((status = read_directory_data( data, fd, mask )))
     {
@@ -1921,10 +1948,11 @@ static NTSTATUS init_cached_dir_data( struct dir_data **data_ret, int fd, const
  *
  * Retrieve the cached directory data, or initialize it if necessary.
  */
-static NTSTATUS get_cached_dir_data( HANDLE handle, struct dir_data **data_ret, int fd,
+static NTSTATUS get_cached_dir_data( HANDLE handle, struct dir_data_ref **ref_ret, int fd,
                                      const UNICODE_STRING *mask )
 {
-    unsigned int i;
+    struct dir_data_ref *ref;
+    unsigned int i, serial = 0;
     int entry = -1, free_entries[16];
     NTSTATUS status;
 
@@ -1939,8 +1967,8 @@ static NTSTATUS get_cached_dir_data( HANDLE handle, struct dir_data **data_ret,
             int free_idx = free_entries[i];
             if (free_idx < dir_data_cache_size)
             {
-                free_dir_data( dir_data_cache[free_idx] );
-                dir_data_cache[free_idx] = NULL;
+                release_dir_data( dir_data_cache[free_idx].data );
+                dir_data_cache[free_idx].data = NULL;
             }
         }
     }
@@ -1955,7 +1983,7 @@ static NTSTATUS get_cached_dir_data( HANDLE handle, struct dir_data **data_ret,
     if (entry >= dir_data_cache_size)
     {
         unsigned int size = max( dir_data_cache_initial_size, max( dir_data_cache_size * 2, entry + 1 ) );
-        struct dir_data **new_cache;
+        struct dir_data_ref *new_cache;
 
         if (dir_data_cache)
             new_cache = RtlReAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, dir_data_cache,
@@ -1967,9 +1995,18 @@ static NTSTATUS get_cached_dir_data( HANDLE handle, struct dir_data **data_ret,
         dir_data_cache_size = size;
     }
 
-    if (!dir_data_cache[entry]) status = init_cached_dir_data( &dir_data_cache[entry], fd, mask );
+    ref = &dir_data_cache[entry];
+    if (!ref->data)
+    {
+        ref->pos = 0;
+        /* full listings can be reused from another handle on the same directory */
+        if (has_wildcard( mask ) && (ref->data = get_shared_dir_data( fd, mask, &serial )))
+            TRACE( "reusing listing of %u files\n", ref->data->count );
+        else if (!(status = init_cached_dir_data( &ref->data, fd, mask )) && has_wildcard( mask ))
+            add_shared_dir_data( ref->data, fd, mask, serial );
+    }
 
-    *data_ret = dir_data_cache[entry];
+    *ref_ret = ref;
     return status;
 }
 
@@ -1988,7 +2025,7 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
                                       BOOLEAN restart_scan )
 {
     int cwd, fd, needs_close;
-    struct dir_data *data;
+    struct dir_data_ref *ref;
     NTSTATUS status;
 
     TRACE("(%p %p %p %p %p %p 0x%08x 0x%08x 0x%08x %s 0x%08x\n",
@@ -2038,16 +2075,17 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
     cwd = open( ".", O_RDONLY );
     if (fchdir( fd ) != -1)
     {
-        if (!(status = get_cached_dir_data( handle, &data, fd, mask )))
+        if (!(status = get_cached_dir_data( handle, &ref, fd, mask )))
         {
             union file_directory_info *last_info = NULL;
 
-            if (restart_scan) data->pos = 0;
+            if (restart_scan) ref->pos = 0;
 
-            while (!status && data->pos < data->count)
+            while (!status && ref->pos < ref->data->count)
             {
-                status = get_dir_data_entry( data, buffer, io, length, info_class, &last_info );
-                if (!status || status == STATUS_BUFFER_OVERFLOW) data->pos++;
+                status = get_dir_data_entry( ref->data, ref->pos, buffer, io, length,
+                                             info_class, &last_info );
+                if (!status || status == STATUS_BUFFER_OVERFLOW) ref->pos++;
                 if (single_entry) break;
             }
 
@@ -2069,6 +2107,476 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
 }
 
 
+#ifdef HAVE_SYS_INOTIFY_H
+
+/* Cache of the names of the directories scanned by find_file_in_dir, so that
+ * case-insensitive lookups don't have to read the whole directory every time.
+ * The cached directories are watched with inotify, and a cache is discarded
+ * as soon as an entry of its directory is created, removed or renamed.
+ * The same watch is used to share NtQueryDirectoryFile listings between
+ * handles opened on the same directory. Network file systems are not cached,
+ * inotify doesn't report the changes made by other clients. */
+
+#define DIR_CACHE_MAX_DIRS      128
+#define DIR_CACHE_MAX_LISTINGS  4
+#define DIR_LISTING_LIFETIME    2000  /* ms, not all file systems report remote changes */
+#define DIR_CACHE_EVENTS    (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+                             IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+struct dir_cache_name
+{
+    struct dir_cache_name *next;
+    ULONG                  hash;
+    int                    length;     /* length of the lowercase Unicode name */
+    char                  *unix_name;  /* real name, stored after the Unicode name */
+    WCHAR                  name[1];
+};
+
+struct dir_cache
+{
+    struct list             entry;     /* entry in dir_caches, most recently used first */
+    int                     wd;        /* inotify watch descriptor */
+    unsigned int            serial;    /* unique id, to detect that the cache was recreated */
+    dev_t                   dev;
+    ino_t                   ino;
+    unsigned int            hash_size;
+    struct dir_cache_name **hash;      /* names, read on the first lookup */
+    struct list             listings;  /* shared directory listings, most recent first */
+    unsigned int            listing_count;
+};
+
+static struct list dir_caches = LIST_INIT( dir_caches );
+static unsigned int dir_cache_count;
+static unsigned int dir_cache_serial;
+static int dir_cache_inotify = -1;  /* -2 if inotify isn't available */
+static unsigned int dir_cache_hits, dir_cache_misses, dir_cache_scans;
+static unsigned int dir_listing_hits, dir_listing_misses;
+
+static RTL_CRITICAL_SECTION dir_cache_section;
+static RTL_CRITICAL_SECTION_DEBUG dir_cache_critsect_debug =
+{
+    0, 0, &dir_cache_section,
+    { &dir_cache_critsect_debug.ProcessLocksList, &dir_cache_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": dir_cache_section") }
+};
+static RTL_CRITICAL_SECTION dir_cache_section = { &dir_cache_critsect_debug, -1, 0, 0, 0, 0 };
+
+static ULONG dir_cache_hash( const WCHAR *name, int length )
+{
+    ULONG hash = 0;
+
+    while (length--) hash = hash * 31 + tolowerW( *name++ );
+    return hash;
+}
+
+static struct dir_cache_name *find_dir_cache_name( struct dir_cache *cache, const WCHAR *name,
+                                                   int length, ULONG hash )
+{
+    struct dir_cache_name *entry;
+    int i;
+
+    for (entry = cache->hash[hash % cache->hash_size]; entry; entry = entry->next)
+    {
+        if (entry->hash != hash || entry->length != length) continue;
+        for (i = 0; i < length; i++) if (entry->name[i] != tolowerW( name[i] )) break;
+        if (i == length) return entry;
+    }
+    return NULL;
+}
+
+static void free_dir_cache_names( struct dir_cache *cache )
+{
+    struct dir_cache_name *name, *next;
+    unsigned int i;
+
+    if (!cache->hash) return;
+    for (i = 0; i < cache->hash_size; i++)
+    {
+        for (name = cache->hash[i]; name; name = next)
+        {
+            next = name->next;
+            RtlFreeHeap( GetProcessHeap(), 0, name );
+        }
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, cache->hash );
+    cache->hash = NULL;
+}
+
+static void remove_dir_cache_listing( struct dir_cache *cache, struct dir_data *data )
+{
+    list_remove( &data->entry );
+    list_init( &data->entry );
+    cache->listing_count--;
+    release_dir_data( data );
+}
+
+static void free_dir_cache( struct dir_cache *cache )
+{
+    struct dir_data *data, *next;
+
+    if (cache->wd != -1) inotify_rm_watch( dir_cache_inotify, cache->wd );
+    free_dir_cache_names( cache );
+    LIST_FOR_EACH_ENTRY_SAFE( data, next, &cache->listings, struct dir_data, entry )
+        remove_dir_cache_listing( cache, data );
+    list_remove( &cache->entry );
+    dir_cache_count--;
+    RtlFreeHeap( GetProcessHeap(), 0, cache );
+}
+
+/* create the inotify fd if needed; dir_cache_section must be held */
+static BOOL init_dir_cache_inotify(void)
+{
+    if (dir_cache_inotify == -2) return FALSE;
+    if (dir_cache_inotify != -1) return TRUE;
+
+    if ((dir_cache_inotify = inotify_init()) == -1)
+    {
+        WARN( "inotify not available, directory contents won't be cached\n" );
+        dir_cache_inotify = -2;
+        return FALSE;
+    }
+    fcntl( dir_cache_inotify, F_SETFD, FD_CLOEXEC );
+    fcntl( dir_cache_inotify, F_SETFL, O_NONBLOCK );
+    return TRUE;
+}
+
+/* discard the caches of the directories that changed; dir_cache_section must be held */
+static void process_dir_cache_events(void)
+{
+    char buffer[4096];
+    struct inotify_event *event;
+    struct dir_cache *cache, *next;
+    ssize_t len;
+    char *p;
+
+    while ((len = read( dir_cache_inotify, buffer, sizeof(buffer) )) > 0)
+    {
+        for (p = buffer; p < buffer + len; p += sizeof(*event) + event->len)
+        {
+            event = (struct inotify_event *)p;
+            LIST_FOR_EACH_ENTRY_SAFE( cache, next, &dir_caches, struct dir_cache, entry )
+            {
+                if (!(event->mask & IN_Q_OVERFLOW) && cache->wd != event->wd) continue;
+                /* the watch is already gone if the directory was removed */
+                if (event->mask & IN_IGNORED) cache->wd = -1;
+                free_dir_cache( cache );
+            }
+        }
+    }
+}
+
+/* find the cache of a directory and mark it as recently used; dir_cache_section must be held */
+static struct dir_cache *find_dir_cache( const struct stat *st )
+{
+    struct dir_cache *cache;
+
+    LIST_FOR_EACH_ENTRY( cache, &dir_caches, struct dir_cache, entry )
+    {
+        if (cache->dev != st->st_dev || cache->ino != st->st_ino) continue;
+        list_remove( &cache->entry );
+        list_add_head( &dir_caches, &cache->entry );
+        return cache;
+    }
+    return NULL;
+}
+
+/* check if a directory is on a file system whose remote changes inotify doesn't see */
+static BOOL is_remote_dir( const char *unix_name )
+{
+#ifdef __linux__
+    struct statfs stfs;
+
+    if (statfs( unix_name, &stfs ) == -1) return TRUE;
+    switch ((unsigned int)stfs.f_type)
+    {
+    case 0x6969:      /* NFS_SUPER_MAGIC */
+    case 0x517b:      /* SMB_SUPER_MAGIC */
+    case 0xff534d42:  /* CIFS_MAGIC_NUMBER */
+    case 0xfe534d42:  /* SMB2_MAGIC_NUMBER */
+    case 0x65735546:  /* FUSE_SUPER_MAGIC */
+    case 0x73757245:  /* CODA_SUPER_MAGIC */
+    case 0x5346414f:  /* AFS_SUPER_MAGIC */
+    case 0x00c36400:  /* CEPH_SUPER_MAGIC */
+    case 0x01021997:  /* V9FS_MAGIC */
+        return TRUE;
+    }
+#endif
+    return FALSE;
+}
+
+/* create a new watched cache for a directory; dir_cache_section must be held */
+static struct dir_cache *create_dir_cache( const char *unix_name, const struct stat *st )
+{
+    struct dir_cache *cache;
+
+    if (is_remote_dir( unix_name )) return NULL;
+
+    if (dir_cache_count >= DIR_CACHE_MAX_DIRS)
+        free_dir_cache( LIST_ENTRY( list_tail( &dir_caches ), struct dir_cache, entry ));
+
+    if (!(cache = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*cache) ))) return NULL;
+    cache->dev = st->st_dev;
+    cache->ino = st->st_ino;
+    cache->hash_size = 0;
+    cache->hash = NULL;
+    cache->listing_count = 0;
+    list_init( &cache->listings );
+    if (!++dir_cache_serial) dir_cache_serial++;
+    cache->serial = dir_cache_serial;
+
+    /* the directory is watched before being read so that no change is missed */
+    if ((cache->wd = inotify_add_watch( dir_cache_inotify, unix_name, DIR_CACHE_EVENTS )) == -1)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, cache );
+        return NULL;
+    }
+    list_add_head( &dir_caches, &cache->entry );
+    dir_cache_count++;
+    return cache;
+}
+
+/* read the names of a whole directory into its cache; dir_cache_section must be held */
+static BOOL read_dir_cache_names( struct dir_cache *cache, const char *unix_name )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN];
+    struct dir_cache_name *name;
+    struct dirent *de;
+    unsigned int count = 0, i;
+    ULONG hash;
+    DIR *dir;
+    int ret;
+
+    cache->hash_size = 64;
+    if (!(cache->hash = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                         cache->hash_size * sizeof(*cache->hash) )))
+        return FALSE;
+    if (!(dir = opendir( unix_name )))
+    {
+        free_dir_cache_names( cache );
+        return FALSE;
+    }
+
+    while ((de = readdir( dir )))
+    {
+        int len = strlen( de->d_name );
+
+        ret = ntdll_umbstowcs( 0, de->d_name, len, buffer, MAX_DIR_ENTRY_LEN );
+        if (ret <= 0) continue;
+
+        /* keep the first of the names that only differ by case, like the scan does */
+        hash = dir_cache_hash( buffer, ret );
+        if (find_dir_cache_name( cache, buffer, ret, hash )) continue;
+
+        if (count >= cache->hash_size * 2)
+        {
+            struct dir_cache_name **hash, *next;
+            unsigned int size = cache->hash_size * 4;
+
+            if (!(hash = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, size * sizeof(*hash) )))
+                goto failed;
+            for (i = 0; i < cache->hash_size; i++)
+            {
+                for (name = cache->hash[i]; name; name = next)
+                {
+                    next = name->next;
+                    name->next = hash[name->hash % size];
+                    hash[name->hash % size] = name;
+                }
+            }
+            RtlFreeHeap( GetProcessHeap(), 0, cache->hash );
+            cache->hash = hash;
+            cache->hash_size = size;
+        }
+
+        if (!(name = RtlAllocateHeap( GetProcessHeap(), 0,
+                                      FIELD_OFFSET( struct dir_cache_name, name[ret] ) + len + 1 )))
+            goto failed;
+        name->hash      = hash;
+        name->length    = ret;
+        name->unix_name = (char *)&name->name[ret];
+        for (i = 0; i < ret; i++) name->name[i] = tolowerW( buffer[i] );
+        memcpy( name->unix_name, de->d_name, len + 1 );
+        name->next = cache->hash[hash % cache->hash_size];
+        cache->hash[hash % cache->hash_size] = name;
+        count++;
+    }
+    closedir( dir );
+    dir_cache_scans++;
+    TRACE( "cached %u entries of %s (%u hits, %u misses, %u scans)\n",
+           count, debugstr_a(unix_name), dir_cache_hits, dir_cache_misses, dir_cache_scans );
+    return TRUE;
+
+failed:
+    closedir( dir );
+    free_dir_cache_names( cache );
+    return FALSE;
+}
+
+/***********************************************************************
+ *           lookup_dir_cache
+ *
+ * Look for a name in the cached directory. Returns 1 and stores the Unix
+ * name if found, 0 if not found, and -1 if the directory can't be cached.
+ */
+static int lookup_dir_cache( const char *unix_name, const WCHAR *name, int length, char *real_name )
+{
+    struct dir_cache *cache;
+    struct dir_cache_name *entry;
+    struct stat st;
+    int ret = 0;
+
+    if (dir_cache_inotify == -2) return -1;
+    if (stat( unix_name, &st ) == -1 || !S_ISDIR( st.st_mode )) return -1;
+
+    RtlEnterCriticalSection( &dir_cache_section );
+
+    if (!init_dir_cache_inotify())
+    {
+        RtlLeaveCriticalSection( &dir_cache_section );
+        return -1;
+    }
+    process_dir_cache_events();
+
+    if (!(cache = find_dir_cache( &st )) && !(cache = create_dir_cache( unix_name, &st )))
+    {
+        RtlLeaveCriticalSection( &dir_cache_section );
+        return -1;
+    }
+    if (!cache->hash && !read_dir_cache_names( cache, unix_name ))
+    {
+        free_dir_cache( cache );
+        RtlLeaveCriticalSection( &dir_cache_section );
+        return -1;
+    }
+
+    if ((entry = find_dir_cache_name( cache, name, length, dir_cache_hash( name, length ) )))
+    {
+        strcpy( real_name, entry->unix_name );
+        dir_cache_hits++;
+        ret = 1;
+    }
+    else dir_cache_misses++;
+
+    RtlLeaveCriticalSection( &dir_cache_section );
+    return ret;
+}
+
+static BOOL is_same_mask( const UNICODE_STRING *mask1, const UNICODE_STRING *mask2 )
+{
+    USHORT len1 = mask1 ? mask1->Length : 0, len2 = mask2 ? mask2->Length : 0;
+
+    return len1 == len2 && (!len1 || !memcmp( mask1->Buffer, mask2->Buffer, len1 ));
+}
+
+/* drop the shared listings that are too old; dir_cache_section must be held */
+static void expire_dir_cache_listings( struct dir_cache *cache, DWORD now )
+{
+    struct dir_data *data, *next;
+
+    LIST_FOR_EACH_ENTRY_SAFE( data, next, &cache->listings, struct dir_data, entry )
+        if (now - data->time > DIR_LISTING_LIFETIME) remove_dir_cache_listing( cache, data );
+}
+
+/***********************************************************************
+ *           get_shared_dir_data
+ *
+ * Look for a listing of the current directory, read with the same mask
+ * through another handle, that can be reused. The serial of the directory
+ * cache is returned for add_shared_dir_data(), even if none is found.
+ */
+static struct dir_data *get_shared_dir_data( int fd, const UNICODE_STRING *mask, unsigned int *serial )
+{
+    struct dir_cache *cache;
+    struct dir_data *data, *ret = NULL;
+    struct stat st;
+
+    if (dir_cache_inotify == -2 || fstat( fd, &st ) == -1) return NULL;
+
+    RtlEnterCriticalSection( &dir_cache_section );
+
+    if (init_dir_cache_inotify())
+    {
+        process_dir_cache_events();
+        if ((cache = find_dir_cache( &st )) || (cache = create_dir_cache( ".", &st )))
+        {
+            *serial = cache->serial;
+            expire_dir_cache_listings( cache, NtGetTickCount() );
+            LIST_FOR_EACH_ENTRY( data, &cache->listings, struct dir_data, entry )
+            {
+                if (!is_same_mask( &data->mask, mask )) continue;
+                interlocked_xchg_add( &data->ref, 1 );
+                ret = data;
+                break;
+            }
+        }
+        if (ret) dir_listing_hits++;
+        else dir_listing_misses++;
+        TRACE( "%u listing hits, %u misses\n", dir_listing_hits, dir_listing_misses );
+    }
+
+    RtlLeaveCriticalSection( &dir_cache_section );
+    return ret;
+}
+
+/***********************************************************************
+ *           add_shared_dir_data
+ *
+ * Make a listing available to other handles, if the directory hasn't
+ * changed since the cache identified by serial was created.
+ */
+static void add_shared_dir_data( struct dir_data *data, int fd, const UNICODE_STRING *mask,
+                                 unsigned int serial )
+{
+    struct dir_cache *cache;
+    struct stat st;
+    DWORD now = NtGetTickCount();
+
+    if (!serial || fstat( fd, &st ) == -1) return;
+    if (mask && !(data->mask.Buffer = RtlAllocateHeap( GetProcessHeap(), 0, mask->Length ))) return;
+    if (mask)
+    {
+        memcpy( data->mask.Buffer, mask->Buffer, mask->Length );
+        data->mask.Length = data->mask.MaximumLength = mask->Length;
+    }
+
+    RtlEnterCriticalSection( &dir_cache_section );
+
+    process_dir_cache_events();
+    LIST_FOR_EACH_ENTRY( cache, &dir_caches, struct dir_cache, entry )
+        expire_dir_cache_listings( cache, now );
+
+    if ((cache = find_dir_cache( &st )) && cache->serial == serial)
+    {
+        if (cache->listing_count >= DIR_CACHE_MAX_LISTINGS)
+            remove_dir_cache_listing( cache, LIST_ENTRY( list_tail( &cache->listings ),
+                                                         struct dir_data, entry ));
+        interlocked_xchg_add( &data->ref, 1 );
+        list_add_head( &cache->listings, &data->entry );
+        cache->listing_count++;
+    }
+
+    RtlLeaveCriticalSection( &dir_cache_section );
+}
+
+#else  /* HAVE_SYS_INOTIFY_H */
+
+static inline int lookup_dir_cache( const char *unix_name, const WCHAR *name, int length, char *real_name )
+{
+    return -1;
+}
+
+static struct dir_data *get_shared_dir_data( int fd, const UNICODE_STRING *mask, unsigned int *serial )
+{
+    return NULL;
+}
+
+static void add_shared_dir_data( struct dir_data *data, int fd, const UNICODE_STRING *mask,
+                                 unsigned int serial )
+{
+}
+
+#endif  /* HAVE_SYS_INOTIFY_H */
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2120,6 +2628,18 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
 
     if (!is_name_8_dot_3 && !get_dir_case_sensitivity( unix_name )) goto not_found;
 
+    /* the cache knows all the long names, only mangled short names need a scan */
+
+    switch (lookup_dir_cache( unix_name, name, length, unix_name + pos ))
+    {
+    case 1:
+        unix_name[pos - 1] = '/';
+        goto success;
+    case 0:
+        if (!is_name_8_dot_3 || !memchrW( name, '~', length )) goto not_found;
+        break;
+    }
+
     /* now look for it through the directory */
 
 #ifdef VFAT_IOCTL_READDIR_BOTH
@@ -16,6 +16,8 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
  */
 
+#define _GNU_SOURCE  /* for statx */
+
 #include "config.h"
 #include "wine/port.h"
 
@@ -167,6 +169,107 @@ int get_file_info( const char *path, struct stat *st, ULONG *attr )
     return ret;
 }
 
+#ifdef HAVE_STATX
+/* statx() wrapper that only requests the fields in mask, with the same consistency as stat() */
+static int stat_with_mask( const char *path, int flags, unsigned int mask, struct stat *st )
+{
+    struct statx stx;
+
+    if (statx( AT_FDCWD, path, flags | AT_STATX_SYNC_AS_STAT, mask, &stx ) == -1) return -1;
+
+    memset( st, 0, sizeof(*st) );
+    st->st_dev   = makedev( stx.stx_dev_major, stx.stx_dev_minor );
+    st->st_ino   = stx.stx_ino;
+    st->st_mode  = stx.stx_mode;
+    st->st_nlink = stx.stx_nlink;
+    st->st_uid   = stx.stx_uid;
+    st->st_gid   = stx.stx_gid;
+    st->st_size  = stx.stx_size;
+    st->st_blocks = stx.stx_blocks;
+    st->st_atim.tv_sec  = stx.stx_atime.tv_sec;
+    st->st_atim.tv_nsec = stx.stx_atime.tv_nsec;
+    st->st_mtim.tv_sec  = stx.stx_mtime.tv_sec;
+    st->st_mtim.tv_nsec = stx.stx_mtime.tv_nsec;
+    st->st_ctim.tv_sec  = stx.stx_ctime.tv_sec;
+    st->st_ctim.tv_nsec = stx.stx_ctime.tv_nsec;
+    return 0;
+}
+#endif
+
+/* get the stat info and file attributes for a directory entry (by name) */
+/* with names_only, only the file type and identity are guaranteed to be valid */
+int get_dir_entry_info( const char *path, struct stat *st, ULONG *attr, BOOL names_only )
+{
+#ifdef HAVE_STATX
+    static int statx_supported = 1;
+    unsigned int mask = names_only ? STATX_TYPE | STATX_MODE | STATX_INO : STATX_BASIC_STATS;
+
+    if (statx_supported)
+    {
+        *attr = 0;
+        if (!stat_with_mask( path, AT_SYMLINK_NOFOLLOW, mask, st ))
+        {
+            if (S_ISLNK( st->st_mode ))
+            {
+                if (stat_with_mask( path, 0, mask, st ) == -1) return -1;
+                /* is a symbolic link and a directory, consider these "reparse points" */
+                if (S_ISDIR( st->st_mode )) *attr |= FILE_ATTRIBUTE_REPARSE_POINT;
+            }
+            *attr |= get_file_attributes( st );
+            return 0;
+        }
+        if (errno != ENOSYS) return -1;
+        statx_supported = 0;
+    }
+#endif
+    return get_file_info( path, st, attr );
+}
+
+/**************************************************************************
+ *                 open_existing_file_fd              (internal)
+ *
+ * Fast path for plain opens of existing regular files: the unix fd is
+ * opened by the client and passed to the server with the create_file
+ * request, so that it can be cached right away instead of being fetched
+ * again with get_handle_fd on the first I/O. The server still performs
+ * the sharing checks. Returns -1 if the fast path can't be used.
+ */
+static int open_existing_file_fd( const ANSI_STRING *unix_name, ACCESS_MASK access,
+                                  const OBJECT_ATTRIBUTES *attr, ULONG disposition, ULONG options )
+{
+    struct stat st, st2;
+    int fd, flags;
+
+    if (disposition != FILE_OPEN || attr->RootDirectory || attr->SecurityDescriptor) return -1;
+    if (options & (FILE_DIRECTORY_FILE | FILE_DELETE_ON_CLOSE | FILE_OPEN_BY_FILE_ID)) return -1;
+    if (access & MAXIMUM_ALLOWED) return -1;
+    if (unix_name->Buffer[0] != '/') return -1;
+
+    if (access & GENERIC_READ)    access |= FILE_GENERIC_READ;
+    if (access & GENERIC_WRITE)   access |= FILE_GENERIC_WRITE;
+    if (access & GENERIC_EXECUTE) access |= FILE_GENERIC_EXECUTE;
+    if (access & GENERIC_ALL)     access |= FILE_ALL_ACCESS;
+
+    /* same mode selection as open_fd() in the server */
+    if (access & (FILE_WRITE_DATA | FILE_APPEND_DATA | FILE_WRITE_ATTRIBUTES | FILE_WRITE_EA))
+    {
+        if (access & (FILE_READ_DATA | FILE_READ_ATTRIBUTES | FILE_READ_EA)) flags = O_RDWR;
+        else flags = O_WRONLY;
+    }
+    else flags = O_RDONLY;
+
+    /* don't risk opening devices or fifos, they may have side effects */
+    if (stat( unix_name->Buffer, &st ) == -1 || !S_ISREG( st.st_mode )) return -1;
+    if ((fd = open( unix_name->Buffer, flags | O_NONBLOCK | O_LARGEFILE )) == -1) return -1;
+    if (fstat( fd, &st2 ) == -1 || st2.st_dev != st.st_dev || st2.st_ino != st.st_ino)
+    {
+        close( fd );
+        return -1;
+    }
+    fcntl( fd, F_SETFD, FD_CLOEXEC );
+    return fd;
+}
+
 /**************************************************************************
  *                 FILE_CreateFile                    (internal)
  * Open a file.
@@ -227,6 +330,8 @@ static NTSTATUS FILE_CreateFile( PHANDLE handle, ACCESS_MASK access, POBJECT_ATT
         OBJECT_ATTRIBUTES unix_attr = *attr;
         data_size_t len;
         struct object_attributes *objattr;
+        unsigned int fd_access = 0, fd_options = 0;
+        int unix_fd = -1, cacheable = 0;
 
         unix_attr.ObjectName = &empty_string;  /* we send the unix name instead */
         if ((io->u.Status = alloc_object_attributes( &unix_attr, &objattr, &len )))
@@ -235,6 +340,9 @@ static NTSTATUS FILE_CreateFile( PHANDLE handle, ACCESS_MASK access, POBJECT_ATT
             return io->u.Status;
         }
 
+        if (!created) unix_fd = open_existing_file_fd( &unix_name, access, attr, disposition, options );
+        if (unix_fd != -1) wine_server_send_fd( unix_fd );
+
         SERVER_START_REQ( create_file )
         {
             req->access     = access;
@@ -242,12 +350,19 @@ static NTSTATUS FILE_CreateFile( PHANDLE handle, ACCESS_MASK access, POBJECT_ATT
             req->create     = disposition;
             req->options    = options;
             req->attrs      = attributes;
+            req->unix_fd    = unix_fd;
             wine_server_add_data( req, objattr, len );
             wine_server_add_data( req, unix_name.Buffer, unix_name.Length );
             io->u.Status = wine_server_call( req );
             *handle = wine_server_ptr_handle( reply->handle );
+            cacheable  = reply->cacheable;
+            fd_access  = reply->access;
+            fd_options = reply->options;
         }
         SERVER_END_REQ;
+        if (unix_fd != -1 && (io->u.Status || !cacheable ||
+            !server_add_fd_to_cache( *handle, unix_fd, FD_TYPE_FILE, fd_access, fd_options )))
+            close( unix_fd );
         RtlFreeHeap( GetProcessHeap(), 0, objattr );
         RtlFreeAnsiString( &unix_name );
     }
@@ -2360,7 +2475,7 @@ NTSTATUS WINAPI NtQueryInformationFile( HANDLE hFile, PIO_STATUS_BLOCK io,
         0,                                             /* FileIdFullDirectoryInformation */
         0,                                             /* FileValidDataLengthInformation */
         0,                                             /* FileShortNameInformation */
-        0,                                             /* FileIoCompletionNotificationInformation, */
+        sizeof(FILE_IO_COMPLETION_NOTIFICATION_INFORMATION), /* FileIoCompletionNotificationInformation */
         0,                                             /* FileIoStatusBlockRangeInformation */
         0,                                             /* FileIoPriorityHintInformation */
         0,                                             /* FileSfioReserveInformation */
@@ -2613,6 +2728,19 @@ NTSTATUS WINAPI NtQueryInformationFile( HANDLE hFile, PIO_STATUS_BLOCK io,
             }
         }
         break;
+    case FileIoCompletionNotificationInformation:
+        {
+            FILE_IO_COMPLETION_NOTIFICATION_INFORMATION *info = ptr;
+
+            SERVER_START_REQ( set_fd_completion_mode )
+            {
+                req->handle = wine_server_obj_handle( hFile );
+                req->flags  = 0;
+                if (!(io->u.Status = wine_server_call( req ))) info->Flags = reply->flags;
+            }
+            SERVER_END_REQ;
+        }
+        break;
     default:
         FIXME("Unsupported class (%d)\n", class);
         io->u.Status = STATUS_NOT_IMPLEMENTED;
@@ -2788,6 +2916,16 @@ NTSTATUS WINAPI NtSetInformationFile(HANDLE handle, PIO_STATUS_BLOCK io,
             io->u.Status = STATUS_INVALID_PARAMETER_3;
         break;
 
+    case FileIoCompletionNotificationInformation:
+        if (len >= sizeof(FILE_IO_COMPLETION_NOTIFICATION_INFORMATION))
+        {
+            FILE_IO_COMPLETION_NOTIFICATION_INFORMATION *info = ptr;
+            io->u.Status = server_set_fd_completion_mode( handle, info->Flags );
+        }
+        else
+            io->u.Status = STATUS_INFO_LENGTH_MISMATCH;
+        break;
+
     case FileAllInformation:
         io->u.Status = STATUS_INVALID_INFO_CLASS;
         break;
@@ -3616,8 +3754,12 @@ NTSTATUS WINAPI NtDeleteFile( POBJECT_ATTRIBUTES ObjectAttributes )
  */
 NTSTATUS WINAPI NtCancelIoFileEx( HANDLE hFile, PIO_STATUS_BLOCK iosb, PIO_STATUS_BLOCK io_status )
 {
+    int count;
+
     TRACE("%p %p %p\n", hFile, iosb, io_status );
 
+    count = server_cancel_async_io( hFile, iosb, FALSE, STATUS_CANCELLED );
+
     SERVER_START_REQ( cancel_async )
     {
         req->handle      = wine_server_obj_handle( hFile );
@@ -3627,6 +3769,7 @@ NTSTATUS WINAPI NtCancelIoFileEx( HANDLE hFile, PIO_STATUS_BLOCK iosb, PIO_STATU
     }
     SERVER_END_REQ;
 
+    if (count && io_status->u.Status == STATUS_NOT_FOUND) io_status->u.Status = STATUS_SUCCESS;
     return io_status->u.Status;
 }
 
@@ -3639,6 +3782,8 @@ NTSTATUS WINAPI NtCancelIoFile( HANDLE hFile, PIO_STATUS_BLOCK io_status )
 {
     TRACE("%p %p\n", hFile, io_status );
 
+    server_cancel_async_io( hFile, NULL, TRUE, STATUS_CANCELLED );
+
     SERVER_START_REQ( cancel_async )
     {
         req->handle      = wine_server_obj_handle( hFile );
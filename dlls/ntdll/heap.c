@@ -86,6 +86,9 @@ typedef struct
 #define ARENA_FREE_MAGIC       0x45455246
 #define ARENA_LARGE_MAGIC      0x6752614c
 
+#define ARENA_LFH_MAGIC        0x48464c
+#define ARENA_LFH_FREE_MAGIC   0x45464c
+
 #define ARENA_INUSE_FILLER     0x55
 #define ARENA_TAIL_FILLER      0xab
 #define ARENA_FREE_FILLER      0xfeeefeee
@@ -128,6 +131,63 @@ typedef union
 
 struct tagHEAP;
 
+/* Low-fragmentation heap front-end: small blocks are carved out of slabs,
+ * which are themselves in-use blocks of the heap.  Each slab holds blocks
+ * of a single size class and keeps its free blocks in a lock-free stack,
+ * so that allocating and freeing don't need the heap critical section.
+ */
+
+typedef struct
+{
+    WORD   block;                   /* Index of the block in its slab */
+    WORD   data_size;               /* Size of user data */
+    DWORD  magic : 24;              /* Magic number; same position as in ARENA_INUSE */
+    DWORD  bucket : 8;              /* Size class of the block */
+} ARENA_LFH;
+
+C_ASSERT( sizeof(ARENA_LFH) == sizeof(ARENA_INUSE) );
+
+#define LFH_MAX_SIZE          0x4000  /* max size of user data for LFH blocks */
+#define LFH_NB_BUCKETS        64      /* number of size classes */
+#define LFH_AFFINITY_SLOTS    8       /* number of slabs in use per size class */
+#define LFH_SLAB_SIZE         0x10000 /* default size of a slab */
+#define LFH_MIN_SLAB_BLOCKS   8       /* min number of blocks in a slab */
+#define LFH_NO_BLOCK          0xffffffff
+#define LFH_SLAB_MAP_SIZE     4096    /* entries in the slab lookup table */
+#define LFH_SLAB_MAP_SHIFT    16      /* granularity of the slab lookup table */
+
+typedef struct tagLFH_SLAB
+{
+    struct list         entry;      /* Entry in bucket slab list */
+    struct tagHEAP     *heap;       /* Main heap structure */
+    LONG64              free_head;  /* Free blocks stack: index in low part, ABA tag in high part */
+    DWORD               nb_blocks;  /* Number of blocks in the slab */
+    DWORD               bucket;     /* Size class of the blocks */
+    DWORD               magic;      /* Magic number */
+} LFH_SLAB;
+
+#define LFH_SLAB_MAGIC   ((DWORD)('L' | ('F'<<8) | ('H'<<16) | ('S'<<24)))
+
+/* offset of the first block arena from the start of the slab */
+#define LFH_SLAB_HEADER  (((sizeof(LFH_SLAB) + ALIGNMENT - 1) & ~(ALIGNMENT - 1)) + ARENA_OFFSET)
+
+typedef struct
+{
+    LFH_SLAB * volatile active[LFH_AFFINITY_SLOTS];  /* Slabs used for allocation */
+    struct list         slabs;      /* All the slabs of this size class */
+} LFH_BUCKET;
+
+/* Slabs are never freed, so they are also indexed by address in an insert-only
+ * open addressing table, one entry for each 64k chunk a slab overlaps.  This
+ * lets the lock-free paths check that a pointer is inside a slab before
+ * reading its arena. */
+typedef struct
+{
+    LFH_BUCKET          buckets[LFH_NB_BUCKETS];
+    LFH_SLAB * volatile slab_map[LFH_SLAB_MAP_SIZE];  /* Slabs by address chunk */
+    unsigned int        slab_map_count;             /* Used entries in slab_map */
+} LFH_HEAP;
+
 typedef struct tagSUBHEAP
 {
     void               *base;       /* Base address of the sub-heap memory block */
@@ -158,6 +218,7 @@ typedef struct tagHEAP
     ARENA_INUSE    **pending_free;  /* Ring buffer for pending free requests */
     RTL_CRITICAL_SECTION critSection; /* Critical section for serialization */
     FREE_LIST_ENTRY *freeList;      /* Free lists */
+    LFH_HEAP        *lfh;           /* Low-fragmentation front-end, if enabled */
 } HEAP;
 
 #define HEAP_MAGIC       ((DWORD)('H' | ('E'<<8) | ('A'<<16) | ('P'<<24)))
@@ -174,7 +235,10 @@ typedef struct tagHEAP
 
 static HEAP *processHeap;  /* main process heap */
 
+ULONG heap_compatibility = 0;  /* HeapCompatibilityInformation for new heaps */
+
 static BOOL HEAP_IsRealArena( HEAP *heapPtr, DWORD flags, LPCVOID block, BOOL quiet );
+static ARENA_LFH *lfh_find_block( HEAP *heap, const void *ptr );
 
 /* mark a block of memory as free for debugging purposes */
 static inline void mark_block_free( void *ptr, SIZE_T size, DWORD flags )
@@ -1327,6 +1391,9 @@ static BOOL HEAP_IsRealArena( HEAP *heapPtr,   /* [in] ptr to the heap */
 
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
+
+    if (block && lfh_find_block( heapPtr, block )) return TRUE;
+
     /* calling HeapLock may result in infinite recursion, so do the critsect directly */
     if (!(flags & HEAP_NO_SERIALIZE))
         RtlEnterCriticalSection( &heapPtr->critSection );
@@ -1437,6 +1504,304 @@ static BOOL validate_block_pointer( HEAP *heap, SUBHEAP **ret_subheap, const ARE
 }
 
 
+/***********************************************************************
+ *           get_lfh_bucket
+ *
+ * Size classes are 16-byte steps up to 256 bytes, then 8 steps for
+ * each power of two up to LFH_MAX_SIZE.
+ */
+static inline unsigned int get_lfh_bucket( SIZE_T size )
+{
+    unsigned int bit;
+
+    if (size <= 0x100) return size ? (size - 1) / 16 : 0;
+    bit = RtlFindMostSignificantBit( size - 1 );
+    return 16 + (bit - 8) * 8 + (((size - 1) >> (bit - 3)) & 7);
+}
+
+
+/***********************************************************************
+ *           get_lfh_block_size
+ *
+ * Size of a block of the given size class, including its arena.
+ */
+static inline SIZE_T get_lfh_block_size( unsigned int bucket )
+{
+    SIZE_T size;
+
+    if (bucket < 16) size = (bucket + 1) * 16;
+    else size = (SIZE_T)(9 + (bucket - 16) % 8) << (5 + (bucket - 16) / 8);
+    return size + ALIGNMENT;
+}
+
+
+static inline ARENA_LFH *get_lfh_arena( LFH_SLAB *slab, unsigned int bucket, DWORD block )
+{
+    return (ARENA_LFH *)((char *)slab + LFH_SLAB_HEADER + block * get_lfh_block_size( bucket ));
+}
+
+
+/***********************************************************************
+ *           lfh_pop_block
+ *
+ * Take a free block from a slab; return NULL if the slab is full.
+ */
+static ARENA_LFH *lfh_pop_block( LFH_SLAB *slab, unsigned int bucket )
+{
+    ULONG64 head, next;
+    ARENA_LFH *arena;
+
+    do
+    {
+        head = slab->free_head;
+        if ((DWORD)head == LFH_NO_BLOCK) return NULL;
+        /* the block may be allocated in the meantime, the tag then makes the exchange fail */
+        arena = get_lfh_arena( slab, bucket, (DWORD)head );
+        next = (((head >> 32) + 1) << 32) | *(DWORD *)(arena + 1);
+    } while (interlocked_cmpxchg64( &slab->free_head, next, head ) != head);
+
+    arena->magic = ARENA_LFH_MAGIC;
+    return arena;
+}
+
+
+/***********************************************************************
+ *           lfh_push_block
+ *
+ * Give a block back to its slab.
+ */
+static void lfh_push_block( LFH_SLAB *slab, ARENA_LFH *arena )
+{
+    ULONG64 head, next;
+
+    arena->magic = ARENA_LFH_FREE_MAGIC;
+    do
+    {
+        head = slab->free_head;
+        *(DWORD *)(arena + 1) = (DWORD)head;
+        next = (((head >> 32) + 1) << 32) | arena->block;
+    } while (interlocked_cmpxchg64( &slab->free_head, next, head ) != head);
+}
+
+
+static inline unsigned int lfh_slab_map_hash( ULONG_PTR chunk )
+{
+    return (ULONG)(chunk * 2654435761u) % LFH_SLAB_MAP_SIZE;
+}
+
+
+/***********************************************************************
+ *           lfh_add_slab_to_map
+ *
+ * Index a new slab by address. Must be called with the heap lock held.
+ */
+static BOOL lfh_add_slab_to_map( LFH_HEAP *lfh, LFH_SLAB *slab, SIZE_T size )
+{
+    ULONG_PTR chunk, first = (ULONG_PTR)slab >> LFH_SLAB_MAP_SHIFT;
+    ULONG_PTR last = ((ULONG_PTR)slab + size - 1) >> LFH_SLAB_MAP_SHIFT;
+    unsigned int i;
+
+    /* keep the table sparse enough for the probe sequences to stay short */
+    if (lfh->slab_map_count + (last - first + 1) > LFH_SLAB_MAP_SIZE / 2) return FALSE;
+
+    for (chunk = first; chunk <= last; chunk++)
+    {
+        for (i = lfh_slab_map_hash( chunk ); lfh->slab_map[i]; i = (i + 1) % LFH_SLAB_MAP_SIZE) ;
+        interlocked_xchg_ptr( (void **)&lfh->slab_map[i], slab );
+        lfh->slab_map_count++;
+    }
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           lfh_find_slab
+ *
+ * Return the slab containing a pointer, without accessing the pointer.
+ */
+static LFH_SLAB *lfh_find_slab( LFH_HEAP *lfh, const void *ptr )
+{
+    unsigned int i = lfh_slab_map_hash( (ULONG_PTR)ptr >> LFH_SLAB_MAP_SHIFT );
+    LFH_SLAB *slab;
+
+    while ((slab = lfh->slab_map[i]))
+    {
+        const char *start = (const char *)slab + LFH_SLAB_HEADER;
+
+        if ((const char *)ptr >= start &&
+            (const char *)ptr < start + slab->nb_blocks * get_lfh_block_size( slab->bucket ))
+            return slab;
+        i = (i + 1) % LFH_SLAB_MAP_SIZE;
+    }
+    return NULL;
+}
+
+
+/***********************************************************************
+ *           lfh_create_slab
+ *
+ * Allocate a new slab for a size class. Must be called with the heap lock held.
+ */
+static LFH_SLAB *lfh_create_slab( HEAP *heap, unsigned int bucket )
+{
+    SIZE_T block_size = get_lfh_block_size( bucket );
+    DWORD i, count = max( (LFH_SLAB_SIZE - LFH_SLAB_HEADER) / block_size, LFH_MIN_SLAB_BLOCKS );
+    LFH_SLAB *slab;
+
+    if (!(slab = RtlAllocateHeap( heap, HEAP_NO_SERIALIZE, LFH_SLAB_HEADER + count * block_size )))
+        return NULL;
+
+    for (i = 0; i < count; i++)
+    {
+        ARENA_LFH *arena = get_lfh_arena( slab, bucket, i );
+        arena->block  = i;
+        arena->bucket = bucket;
+        arena->magic  = ARENA_LFH_FREE_MAGIC;
+        *(DWORD *)(arena + 1) = (i < count - 1) ? i + 1 : LFH_NO_BLOCK;
+    }
+    slab->heap      = heap;
+    slab->free_head = 0;
+    slab->nb_blocks = count;
+    slab->bucket    = bucket;
+    slab->magic     = LFH_SLAB_MAGIC;
+    if (!lfh_add_slab_to_map( heap->lfh, slab, LFH_SLAB_HEADER + count * block_size ))
+    {
+        RtlFreeHeap( heap, HEAP_NO_SERIALIZE, slab );
+        return NULL;
+    }
+    list_add_tail( &heap->lfh->buckets[bucket].slabs, &slab->entry );
+    return slab;
+}
+
+
+/***********************************************************************
+ *           lfh_alloc_slow
+ *
+ * Find a slab with free blocks when the active one is full.
+ */
+static ARENA_LFH *lfh_alloc_slow( HEAP *heap, unsigned int bucket, unsigned int slot )
+{
+    LFH_BUCKET *lfh_bucket = &heap->lfh->buckets[bucket];
+    ARENA_LFH *arena = NULL;
+    LFH_SLAB *slab;
+
+    RtlEnterCriticalSection( &heap->critSection );
+    LIST_FOR_EACH_ENTRY( slab, &lfh_bucket->slabs, LFH_SLAB, entry )
+        if ((arena = lfh_pop_block( slab, bucket ))) break;
+    if (!arena && (slab = lfh_create_slab( heap, bucket )))
+        arena = lfh_pop_block( slab, bucket );
+    if (arena) lfh_bucket->active[slot] = slab;
+    RtlLeaveCriticalSection( &heap->critSection );
+    return arena;
+}
+
+
+/***********************************************************************
+ *           lfh_alloc
+ */
+static void *lfh_alloc( HEAP *heap, DWORD flags, SIZE_T size )
+{
+    unsigned int bucket = get_lfh_bucket( size );
+    /* spread the threads over several slabs to limit contention */
+    unsigned int slot = (HandleToULong( NtCurrentTeb()->ClientId.UniqueThread ) >> 2) % LFH_AFFINITY_SLOTS;
+    LFH_SLAB *slab = heap->lfh->buckets[bucket].active[slot];
+    ARENA_LFH *arena;
+
+    if (!slab || !(arena = lfh_pop_block( slab, bucket )))
+    {
+        if (!(arena = lfh_alloc_slow( heap, bucket, slot ))) return NULL;
+    }
+    arena->data_size = size;
+    if (flags & HEAP_ZERO_MEMORY) memset( arena + 1, 0, size );
+    return arena + 1;
+}
+
+
+/***********************************************************************
+ *           lfh_find_block
+ *
+ * Return the LFH arena of a block, or NULL if it isn't an LFH block.
+ */
+static ARENA_LFH *lfh_find_block( HEAP *heap, const void *ptr )
+{
+    ARENA_LFH *arena = (ARENA_LFH *)ptr - 1;
+    LFH_SLAB *slab;
+    SIZE_T offset;
+
+    if (!heap->lfh) return NULL;
+    /* the pointer may be NULL or belong to another heap, only read it inside a slab */
+    if (!(slab = lfh_find_slab( heap->lfh, arena ))) return NULL;
+    offset = (char *)arena - ((char *)slab + LFH_SLAB_HEADER);
+    if (offset % get_lfh_block_size( slab->bucket )) return NULL;
+    if (arena->magic == ARENA_LFH_FREE_MAGIC)
+    {
+        WARN( "Heap %p: block %p used after free\n", heap, ptr );
+        return NULL;
+    }
+    return arena;
+}
+
+
+/***********************************************************************
+ *           lfh_free
+ */
+static void lfh_free( ARENA_LFH *arena )
+{
+    LFH_SLAB *slab = (LFH_SLAB *)((char *)arena - LFH_SLAB_HEADER -
+                                  arena->block * get_lfh_block_size( arena->bucket ));
+    lfh_push_block( slab, arena );
+}
+
+
+/***********************************************************************
+ *           lfh_realloc
+ */
+static void *lfh_realloc( HEAP *heap, DWORD flags, ARENA_LFH *arena, SIZE_T size )
+{
+    SIZE_T old_size = arena->data_size;
+    void *ret;
+
+    if (size <= get_lfh_block_size( arena->bucket ) - sizeof(*arena))
+    {
+        if (size > old_size && (flags & HEAP_ZERO_MEMORY))
+            memset( (char *)(arena + 1) + old_size, 0, size - old_size );
+        arena->data_size = size;
+        return arena + 1;
+    }
+    if (flags & HEAP_REALLOC_IN_PLACE_ONLY) return NULL;
+    if (!(ret = RtlAllocateHeap( heap, flags & ~HEAP_GENERATE_EXCEPTIONS, size ))) return NULL;
+    memcpy( ret, arena + 1, old_size );
+    lfh_free( arena );
+    return ret;
+}
+
+
+/***********************************************************************
+ *           heap_enable_lfh
+ */
+static NTSTATUS heap_enable_lfh( HEAP *heap )
+{
+    LFH_HEAP *lfh;
+    unsigned int i;
+
+    if (heap->lfh) return STATUS_SUCCESS;
+
+    /* the LFH bypasses the debugging checks */
+    if (!(heap->flags & HEAP_GROWABLE) || RUNNING_ON_VALGRIND ||
+        (heap->flags & (HEAP_NO_SERIALIZE | HEAP_VALIDATE | HEAP_PAGE_ALLOCS |
+                        HEAP_TAIL_CHECKING_ENABLED | HEAP_FREE_CHECKING_ENABLED)))
+        return STATUS_UNSUCCESSFUL;
+
+    if (!(lfh = RtlAllocateHeap( heap, HEAP_ZERO_MEMORY, sizeof(*lfh) ))) return STATUS_NO_MEMORY;
+    for (i = 0; i < LFH_NB_BUCKETS; i++) list_init( &lfh->buckets[i].slabs );
+
+    if (interlocked_cmpxchg_ptr( (void **)&heap->lfh, lfh, NULL ))
+        RtlFreeHeap( heap, 0, lfh );  /* somebody else was faster */
+    TRACE( "enabled LFH for heap %p\n", heap );
+    return STATUS_SUCCESS;
+}
+
+
 /***********************************************************************
  *           heap_set_debug_flags
  */
@@ -1517,6 +1882,8 @@ void heap_set_debug_flags( HANDLE handle )
             heap->pending_pos = 0;
         }
     }
+
+    if (heap_compatibility == 2) heap_enable_lfh( heap );
 }
 
 
@@ -1673,6 +2040,17 @@ PVOID WINAPI RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
     }
     if (rounded_size < HEAP_MIN_DATA_SIZE) rounded_size = HEAP_MIN_DATA_SIZE;
 
+    if (heapPtr->lfh && size <= LFH_MAX_SIZE)
+    {
+        void *ret = lfh_alloc( heapPtr, flags, size );
+        if (ret)
+        {
+            TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, ret );
+            return ret;
+        }
+        /* fall back to a normal block */
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     if (rounded_size >= HEAP_MIN_LARGE_BLOCK_SIZE && (flags & HEAP_GROWABLE))
@@ -1740,6 +2118,7 @@ PVOID WINAPI RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
 BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
 {
     ARENA_INUSE *pInUse;
+    ARENA_LFH *lfh_arena;
     SUBHEAP *subheap;
     HEAP *heapPtr;
 
@@ -1756,6 +2135,14 @@ BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
 
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
+
+    if ((lfh_arena = lfh_find_block( heapPtr, ptr )))
+    {
+        lfh_free( lfh_arena );
+        TRACE("(%p,%08x,%p): returning TRUE\n", heap, flags, ptr );
+        return TRUE;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     /* Inform valgrind we are trying to free memory, so it can throw up an error message */
@@ -1800,6 +2187,7 @@ error:
 PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size )
 {
     ARENA_INUSE *pArena;
+    ARENA_LFH *lfh_arena;
     HEAP *heapPtr;
     SUBHEAP *subheap;
     SIZE_T oldBlockSize, oldActualSize, rounded_size;
@@ -1817,6 +2205,18 @@ PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size
     flags &= HEAP_GENERATE_EXCEPTIONS | HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY |
              HEAP_REALLOC_IN_PLACE_ONLY;
     flags |= heapPtr->flags;
+
+    if ((lfh_arena = lfh_find_block( heapPtr, ptr )))
+    {
+        if (!(ret = lfh_realloc( heapPtr, flags, lfh_arena, size )))
+        {
+            if (flags & HEAP_GENERATE_EXCEPTIONS) RtlRaiseStatus( STATUS_NO_MEMORY );
+            RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_NO_MEMORY );
+        }
+        TRACE("(%p,%08x,%p,%08lx): returning %p\n", heap, flags, ptr, size, ret );
+        return ret;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     rounded_size = ROUND_SIZE(size) + HEAP_TAIL_EXTRA_SIZE(flags);
@@ -2016,6 +2416,7 @@ SIZE_T WINAPI RtlSizeHeap( HANDLE heap, ULONG flags, const void *ptr )
 {
     SIZE_T ret;
     const ARENA_INUSE *pArena;
+    const ARENA_LFH *lfh_arena;
     SUBHEAP *subheap;
     HEAP *heapPtr = HEAP_GetPtr( heap );
 
@@ -2026,6 +2427,14 @@ SIZE_T WINAPI RtlSizeHeap( HANDLE heap, ULONG flags, const void *ptr )
     }
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
+
+    if ((lfh_arena = lfh_find_block( heapPtr, ptr )))
+    {
+        ret = lfh_arena->data_size;
+        TRACE("(%p,%08x,%p): returning %08lx\n", heap, flags, ptr, ret );
+        return ret;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     pArena = (const ARENA_INUSE *)ptr - 1;
@@ -2236,6 +2645,8 @@ ULONG WINAPI RtlGetProcessHeaps( ULONG count, HANDLE *heaps )
 NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class,
                                          PVOID info, SIZE_T size_in, PSIZE_T size_out)
 {
+    HEAP *heapPtr;
+
     switch (info_class)
     {
     case HeapCompatibilityInformation:
@@ -2244,7 +2655,8 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
         if (size_in < sizeof(ULONG))
             return STATUS_BUFFER_TOO_SMALL;
 
-        *(ULONG *)info = 0; /* standard heap */
+        heapPtr = HEAP_GetPtr( heap );
+        *(ULONG *)info = (heapPtr && heapPtr->lfh) ? 2 : 0; /* LFH or standard heap */
         return STATUS_SUCCESS;
 
     default:
@@ -2258,6 +2670,29 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
  */
 NTSTATUS WINAPI RtlSetHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class, PVOID info, SIZE_T size)
 {
-    FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
-    return STATUS_SUCCESS;
+    HEAP *heapPtr;
+
+    switch (info_class)
+    {
+    case HeapCompatibilityInformation:
+        if (size < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+
+        switch (*(ULONG *)info)
+        {
+        case 0:  /* standard heap, can't be restored once the LFH is enabled */
+            return heapPtr->lfh ? STATUS_UNSUCCESSFUL : STATUS_SUCCESS;
+        case 1:  /* look-aside lists */
+            FIXME("%p: look-aside lists not supported\n", heap);
+            return STATUS_SUCCESS;
+        case 2:
+            return heap_enable_lfh( heapPtr );
+        default:
+            return STATUS_INVALID_PARAMETER;
+        }
+
+    default:
+        FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
+        return STATUS_SUCCESS;
+    }
 }
@@ -1764,6 +1764,33 @@ static NTSTATUS perform_relocations( void *module, SIZE_T len )
     return STATUS_SUCCESS;
 }
 
+/******************************************************************************
+ *	relocate_image
+ *
+ * Apply the base relocations of a native dll, sharing the relocated pages
+ * with the other processes that load the same dll at the same address.
+ */
+static NTSTATUS relocate_image( HANDLE mapping, void *module, SIZE_T len )
+{
+    IMAGE_NT_HEADERS *nt = RtlImageNtHeader( module );
+    LARGE_INTEGER start, end;
+    NTSTATUS status;
+
+    if (!(nt->FileHeader.Characteristics & IMAGE_FILE_DLL) ||
+        nt->OptionalHeader.SectionAlignment < page_size)
+        return perform_relocations( module, len );
+
+    status = virtual_map_relocated_image( mapping, module, len );
+    if (status != STATUS_NOT_FOUND) return status;
+
+    NtQueryPerformanceCounter( &start, NULL );
+    if ((status = perform_relocations( module, len ))) return status;
+    NtQueryPerformanceCounter( &end, NULL );
+    virtual_add_relocated_image( mapping, module, len, (end.QuadPart - start.QuadPart) / 10 );
+    return STATUS_SUCCESS;
+}
+
+
 /******************************************************************************
  *	load_native_dll  (internal)
  */
@@ -1792,7 +1819,7 @@ static NTSTATUS load_native_dll( LPCWSTR load_path, LPCWSTR name, HANDLE file,
     /* perform base relocation, if necessary */
 
     if (status == STATUS_IMAGE_NOT_AT_BASE)
-        status = perform_relocations( module, len );
+        status = relocate_image( mapping, module, len );
 
     if (status != STATUS_SUCCESS)
     {
@@ -2730,6 +2757,7 @@ void WINAPI LdrShutdownProcess(void)
     TRACE("()\n");
     process_detaching = TRUE;
     process_detach();
+    __wine_dump_cs_profile();
 }
 
 
@@ -3055,6 +3083,8 @@ void WINAPI LdrInitializeThunk( void *kernel_start, ULONG_PTR unknown2,
                                 ULONG_PTR unknown3, ULONG_PTR unknown4 )
 {
     static const WCHAR globalflagW[] = {'G','l','o','b','a','l','F','l','a','g',0};
+    static const WCHAR heapcompatW[] = {'H','e','a','p','C','o','m','p','a','t','i','b','i','l','i','t','y',
+                                        'I','n','f','o','r','m','a','t','i','o','n',0};
     NTSTATUS status;
     WINE_MODREF *wm;
     LPCWSTR load_path;
@@ -3080,6 +3110,9 @@ void WINAPI LdrInitializeThunk( void *kernel_start, ULONG_PTR unknown2,
 
     LdrQueryImageFileExecutionOptions( &peb->ProcessParameters->ImagePathName, globalflagW,
                                        REG_DWORD, &peb->NtGlobalFlag, sizeof(peb->NtGlobalFlag), NULL );
+    /* a value of 2 enables the low-fragmentation heap for the process */
+    LdrQueryImageFileExecutionOptions( &peb->ProcessParameters->ImagePathName, heapcompatW,
+                                       REG_DWORD, &heap_compatibility, sizeof(heap_compatibility), NULL );
 
     /* the main exe needs to be the first in the load order list */
     RemoveEntryList( &wm->ldr.InLoadOrderModuleList );
@@ -76,6 +76,7 @@ extern void virtual_init(void) DECLSPEC_HIDDEN;
 extern void virtual_init_threading(void) DECLSPEC_HIDDEN;
 extern void fill_cpu_info(void) DECLSPEC_HIDDEN;
 extern void heap_set_debug_flags( HANDLE handle ) DECLSPEC_HIDDEN;
+extern ULONG heap_compatibility DECLSPEC_HIDDEN;
 
 /* server support */
 extern timeout_t server_start_time DECLSPEC_HIDDEN;
@@ -94,6 +95,17 @@ extern unsigned int server_select( const select_op_t *select_op, data_size_t siz
                                    UINT flags, const LARGE_INTEGER *timeout ) DECLSPEC_HIDDEN;
 extern unsigned int server_queue_process_apc( HANDLE process, const apc_call_t *call, apc_result_t *result ) DECLSPEC_HIDDEN;
 extern int server_remove_fd_from_cache( HANDLE handle ) DECLSPEC_HIDDEN;
+extern BOOL server_add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
+                                    unsigned int access, unsigned int options ) DECLSPEC_HIDDEN;
+extern NTSTATUS server_set_fd_completion_mode( HANDLE handle, unsigned int flags ) DECLSPEC_HIDDEN;
+extern BOOL server_skip_completion( HANDLE handle, NTSTATUS status ) DECLSPEC_HIDDEN;
+extern int server_cancel_async_io( HANDLE handle, const IO_STATUS_BLOCK *iosb, BOOL only_thread,
+                                   NTSTATUS status ) DECLSPEC_HIDDEN;
+extern struct fast_sync_object *server_get_fast_sync( HANDLE handle, enum fast_sync_type *type,
+                                                      unsigned int *access ) DECLSPEC_HIDDEN;
+extern void server_remove_fast_sync_from_cache( HANDLE handle ) DECLSPEC_HIDDEN;
+extern void init_registry_cache(void) DECLSPEC_HIDDEN;
+extern void registry_cache_remove_handle( HANDLE handle ) DECLSPEC_HIDDEN;
 extern int server_get_unix_fd( HANDLE handle, unsigned int access, int *unix_fd,
                                int *needs_close, enum server_fd_type *type, unsigned int *options ) DECLSPEC_HIDDEN;
 extern int server_pipe( int fd[2] ) DECLSPEC_HIDDEN;
@@ -148,6 +160,7 @@ extern NTSTATUS COMM_FlushBuffersFile( int fd ) DECLSPEC_HIDDEN;
 struct stat;
 extern NTSTATUS FILE_GetNtStatus(void) DECLSPEC_HIDDEN;
 extern int get_file_info( const char *path, struct stat *st, ULONG *attr ) DECLSPEC_HIDDEN;
+extern int get_dir_entry_info( const char *path, struct stat *st, ULONG *attr, BOOL names_only ) DECLSPEC_HIDDEN;
 extern NTSTATUS fill_file_info( const struct stat *st, ULONG attr, void *ptr,
                                 FILE_INFORMATION_CLASS class ) DECLSPEC_HIDDEN;
 extern NTSTATUS server_get_unix_name( HANDLE handle, ANSI_STRING *unix_name ) DECLSPEC_HIDDEN;
@@ -163,6 +176,8 @@ extern NTSTATUS nt_to_unix_file_name_attr( const OBJECT_ATTRIBUTES *attr, ANSI_S
 /* virtual memory */
 extern void virtual_get_system_info( SYSTEM_BASIC_INFORMATION *info ) DECLSPEC_HIDDEN;
 extern NTSTATUS virtual_create_builtin_view( void *base ) DECLSPEC_HIDDEN;
+extern NTSTATUS virtual_map_relocated_image( HANDLE mapping, void *module, SIZE_T size ) DECLSPEC_HIDDEN;
+extern void virtual_add_relocated_image( HANDLE mapping, void *module, SIZE_T size, ULONG time ) DECLSPEC_HIDDEN;
 extern NTSTATUS virtual_alloc_thread_stack( TEB *teb, SIZE_T reserve_size, SIZE_T commit_size ) DECLSPEC_HIDDEN;
 extern void virtual_clear_thread_stack(void) DECLSPEC_HIDDEN;
 extern BOOL virtual_handle_stack_fault( void *addr ) DECLSPEC_HIDDEN;
@@ -181,6 +196,9 @@ extern struct _KUSER_SHARED_DATA *user_shared_data DECLSPEC_HIDDEN;
 extern NTSTATUS NTDLL_AddCompletion( HANDLE hFile, ULONG_PTR CompletionValue,
                                      NTSTATUS CompletionStatus, ULONG Information ) DECLSPEC_HIDDEN;
 
+/* critical sections */
+extern void CDECL __wine_dump_cs_profile(void);
+
 /* code pages */
 extern int ntdll_umbstowcs(DWORD flags, const char* src, int srclen, WCHAR* dst, int dstlen) DECLSPEC_HIDDEN;
 extern int ntdll_wcstoumbs(DWORD flags, const WCHAR* src, int srclen, char* dst, int dstlen,
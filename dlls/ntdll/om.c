@@ -368,8 +368,13 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source,
             if (dest) *dest = wine_server_ptr_handle( reply->handle );
             if (reply->closed && reply->self)
             {
-                int fd = server_remove_fd_from_cache( source );
+                int fd;
+
+                server_cancel_async_io( source, NULL, FALSE, STATUS_HANDLES_CLOSED );
+                fd = server_remove_fd_from_cache( source );
                 if (fd != -1) close( fd );
+                server_remove_fast_sync_from_cache( source );
+                registry_cache_remove_handle( source );
             }
         }
     }
@@ -381,8 +386,14 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source,
 NTSTATUS close_handle( HANDLE handle )
 {
     NTSTATUS ret;
-    int fd = server_remove_fd_from_cache( handle );
+    int fd;
+
+    /* while the handle is still valid, so that completions can be queued */
+    server_cancel_async_io( handle, NULL, FALSE, STATUS_HANDLES_CLOSED );
+    fd = server_remove_fd_from_cache( handle );
 
+    server_remove_fast_sync_from_cache( handle );
+    registry_cache_remove_handle( handle );
     SERVER_START_REQ( close_handle )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -29,9 +29,21 @@
 #include "config.h"
 #include "wine/port.h"
 
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -41,10 +53,212 @@
 #include "wine/unicode.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(reg);
+WINE_DECLARE_DEBUG_CHANNEL(regcache);
 
 /* maximum length of a value name in bytes (without terminating null) */
 #define MAX_VALUE_LENGTH (16383 * sizeof(WCHAR))
 
+/*
+ * Values read with NtQueryValueKey are cached per process.  The server gives
+ * each key an id, and keeps for every id a generation counter in shared memory
+ * that it increments on every change to the key.  A cached value is used as
+ * long as the generation of its key hasn't changed.
+ */
+
+#define VALUE_CACHE_SIZE     1024   /* number of entries, must be a power of 2 */
+#define VALUE_CACHE_MAX_DATA 1024   /* larger values are not cached */
+
+struct value_cache_entry
+{
+    unsigned int key_id;       /* id of the key, 0 if the entry is free */
+    unsigned int generation;   /* generation of the key when the value was read */
+    int          type;         /* value type, -1 if the value doesn't exist */
+    DWORD        data_len;     /* length of the value data */
+    USHORT       name_len;     /* length of the value name in bytes */
+    WCHAR       *name;         /* value name */
+    BYTE        *data;         /* value data */
+};
+
+static struct value_cache_entry value_cache[VALUE_CACHE_SIZE];
+static const volatile unsigned int *key_generations;
+static unsigned int key_generation_count;
+static unsigned int cache_hits, cache_misses, cache_stale;
+
+static RTL_CRITICAL_SECTION value_cache_section;
+static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
+{
+    0, 0, &value_cache_section,
+    { &critsect_debug.ProcessLocksList, &critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": value_cache_section") }
+};
+static RTL_CRITICAL_SECTION value_cache_section = { &critsect_debug, -1, 0, 0, 0, 0 };
+
+/* key id for each open key handle, allocated in blocks like the fd cache */
+#define KEY_ID_CACHE_BLOCK_SIZE  (65536 / sizeof(unsigned int))
+#define KEY_ID_CACHE_ENTRIES     256
+
+static unsigned int *key_id_cache[KEY_ID_CACHE_ENTRIES];
+
+static inline unsigned int key_handle_to_index( HANDLE handle, unsigned int *entry )
+{
+    unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
+    *entry = idx / KEY_ID_CACHE_BLOCK_SIZE;
+    return idx % KEY_ID_CACHE_BLOCK_SIZE;
+}
+
+/* remember the key id of a handle */
+static void set_handle_key_id( HANDLE handle, unsigned int key_id )
+{
+    unsigned int entry, idx = key_handle_to_index( handle, &entry );
+
+    if (!key_generations || entry >= KEY_ID_CACHE_ENTRIES) return;
+    if (!key_id_cache[entry])
+    {
+        void *ptr;
+
+        if (!key_id) return;
+        ptr = wine_anon_mmap( NULL, KEY_ID_CACHE_BLOCK_SIZE * sizeof(unsigned int),
+                              PROT_READ | PROT_WRITE, 0 );
+        if (ptr == MAP_FAILED) return;
+        if (interlocked_cmpxchg_ptr( (void **)&key_id_cache[entry], ptr, NULL ))
+            munmap( ptr, KEY_ID_CACHE_BLOCK_SIZE * sizeof(unsigned int) );
+    }
+    key_id_cache[entry][idx] = key_id;
+}
+
+static unsigned int get_handle_key_id( HANDLE handle )
+{
+    unsigned int entry, idx = key_handle_to_index( handle, &entry );
+
+    if (entry >= KEY_ID_CACHE_ENTRIES || !key_id_cache[entry]) return 0;
+    return key_id_cache[entry][idx];
+}
+
+/***********************************************************************
+ *           registry_cache_remove_handle
+ *
+ * Forget the key id of a handle that is being closed.
+ */
+void registry_cache_remove_handle( HANDLE handle )
+{
+    unsigned int entry, idx = key_handle_to_index( handle, &entry );
+
+    if (entry < KEY_ID_CACHE_ENTRIES && key_id_cache[entry]) key_id_cache[entry][idx] = 0;
+}
+
+/***********************************************************************
+ *           init_registry_cache
+ *
+ * Map the key generation counters, if the server provides them.
+ */
+void init_registry_cache(void)
+{
+    static const char name[] = "/registry-gen";
+    const char *dir = wine_get_server_dir();
+    const char *env = getenv( "WINEREGCACHE" );
+    struct stat st;
+    char *path;
+    void *ptr;
+    int fd;
+
+    if (env && !atoi( env )) return;
+    if (!(path = RtlAllocateHeap( GetProcessHeap(), 0, strlen(dir) + sizeof(name) ))) return;
+    strcpy( path, dir );
+    strcat( path, name );
+    fd = open( path, O_RDONLY );
+    RtlFreeHeap( GetProcessHeap(), 0, path );
+    if (fd == -1) return;
+
+    if (!fstat( fd, &st ) && st.st_size >= sizeof(*key_generations))
+    {
+        ptr = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+        if (ptr != MAP_FAILED)
+        {
+            key_generation_count = st.st_size / sizeof(*key_generations);
+            key_generations = ptr;
+            TRACE_(regcache)( "using %u key generation counters\n", key_generation_count );
+        }
+    }
+    close( fd );
+}
+
+static inline unsigned int get_key_generation( unsigned int key_id )
+{
+    return key_generations[key_id % key_generation_count];
+}
+
+static struct value_cache_entry *get_value_cache_entry( unsigned int key_id, const UNICODE_STRING *name )
+{
+    unsigned int i, hash = key_id * 0x9e3779b1;
+
+    for (i = 0; i < name->Length / sizeof(WCHAR); i++) hash = hash * 31 + toupperW( name->Buffer[i] );
+    return &value_cache[hash & (VALUE_CACHE_SIZE - 1)];
+}
+
+static void dump_value_cache_stats(void)
+{
+    if ((cache_hits + cache_misses) % 1024) return;
+    TRACE_(regcache)( "%u hits, %u misses, %u stale\n", cache_hits, cache_misses, cache_stale );
+}
+
+/* retrieve a value from the cache; return FALSE if not cached */
+static BOOL get_cached_value( unsigned int key_id, const UNICODE_STRING *name, void *data,
+                              DWORD max_len, int *type, DWORD *total )
+{
+    struct value_cache_entry *entry;
+    BOOL ret = FALSE;
+
+    RtlEnterCriticalSection( &value_cache_section );
+    entry = get_value_cache_entry( key_id, name );
+    if (entry->key_id == key_id && entry->name_len == name->Length &&
+        !strncmpiW( entry->name, name->Buffer, name->Length / sizeof(WCHAR) ))
+    {
+        if (entry->generation == get_key_generation( key_id ))
+        {
+            *type = entry->type;
+            *total = entry->data_len;
+            if (data) memcpy( data, entry->data, min( max_len, entry->data_len ));
+            ret = TRUE;
+        }
+        else cache_stale++;
+    }
+    if (ret) cache_hits++;
+    else cache_misses++;
+    if (TRACE_ON(regcache)) dump_value_cache_stats();
+    RtlLeaveCriticalSection( &value_cache_section );
+    return ret;
+}
+
+/* store a value retrieved from the server in the cache */
+static void cache_value( unsigned int key_id, unsigned int generation, const UNICODE_STRING *name,
+                         int type, const void *data, DWORD len )
+{
+    struct value_cache_entry *entry;
+    WCHAR *new_name;
+    BYTE *new_data = NULL;
+
+    if (!key_generations || len > VALUE_CACHE_MAX_DATA) return;
+    if (!(new_name = RtlAllocateHeap( GetProcessHeap(), 0, name->Length + len ))) return;
+    memcpy( new_name, name->Buffer, name->Length );
+    if (len)
+    {
+        new_data = (BYTE *)new_name + name->Length;
+        memcpy( new_data, data, len );
+    }
+
+    RtlEnterCriticalSection( &value_cache_section );
+    entry = get_value_cache_entry( key_id, name );
+    RtlFreeHeap( GetProcessHeap(), 0, entry->name );
+    entry->key_id     = key_id;
+    entry->generation = generation;
+    entry->type       = type;
+    entry->data_len   = len;
+    entry->name_len   = name->Length;
+    entry->name       = new_name;
+    entry->data       = new_data;
+    RtlLeaveCriticalSection( &value_cache_section );
+}
+
 /******************************************************************************
  * NtCreateKey [NTDLL.@]
  * ZwCreateKey [NTDLL.@]
@@ -75,6 +289,7 @@ NTSTATUS WINAPI NtCreateKey( PHANDLE retkey, ACCESS_MASK access, const OBJECT_AT
         {
             *retkey = wine_server_ptr_handle( reply->hkey );
             if (dispos) *dispos = reply->created ? REG_CREATED_NEW_KEY : REG_OPENED_EXISTING_KEY;
+            set_handle_key_id( *retkey, reply->key_id );
         }
     }
     SERVER_END_REQ;
@@ -140,6 +355,7 @@ static NTSTATUS open_key( PHANDLE retkey, ACCESS_MASK access, const OBJECT_ATTRI
         wine_server_add_data( req, attr->ObjectName->Buffer, attr->ObjectName->Length );
         ret = wine_server_call( req );
         *retkey = wine_server_ptr_handle( reply->hkey );
+        if (!ret) set_handle_key_id( *retkey, reply->key_id );
     }
     SERVER_END_REQ;
     TRACE("<- %p\n", *retkey);
@@ -538,7 +754,9 @@ NTSTATUS WINAPI NtQueryValueKey( HANDLE handle, const UNICODE_STRING *name,
 {
     NTSTATUS ret;
     UCHAR *data_ptr;
-    unsigned int fixed_size, min_size;
+    unsigned int fixed_size, min_size, key_id;
+    DWORD total;
+    int type;
 
     TRACE( "(%p,%s,%d,%p,%d)\n", handle, debugstr_us(name), info_class, info, length );
 
@@ -576,12 +794,33 @@ NTSTATUS WINAPI NtQueryValueKey( HANDLE handle, const UNICODE_STRING *name,
         return STATUS_INVALID_PARAMETER;
     }
 
+    if (key_generations && (key_id = get_handle_key_id( handle )) &&
+        get_cached_value( key_id, name, length > fixed_size ? data_ptr : NULL,
+                          length > fixed_size ? length - fixed_size : 0, &type, &total ))
+    {
+        if (type == -1) return STATUS_OBJECT_NAME_NOT_FOUND;
+        ret = STATUS_SUCCESS;
+        copy_key_value_info( info_class, info, length, type, name->Length, total );
+        *result_len = fixed_size + (info_class == KeyValueBasicInformation ? 0 : total);
+        if (length < min_size) ret = STATUS_BUFFER_TOO_SMALL;
+        else if (length < *result_len) ret = STATUS_BUFFER_OVERFLOW;
+        return ret;
+    }
+
     SERVER_START_REQ( get_key_value )
     {
         req->hkey = wine_server_obj_handle( handle );
         wine_server_add_data( req, name->Buffer, name->Length );
         if (length > fixed_size && data_ptr) wine_server_set_reply( req, data_ptr, length - fixed_size );
-        if (!(ret = wine_server_call( req )))
+        ret = wine_server_call( req );
+        if (reply->key_id && (!ret || ret == STATUS_OBJECT_NAME_NOT_FOUND))
+        {
+            set_handle_key_id( handle, reply->key_id );
+            if (ret) cache_value( reply->key_id, reply->generation, name, -1, NULL, 0 );
+            else if (data_ptr && length >= fixed_size + reply->total)
+                cache_value( reply->key_id, reply->generation, name, reply->type, data_ptr, reply->total );
+        }
+        if (!ret)
         {
             copy_key_value_info( info_class, info, length, reply->type,
                                  name->Length, reply->total );
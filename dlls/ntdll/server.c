@@ -48,6 +48,9 @@
 #ifdef HAVE_SYS_UN_H
 #include <sys/un.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 #ifdef HAVE_SYS_MMAN_H
 #include <sys/mman.h>
 #endif
@@ -76,8 +79,10 @@
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
 #include "windef.h"
+#include "winbase.h"
 #include "winnt.h"
 #include "wine/library.h"
+#include "wine/list.h"
 #include "wine/server.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
@@ -810,14 +815,16 @@ union fd_cache_entry
     struct
     {
         int fd;
-        enum server_fd_type type : 5;
+        enum server_fd_type type : 4;
         unsigned int        access : 3;
         unsigned int        options : 24;
+        unsigned int        skip_port : 1;  /* FILE_SKIP_COMPLETION_PORT_ON_SUCCESS is set */
     } s;
 };
 #include "poppack.h"
 
 C_ASSERT( sizeof(union fd_cache_entry) == sizeof(LONG64) );
+C_ASSERT( FD_TYPE_NB_TYPES <= 16 );
 
 #define FD_CACHE_BLOCK_SIZE  (65536 / sizeof(union fd_cache_entry))
 #define FD_CACHE_ENTRIES     128
@@ -839,7 +846,7 @@ static inline unsigned int handle_to_index( HANDLE handle, unsigned int *entry )
  * Caller must hold fd_cache_section.
  */
 static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
-                            unsigned int access, unsigned int options )
+                            unsigned int access, unsigned int options, unsigned int comp_flags )
 {
     unsigned int entry, idx = handle_to_index( handle, &entry );
     union fd_cache_entry cache;
@@ -867,6 +874,7 @@ static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
     cache.s.type = type;
     cache.s.access = access;
     cache.s.options = options;
+    cache.s.skip_port = (comp_flags & FILE_SKIP_COMPLETION_PORT_ON_SUCCESS) != 0;
     cache.data = interlocked_xchg64( &fd_cache[entry][idx].data, cache.data );
     assert( !cache.s.fd );
     return TRUE;
@@ -914,6 +922,640 @@ int server_remove_fd_from_cache( HANDLE handle )
 }
 
 
+/***********************************************************************
+ *           server_add_fd_to_cache
+ *
+ * Cache an fd that was opened by the client for a newly created handle.
+ */
+BOOL server_add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
+                             unsigned int access, unsigned int options )
+{
+    sigset_t sigset;
+    BOOL ret;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    ret = add_fd_to_cache( handle, fd, type, access, options, 0 );
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+    return ret;
+}
+
+
+/***********************************************************************
+ *           server_set_fd_completion_mode
+ *
+ * Add completion notification modes to a file, and update the cached entry.
+ */
+NTSTATUS server_set_fd_completion_mode( HANDLE handle, unsigned int flags )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    union fd_cache_entry cache, new;
+    sigset_t sigset;
+    NTSTATUS ret;
+
+    /* hold the section so that the fd cannot be cached concurrently with the old modes */
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    SERVER_START_REQ( set_fd_completion_mode )
+    {
+        req->handle = wine_server_obj_handle( handle );
+        req->flags  = flags;
+        ret = wine_server_call( req );
+        flags = reply->flags;
+    }
+    SERVER_END_REQ;
+
+    if (!ret && entry < FD_CACHE_ENTRIES && fd_cache[entry])
+    {
+        do
+        {
+            cache.data = fd_cache[entry][idx].data;
+            if (!cache.s.fd) break;
+            new = cache;
+            new.s.skip_port = (flags & FILE_SKIP_COMPLETION_PORT_ON_SUCCESS) != 0;
+        } while (interlocked_cmpxchg64( &fd_cache[entry][idx].data, new.data, cache.data ) != cache.data);
+    }
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+    return ret;
+}
+
+
+/***********************************************************************
+ *           server_skip_completion
+ *
+ * Check if the completion of an operation that succeeded immediately
+ * should not be queued. This only uses the fd cache, the server makes
+ * the final decision for files that aren't cached.
+ */
+BOOL server_skip_completion( HANDLE handle, NTSTATUS status )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    union fd_cache_entry cache;
+
+    if (status != STATUS_SUCCESS) return FALSE;
+    if (entry >= FD_CACHE_ENTRIES || !fd_cache[entry]) return FALSE;
+    cache.data = interlocked_cmpxchg64( &fd_cache[entry][idx].data, 0, 0 );
+    return cache.s.fd && cache.s.skip_port;
+}
+
+
+/***********************************************************************
+ *           wine_server_skip_completion   (NTDLL.@)
+ *
+ * Check if the completion of an operation done by the caller on a file
+ * should not be queued, so that the add_fd_completion request can be
+ * skipped.
+ *
+ * PARAMS
+ *     handle [I] Wine file handle.
+ *     status [I] Status of the operation.
+ *
+ * RETURNS
+ *     TRUE if the operation succeeded and the file has the
+ *     FILE_SKIP_COMPLETION_PORT_ON_SUCCESS mode set, FALSE otherwise.
+ */
+BOOL CDECL wine_server_skip_completion( HANDLE handle, NTSTATUS status )
+{
+    return server_skip_completion( handle, status );
+}
+
+
+/***********************************************************************/
+/* fast synchronization objects support */
+
+union fast_sync_cache_entry
+{
+    LONG64 data;
+    struct
+    {
+        unsigned int index;       /* index of the object in the shared memory area */
+        unsigned int type : 3;    /* object type, see enum fast_sync_type */
+        unsigned int access : 28; /* handle access rights, limited to FAST_SYNC_ACCESS_MASK */
+        unsigned int cached : 1;  /* entry has been filled */
+    } s;
+};
+
+C_ASSERT( sizeof(union fast_sync_cache_entry) == sizeof(LONG64) );
+
+#define FAST_SYNC_ACCESS_MASK         (SYNCHRONIZE | EVENT_MODIFY_STATE)
+#define FAST_SYNC_CACHE_BLOCK_SIZE    (65536 / sizeof(union fast_sync_cache_entry))
+#define FAST_SYNC_CACHE_ENTRIES       128
+
+static union fast_sync_cache_entry *fast_sync_cache[FAST_SYNC_CACHE_ENTRIES];
+static struct fast_sync_object *fast_sync_objects;
+static unsigned int fast_sync_count;
+
+static inline unsigned int fast_sync_handle_to_index( HANDLE handle, unsigned int *entry )
+{
+    unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
+    *entry = idx / FAST_SYNC_CACHE_BLOCK_SIZE;
+    return idx % FAST_SYNC_CACHE_BLOCK_SIZE;
+}
+
+
+/***********************************************************************
+ *           init_fast_sync
+ *
+ * Map the shared synchronization objects, if the server provides them.
+ */
+static void init_fast_sync(void)
+{
+    static const char name[] = "/fast-sync";
+    const char *dir = wine_get_server_dir();
+    struct stat st;
+    char *path;
+    void *ptr;
+    int fd;
+
+    if (!(path = RtlAllocateHeap( GetProcessHeap(), 0, strlen(dir) + sizeof(name) ))) return;
+    strcpy( path, dir );
+    strcat( path, name );
+    fd = open( path, O_RDWR );
+    RtlFreeHeap( GetProcessHeap(), 0, path );
+    if (fd == -1) return;
+
+    if (!fstat( fd, &st ) && st.st_size >= sizeof(*fast_sync_objects))
+    {
+        ptr = mmap( NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+        if (ptr != MAP_FAILED)
+        {
+            fast_sync_objects = ptr;
+            fast_sync_count = st.st_size / sizeof(*fast_sync_objects);
+            TRACE( "using %u shared synchronization objects\n", fast_sync_count );
+        }
+    }
+    close( fd );
+}
+
+
+/***********************************************************************
+ *           server_get_fast_sync
+ *
+ * Retrieve the shared state of an event, semaphore or mutex. Returns NULL
+ * if the object has none, in which case the server must be used.
+ */
+struct fast_sync_object *server_get_fast_sync( HANDLE handle, enum fast_sync_type *type,
+                                               unsigned int *access )
+{
+    unsigned int entry, idx = fast_sync_handle_to_index( handle, &entry );
+    union fast_sync_cache_entry cache;
+    NTSTATUS ret;
+
+    if (!fast_sync_objects || entry >= FAST_SYNC_CACHE_ENTRIES) return NULL;
+
+    if (!fast_sync_cache[entry])  /* do we need to allocate a new block of entries? */
+    {
+        void *ptr = wine_anon_mmap( NULL, FAST_SYNC_CACHE_BLOCK_SIZE * sizeof(union fast_sync_cache_entry),
+                                    PROT_READ | PROT_WRITE, 0 );
+        if (ptr == MAP_FAILED) return NULL;
+        if (interlocked_cmpxchg_ptr( (void **)&fast_sync_cache[entry], ptr, NULL ))
+            munmap( ptr, FAST_SYNC_CACHE_BLOCK_SIZE * sizeof(union fast_sync_cache_entry) );
+    }
+
+    cache.data = interlocked_cmpxchg64( &fast_sync_cache[entry][idx].data, 0, 0 );
+    if (!cache.s.cached)
+    {
+        SERVER_START_REQ( get_fast_sync )
+        {
+            req->handle = wine_server_obj_handle( handle );
+            if (!(ret = wine_server_call( req )))
+            {
+                cache.s.index  = reply->index;
+                cache.s.type   = reply->type;
+                cache.s.access = reply->access & FAST_SYNC_ACCESS_MASK;
+                cache.s.cached = 1;
+            }
+        }
+        SERVER_END_REQ;
+        if (ret) return NULL;  /* let the server report the error */
+        if (cache.s.index >= fast_sync_count) cache.s.type = FAST_SYNC_NONE;
+        interlocked_cmpxchg64( &fast_sync_cache[entry][idx].data, cache.data, 0 );
+    }
+
+    if (cache.s.type == FAST_SYNC_NONE) return NULL;
+    *type = cache.s.type;
+    *access = cache.s.access;
+    return &fast_sync_objects[cache.s.index];
+}
+
+
+/***********************************************************************
+ *           server_remove_fast_sync_from_cache
+ */
+void server_remove_fast_sync_from_cache( HANDLE handle )
+{
+    unsigned int entry, idx = fast_sync_handle_to_index( handle, &entry );
+
+    if (entry < FAST_SYNC_CACHE_ENTRIES && fast_sync_cache[entry])
+        interlocked_xchg64( &fast_sync_cache[entry][idx].data, 0 );
+}
+
+
+/***********************************************************************/
+/* in-process async I/O on sockets */
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE)
+
+#define ASYNC_FD_HASH_SIZE  64
+
+struct async_fd
+{
+    struct list   entry;         /* entry in async_fd_hash */
+    HANDLE        handle;        /* handle the asyncs were queued on */
+    int           unix_fd;       /* cached unix fd of the handle */
+    int           registered;    /* fd has been added to the epoll set */
+    int           busy;          /* asyncs are being run outside of async_fd_section */
+    struct list   queue[2];      /* pending read and write asyncs */
+};
+
+struct client_async
+{
+    struct list   entry;         /* entry in the async_fd queue */
+    async_data_t  data;          /* async parameters, as for the register_async request */
+    DWORD         tid;           /* thread that queued the async */
+};
+
+static RTL_CRITICAL_SECTION async_fd_section;
+static RTL_CRITICAL_SECTION_DEBUG async_fd_critsect_debug =
+{
+    0, 0, &async_fd_section,
+    { &async_fd_critsect_debug.ProcessLocksList, &async_fd_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": async_fd_section") }
+};
+static RTL_CRITICAL_SECTION async_fd_section = { &async_fd_critsect_debug, -1, 0, 0, 0, 0 };
+
+static RTL_CONDITION_VARIABLE async_fd_idle = RTL_CONDITION_VARIABLE_INIT;
+static struct list async_fd_hash[ASYNC_FD_HASH_SIZE];
+static int async_epoll_fd = -1;  /* -1: not initialized yet, -2: not available */
+static LONG client_async_count;  /* number of asyncs handled in-process */
+
+static inline struct list *async_fd_bucket( HANDLE handle )
+{
+    return &async_fd_hash[((ULONG_PTR)handle >> 2) % ASYNC_FD_HASH_SIZE];
+}
+
+/* find the async fd of a handle; caller must hold async_fd_section */
+static struct async_fd *get_async_fd( HANDLE handle )
+{
+    struct async_fd *afd;
+
+    LIST_FOR_EACH_ENTRY( afd, async_fd_bucket( handle ), struct async_fd, entry )
+        if (afd->handle == handle) return afd;
+    return NULL;
+}
+
+/* update the epoll registration of an async fd, and free it once it is idle */
+static int update_async_fd( struct async_fd *afd )
+{
+    struct epoll_event ev;
+
+    ev.events = EPOLLONESHOT;
+    if (!list_empty( &afd->queue[0] )) ev.events |= EPOLLIN | EPOLLPRI;
+    if (!list_empty( &afd->queue[1] )) ev.events |= EPOLLOUT;
+    ev.data.u64 = (ULONG_PTR)afd->handle;
+
+    if (ev.events != EPOLLONESHOT)
+    {
+        if (!epoll_ctl( async_epoll_fd, afd->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, afd->unix_fd, &ev ))
+        {
+            afd->registered = 1;
+            return 0;
+        }
+        WARN( "failed to watch fd %d for handle %p: %s\n", afd->unix_fd, afd->handle, strerror(errno) );
+        return -1;
+    }
+
+    if (afd->busy) return 0;
+    if (afd->registered) epoll_ctl( async_epoll_fd, EPOLL_CTL_DEL, afd->unix_fd, &ev );
+    list_remove( &afd->entry );
+    RtlFreeHeap( GetProcessHeap(), 0, afd );
+    return 0;
+}
+
+/* mark an async fd as busy, so that its asyncs can be run outside of async_fd_section;
+ * caller must hold async_fd_section */
+static void lock_async_fd( struct async_fd *afd )
+{
+    while (afd->busy) RtlSleepConditionVariableCS( &async_fd_idle, &async_fd_section, NULL );
+    afd->busy = 1;
+}
+
+/* release an async fd marked busy, and free it if it's idle; caller must hold async_fd_section */
+static void unlock_async_fd( struct async_fd *afd )
+{
+    afd->busy = 0;
+    RtlWakeAllConditionVariable( &async_fd_idle );
+    update_async_fd( afd );
+}
+
+/* set the signaled state of the fd of an async that doesn't have an event */
+static void set_client_async_signaled( const async_data_t *data, int signaled )
+{
+    SERVER_START_REQ( set_fd_signaled )
+    {
+        req->handle   = data->handle;
+        req->signaled = signaled;
+        wine_server_call( req );
+    }
+    SERVER_END_REQ;
+}
+
+/* report the result of a finished async, same as the server does for its own asyncs;
+ * the async fd must be busy, so that the handle cannot be closed meanwhile */
+static void finish_client_async( struct client_async *async, NTSTATUS status, void *apc, void *arg )
+{
+    IO_STATUS_BLOCK *iosb = wine_server_get_ptr( async->data.iosb );
+
+    if (status == STATUS_MORE_PROCESSING_REQUIRED) goto done;
+
+    if (async->data.cvalue)
+    {
+        SERVER_START_REQ( add_fd_completion )
+        {
+            req->handle      = async->data.handle;
+            req->cvalue      = async->data.cvalue;
+            req->status      = status;
+            req->information = iosb->Information;
+            req->async       = 1;
+            wine_server_call( req );
+        }
+        SERVER_END_REQ;
+    }
+    if (apc)
+    {
+        OBJECT_ATTRIBUTES attr;
+        CLIENT_ID cid;
+        HANDLE thread;
+
+        cid.UniqueProcess = 0;
+        cid.UniqueThread  = ULongToHandle( async->tid );
+        InitializeObjectAttributes( &attr, NULL, 0, NULL, NULL );
+        if (!NtOpenThread( &thread, THREAD_SET_CONTEXT, &attr, &cid ))
+        {
+            NtQueueApcThread( thread, (PNTAPCFUNC)apc, (ULONG_PTR)arg, (ULONG_PTR)iosb, 0 );
+            NtClose( thread );
+        }
+    }
+    if (async->data.event) NtSetEvent( wine_server_ptr_handle( async->data.event ), NULL );
+    else set_client_async_signaled( &async->data, 1 );
+
+done:
+    interlocked_xchg_add( &client_async_count, -1 );
+    RtlFreeHeap( GetProcessHeap(), 0, async );
+}
+
+/* run the callback of an async removed from its queue, and finish it unless it's still pending */
+static NTSTATUS call_client_async( struct client_async *async, NTSTATUS status )
+{
+    NTSTATUS (*func)(void *, IO_STATUS_BLOCK *, NTSTATUS, void **, void **) = wine_server_get_ptr( async->data.callback );
+    void *apc = NULL, *arg = NULL;
+
+    status = func( wine_server_get_ptr( async->data.arg ), wine_server_get_ptr( async->data.iosb ),
+                   status, &apc, &arg );
+    if (status != STATUS_PENDING) finish_client_async( async, status, apc, arg );
+    return status;
+}
+
+/* thread waiting for the fds of the queued asyncs to become ready */
+static void CALLBACK async_fd_thread( void *arg )
+{
+    struct epoll_event events[64];
+    int i, count;
+
+    for (;;)
+    {
+        count = epoll_wait( async_epoll_fd, events, sizeof(events) / sizeof(events[0]), -1 );
+        if (count == -1)
+        {
+            if (errno != EINTR) ERR( "epoll_wait failed: %s\n", strerror(errno) );
+            continue;
+        }
+
+        RtlEnterCriticalSection( &async_fd_section );
+        for (i = 0; i < count; i++)
+        {
+            /* the handle may have been closed since, and even reused */
+            struct async_fd *afd = get_async_fd( (HANDLE)(ULONG_PTR)events[i].data.u64 );
+            struct list *ptr;
+            int j;
+
+            if (!afd) continue;
+            lock_async_fd( afd );
+            for (j = 0; j < 2; j++)
+            {
+                unsigned int mask = (j ? EPOLLOUT : EPOLLIN | EPOLLPRI) | EPOLLERR | EPOLLHUP;
+
+                if (!(events[i].events & mask)) continue;
+
+                /* complete the asyncs in order, until one of them can't make progress */
+                while ((ptr = list_head( &afd->queue[j] )))
+                {
+                    struct client_async *async = LIST_ENTRY( ptr, struct client_async, entry );
+                    NTSTATUS status;
+
+                    list_remove( &async->entry );
+                    RtlLeaveCriticalSection( &async_fd_section );
+                    status = call_client_async( async, STATUS_ALERTED );
+                    RtlEnterCriticalSection( &async_fd_section );
+                    if (status != STATUS_PENDING) continue;
+                    list_add_head( &afd->queue[j], &async->entry );
+                    break;
+                }
+            }
+            unlock_async_fd( afd );
+        }
+        RtlLeaveCriticalSection( &async_fd_section );
+    }
+}
+
+/* create the epoll set and its thread on first use */
+static BOOL init_async_fd(void)
+{
+    HANDLE thread;
+    unsigned int i;
+    int fd;
+
+    if (async_epoll_fd >= 0) return TRUE;
+    if (async_epoll_fd == -2) return FALSE;
+
+    RtlEnterCriticalSection( &async_fd_section );
+    if (async_epoll_fd == -1)
+    {
+        for (i = 0; i < ASYNC_FD_HASH_SIZE; i++) list_init( &async_fd_hash[i] );
+        fd = epoll_create( 64 );
+        if (fd != -1)
+        {
+            fcntl( fd, F_SETFD, FD_CLOEXEC );
+            async_epoll_fd = fd;
+            if (RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                     async_fd_thread, NULL, &thread, NULL ))
+            {
+                close( fd );
+                async_epoll_fd = -2;
+            }
+            else NtClose( thread );
+        }
+        else async_epoll_fd = -2;
+        if (async_epoll_fd == -2) WARN( "in-process async I/O not available, using the server\n" );
+    }
+    RtlLeaveCriticalSection( &async_fd_section );
+    return async_epoll_fd >= 0;
+}
+
+/* queue a read or write async on a socket to be handled in-process */
+static BOOL queue_client_async( int type, const async_data_t *data )
+{
+    HANDLE handle = wine_server_ptr_handle( data->handle );
+    unsigned int access = (type == ASYNC_TYPE_READ) ? FILE_READ_DATA : FILE_WRITE_DATA;
+    struct client_async *async;
+    struct async_fd *afd;
+    enum server_fd_type fd_type;
+    int unix_fd, needs_close;
+
+    if (type != ASYNC_TYPE_READ && type != ASYNC_TYPE_WRITE) return FALSE;
+    if (!init_async_fd()) return FALSE;
+    if (server_get_unix_fd( handle, access, &unix_fd, &needs_close, &fd_type, NULL )) return FALSE;
+    if (needs_close || fd_type != FD_TYPE_SOCKET)
+    {
+        /* only sockets whose fd stays cached as long as the handle is open */
+        if (needs_close) close( unix_fd );
+        return FALSE;
+    }
+    if (!(async = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*async) ))) return FALSE;
+    async->data = *data;
+    async->tid  = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+
+    if (data->event) NtResetEvent( wine_server_ptr_handle( data->event ), NULL );
+    else set_client_async_signaled( data, 0 );
+
+    RtlEnterCriticalSection( &async_fd_section );
+    if (!(afd = get_async_fd( handle )))
+    {
+        if (!(afd = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*afd) )))
+        {
+            RtlLeaveCriticalSection( &async_fd_section );
+            RtlFreeHeap( GetProcessHeap(), 0, async );
+            return FALSE;
+        }
+        afd->handle     = handle;
+        afd->unix_fd    = unix_fd;
+        afd->registered = 0;
+        afd->busy       = 0;
+        list_init( &afd->queue[0] );
+        list_init( &afd->queue[1] );
+        list_add_head( async_fd_bucket( handle ), &afd->entry );
+    }
+    list_add_tail( &afd->queue[type == ASYNC_TYPE_WRITE], &async->entry );
+    if (update_async_fd( afd ))
+    {
+        /* let the server poll it instead */
+        list_remove( &async->entry );
+        update_async_fd( afd );
+        RtlLeaveCriticalSection( &async_fd_section );
+        RtlFreeHeap( GetProcessHeap(), 0, async );
+        return FALSE;
+    }
+    interlocked_xchg_add( &client_async_count, 1 );
+    RtlLeaveCriticalSection( &async_fd_section );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           server_cancel_async_io
+ *
+ * Cancel the in-process asyncs of a handle, either all of them, the ones
+ * queued by the current thread or the one using the given iosb.
+ * Returns the number of asyncs that were cancelled.
+ */
+int server_cancel_async_io( HANDLE handle, const IO_STATUS_BLOCK *iosb, BOOL only_thread, NTSTATUS status )
+{
+    DWORD tid = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    struct client_async *async, *next;
+    struct async_fd *afd;
+    struct list cancelled = LIST_INIT( cancelled );
+    int i, count = 0;
+
+    /* called on every handle close, so avoid the lookup when there's nothing to cancel */
+    if (!client_async_count) return 0;
+
+    RtlEnterCriticalSection( &async_fd_section );
+    if (!(afd = get_async_fd( handle )))
+    {
+        RtlLeaveCriticalSection( &async_fd_section );
+        return 0;
+    }
+    lock_async_fd( afd );
+    for (i = 0; i < 2; i++)
+    {
+        LIST_FOR_EACH_ENTRY_SAFE( async, next, &afd->queue[i], struct client_async, entry )
+        {
+            if (only_thread && async->tid != tid) continue;
+            if (iosb && wine_server_get_ptr( async->data.iosb ) != iosb) continue;
+            list_remove( &async->entry );
+            list_add_tail( &cancelled, &async->entry );
+        }
+    }
+    RtlLeaveCriticalSection( &async_fd_section );
+
+    LIST_FOR_EACH_ENTRY_SAFE( async, next, &cancelled, struct client_async, entry )
+    {
+        list_remove( &async->entry );
+        if (call_client_async( async, status ) == STATUS_PENDING)
+            finish_client_async( async, status, NULL, NULL );
+        count++;
+    }
+
+    RtlEnterCriticalSection( &async_fd_section );
+    unlock_async_fd( afd );
+    RtlLeaveCriticalSection( &async_fd_section );
+    return count;
+}
+
+#else  /* HAVE_SYS_EPOLL_H && HAVE_EPOLL_CREATE */
+
+static BOOL queue_client_async( int type, const async_data_t *data )
+{
+    return FALSE;
+}
+
+int server_cancel_async_io( HANDLE handle, const IO_STATUS_BLOCK *iosb, BOOL only_thread, NTSTATUS status )
+{
+    return 0;
+}
+
+#endif  /* HAVE_SYS_EPOLL_H && HAVE_EPOLL_CREATE */
+
+
+/***********************************************************************
+ *           wine_server_register_async   (NTDLL.@)
+ *
+ * Queue an async I/O operation on a file. Reads and writes on sockets are
+ * handled in-process, which saves the round trips of having the server
+ * poll the fd and send the async back as an APC; everything else is
+ * registered with the server.
+ *
+ * PARAMS
+ *     type  [I] Async type (ASYNC_TYPE_READ or ASYNC_TYPE_WRITE).
+ *     async [I] Async parameters, as for the register_async request.
+ *
+ * RETURNS
+ *     STATUS_PENDING if the async has been queued, otherwise an NTSTATUS error code.
+ */
+unsigned int CDECL wine_server_register_async( int type, const async_data_t *async )
+{
+    unsigned int status;
+
+    if (queue_client_async( type, async )) return STATUS_PENDING;
+
+    SERVER_START_REQ( register_async )
+    {
+        req->type  = type;
+        req->async = *async;
+        status = wine_server_call( req );
+    }
+    SERVER_END_REQ;
+    return status;
+}
+
+
 /***********************************************************************
  *           server_get_unix_fd
  *
@@ -950,8 +1592,8 @@ int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
                 {
                     assert( wine_server_ptr_handle(fd_handle) == handle );
                     *needs_close = (!reply->cacheable ||
-                                    !add_fd_to_cache( handle, fd, reply->type,
-                                                      reply->access, reply->options ));
+                                    !add_fd_to_cache( handle, fd, reply->type, reply->access,
+                                                      reply->options, reply->comp_flags ));
                 }
                 else ret = STATUS_TOO_MANY_OPENED_FILES;
             }
@@ -1450,6 +2092,8 @@ NTSTATUS server_init_process_done(void)
     }
     SERVER_END_REQ;
 
+    init_fast_sync();
+    init_registry_cache();
     return status;
 }
 
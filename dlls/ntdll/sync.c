@@ -42,6 +42,10 @@
 #ifdef HAVE_SCHED_H
 # include <sched.h>
 #endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+#include <limits.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -166,6 +170,230 @@ NTSTATUS validate_open_object_attributes( const OBJECT_ATTRIBUTES *attr )
     return STATUS_SUCCESS;
 }
 
+/*
+ *	Fast synchronization objects
+ *
+ * When the server provides them, events, semaphores and mutexes have their
+ * state in memory shared with the server, and can be signaled and acquired
+ * without a server call as long as no thread waits on them in the server.
+ * These helpers return STATUS_NOT_IMPLEMENTED when the server has to be used.
+ */
+
+#if defined(__linux__) && defined(__NR_futex)
+
+#define TICKSPERSEC 10000000
+
+static inline int shared_futex_wait( int *addr, int val, struct timespec *timeout )
+{
+    return syscall( __NR_futex, addr, 0 /* FUTEX_WAIT */, val, timeout, 0, 0 );
+}
+
+static inline void shared_futex_wake( struct fast_sync_object *obj, int count )
+{
+    if (obj->waiters) syscall( __NR_futex, &obj->value, 1 /* FUTEX_WAKE */, count, NULL, 0, 0 );
+}
+
+static NTSTATUS fast_set_event( HANDLE handle )
+{
+    struct fast_sync_object *obj;
+    enum fast_sync_type type;
+    unsigned int access;
+    int val;
+
+    if (!(obj = server_get_fast_sync( handle, &type, &access ))) return STATUS_NOT_IMPLEMENTED;
+    if (type != FAST_SYNC_AUTO_EVENT && type != FAST_SYNC_MANUAL_EVENT) return STATUS_NOT_IMPLEMENTED;
+    if (!(access & EVENT_MODIFY_STATE)) return STATUS_ACCESS_DENIED;
+
+    do
+    {
+        if ((val = obj->value) & FAST_SYNC_SERVER_WAIT) return STATUS_NOT_IMPLEMENTED;
+        if (val & FAST_SYNC_EVENT_SIGNALED) return STATUS_SUCCESS;  /* already signaled */
+    } while (interlocked_cmpxchg( &obj->value, val | FAST_SYNC_EVENT_SIGNALED, val ) != val);
+
+    shared_futex_wake( obj, type == FAST_SYNC_MANUAL_EVENT ? INT_MAX : 1 );
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fast_reset_event( HANDLE handle )
+{
+    struct fast_sync_object *obj;
+    enum fast_sync_type type;
+    unsigned int access;
+    int val;
+
+    if (!(obj = server_get_fast_sync( handle, &type, &access ))) return STATUS_NOT_IMPLEMENTED;
+    if (type != FAST_SYNC_AUTO_EVENT && type != FAST_SYNC_MANUAL_EVENT) return STATUS_NOT_IMPLEMENTED;
+    if (!(access & EVENT_MODIFY_STATE)) return STATUS_ACCESS_DENIED;
+
+    do
+    {
+        if ((val = obj->value) & FAST_SYNC_SERVER_WAIT) return STATUS_NOT_IMPLEMENTED;
+        if (!(val & FAST_SYNC_EVENT_SIGNALED)) return STATUS_SUCCESS;  /* already reset */
+    } while (interlocked_cmpxchg( &obj->value, val & ~FAST_SYNC_EVENT_SIGNALED, val ) != val);
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fast_release_semaphore( HANDLE handle, ULONG count, ULONG *previous )
+{
+    struct fast_sync_object *obj;
+    enum fast_sync_type type;
+    unsigned int access;
+    int val;
+
+    if (!(obj = server_get_fast_sync( handle, &type, &access ))) return STATUS_NOT_IMPLEMENTED;
+    if (type != FAST_SYNC_SEMAPHORE) return STATUS_NOT_IMPLEMENTED;
+    if (!(access & SEMAPHORE_MODIFY_STATE)) return STATUS_ACCESS_DENIED;
+
+    do
+    {
+        if ((val = obj->value) & FAST_SYNC_SERVER_WAIT) return STATUS_NOT_IMPLEMENTED;
+        if (count > (unsigned int)(obj->max - val)) return STATUS_SEMAPHORE_LIMIT_EXCEEDED;
+    } while (interlocked_cmpxchg( &obj->value, val + count, val ) != val);
+
+    if (previous) *previous = val;
+    shared_futex_wake( obj, count );
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fast_release_mutex( HANDLE handle, LONG *prev_count )
+{
+    struct fast_sync_object *obj;
+    enum fast_sync_type type;
+    unsigned int access;
+    int val, tid = GetCurrentThreadId();
+
+    if (!(obj = server_get_fast_sync( handle, &type, &access ))) return STATUS_NOT_IMPLEMENTED;
+    if (type != FAST_SYNC_MUTEX) return STATUS_NOT_IMPLEMENTED;
+
+    if ((val = obj->value) & FAST_SYNC_SERVER_WAIT) return STATUS_NOT_IMPLEMENTED;
+    if (val != tid) return STATUS_MUTANT_NOT_OWNED;
+
+    /* only the owner modifies the recursion count */
+    if (obj->count > 1)
+    {
+        if (prev_count) *prev_count = 1 - obj->count;
+        obj->count--;
+        return STATUS_SUCCESS;
+    }
+    obj->count = 0;
+    if (interlocked_cmpxchg( &obj->value, 0, tid ) != tid)
+    {
+        /* a server wait started in the meantime */
+        obj->count = 1;
+        return STATUS_NOT_IMPLEMENTED;
+    }
+    if (prev_count) *prev_count = 0;
+    shared_futex_wake( obj, 1 );
+    return STATUS_SUCCESS;
+}
+
+/* wait on a single object; a relative timeout is converted to absolute
+ * in abs_timeout, so that the server wait doesn't restart it on fallback */
+static NTSTATUS fast_wait( HANDLE handle, const LARGE_INTEGER **timeout, LARGE_INTEGER *abs_timeout )
+{
+    struct fast_sync_object *obj;
+    enum fast_sync_type type;
+    unsigned int access;
+    int val, tid = GetCurrentThreadId();
+    struct timespec ts, *tsp;
+    LARGE_INTEGER now;
+    LONGLONG diff;
+
+    if (!(obj = server_get_fast_sync( handle, &type, &access ))) return STATUS_NOT_IMPLEMENTED;
+    if (!(access & SYNCHRONIZE)) return STATUS_ACCESS_DENIED;
+
+    if (*timeout && (*timeout)->QuadPart < 0)
+    {
+        NtQuerySystemTime( &now );
+        abs_timeout->QuadPart = now.QuadPart - (*timeout)->QuadPart;
+        *timeout = abs_timeout;
+    }
+
+    for (;;)
+    {
+        if ((val = obj->value) & FAST_SYNC_SERVER_WAIT) return STATUS_NOT_IMPLEMENTED;
+
+        switch (type)
+        {
+        case FAST_SYNC_AUTO_EVENT:
+            if (!(val & FAST_SYNC_EVENT_SIGNALED)) break;
+            if (interlocked_cmpxchg( &obj->value, val & ~FAST_SYNC_EVENT_SIGNALED, val ) != val) continue;
+            return STATUS_WAIT_0;
+        case FAST_SYNC_MANUAL_EVENT:
+            if (!(val & FAST_SYNC_EVENT_SIGNALED)) break;
+            return STATUS_WAIT_0;
+        case FAST_SYNC_SEMAPHORE:
+            if (!val) break;
+            if (interlocked_cmpxchg( &obj->value, val - 1, val ) != val) continue;
+            return STATUS_WAIT_0;
+        case FAST_SYNC_MUTEX:
+            if (val == tid)
+            {
+                obj->count++;
+                return STATUS_WAIT_0;
+            }
+            if (val) break;
+            if (interlocked_cmpxchg( &obj->value, tid, 0 )) continue;
+            obj->count = 1;
+            return interlocked_xchg( &obj->abandoned, 0 ) ? STATUS_ABANDONED_WAIT_0 : STATUS_WAIT_0;
+        default:
+            return STATUS_NOT_IMPLEMENTED;
+        }
+
+        tsp = NULL;
+        if (*timeout && (*timeout)->QuadPart != TIMEOUT_INFINITE)
+        {
+            NtQuerySystemTime( &now );
+            if ((diff = (*timeout)->QuadPart - now.QuadPart) <= 0) return STATUS_TIMEOUT;
+            ts.tv_sec  = diff / TICKSPERSEC;
+            ts.tv_nsec = (diff % TICKSPERSEC) * 100;
+            tsp = &ts;
+        }
+
+        interlocked_xchg_add( &obj->waiters, 1 );
+        shared_futex_wait( &obj->value, val, tsp );
+        interlocked_xchg_add( &obj->waiters, -1 );
+
+        /* the event has been pulsed while we were waiting; an auto-reset */
+        /* pulse is only taken by the first thread that notices it */
+        if ((type == FAST_SYNC_AUTO_EVENT || type == FAST_SYNC_MANUAL_EVENT) &&
+            ((obj->value ^ val) & ~(FAST_SYNC_SERVER_WAIT | FAST_SYNC_EVENT_SIGNALED)))
+        {
+            if (type == FAST_SYNC_MANUAL_EVENT || interlocked_xchg( &obj->count, 0 ))
+                return STATUS_WAIT_0;
+        }
+    }
+}
+
+#else  /* __linux__ */
+
+static NTSTATUS fast_set_event( HANDLE handle )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_reset_event( HANDLE handle )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_release_semaphore( HANDLE handle, ULONG count, ULONG *previous )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_release_mutex( HANDLE handle, LONG *prev_count )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_wait( HANDLE handle, const LARGE_INTEGER **timeout, LARGE_INTEGER *abs_timeout )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif  /* __linux__ */
+
 /*
  *	Semaphores
  */
@@ -266,6 +494,10 @@ NTSTATUS WINAPI NtQuerySemaphore( HANDLE handle, SEMAPHORE_INFORMATION_CLASS cla
 NTSTATUS WINAPI NtReleaseSemaphore( HANDLE handle, ULONG count, PULONG previous )
 {
     NTSTATUS ret;
+
+    if ((ret = fast_release_semaphore( handle, count, previous )) != STATUS_NOT_IMPLEMENTED)
+        return ret;
+
     SERVER_START_REQ( release_semaphore )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -346,6 +578,8 @@ NTSTATUS WINAPI NtSetEvent( HANDLE handle, PULONG NumberOfThreadsReleased )
 
     /* FIXME: set NumberOfThreadsReleased */
 
+    if ((ret = fast_set_event( handle )) != STATUS_NOT_IMPLEMENTED) return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -366,6 +600,8 @@ NTSTATUS WINAPI NtResetEvent( HANDLE handle, PULONG NumberOfThreadsReleased )
     /* resetting an event can't release any thread... */
     if (NumberOfThreadsReleased) *NumberOfThreadsReleased = 0;
 
+    if ((ret = fast_reset_event( handle )) != STATUS_NOT_IMPLEMENTED) return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -510,6 +746,9 @@ NTSTATUS WINAPI NtReleaseMutant( IN HANDLE handle, OUT PLONG prev_count OPTIONAL
 {
     NTSTATUS    status;
 
+    if ((status = fast_release_mutex( handle, prev_count )) != STATUS_NOT_IMPLEMENTED)
+        return status;
+
     SERVER_START_REQ( release_mutex )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -998,9 +1237,16 @@ static NTSTATUS wait_objects( DWORD count, const HANDLE *handles,
 {
     select_op_t select_op;
     UINT i, flags = SELECT_INTERRUPTIBLE;
+    LARGE_INTEGER abs_timeout;
+    NTSTATUS ret;
 
     if (!count || count > MAXIMUM_WAIT_OBJECTS) return STATUS_INVALID_PARAMETER_1;
 
+    /* only the server can handle alertable and multiple object waits */
+    if (count == 1 && !alertable &&
+        (ret = fast_wait( handles[0], &timeout, &abs_timeout )) != STATUS_NOT_IMPLEMENTED)
+        return ret;
+
     if (alertable) flags |= SELECT_ALERTABLE;
     select_op.wait.op = wait_any ? SELECT_WAIT : SELECT_WAIT_ALL;
     for (i = 0; i < count; i++) select_op.wait.handles[i] = wine_server_obj_handle( handles[i] );
@@ -1307,6 +1553,67 @@ NTSTATUS WINAPI NtRemoveIoCompletion( HANDLE CompletionPort, PULONG_PTR Completi
     return status;
 }
 
+/******************************************************************
+ *              NtRemoveIoCompletionEx (NTDLL.@)
+ *              ZwRemoveIoCompletionEx (NTDLL.@)
+ *
+ * (Wait for and) retrieve up to count completion messages from completion
+ * object's queue, with a single server request when messages are queued.
+ */
+NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE port, FILE_IO_COMPLETION_INFORMATION *info, ULONG count,
+                                        ULONG *written, LARGE_INTEGER *timeout, BOOLEAN alertable )
+{
+    struct completion_msg msgs[64];
+    LARGE_INTEGER abs_timeout, now;
+    NTSTATUS status;
+    ULONG i;
+
+    TRACE( "(%p %p %u %p %p %u)\n", port, info, count, written, timeout, alertable );
+
+    if (!count) return STATUS_INVALID_PARAMETER;
+    count = min( count, sizeof(msgs) / sizeof(msgs[0]) );
+
+    /* don't restart a relative timeout on every wait */
+    if (timeout && timeout->QuadPart < 0)
+    {
+        NtQuerySystemTime( &now );
+        abs_timeout.QuadPart = now.QuadPart - timeout->QuadPart;
+        timeout = &abs_timeout;
+    }
+
+    for (;;)
+    {
+        SERVER_START_REQ( remove_completions )
+        {
+            req->handle = wine_server_obj_handle( port );
+            wine_server_set_reply( req, msgs, count * sizeof(msgs[0]) );
+            if (!(status = wine_server_call( req )))
+                count = wine_server_reply_size( reply ) / sizeof(msgs[0]);
+        }
+        SERVER_END_REQ;
+        if (status != STATUS_PENDING) break;
+
+        status = NtWaitForSingleObject( port, alertable, timeout );
+        if (status != WAIT_OBJECT_0) break;
+    }
+
+    if (status)
+    {
+        *written = 0;
+        return status;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        info[i].CompletionKey             = msgs[i].ckey;
+        info[i].CompletionValue           = msgs[i].cvalue;
+        info[i].IoStatusBlock.Information = msgs[i].information;
+        info[i].IoStatusBlock.u.Status    = msgs[i].status;
+    }
+    *written = count;
+    return STATUS_SUCCESS;
+}
+
 /******************************************************************
  *              NtOpenIoCompletion (NTDLL.@)
  *              ZwOpenIoCompletion (NTDLL.@)
@@ -1391,11 +1698,109 @@ NTSTATUS WINAPI NtQueryIoCompletion( HANDLE CompletionPort, IO_COMPLETION_INFORM
     return status;
 }
 
+/******************************************************************
+ *              NtCreateWaitCompletionPacket (NTDLL.@)
+ *              ZwCreateWaitCompletionPacket (NTDLL.@)
+ */
+NTSTATUS WINAPI NtCreateWaitCompletionPacket( HANDLE *handle, ACCESS_MASK access, OBJECT_ATTRIBUTES *attr )
+{
+    NTSTATUS status;
+    data_size_t len;
+    struct object_attributes *objattr;
+
+    TRACE( "(%p, %x, %p)\n", handle, access, attr );
+
+    if (!handle) return STATUS_INVALID_PARAMETER;
+
+    if ((status = alloc_object_attributes( attr, &objattr, &len ))) return status;
+
+    SERVER_START_REQ( create_wait_completion_packet )
+    {
+        req->access = access;
+        wine_server_add_data( req, objattr, len );
+        if (!(status = wine_server_call( req )))
+            *handle = wine_server_ptr_handle( reply->handle );
+    }
+    SERVER_END_REQ;
+
+    RtlFreeHeap( GetProcessHeap(), 0, objattr );
+    return status;
+}
+
+/******************************************************************
+ *              NtAssociateWaitCompletionPacket (NTDLL.@)
+ *              ZwAssociateWaitCompletionPacket (NTDLL.@)
+ *
+ * Queues a completion packet to a port once an object is signaled. The
+ * wait is done by the server, so that no thread is blocked per object.
+ *
+ * PARAMS
+ *      packet          [I] wait completion packet
+ *      port            [I] completion port the packet is queued to
+ *      target          [I] object to wait for
+ *      key             [I] completion key
+ *      apc_context     [I] completion value
+ *      io_status       [I] status of the completion
+ *      io_info         [I] information of the completion
+ *      signaled        [O] set if the object was already signaled
+ */
+NTSTATUS WINAPI NtAssociateWaitCompletionPacket( HANDLE packet, HANDLE port, HANDLE target, void *key,
+                                                 void *apc_context, NTSTATUS io_status, ULONG_PTR io_info,
+                                                 BOOLEAN *signaled )
+{
+    NTSTATUS status;
+
+    TRACE( "(%p, %p, %p, %p, %p, %x, %#lx, %p)\n", packet, port, target, key, apc_context,
+           io_status, io_info, signaled );
+
+    SERVER_START_REQ( associate_wait_completion_packet )
+    {
+        req->packet      = wine_server_obj_handle( packet );
+        req->completion  = wine_server_obj_handle( port );
+        req->target      = wine_server_obj_handle( target );
+        req->ckey        = wine_server_client_ptr( key );
+        req->cvalue      = wine_server_client_ptr( apc_context );
+        req->information = io_info;
+        req->status      = io_status;
+        if (!(status = wine_server_call( req )) && signaled)
+            *signaled = reply->signaled;
+    }
+    SERVER_END_REQ;
+
+    return status;
+}
+
+/******************************************************************
+ *              NtCancelWaitCompletionPacket (NTDLL.@)
+ *              ZwCancelWaitCompletionPacket (NTDLL.@)
+ *
+ * Returns STATUS_PENDING if the packet is already queued and remove_signaled
+ * isn't set, STATUS_CANCELLED if the packet is neither waiting nor queued.
+ */
+NTSTATUS WINAPI NtCancelWaitCompletionPacket( HANDLE packet, BOOLEAN remove_signaled )
+{
+    NTSTATUS status;
+
+    TRACE( "(%p, %d)\n", packet, remove_signaled );
+
+    SERVER_START_REQ( cancel_wait_completion_packet )
+    {
+        req->packet          = wine_server_obj_handle( packet );
+        req->remove_signaled = remove_signaled;
+        status = wine_server_call( req );
+    }
+    SERVER_END_REQ;
+
+    return status;
+}
+
 NTSTATUS NTDLL_AddCompletion( HANDLE hFile, ULONG_PTR CompletionValue,
                               NTSTATUS CompletionStatus, ULONG Information )
 {
     NTSTATUS status;
 
+    if (server_skip_completion( hFile, CompletionStatus )) return STATUS_SUCCESS;
+
     SERVER_START_REQ( add_fd_completion )
     {
         req->handle      = wine_server_obj_handle( hFile );
@@ -1408,6 +1813,324 @@ NTSTATUS NTDLL_AddCompletion( HANDLE hFile, ULONG_PTR CompletionValue,
     return status;
 }
 
+/* Address waits
+ *
+ * Threads waiting on an address are hashed to one of a fixed number of
+ * wait slots, where they queue an entry holding the address they wait on.
+ * A waker removes the entries matching its address from the queue, so that
+ * unrelated addresses sharing a slot don't wake each other.  The waiter
+ * then sleeps on a futex in its entry on Linux, and on the keyed event
+ * keyed by its entry otherwise.
+ */
+
+#define ADDR_WAIT_SLOTS 256
+
+struct addr_wait_entry
+{
+    struct addr_wait_entry *next;
+    struct addr_wait_entry *prev;
+    const void             *addr;    /* address waited on, NULL once dequeued */
+    int                     woken;   /* set by the waker, used as futex */
+};
+
+struct addr_wait_slot
+{
+    LONG                    lock;        /* spin lock protecting the queue */
+    struct addr_wait_entry *head;        /* queue of waiters, oldest first */
+    struct addr_wait_entry *tail;
+    int                     cv_waiters;  /* number of condition variable waiters */
+};
+
+static struct addr_wait_slot addr_wait_slots[ADDR_WAIT_SLOTS];
+
+static inline struct addr_wait_slot *get_addr_wait_slot( const void *addr )
+{
+    ULONG_PTR val = (ULONG_PTR)addr >> 2;
+    return &addr_wait_slots[(val ^ (val >> 8) ^ (val >> 16)) % ADDR_WAIT_SLOTS];
+}
+
+static void lock_addr_wait_slot( struct addr_wait_slot *slot )
+{
+    while (interlocked_cmpxchg( &slot->lock, 1, 0 )) NtYieldExecution();
+}
+
+static void unlock_addr_wait_slot( struct addr_wait_slot *slot )
+{
+    interlocked_xchg( &slot->lock, 0 );
+}
+
+static void remove_addr_wait_entry( struct addr_wait_slot *slot, struct addr_wait_entry *entry )
+{
+    if (entry->prev) entry->prev->next = entry->next;
+    else slot->head = entry->next;
+    if (entry->next) entry->next->prev = entry->prev;
+    else slot->tail = entry->prev;
+    entry->addr = NULL;
+}
+
+static inline BOOL compare_addr( const void *addr, const void *cmp, SIZE_T size )
+{
+    switch (size)
+    {
+    case 1: return *(const volatile BYTE *)addr == *(const BYTE *)cmp;
+    case 2: return *(const volatile WORD *)addr == *(const WORD *)cmp;
+    case 4: return *(const volatile DWORD *)addr == *(const DWORD *)cmp;
+    case 8: return *(const volatile DWORD64 *)addr == *(const DWORD64 *)cmp;
+    }
+    return FALSE;
+}
+
+#if defined(__linux__) && defined(__NR_futex)
+
+static int futex_private = 128;  /* FUTEX_PRIVATE_FLAG */
+
+static inline int futex_wait( int *addr, int val, struct timespec *timeout )
+{
+    return syscall( __NR_futex, addr, 0 /* FUTEX_WAIT */ | futex_private, val, timeout, 0, 0 );
+}
+
+static inline int futex_wake( int *addr, int count )
+{
+    return syscall( __NR_futex, addr, 1 /* FUTEX_WAKE */ | futex_private, count, NULL, 0, 0 );
+}
+
+static inline int use_futexes(void)
+{
+    static int supported = -1;
+
+    if (supported == -1)
+    {
+        futex_wait( &supported, 10, NULL );
+        if (errno == ENOSYS)
+        {
+            futex_private = 0;
+            futex_wait( &supported, 10, NULL );
+        }
+        supported = (errno != ENOSYS);
+    }
+    return supported;
+}
+
+/* convert an NT timeout to a relative futex timeout, NULL meaning infinite */
+static struct timespec *get_futex_timeout( const LARGE_INTEGER *timeout, struct timespec *ts )
+{
+    LARGE_INTEGER now;
+    LONGLONG diff;
+
+    if (!timeout || timeout->QuadPart == TIMEOUT_INFINITE) return NULL;
+
+    if (timeout->QuadPart >= 0)
+    {
+        NtQuerySystemTime( &now );
+        diff = timeout->QuadPart - now.QuadPart;
+        if (diff < 0) diff = 0;
+    }
+    else diff = -timeout->QuadPart;
+
+    ts->tv_sec  = diff / TICKSPERSEC;
+    ts->tv_nsec = (diff % TICKSPERSEC) * 100;
+    return ts;
+}
+
+static NTSTATUS fast_sleep_addr_entry( struct addr_wait_entry *entry, const LARGE_INTEGER *timeout )
+{
+    struct timespec ts, *futex_timeout;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    futex_timeout = get_futex_timeout( timeout, &ts );
+    while (!*(volatile int *)&entry->woken)
+    {
+        if (futex_wait( &entry->woken, 0, futex_timeout ) == -1 && errno == ETIMEDOUT)
+            return STATUS_TIMEOUT;
+        /* an absolute timeout has to be converted again after a spurious wakeup */
+        futex_timeout = get_futex_timeout( timeout, &ts );
+    }
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fast_wake_addr_entry( struct addr_wait_entry *entry )
+{
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    /* the entry may go away as soon as it is marked woken */
+    interlocked_xchg( &entry->woken, 1 );
+    futex_wake( &entry->woken, 1 );
+    return STATUS_SUCCESS;
+}
+
+/* the condition variable value is a wake sequence number used as futex, the
+ * waiters are counted in the address wait slots so that wakes can skip the syscall */
+static int fast_start_wait_cv( RTL_CONDITION_VARIABLE *variable )
+{
+    /* the waiter has to be counted before the sequence number is read */
+    interlocked_xchg_add( &get_addr_wait_slot( variable )->cv_waiters, 1 );
+    return *(volatile int *)&variable->Ptr;
+}
+
+static NTSTATUS fast_wait_cv( RTL_CONDITION_VARIABLE *variable, int val, const LARGE_INTEGER *timeout )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    struct timespec ts;
+
+    if (futex_wait( (int *)&variable->Ptr, val, get_futex_timeout( timeout, &ts )) == -1 &&
+        errno == ETIMEDOUT)
+        status = STATUS_TIMEOUT;
+    interlocked_xchg_add( &get_addr_wait_slot( variable )->cv_waiters, -1 );
+    return status;
+}
+
+static NTSTATUS fast_wake_cv( RTL_CONDITION_VARIABLE *variable, int count )
+{
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    interlocked_xchg_add( (int *)&variable->Ptr, 1 );
+    if (*(volatile int *)&get_addr_wait_slot( variable )->cv_waiters)
+        futex_wake( (int *)&variable->Ptr, count );
+    return STATUS_SUCCESS;
+}
+
+#else  /* __linux__ */
+
+static inline int use_futexes(void)
+{
+    return 0;
+}
+
+static NTSTATUS fast_sleep_addr_entry( struct addr_wait_entry *entry, const LARGE_INTEGER *timeout )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_wake_addr_entry( struct addr_wait_entry *entry )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static int fast_start_wait_cv( RTL_CONDITION_VARIABLE *variable )
+{
+    return 0;
+}
+
+static NTSTATUS fast_wait_cv( RTL_CONDITION_VARIABLE *variable, int val, const LARGE_INTEGER *timeout )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_wake_cv( RTL_CONDITION_VARIABLE *variable, int count )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif  /* __linux__ */
+
+static NTSTATUS sleep_addr_entry( struct addr_wait_entry *entry, const LARGE_INTEGER *timeout )
+{
+    NTSTATUS status;
+
+    if ((status = fast_sleep_addr_entry( entry, timeout )) != STATUS_NOT_IMPLEMENTED)
+        return status;
+    return NtWaitForKeyedEvent( keyed_event, entry, FALSE, timeout );
+}
+
+static void wake_addr_entry( struct addr_wait_entry *entry )
+{
+    if (fast_wake_addr_entry( entry ) != STATUS_NOT_IMPLEMENTED) return;
+    NtReleaseKeyedEvent( keyed_event, entry, FALSE, NULL );
+}
+
+/* wait on the queue of key while the value at addr is equal to cmp */
+static NTSTATUS wait_on_address( const void *key, const void *addr, const void *cmp, SIZE_T size,
+                                 const LARGE_INTEGER *timeout )
+{
+    struct addr_wait_slot *slot = get_addr_wait_slot( key );
+    struct addr_wait_entry entry;
+    NTSTATUS status;
+
+    /* the value has to be compared with the slot locked, a waker changes
+     * it before dequeuing the waiters and can't miss the entry */
+    lock_addr_wait_slot( slot );
+    if (!compare_addr( addr, cmp, size ))
+    {
+        unlock_addr_wait_slot( slot );
+        return STATUS_SUCCESS;
+    }
+    entry.addr  = key;
+    entry.woken = 0;
+    entry.next  = NULL;
+    entry.prev  = slot->tail;
+    if (slot->tail) slot->tail->next = &entry;
+    else slot->head = &entry;
+    slot->tail = &entry;
+    unlock_addr_wait_slot( slot );
+
+    if ((status = sleep_addr_entry( &entry, timeout )) == STATUS_SUCCESS) return status;
+
+    lock_addr_wait_slot( slot );
+    if (entry.addr) remove_addr_wait_entry( slot, &entry );
+    else status = STATUS_SUCCESS;
+    unlock_addr_wait_slot( slot );
+
+    /* a waker dequeued us already, its wake has to be consumed */
+    if (status == STATUS_SUCCESS) sleep_addr_entry( &entry, NULL );
+    return status;
+}
+
+/* wake the first waiter, or all the waiters, queued on key */
+static void wake_address( const void *key, BOOL all )
+{
+    struct addr_wait_slot *slot = get_addr_wait_slot( key );
+    struct addr_wait_entry *entry, *next, *woken = NULL;
+
+    lock_addr_wait_slot( slot );
+    for (entry = slot->head; entry; entry = next)
+    {
+        next = entry->next;
+        if (entry->addr != key) continue;
+        remove_addr_wait_entry( slot, entry );
+        entry->next = woken;
+        woken = entry;
+        if (!all) break;
+    }
+    unlock_addr_wait_slot( slot );
+
+    for (entry = woken; entry; entry = next)
+    {
+        next = entry->next;
+        wake_addr_entry( entry );
+    }
+}
+
+/***********************************************************************
+ *           RtlWaitOnAddress   (NTDLL.@)
+ *
+ * Waits until the value at addr differs from the one at cmp, or until a
+ * thread wakes the address.  The wait may also end spuriously.
+ */
+NTSTATUS WINAPI RtlWaitOnAddress( const void *addr, const void *cmp, SIZE_T size,
+                                  const LARGE_INTEGER *timeout )
+{
+    if (size != 1 && size != 2 && size != 4 && size != 8) return STATUS_INVALID_PARAMETER;
+
+    return wait_on_address( addr, addr, cmp, size, timeout );
+}
+
+/***********************************************************************
+ *           RtlWakeAddressAll   (NTDLL.@)
+ */
+void WINAPI RtlWakeAddressAll( const void *addr )
+{
+    wake_address( addr, TRUE );
+}
+
+/***********************************************************************
+ *           RtlWakeAddressSingle   (NTDLL.@)
+ */
+void WINAPI RtlWakeAddressSingle( const void *addr )
+{
+    wake_address( addr, FALSE );
+}
+
 /******************************************************************
  *              RtlRunOnceInitialize (NTDLL.@)
  */
@@ -1433,7 +2156,7 @@ DWORD WINAPI RtlRunOnceBeginInitialize( RTL_RUN_ONCE *once, ULONG flags, void **
 
     for (;;)
     {
-        ULONG_PTR next, val = (ULONG_PTR)once->Ptr;
+        ULONG_PTR val = (ULONG_PTR)once->Ptr;
 
         switch (val & 3)
         {
@@ -1445,10 +2168,7 @@ DWORD WINAPI RtlRunOnceBeginInitialize( RTL_RUN_ONCE *once, ULONG flags, void **
 
         case 1:  /* in progress, wait */
             if (flags & RTL_RUN_ONCE_ASYNC) return STATUS_INVALID_PARAMETER;
-            next = val & ~3;
-            if (interlocked_cmpxchg_ptr( &once->Ptr, (void *)((ULONG_PTR)&next | 1),
-                                         (void *)val ) == (void *)val)
-                NtWaitForKeyedEvent( keyed_event, &next, FALSE, NULL );
+            RtlWaitOnAddress( &once->Ptr, &val, sizeof(val), NULL );
             break;
 
         case 2:  /* done */
@@ -1484,13 +2204,7 @@ DWORD WINAPI RtlRunOnceComplete( RTL_RUN_ONCE *once, ULONG flags, void *context
         {
         case 1:  /* in progress */
             if (interlocked_cmpxchg_ptr( &once->Ptr, context, (void *)val ) != (void *)val) break;
-            val &= ~3;
-            while (val)
-            {
-                ULONG_PTR next = *(ULONG_PTR *)val;
-                NtReleaseKeyedEvent( keyed_event, (void *)val, FALSE, NULL );
-                val = next;
-            }
+            RtlWakeAddressAll( &once->Ptr );
             return STATUS_SUCCESS;
 
         case 3:  /* in progress, async */
@@ -1526,124 +2240,27 @@ DWORD WINAPI RtlRunOnceExecuteOnce( RTL_RUN_ONCE *once, PRTL_RUN_ONCE_INIT_FN fu
 
 /* SRW locks implementation
  *
- * The memory layout used by the lock is:
- *
- * 32 31            16               0
- *  ________________ ________________
- * | X| #exclusive  |    #shared     |
- *  ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
- * Since there is no space left for a separate counter of shared access
- * threads inside the locked section the #shared field is used for multiple
- * purposes. The following table lists all possible states the lock can be
- * in, notation: [X, #exclusive, #shared]:
- *
- * [0,   0,   N] -> locked by N shared access threads, if N=0 its unlocked
- * [0, >=1, >=1] -> threads are requesting exclusive locks, but there are
- * still shared access threads inside. #shared should not be incremented
- * anymore!
- * [1, >=1, >=0] -> lock is owned by an exclusive thread and the #shared
- * counter can be used again to count the number of threads waiting in the
- * queue for shared access.
- *
- * the following states are invalid and will never occur:
- * [0, >=1,   0], [1,   0, >=0]
- *
- * The main problem arising from the fact that we have no separate counter
- * of shared access threads inside the locked section is that in the state
- * [0, >=1, >=1] above we cannot add additional waiting threads to the
- * shared access queue - it wouldn't be possible to distinguish waiting
- * threads and those that are still inside. To solve this problem the lock
- * uses the following approach: a thread that isn't able to allocate a
- * shared lock just uses the exclusive queue instead. As soon as the thread
- * is woken up it is in the state [1, >=1, >=0]. In this state it's again
- * possible to use the shared access queue. The thread atomically moves
- * itself to the shared access queue and releases the exclusive lock, so
- * that the "real" exclusive access threads have a chance. As soon as they
- * are all ready the shared access threads are processed.
- */
-
-#define SRWLOCK_MASK_IN_EXCLUSIVE     0x80000000
-#define SRWLOCK_MASK_EXCLUSIVE_QUEUE  0x7fff0000
-#define SRWLOCK_MASK_SHARED_QUEUE     0x0000ffff
-#define SRWLOCK_RES_EXCLUSIVE         0x00010000
-#define SRWLOCK_RES_SHARED            0x00000001
-
-#ifdef WORDS_BIGENDIAN
-#define srwlock_key_exclusive(lock)   (&lock->Ptr)
-#define srwlock_key_shared(lock)      ((void *)((char *)&lock->Ptr + 2))
-#else
-#define srwlock_key_exclusive(lock)   ((void *)((char *)&lock->Ptr + 2))
-#define srwlock_key_shared(lock)      (&lock->Ptr)
-#endif
-
-static inline void srwlock_check_invalid( unsigned int val )
-{
-    /* Throw exception if it's impossible to acquire/release this lock. */
-    if ((val & SRWLOCK_MASK_EXCLUSIVE_QUEUE) == SRWLOCK_MASK_EXCLUSIVE_QUEUE ||
-            (val & SRWLOCK_MASK_SHARED_QUEUE) == SRWLOCK_MASK_SHARED_QUEUE)
-        RtlRaiseStatus(STATUS_RESOURCE_NOT_OWNED);
-}
-
-static inline unsigned int srwlock_lock_exclusive( unsigned int *dest, int incr )
-{
-    unsigned int val, tmp;
-    /* Atomically modifies the value of *dest by adding incr. If the shared
-     * queue is empty and there are threads waiting for exclusive access, then
-     * sets the mark SRWLOCK_MASK_IN_EXCLUSIVE to signal other threads that
-     * they are allowed again to use the shared queue counter. */
-    for (val = *dest;; val = tmp)
-    {
-        tmp = val + incr;
-        srwlock_check_invalid( tmp );
-        if ((tmp & SRWLOCK_MASK_EXCLUSIVE_QUEUE) && !(tmp & SRWLOCK_MASK_SHARED_QUEUE))
-            tmp |= SRWLOCK_MASK_IN_EXCLUSIVE;
-        if ((tmp = interlocked_cmpxchg( (int *)dest, tmp, val )) == val)
-            break;
-    }
-    return val;
-}
+ * The lock value holds the number of shared owners, or -1 if the lock is
+ * owned exclusively, and the number of threads waiting for exclusive
+ * access, which take precedence over new shared owners.  Threads wait
+ * for any change of the lock value, exclusive waiters queued on the
+ * address of the waiter count and shared waiters on the lock address, so
+ * that a release can wake a single exclusive waiter.
+ */
 
-static inline unsigned int srwlock_unlock_exclusive( unsigned int *dest, int incr )
+struct srw_lock
 {
-    unsigned int val, tmp;
-    /* Atomically modifies the value of *dest by adding incr. If the queue of
-     * threads waiting for exclusive access is empty, then remove the
-     * SRWLOCK_MASK_IN_EXCLUSIVE flag (only the shared queue counter will
-     * remain). */
-    for (val = *dest;; val = tmp)
-    {
-        tmp = val + incr;
-        srwlock_check_invalid( tmp );
-        if (!(tmp & SRWLOCK_MASK_EXCLUSIVE_QUEUE))
-            tmp &= SRWLOCK_MASK_SHARED_QUEUE;
-        if ((tmp = interlocked_cmpxchg( (int *)dest, tmp, val )) == val)
-            break;
-    }
-    return val;
-}
+    short owners;
+    unsigned short exclusive_waiters;
+};
 
-static inline void srwlock_leave_exclusive( RTL_SRWLOCK *lock, unsigned int val )
+union srw_lock_value
 {
-    /* Used when a thread leaves an exclusive section. If there are other
-     * exclusive access threads they are processed first, followed by
-     * the shared waiters. */
-    if (val & SRWLOCK_MASK_EXCLUSIVE_QUEUE)
-        NtReleaseKeyedEvent( keyed_event, srwlock_key_exclusive(lock), FALSE, NULL );
-    else
-    {
-        val &= SRWLOCK_MASK_SHARED_QUEUE; /* remove SRWLOCK_MASK_IN_EXCLUSIVE */
-        while (val--)
-            NtReleaseKeyedEvent( keyed_event, srwlock_key_shared(lock), FALSE, NULL );
-    }
-}
+    struct srw_lock s;
+    int l;
+};
 
-static inline void srwlock_leave_shared( RTL_SRWLOCK *lock, unsigned int val )
-{
-    /* Wake up one exclusive thread as soon as the last shared access thread
-     * has left. */
-    if ((val & SRWLOCK_MASK_EXCLUSIVE_QUEUE) && !(val & SRWLOCK_MASK_SHARED_QUEUE))
-        NtReleaseKeyedEvent( keyed_event, srwlock_key_exclusive(lock), FALSE, NULL );
-}
+C_ASSERT( sizeof(struct srw_lock) == sizeof(int) );
 
 /***********************************************************************
  *              RtlInitializeSRWLock (NTDLL.@)
@@ -1651,9 +2268,8 @@ static inline void srwlock_leave_shared( RTL_SRWLOCK *lock, unsigned int val )
  * NOTES
  *  Please note that SRWLocks do not keep track of the owner of a lock.
  *  It doesn't make any difference which thread for example unlocks an
- *  SRWLock (see corresponding tests). This implementation uses two
- *  keyed events (one for the exclusive waiters and one for the shared
- *  waiters) and is limited to 2^15-1 waiting threads.
+ *  SRWLock (see corresponding tests). This implementation is limited to
+ *  2^15-1 shared owners and 2^16-1 exclusive waiters.
  */
 void WINAPI RtlInitializeSRWLock( RTL_SRWLOCK *lock )
 {
@@ -1670,8 +2286,39 @@ void WINAPI RtlInitializeSRWLock( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 {
-    if (srwlock_lock_exclusive( (unsigned int *)&lock->Ptr, SRWLOCK_RES_EXCLUSIVE ))
-        NtWaitForKeyedEvent( keyed_event, srwlock_key_exclusive(lock), FALSE, NULL );
+    struct srw_lock *srw = (struct srw_lock *)&lock->Ptr;
+    union srw_lock_value old, new;
+
+    if (RtlTryAcquireSRWLockExclusive( lock )) return;
+
+    do
+    {
+        old.l = *(volatile int *)srw;
+        new = old;
+        if (new.s.exclusive_waiters == 0xffff) RtlRaiseStatus( STATUS_RESOURCE_NOT_OWNED );
+        new.s.exclusive_waiters++;
+    } while (interlocked_cmpxchg( (int *)srw, new.l, old.l ) != old.l);
+
+    for (;;)
+    {
+        BOOL wait;
+
+        do
+        {
+            old.l = *(volatile int *)srw;
+            new = old;
+            if (!old.s.owners)
+            {
+                new.s.owners = -1;
+                new.s.exclusive_waiters--;
+                wait = FALSE;
+            }
+            else wait = TRUE;
+        } while (interlocked_cmpxchg( (int *)srw, new.l, old.l ) != old.l);
+
+        if (!wait) return;
+        wait_on_address( &srw->exclusive_waiters, srw, &new.s, sizeof(*srw), NULL );
+    }
 }
 
 /***********************************************************************
@@ -1683,30 +2330,29 @@ void WINAPI RtlAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlAcquireSRWLockShared( RTL_SRWLOCK *lock )
 {
-    unsigned int val, tmp;
-    /* Acquires a shared lock. If it's currently not possible to add elements to
-     * the shared queue, then request exclusive access instead. */
-    for (val = *(unsigned int *)&lock->Ptr;; val = tmp)
-    {
-        if ((val & SRWLOCK_MASK_EXCLUSIVE_QUEUE) && !(val & SRWLOCK_MASK_IN_EXCLUSIVE))
-            tmp = val + SRWLOCK_RES_EXCLUSIVE;
-        else
-            tmp = val + SRWLOCK_RES_SHARED;
-        if ((tmp = interlocked_cmpxchg( (int *)&lock->Ptr, tmp, val )) == val)
-            break;
-    }
+    struct srw_lock *srw = (struct srw_lock *)&lock->Ptr;
+    union srw_lock_value old, new;
 
-    /* Drop exclusive access again and instead requeue for shared access. */
-    if ((val & SRWLOCK_MASK_EXCLUSIVE_QUEUE) && !(val & SRWLOCK_MASK_IN_EXCLUSIVE))
+    for (;;)
     {
-        NtWaitForKeyedEvent( keyed_event, srwlock_key_exclusive(lock), FALSE, NULL );
-        val = srwlock_unlock_exclusive( (unsigned int *)&lock->Ptr, (SRWLOCK_RES_SHARED
-                                        - SRWLOCK_RES_EXCLUSIVE) ) - SRWLOCK_RES_EXCLUSIVE;
-        srwlock_leave_exclusive( lock, val );
-    }
+        BOOL wait;
+
+        do
+        {
+            old.l = *(volatile int *)srw;
+            new = old;
+            if (old.s.owners != -1 && !old.s.exclusive_waiters)
+            {
+                if (new.s.owners == 0x7fff) RtlRaiseStatus( STATUS_RESOURCE_NOT_OWNED );
+                new.s.owners++;
+                wait = FALSE;
+            }
+            else wait = TRUE;
+        } while (interlocked_cmpxchg( (int *)srw, new.l, old.l ) != old.l);
 
-    if (val & SRWLOCK_MASK_EXCLUSIVE_QUEUE)
-        NtWaitForKeyedEvent( keyed_event, srwlock_key_shared(lock), FALSE, NULL );
+        if (!wait) return;
+        wait_on_address( srw, srw, &new.s, sizeof(*srw), NULL );
+    }
 }
 
 /***********************************************************************
@@ -1714,8 +2360,19 @@ void WINAPI RtlAcquireSRWLockShared( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlReleaseSRWLockExclusive( RTL_SRWLOCK *lock )
 {
-    srwlock_leave_exclusive( lock, srwlock_unlock_exclusive( (unsigned int *)&lock->Ptr,
-                             - SRWLOCK_RES_EXCLUSIVE ) - SRWLOCK_RES_EXCLUSIVE );
+    struct srw_lock *srw = (struct srw_lock *)&lock->Ptr;
+    union srw_lock_value old, new;
+
+    do
+    {
+        old.l = *(volatile int *)srw;
+        new = old;
+        if (old.s.owners != -1) ERR( "Lock %p is not owned exclusive!\n", lock );
+        new.s.owners = 0;
+    } while (interlocked_cmpxchg( (int *)srw, new.l, old.l ) != old.l);
+
+    if (old.s.exclusive_waiters) wake_address( &srw->exclusive_waiters, FALSE );
+    else wake_address( srw, TRUE );
 }
 
 /***********************************************************************
@@ -1723,8 +2380,19 @@ void WINAPI RtlReleaseSRWLockExclusive( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlReleaseSRWLockShared( RTL_SRWLOCK *lock )
 {
-    srwlock_leave_shared( lock, srwlock_lock_exclusive( (unsigned int *)&lock->Ptr,
-                          - SRWLOCK_RES_SHARED ) - SRWLOCK_RES_SHARED );
+    struct srw_lock *srw = (struct srw_lock *)&lock->Ptr;
+    union srw_lock_value old, new;
+
+    do
+    {
+        old.l = *(volatile int *)srw;
+        new = old;
+        if (old.s.owners == -1) ERR( "Lock %p is owned exclusive!\n", lock );
+        else if (!old.s.owners) ERR( "Lock %p is not owned shared!\n", lock );
+        new.s.owners--;
+    } while (interlocked_cmpxchg( (int *)srw, new.l, old.l ) != old.l);
+
+    if (!new.s.owners && new.s.exclusive_waiters) wake_address( &srw->exclusive_waiters, FALSE );
 }
 
 /***********************************************************************
@@ -1736,8 +2404,11 @@ void WINAPI RtlReleaseSRWLockShared( RTL_SRWLOCK *lock )
  */
 BOOLEAN WINAPI RtlTryAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 {
-    return interlocked_cmpxchg( (int *)&lock->Ptr, SRWLOCK_MASK_IN_EXCLUSIVE |
-                                SRWLOCK_RES_EXCLUSIVE, 0 ) == 0;
+    union srw_lock_value new;
+
+    new.s.owners = -1;
+    new.s.exclusive_waiters = 0;
+    return interlocked_cmpxchg( (int *)&lock->Ptr, new.l, 0 ) == 0;
 }
 
 /***********************************************************************
@@ -1745,14 +2416,17 @@ BOOLEAN WINAPI RtlTryAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
  */
 BOOLEAN WINAPI RtlTryAcquireSRWLockShared( RTL_SRWLOCK *lock )
 {
-    unsigned int val, tmp;
-    for (val = *(unsigned int *)&lock->Ptr;; val = tmp)
+    struct srw_lock *srw = (struct srw_lock *)&lock->Ptr;
+    union srw_lock_value old, new;
+
+    do
     {
-        if (val & SRWLOCK_MASK_EXCLUSIVE_QUEUE)
-            return FALSE;
-        if ((tmp = interlocked_cmpxchg( (int *)&lock->Ptr, val + SRWLOCK_RES_SHARED, val )) == val)
-            break;
-    }
+        old.l = *(volatile int *)srw;
+        new = old;
+        if (old.s.owners == -1 || old.s.exclusive_waiters || old.s.owners == 0x7fff) return FALSE;
+        new.s.owners++;
+    } while (interlocked_cmpxchg( (int *)srw, new.l, old.l ) != old.l);
+
     return TRUE;
 }
 
@@ -1789,6 +2463,7 @@ void WINAPI RtlInitializeConditionVariable( RTL_CONDITION_VARIABLE *variable )
  */
 void WINAPI RtlWakeConditionVariable( RTL_CONDITION_VARIABLE *variable )
 {
+    if (fast_wake_cv( variable, 1 ) != STATUS_NOT_IMPLEMENTED) return;
     if (interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
         NtReleaseKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
 }
@@ -1800,7 +2475,10 @@ void WINAPI RtlWakeConditionVariable( RTL_CONDITION_VARIABLE *variable )
  */
 void WINAPI RtlWakeAllConditionVariable( RTL_CONDITION_VARIABLE *variable )
 {
-    int val = interlocked_xchg( (int *)&variable->Ptr, 0 );
+    int val;
+
+    if (fast_wake_cv( variable, INT_MAX ) != STATUS_NOT_IMPLEMENTED) return;
+    val = interlocked_xchg( (int *)&variable->Ptr, 0 );
     while (val-- > 0)
         NtReleaseKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
 }
@@ -1824,6 +2502,16 @@ NTSTATUS WINAPI RtlSleepConditionVariableCS( RTL_CONDITION_VARIABLE *variable, R
                                              const LARGE_INTEGER *timeout )
 {
     NTSTATUS status;
+
+    if (use_futexes())
+    {
+        int val = fast_start_wait_cv( variable );
+        RtlLeaveCriticalSection( crit );
+        status = fast_wait_cv( variable, val, timeout );
+        RtlEnterCriticalSection( crit );
+        return status;
+    }
+
     interlocked_xchg_add( (int *)&variable->Ptr, 1 );
     RtlLeaveCriticalSection( crit );
 
@@ -1861,18 +2549,26 @@ NTSTATUS WINAPI RtlSleepConditionVariableSRW( RTL_CONDITION_VARIABLE *variable,
                                               const LARGE_INTEGER *timeout, ULONG flags )
 {
     NTSTATUS status;
-    interlocked_xchg_add( (int *)&variable->Ptr, 1 );
+    int val = 0;
+
+    if (use_futexes()) val = fast_start_wait_cv( variable );
+    else interlocked_xchg_add( (int *)&variable->Ptr, 1 );
 
     if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
         RtlReleaseSRWLockShared( lock );
     else
         RtlReleaseSRWLockExclusive( lock );
 
-    status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, timeout );
-    if (status != STATUS_SUCCESS)
+    if (use_futexes())
+        status = fast_wait_cv( variable, val, timeout );
+    else
     {
-        if (!interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
-            status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
+        status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, timeout );
+        if (status != STATUS_SUCCESS)
+        {
+            if (!interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
+                status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
+        }
     }
 
     if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
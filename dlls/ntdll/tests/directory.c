@@ -823,6 +823,169 @@ done:
     pRtlFreeUnicodeString(&ntdirname);
 }
 
+static void test_case_insensitive_open(void)
+{
+    char testdir[MAX_PATH], path[MAX_PATH], name[MAX_PATH];
+    DWORD ticks;
+    HANDLE file;
+    BOOL ret;
+    int i;
+
+    GetTempPathA(MAX_PATH, testdir);
+    strcat(testdir, "lookup.tmp");
+    ret = CreateDirectoryA(testdir, NULL);
+    ok(ret, "CreateDirectory failed, error %u\n", GetLastError());
+
+    for (i = 0; i < 500; i++)
+    {
+        sprintf(path, "%s\\File%u.Txt", testdir, i);
+        file = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, NULL);
+        ok(file != INVALID_HANDLE_VALUE, "failed to create %s, error %u\n", path, GetLastError());
+        CloseHandle(file);
+    }
+
+    /* names are found whatever their case */
+    ticks = GetTickCount();
+    for (i = 0; i < 500; i++)
+    {
+        sprintf(path, "%s\\FILE%u.TXT", testdir, i);
+        file = CreateFileA(path, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
+        if (file == INVALID_HANDLE_VALUE) break;
+        CloseHandle(file);
+    }
+    ticks = GetTickCount() - ticks;
+    ok(i == 500, "failed to open %s, error %u\n", path, GetLastError());
+    if (winetest_interactive)
+        trace("opened %u files with case mismatches in %u ms\n", i, ticks);
+
+    /* changes to the directory are seen right away */
+    sprintf(path, "%s\\file1.txt", testdir);
+    sprintf(name, "%s\\FILE1.TXT", testdir);
+    ret = DeleteFileA(path);
+    ok(ret, "DeleteFile failed, error %u\n", GetLastError());
+    file = CreateFileA(name, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
+    ok(file == INVALID_HANDLE_VALUE, "opened deleted file\n");
+    ok(GetLastError() == ERROR_FILE_NOT_FOUND, "got error %u\n", GetLastError());
+
+    sprintf(path, "%s\\NewFile.Txt", testdir);
+    file = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "failed to create %s, error %u\n", path, GetLastError());
+    CloseHandle(file);
+    sprintf(name, "%s\\newfile.TXT", testdir);
+    file = CreateFileA(name, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "failed to open new file, error %u\n", GetLastError());
+    CloseHandle(file);
+
+    sprintf(name, "%s\\Renamed.Txt", testdir);
+    ret = MoveFileA(path, name);
+    ok(ret, "MoveFile failed, error %u\n", GetLastError());
+    sprintf(path, "%s\\NEWFILE.TXT", testdir);
+    file = CreateFileA(path, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
+    ok(file == INVALID_HANDLE_VALUE, "opened renamed file\n");
+    sprintf(path, "%s\\RENAMED.TXT", testdir);
+    file = CreateFileA(path, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "failed to open renamed file, error %u\n", GetLastError());
+    CloseHandle(file);
+
+    DeleteFileA(name);
+    for (i = 0; i < 500; i++)
+    {
+        sprintf(path, "%s\\File%u.Txt", testdir, i);
+        DeleteFileA(path);
+    }
+    ret = RemoveDirectoryA(testdir);
+    ok(ret, "RemoveDirectory failed, error %u\n", GetLastError());
+}
+
+static int count_dir_entries(const char *testdir, DWORD *size)
+{
+    WIN32_FIND_DATAA data;
+    char mask[MAX_PATH];
+    HANDLE find;
+    int count = 0;
+
+    sprintf(mask, "%s\\*", testdir);
+    find = FindFirstFileA(mask, &data);
+    ok(find != INVALID_HANDLE_VALUE, "FindFirstFile failed, error %u\n", GetLastError());
+    if (find == INVALID_HANDLE_VALUE) return -1;
+    do
+    {
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+        if (size && !strcmp(data.cFileName, "File0.Txt")) *size = data.nFileSizeLow;
+        count++;
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+    return count;
+}
+
+static void test_enumeration_cache(void)
+{
+    int i, count, file_count = winetest_interactive ? 100000 : 1000;
+    char testdir[MAX_PATH], path[MAX_PATH];
+    DWORD ticks, size, written;
+    HANDLE file;
+    BOOL ret;
+
+    GetTempPathA(MAX_PATH, testdir);
+    strcat(testdir, "enum.tmp");
+    ret = CreateDirectoryA(testdir, NULL);
+    ok(ret, "CreateDirectory failed, error %u\n", GetLastError());
+
+    for (i = 0; i < file_count; i++)
+    {
+        sprintf(path, "%s\\File%u.Txt", testdir, i);
+        file = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, NULL);
+        ok(file != INVALID_HANDLE_VALUE, "failed to create %s, error %u\n", path, GetLastError());
+        CloseHandle(file);
+    }
+
+    ticks = GetTickCount();
+    count = count_dir_entries(testdir, NULL);
+    ticks = GetTickCount() - ticks;
+    ok(count == file_count, "got %d files\n", count);
+    if (winetest_interactive)
+        trace("enumerated %d files in %u ms\n", count, ticks);
+
+    ticks = GetTickCount();
+    count = count_dir_entries(testdir, NULL);
+    ticks = GetTickCount() - ticks;
+    ok(count == file_count, "got %d files\n", count);
+    if (winetest_interactive)
+        trace("enumerated %d files again in %u ms\n", count, ticks);
+
+    /* new and deleted files are seen right away by new searches */
+    sprintf(path, "%s\\NewFile.Txt", testdir);
+    file = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "failed to create %s, error %u\n", path, GetLastError());
+    CloseHandle(file);
+    count = count_dir_entries(testdir, NULL);
+    ok(count == file_count + 1, "got %d files\n", count);
+
+    ret = DeleteFileA(path);
+    ok(ret, "DeleteFile failed, error %u\n", GetLastError());
+    count = count_dir_entries(testdir, NULL);
+    ok(count == file_count, "got %d files\n", count);
+
+    /* file information is not cached */
+    sprintf(path, "%s\\File0.Txt", testdir);
+    file = CreateFileA(path, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "failed to open %s, error %u\n", path, GetLastError());
+    WriteFile(file, "data", 4, &written, NULL);
+    CloseHandle(file);
+    size = 0;
+    count = count_dir_entries(testdir, &size);
+    ok(count == file_count, "got %d files\n", count);
+    ok(size == 4, "got size %u\n", size);
+
+    for (i = 0; i < file_count; i++)
+    {
+        sprintf(path, "%s\\File%u.Txt", testdir, i);
+        DeleteFileA(path);
+    }
+    ret = RemoveDirectoryA(testdir);
+    ok(ret, "RemoveDirectory failed, error %u\n", GetLastError());
+}
+
 static void test_redirection(void)
 {
     ULONG old, cur;
@@ -899,5 +1062,7 @@ START_TEST(directory)
     test_directory_sort( sysdir );
     test_NtQueryDirectoryFile();
     test_NtQueryDirectoryFile_case();
+    test_case_insensitive_open();
+    test_enumeration_cache();
     test_redirection();
 }
@@ -73,6 +73,9 @@ static NTSTATUS (WINAPI *pNtOpenIoCompletion)(PHANDLE, ACCESS_MASK, POBJECT_ATTR
 static NTSTATUS (WINAPI *pNtQueryIoCompletion)(HANDLE, IO_COMPLETION_INFORMATION_CLASS, PVOID, ULONG, PULONG);
 static NTSTATUS (WINAPI *pNtRemoveIoCompletion)(HANDLE, PULONG_PTR, PULONG_PTR, PIO_STATUS_BLOCK, PLARGE_INTEGER);
 static NTSTATUS (WINAPI *pNtSetIoCompletion)(HANDLE, ULONG_PTR, ULONG_PTR, NTSTATUS, SIZE_T);
+static NTSTATUS (WINAPI *pNtCreateWaitCompletionPacket)(PHANDLE, ACCESS_MASK, POBJECT_ATTRIBUTES);
+static NTSTATUS (WINAPI *pNtAssociateWaitCompletionPacket)(HANDLE, HANDLE, HANDLE, PVOID, PVOID, NTSTATUS, ULONG_PTR, BOOLEAN *);
+static NTSTATUS (WINAPI *pNtCancelWaitCompletionPacket)(HANDLE, BOOLEAN);
 static NTSTATUS (WINAPI *pNtSetInformationFile)(HANDLE, PIO_STATUS_BLOCK, PVOID, ULONG, FILE_INFORMATION_CLASS);
 static NTSTATUS (WINAPI *pNtQueryInformationFile)(HANDLE, PIO_STATUS_BLOCK, PVOID, ULONG, FILE_INFORMATION_CLASS);
 static NTSTATUS (WINAPI *pNtQueryDirectoryFile)(HANDLE,HANDLE,PIO_APC_ROUTINE,PVOID,PIO_STATUS_BLOCK,
@@ -568,6 +571,77 @@ static void open_file_test(void)
     DeleteFileW( tmpfile );
 }
 
+static void test_open_existing_file(void)
+{
+    static const WCHAR fooW[] = {'f','o','o',0};
+    static const char testdata[] = "Hello World";
+    WCHAR path[MAX_PATH], tmpfile[MAX_PATH];
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING nameW;
+    IO_STATUS_BLOCK io;
+    HANDLE file, file2;
+    NTSTATUS status;
+    DWORD start, count;
+    char data[32];
+    int i;
+
+    GetTempPathW( MAX_PATH, path );
+    GetTempFileNameW( path, fooW, 0, tmpfile );
+    file = CreateFileW( tmpfile, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, 0 );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile failed %u\n", GetLastError() );
+    WriteFile( file, testdata, sizeof(testdata) - 1, &count, NULL );
+    CloseHandle( file );
+
+    pRtlDosPathNameToNtPathName_U( tmpfile, &nameW, NULL, NULL );
+    attr.Length = sizeof(attr);
+    attr.RootDirectory = 0;
+    attr.ObjectName = &nameW;
+    attr.Attributes = OBJ_CASE_INSENSITIVE;
+    attr.SecurityDescriptor = NULL;
+    attr.SecurityQualityOfService = NULL;
+
+    status = pNtOpenFile( &file, GENERIC_READ | SYNCHRONIZE, &attr, &io,
+                          FILE_SHARE_READ, FILE_SYNCHRONOUS_IO_NONALERT );
+    ok( !status, "NtOpenFile failed %x\n", status );
+    ok( io.Information == FILE_OPENED, "wrong info %lu\n", io.Information );
+
+    /* sharing must still be enforced */
+    status = pNtOpenFile( &file2, GENERIC_WRITE | SYNCHRONIZE, &attr, &io,
+                          FILE_SHARE_READ | FILE_SHARE_WRITE, FILE_SYNCHRONOUS_IO_NONALERT );
+    ok( status == STATUS_SHARING_VIOLATION, "expected STATUS_SHARING_VIOLATION, got %x\n", status );
+    status = pNtOpenFile( &file2, GENERIC_READ | SYNCHRONIZE, &attr, &io,
+                          FILE_SHARE_READ, FILE_SYNCHRONOUS_IO_NONALERT );
+    ok( !status, "NtOpenFile failed %x\n", status );
+
+    memset( data, 0, sizeof(data) );
+    status = pNtReadFile( file2, 0, NULL, NULL, &io, data, sizeof(data), NULL, NULL );
+    ok( !status, "NtReadFile failed %x\n", status );
+    ok( io.Information == sizeof(testdata) - 1, "wrong size %lu\n", io.Information );
+    ok( !memcmp( data, testdata, sizeof(testdata) - 1 ), "wrong data %s\n", data );
+    CloseHandle( file2 );
+
+    status = pNtWriteFile( file, 0, NULL, NULL, &io, testdata, sizeof(testdata) - 1, NULL, NULL );
+    ok( status == STATUS_ACCESS_DENIED, "expected STATUS_ACCESS_DENIED, got %x\n", status );
+    CloseHandle( file );
+
+    start = GetTickCount();
+    for (i = 0; i < 5000; i++)
+    {
+        status = pNtOpenFile( &file, GENERIC_READ | SYNCHRONIZE, &attr, &io,
+                              FILE_SHARE_READ, FILE_SYNCHRONOUS_IO_NONALERT );
+        if (status) break;
+        status = pNtReadFile( file, 0, NULL, NULL, &io, data, 1, NULL, NULL );
+        CloseHandle( file );
+        if (status) break;
+    }
+    ok( !status, "open/read/close loop failed at %d: %x\n", i, status );
+    if (winetest_interactive)
+        trace( "%d open/read/close cycles in %u ms\n", i, GetTickCount() - start );
+
+    pRtlFreeUnicodeString( &nameW );
+    DeleteFileW( tmpfile );
+}
+
 static void delete_file_test(void)
 {
     NTSTATUS ret;
@@ -2997,6 +3071,89 @@ static void test_iocompletion(void)
     }
 }
 
+static void test_wait_completion_packet(void)
+{
+    HANDLE port, packet, event;
+    BOOLEAN signaled;
+    NTSTATUS res;
+    ULONG count;
+
+    if (!pNtCreateWaitCompletionPacket)
+    {
+        win_skip( "NtCreateWaitCompletionPacket not supported\n" );
+        return;
+    }
+
+    res = pNtCreateIoCompletion( &port, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+    ok( res == STATUS_SUCCESS, "NtCreateIoCompletion failed: %x\n", res );
+    res = pNtCreateWaitCompletionPacket( &packet, GENERIC_ALL, NULL );
+    ok( res == STATUS_SUCCESS, "NtCreateWaitCompletionPacket failed: %x\n", res );
+    event = CreateEventA( NULL, FALSE, FALSE, NULL );
+
+    /* the packet is queued once the object is signaled */
+    signaled = 0xcc;
+    res = pNtAssociateWaitCompletionPacket( packet, port, event, (void *)CKEY_FIRST, (void *)CVALUE_FIRST,
+                                            STATUS_INVALID_DEVICE_REQUEST, 0xdead, &signaled );
+    ok( res == STATUS_SUCCESS, "NtAssociateWaitCompletionPacket failed: %x\n", res );
+    ok( !signaled, "got signaled %u\n", signaled );
+    count = get_pending_msgs( port );
+    ok( !count, "Unexpected msg count: %d\n", count );
+
+    res = pNtAssociateWaitCompletionPacket( packet, port, event, NULL, NULL, 0, 0, NULL );
+    ok( res == STATUS_INVALID_PARAMETER_1, "NtAssociateWaitCompletionPacket returned %x\n", res );
+
+    SetEvent( event );
+    count = get_pending_msgs( port );
+    ok( count == 1, "Unexpected msg count: %d\n", count );
+    ok( WaitForSingleObject( event, 0 ) == WAIT_TIMEOUT, "event not reset\n" );
+    if (get_msg( port ))
+    {
+        ok( completionKey == CKEY_FIRST, "Invalid completion key: %lx\n", completionKey );
+        ok( completionValue == CVALUE_FIRST, "Invalid completion value: %lx\n", completionValue );
+        ok( U(ioSb).Status == STATUS_INVALID_DEVICE_REQUEST, "Invalid status: %x\n", U(ioSb).Status );
+        ok( ioSb.Information == 0xdead, "Invalid ioSb.Information: %lu\n", ioSb.Information );
+    }
+    res = pNtCancelWaitCompletionPacket( packet, TRUE );
+    ok( res == STATUS_CANCELLED, "NtCancelWaitCompletionPacket returned %x\n", res );
+
+    /* already signaled objects queue the packet immediately */
+    SetEvent( event );
+    signaled = 0xcc;
+    res = pNtAssociateWaitCompletionPacket( packet, port, event, NULL, NULL, 0, 0, &signaled );
+    ok( res == STATUS_SUCCESS, "NtAssociateWaitCompletionPacket failed: %x\n", res );
+    ok( signaled == TRUE, "got signaled %u\n", signaled );
+    count = get_pending_msgs( port );
+    ok( count == 1, "Unexpected msg count: %d\n", count );
+
+    res = pNtCancelWaitCompletionPacket( packet, FALSE );
+    ok( res == STATUS_PENDING, "NtCancelWaitCompletionPacket returned %x\n", res );
+    res = pNtCancelWaitCompletionPacket( packet, TRUE );
+    ok( res == STATUS_SUCCESS, "NtCancelWaitCompletionPacket returned %x\n", res );
+    count = get_pending_msgs( port );
+    ok( !count, "Unexpected msg count: %d\n", count );
+
+    /* cancelled waits don't queue anything */
+    res = pNtAssociateWaitCompletionPacket( packet, port, event, NULL, NULL, 0, 0, NULL );
+    ok( res == STATUS_SUCCESS, "NtAssociateWaitCompletionPacket failed: %x\n", res );
+    res = pNtCancelWaitCompletionPacket( packet, FALSE );
+    ok( res == STATUS_SUCCESS, "NtCancelWaitCompletionPacket returned %x\n", res );
+    SetEvent( event );
+    count = get_pending_msgs( port );
+    ok( !count, "Unexpected msg count: %d\n", count );
+    ok( WaitForSingleObject( event, 0 ) == WAIT_OBJECT_0, "event was reset\n" );
+
+    /* closing the packet cancels the wait */
+    res = pNtAssociateWaitCompletionPacket( packet, port, event, NULL, NULL, 0, 0, NULL );
+    ok( res == STATUS_SUCCESS, "NtAssociateWaitCompletionPacket failed: %x\n", res );
+    pNtClose( packet );
+    SetEvent( event );
+    count = get_pending_msgs( port );
+    ok( !count, "Unexpected msg count: %d\n", count );
+
+    CloseHandle( event );
+    pNtClose( port );
+}
+
 static void test_file_name_information(void)
 {
     WCHAR *file_name, *volume_prefix, *expected;
@@ -4190,6 +4347,9 @@ START_TEST(file)
     pNtQueryIoCompletion    = (void *)GetProcAddress(hntdll, "NtQueryIoCompletion");
     pNtRemoveIoCompletion   = (void *)GetProcAddress(hntdll, "NtRemoveIoCompletion");
     pNtSetIoCompletion      = (void *)GetProcAddress(hntdll, "NtSetIoCompletion");
+    pNtCreateWaitCompletionPacket = (void *)GetProcAddress(hntdll, "NtCreateWaitCompletionPacket");
+    pNtAssociateWaitCompletionPacket = (void *)GetProcAddress(hntdll, "NtAssociateWaitCompletionPacket");
+    pNtCancelWaitCompletionPacket = (void *)GetProcAddress(hntdll, "NtCancelWaitCompletionPacket");
     pNtSetInformationFile   = (void *)GetProcAddress(hntdll, "NtSetInformationFile");
     pNtQueryInformationFile = (void *)GetProcAddress(hntdll, "NtQueryInformationFile");
     pNtQueryDirectoryFile   = (void *)GetProcAddress(hntdll, "NtQueryDirectoryFile");
@@ -4200,11 +4360,13 @@ START_TEST(file)
     test_NtCreateFile();
     create_file_test();
     open_file_test();
+    test_open_existing_file();
     delete_file_test();
     read_file_test();
     append_file_test();
     nt_mailslot_test();
     test_iocompletion();
+    test_wait_completion_packet();
     test_file_basic_information();
     test_file_all_information();
     test_file_both_information();
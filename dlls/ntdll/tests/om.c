@@ -1979,6 +1979,57 @@ static void test_mutant(void)
     NtClose( mutant );
 }
 
+static void test_many_names(void)
+{
+    /* enough names to force the server to grow and shrink the namespace table */
+    static const unsigned int count = 2000;
+    HANDLE *events, h;
+    char name[32];
+    unsigned int i;
+    DWORD ret;
+
+    events = HeapAlloc( GetProcessHeap(), 0, count * sizeof(*events) );
+    for (i = 0; i < count; i++)
+    {
+        sprintf( name, "wine_test_om_%u", i );
+        events[i] = CreateEventA( NULL, TRUE, !(i % 3), name );
+        ok( events[i] != NULL, "%u: CreateEvent failed %u\n", i, GetLastError() );
+        ok( GetLastError() != ERROR_ALREADY_EXISTS, "%u: event already exists\n", i );
+    }
+
+    /* similar names and anagrams must not be confused */
+    for (i = 0; i < count; i++)
+    {
+        sprintf( name, "wine_test_om_%u", i );
+        h = OpenEventA( SYNCHRONIZE, FALSE, name );
+        ok( h != NULL, "%u: OpenEvent failed %u\n", i, GetLastError() );
+        ret = WaitForSingleObject( h, 0 );
+        ok( ret == (i % 3 ? WAIT_TIMEOUT : WAIT_OBJECT_0), "%u: wait returned %u\n", i, ret );
+        CloseHandle( h );
+    }
+
+    for (i = 1; i < count; i += 2) CloseHandle( events[i] );
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf( name, "wine_test_om_%u", i );
+        h = OpenEventA( SYNCHRONIZE, FALSE, name );
+        if (i % 2)
+        {
+            ok( !h, "%u: OpenEvent succeeded on a closed event\n", i );
+            ok( GetLastError() == ERROR_FILE_NOT_FOUND, "%u: wrong error %u\n", i, GetLastError() );
+            if (h) CloseHandle( h );
+            continue;
+        }
+        ok( h != NULL, "%u: OpenEvent failed %u\n", i, GetLastError() );
+        ret = WaitForSingleObject( h, 0 );
+        ok( ret == (i % 3 ? WAIT_TIMEOUT : WAIT_OBJECT_0), "%u: wait returned %u\n", i, ret );
+        CloseHandle( h );
+        CloseHandle( events[i] );
+    }
+    HeapFree( GetProcessHeap(), 0, events );
+}
+
 START_TEST(om)
 {
     HMODULE hntdll = GetModuleHandleA("ntdll.dll");
@@ -2044,4 +2095,5 @@ START_TEST(om)
     test_mutant();
     test_keyed_events();
     test_null_device();
+    test_many_names();
 }
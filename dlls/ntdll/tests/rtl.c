@@ -2094,6 +2094,97 @@ static void test_RtlInitializeCriticalSectionEx(void)
     RtlDeleteCriticalSection(&cs);
 }
 
+static CRITICAL_SECTION dynamic_spin_cs;
+static LONG dynamic_spin_value;
+static LONG dynamic_spin_iterations;
+
+static DWORD WINAPI dynamic_spin_thread(void *arg)
+{
+    int i;
+
+    for (i = 0; i < dynamic_spin_iterations; i++)
+    {
+        RtlEnterCriticalSection(&dynamic_spin_cs);
+        dynamic_spin_value++;
+        if (arg && !(i % 64)) Sleep(0);
+        RtlLeaveCriticalSection(&dynamic_spin_cs);
+    }
+    return 0;
+}
+
+/* run threads contending for dynamic_spin_cs, return the number of times they had to wait */
+static DWORD run_dynamic_spin_threads(int count, int iterations, void *arg)
+{
+    HANDLE threads[4];
+    DWORD ret;
+    int i;
+
+    dynamic_spin_value = 0;
+    dynamic_spin_iterations = iterations;
+    if (dynamic_spin_cs.DebugInfo) dynamic_spin_cs.DebugInfo->ContentionCount = 0;
+    for (i = 0; i < count; i++)
+        threads[i] = CreateThread(NULL, 0, dynamic_spin_thread, arg, 0, NULL);
+    ret = WaitForMultipleObjects(count, threads, TRUE, 60000);
+    ok(!ret, "threads didn't finish, ret %u\n", ret);
+    for (i = 0; i < count; i++) CloseHandle(threads[i]);
+    ok(dynamic_spin_value == count * iterations, "got %d\n", dynamic_spin_value);
+    return dynamic_spin_cs.DebugInfo ? dynamic_spin_cs.DebugInfo->ContentionCount : 0;
+}
+
+static void test_dynamic_spin(void)
+{
+    static const CRITICAL_SECTION_DEBUG *no_debug = (void *)~(ULONG_PTR)0;
+    DWORD plain_waits, dynamic_waits;
+    SYSTEM_INFO info;
+    NTSTATUS status;
+
+    if (!pRtlInitializeCriticalSectionEx)
+    {
+        win_skip("RtlInitializeCriticalSectionEx is not available\n");
+        return;
+    }
+
+    status = pRtlInitializeCriticalSectionEx(&dynamic_spin_cs, 1000, RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN);
+    ok(!status, "RtlInitializeCriticalSectionEx failed: %x\n", status);
+    run_dynamic_spin_threads(4, 100000, (void *)1);
+    ok(RtlTryEnterCriticalSection(&dynamic_spin_cs), "couldn't enter critical section\n");
+    RtlLeaveCriticalSection(&dynamic_spin_cs);
+    RtlDeleteCriticalSection(&dynamic_spin_cs);
+
+    GetSystemInfo(&info);
+    if (info.dwNumberOfProcessors < 2)
+    {
+        skip("spinning needs more than one processor\n");
+        return;
+    }
+
+    /* a section without spin count blocks on each contended acquisition */
+    pRtlInitializeCriticalSectionEx(&dynamic_spin_cs, 0, 0);
+    if (!dynamic_spin_cs.DebugInfo || dynamic_spin_cs.DebugInfo == no_debug)
+    {
+        win_skip("no debug info\n");
+        RtlDeleteCriticalSection(&dynamic_spin_cs);
+        return;
+    }
+    plain_waits = run_dynamic_spin_threads(2, 200000, NULL);
+    RtlDeleteCriticalSection(&dynamic_spin_cs);
+
+    /* a dynamic section starting with the same spin count learns to spin for short hold times */
+    pRtlInitializeCriticalSectionEx(&dynamic_spin_cs, 0, RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN);
+    dynamic_waits = run_dynamic_spin_threads(2, 200000, NULL);
+    ok(!dynamic_spin_cs.SpinCount, "got spin count %lu\n", dynamic_spin_cs.SpinCount);
+    RtlDeleteCriticalSection(&dynamic_spin_cs);
+
+    trace("waits without spinning %u, with dynamic spinning %u\n", plain_waits, dynamic_waits);
+    if (!plain_waits)
+    {
+        skip("no contention\n");
+        return;
+    }
+    ok(dynamic_waits < plain_waits / 2, "dynamic spinning didn't reduce waits, %u vs %u\n",
+       dynamic_waits, plain_waits);
+}
+
 START_TEST(rtl)
 {
     InitFunctionPtrs();
@@ -2125,4 +2216,5 @@ START_TEST(rtl)
     test_RtlDecompressBuffer();
     test_RtlIsCriticalSectionLocked();
     test_RtlInitializeCriticalSectionEx();
+    test_dynamic_spin();
 }
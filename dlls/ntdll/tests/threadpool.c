@@ -22,18 +22,21 @@
 
 static HMODULE hntdll = 0;
 static NTSTATUS (WINAPI *pTpAllocCleanupGroup)(TP_CLEANUP_GROUP **);
+static NTSTATUS (WINAPI *pTpAllocIoCompletion)(TP_IO **,HANDLE,PTP_IO_CALLBACK,void *,TP_CALLBACK_ENVIRON *);
 static NTSTATUS (WINAPI *pTpAllocPool)(TP_POOL **,PVOID);
 static NTSTATUS (WINAPI *pTpAllocTimer)(TP_TIMER **,PTP_TIMER_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
 static NTSTATUS (WINAPI *pTpAllocWait)(TP_WAIT **,PTP_WAIT_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
 static NTSTATUS (WINAPI *pTpAllocWork)(TP_WORK **,PTP_WORK_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
 static NTSTATUS (WINAPI *pTpCallbackMayRunLong)(TP_CALLBACK_INSTANCE *);
 static VOID     (WINAPI *pTpCallbackReleaseSemaphoreOnCompletion)(TP_CALLBACK_INSTANCE *,HANDLE,DWORD);
+static VOID     (WINAPI *pTpCancelAsyncIoOperation)(TP_IO *);
 static VOID     (WINAPI *pTpDisassociateCallback)(TP_CALLBACK_INSTANCE *);
 static BOOL     (WINAPI *pTpIsTimerSet)(TP_TIMER *);
 static VOID     (WINAPI *pTpReleaseWait)(TP_WAIT *);
 static VOID     (WINAPI *pTpPostWork)(TP_WORK *);
 static VOID     (WINAPI *pTpReleaseCleanupGroup)(TP_CLEANUP_GROUP *);
 static VOID     (WINAPI *pTpReleaseCleanupGroupMembers)(TP_CLEANUP_GROUP *,BOOL,PVOID);
+static VOID     (WINAPI *pTpReleaseIoCompletion)(TP_IO *);
 static VOID     (WINAPI *pTpReleasePool)(TP_POOL *);
 static VOID     (WINAPI *pTpReleaseTimer)(TP_TIMER *);
 static VOID     (WINAPI *pTpReleaseWork)(TP_WORK *);
@@ -41,6 +44,8 @@ static VOID     (WINAPI *pTpSetPoolMaxThreads)(TP_POOL *,DWORD);
 static VOID     (WINAPI *pTpSetTimer)(TP_TIMER *,LARGE_INTEGER *,LONG,LONG);
 static VOID     (WINAPI *pTpSetWait)(TP_WAIT *,HANDLE,LARGE_INTEGER *);
 static NTSTATUS (WINAPI *pTpSimpleTryPost)(PTP_SIMPLE_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
+static VOID     (WINAPI *pTpStartAsyncIoOperation)(TP_IO *);
+static VOID     (WINAPI *pTpWaitForIoCompletion)(TP_IO *,BOOL);
 static VOID     (WINAPI *pTpWaitForTimer)(TP_TIMER *,BOOL);
 static VOID     (WINAPI *pTpWaitForWait)(TP_WAIT *,BOOL);
 static VOID     (WINAPI *pTpWaitForWork)(TP_WORK *,BOOL);
@@ -63,17 +68,20 @@ static BOOL init_threadpool(void)
     }
 
     NTDLL_GET_PROC(TpAllocCleanupGroup);
+    NTDLL_GET_PROC(TpAllocIoCompletion);
     NTDLL_GET_PROC(TpAllocPool);
     NTDLL_GET_PROC(TpAllocTimer);
     NTDLL_GET_PROC(TpAllocWait);
     NTDLL_GET_PROC(TpAllocWork);
     NTDLL_GET_PROC(TpCallbackMayRunLong);
     NTDLL_GET_PROC(TpCallbackReleaseSemaphoreOnCompletion);
+    NTDLL_GET_PROC(TpCancelAsyncIoOperation);
     NTDLL_GET_PROC(TpDisassociateCallback);
     NTDLL_GET_PROC(TpIsTimerSet);
     NTDLL_GET_PROC(TpPostWork);
     NTDLL_GET_PROC(TpReleaseCleanupGroup);
     NTDLL_GET_PROC(TpReleaseCleanupGroupMembers);
+    NTDLL_GET_PROC(TpReleaseIoCompletion);
     NTDLL_GET_PROC(TpReleasePool);
     NTDLL_GET_PROC(TpReleaseTimer);
     NTDLL_GET_PROC(TpReleaseWait);
@@ -82,6 +90,8 @@ static BOOL init_threadpool(void)
     NTDLL_GET_PROC(TpSetTimer);
     NTDLL_GET_PROC(TpSetWait);
     NTDLL_GET_PROC(TpSimpleTryPost);
+    NTDLL_GET_PROC(TpStartAsyncIoOperation);
+    NTDLL_GET_PROC(TpWaitForIoCompletion);
     NTDLL_GET_PROC(TpWaitForTimer);
     NTDLL_GET_PROC(TpWaitForWait);
     NTDLL_GET_PROC(TpWaitForWork);
@@ -706,6 +716,102 @@ static void test_tp_work_scheduler(void)
     pTpReleasePool(pool);
 }
 
+struct throughput_info
+{
+    TP_CALLBACK_ENVIRON environment;
+    LONG                callbacks;
+    LONG                remaining;
+    HANDLE              done_event;
+};
+
+static void CALLBACK throughput_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
+{
+    struct throughput_info *info = userdata;
+    if (!InterlockedDecrement(&info->remaining))
+        SetEvent(info->done_event);
+}
+
+static DWORD WINAPI throughput_post_thread(void *param)
+{
+    struct throughput_info *info = param;
+    NTSTATUS status;
+    LONG i;
+
+    for (i = 0; i < info->callbacks; i++)
+    {
+        status = pTpSimpleTryPost(throughput_cb, info, &info->environment);
+        ok(!status, "TpSimpleTryPost failed with status %x\n", status);
+    }
+    return 0;
+}
+
+/* posts callbacks from the given number of threads to a pool limited to the
+ * same number of worker threads, returns the number of callbacks per second */
+static double run_tp_throughput(unsigned int num_threads, LONG callbacks)
+{
+    struct throughput_info info;
+    LARGE_INTEGER freq, start, end;
+    HANDLE threads[16];
+    TP_POOL *pool;
+    NTSTATUS status;
+    unsigned int i;
+    DWORD result;
+
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+    pTpSetPoolMaxThreads(pool, num_threads);
+
+    memset(&info.environment, 0, sizeof(info.environment));
+    info.environment.Version = 1;
+    info.environment.Pool = pool;
+    info.callbacks = callbacks;
+    info.remaining = num_threads * callbacks;
+    info.done_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+    ok(info.done_event != NULL, "CreateEvent failed with %u\n", GetLastError());
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < num_threads; i++)
+    {
+        threads[i] = CreateThread(NULL, 0, throughput_post_thread, &info, 0, NULL);
+        ok(threads[i] != NULL, "CreateThread failed with %u\n", GetLastError());
+    }
+    result = WaitForSingleObject(info.done_event, 30000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    QueryPerformanceCounter(&end);
+
+    WaitForMultipleObjects(num_threads, threads, TRUE, INFINITE);
+    for (i = 0; i < num_threads; i++) CloseHandle(threads[i]);
+    ok(!info.remaining, "%d callbacks did not run\n", info.remaining);
+
+    CloseHandle(info.done_event);
+    pTpReleasePool(pool);
+    return num_threads * callbacks * (double)freq.QuadPart / (end.QuadPart - start.QuadPart);
+}
+
+static void test_tp_throughput(void)
+{
+    SYSTEM_INFO info;
+    unsigned int num_threads;
+    double rate;
+
+    /* callbacks posted concurrently from several threads all have to run */
+    run_tp_throughput(4, 1000);
+
+    if (!winetest_interactive)
+        return;
+
+    /* measure scaling of callbacks/s with the number of threads */
+    GetSystemInfo(&info);
+    for (num_threads = 1; num_threads <= min(info.dwNumberOfProcessors, 16); num_threads *= 2)
+    {
+        rate = run_tp_throughput(num_threads, 100000);
+        trace("%u threads: %.0f callbacks/s\n", num_threads, rate);
+    }
+}
+
 static DWORD group_cancel_tid;
 
 static void CALLBACK group_cancel_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
@@ -1316,7 +1422,7 @@ static void test_tp_wait(void)
     TP_CALLBACK_ENVIRON environment;
     TP_WAIT *wait1, *wait2;
     struct wait_info info;
-    HANDLE semaphores[2];
+    HANDLE semaphores[2], mutex;
     LARGE_INTEGER when;
     NTSTATUS status;
     TP_POOL *pool;
@@ -1539,6 +1645,23 @@ static void test_tp_wait(void)
     result = WaitForSingleObject(semaphores[1], 0);
     ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", result);
 
+    /* a mutex owned by the thread setting the wait isn't signaled for the pool */
+    mutex = CreateMutexW(NULL, TRUE, NULL);
+    ok(mutex != NULL, "failed to create mutex\n");
+    info.userdata = 0;
+    pTpSetWait(wait1, mutex, NULL);
+    result = WaitForSingleObject(semaphores[0], 100);
+    ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", result);
+    ok(info.userdata == 0, "expected info.userdata = 0, got %u\n", info.userdata);
+    ReleaseMutex(mutex);
+    result = WaitForSingleObject(semaphores[0], 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    ok(info.userdata == 1, "expected info.userdata = 1, got %u\n", info.userdata);
+    /* the pool acquired it */
+    result = WaitForSingleObject(mutex, 0);
+    ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", result);
+    CloseHandle(mutex);
+
     /* cleanup */
     pTpReleaseWait(wait1);
     pTpReleaseWait(wait2);
@@ -1666,6 +1789,127 @@ static void test_tp_multi_wait(void)
     CloseHandle(semaphore);
 }
 
+struct io_cb_info
+{
+    HANDLE semaphore;
+    OVERLAPPED *ovl;
+    NTSTATUS status;
+    ULONG_PTR information;
+    LONG count;
+};
+
+static void CALLBACK io_cb(TP_CALLBACK_INSTANCE *instance, void *userdata,
+                           void *cvalue, IO_STATUS_BLOCK *iosb, TP_IO *io)
+{
+    struct io_cb_info *info = userdata;
+    trace("Running io callback\n");
+    info->ovl = cvalue;
+    info->status = U(*iosb).Status;
+    info->information = iosb->Information;
+    InterlockedIncrement(&info->count);
+    ReleaseSemaphore(info->semaphore, 1, NULL);
+}
+
+static void test_tp_io(void)
+{
+    static const char pipe_name[] = "\\\\.\\pipe\\wine_tp_io_test";
+    TP_CALLBACK_ENVIRON environment;
+    struct io_cb_info info;
+    OVERLAPPED ovl, ovl2;
+    HANDLE server, client;
+    char in[16], out[16];
+    TP_POOL *pool;
+    TP_IO *io;
+    NTSTATUS status;
+    DWORD result, size;
+    BOOL ret;
+    int i;
+
+    if (!pTpAllocIoCompletion)
+    {
+        win_skip("TpAllocIoCompletion not supported\n");
+        return;
+    }
+
+    memset(&info, 0, sizeof(info));
+    info.semaphore = CreateSemaphoreA(NULL, 0, 10, NULL);
+    ok(info.semaphore != NULL, "CreateSemaphoreA failed %u\n", GetLastError());
+
+    server = CreateNamedPipeA(pipe_name, PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED,
+                              PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT, 1, 1024, 1024, 0, NULL);
+    ok(server != INVALID_HANDLE_VALUE, "CreateNamedPipeA failed %u\n", GetLastError());
+    client = CreateFileA(pipe_name, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    ok(client != INVALID_HANDLE_VALUE, "CreateFileA failed %u\n", GetLastError());
+
+    /* allocate new threadpool */
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+
+    io = NULL;
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+    status = pTpAllocIoCompletion(&io, server, io_cb, &info, &environment);
+    ok(!status, "TpAllocIoCompletion failed with status %x\n", status);
+    ok(io != NULL, "expected io != NULL\n");
+
+    /* completions are dispatched to the callback */
+    for (i = 0; i < 3; i++)
+    {
+        pTpStartAsyncIoOperation(io);
+        memset(&ovl, 0, sizeof(ovl));
+        ret = ReadFile(server, in, sizeof(in), NULL, &ovl);
+        ok(!ret && GetLastError() == ERROR_IO_PENDING, "ReadFile returned %d, error %u\n", ret, GetLastError());
+
+        memset(out, 'a' + i, sizeof(out));
+        ret = WriteFile(client, out, 5 + i, &size, NULL);
+        ok(ret, "WriteFile failed %u\n", GetLastError());
+
+        result = WaitForSingleObject(info.semaphore, 1000);
+        ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+        ok(info.ovl == &ovl, "expected %p, got %p\n", &ovl, info.ovl);
+        ok(info.status == STATUS_SUCCESS, "got status %x\n", info.status);
+        ok(info.information == 5 + i, "got information %lu\n", info.information);
+        ok(!memcmp(in, out, 5 + i), "wrong data\n");
+    }
+    ok(info.count == 3, "expected 3 callbacks, got %d\n", info.count);
+
+    /* canceled operations don't invoke the callback */
+    pTpStartAsyncIoOperation(io);
+    pTpCancelAsyncIoOperation(io);
+
+    /* several completions dequeued at once */
+    info.count = 0;
+    pTpStartAsyncIoOperation(io);
+    memset(&ovl, 0, sizeof(ovl));
+    ret = ReadFile(server, in, sizeof(in), NULL, &ovl);
+    ok(!ret && GetLastError() == ERROR_IO_PENDING, "ReadFile returned %d, error %u\n", ret, GetLastError());
+    pTpStartAsyncIoOperation(io);
+    memset(&ovl2, 0, sizeof(ovl2));
+    ret = ReadFile(server, in + 8, 8, NULL, &ovl2);
+    ok(!ret && GetLastError() == ERROR_IO_PENDING, "ReadFile returned %d, error %u\n", ret, GetLastError());
+    ret = WriteFile(client, out, 4, &size, NULL);
+    ok(ret, "WriteFile failed %u\n", GetLastError());
+    ret = WriteFile(client, out, 4, &size, NULL);
+    ok(ret, "WriteFile failed %u\n", GetLastError());
+    for (i = 0; i < 2; i++)
+    {
+        result = WaitForSingleObject(info.semaphore, 1000);
+        ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    }
+    pTpWaitForIoCompletion(io, FALSE);
+    ok(info.count == 2, "expected 2 callbacks, got %d\n", info.count);
+
+    /* cleanup */
+    pTpReleaseIoCompletion(io);
+    pTpReleasePool(pool);
+    CloseHandle(client);
+    CloseHandle(server);
+    CloseHandle(info.semaphore);
+}
+
 START_TEST(threadpool)
 {
     test_RtlQueueWorkItem();
@@ -1677,6 +1921,7 @@ START_TEST(threadpool)
     test_tp_simple();
     test_tp_work();
     test_tp_work_scheduler();
+    test_tp_throughput();
     test_tp_group_cancel();
     test_tp_instance();
     test_tp_disassociate();
@@ -1684,4 +1929,5 @@ START_TEST(threadpool)
     test_tp_window_length();
     test_tp_wait();
     test_tp_multi_wait();
+    test_tp_io();
 }
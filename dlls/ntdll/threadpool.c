@@ -115,6 +115,37 @@ struct timer_queue
 
 #define THREADPOOL_WORKER_TIMEOUT 5000
 #define MAXIMUM_WAITQUEUE_OBJECTS (MAXIMUM_WAIT_OBJECTS - 1)
+#define IOQUEUE_BATCH_SIZE 64
+/* completion keys of I/O objects hold a slot index and a generation number */
+#define IOQUEUE_KEY_INDEX_BITS (sizeof(ULONG_PTR) * 4)
+#define IOQUEUE_KEY_INDEX_MASK (((ULONG_PTR)1 << IOQUEUE_KEY_INDEX_BITS) - 1)
+#define THREADPOOL_MAX_QUEUES 64
+
+struct threadpool_object;
+
+/* slot of an I/O object in its pool, found from the completion key */
+struct io_slot
+{
+    struct threadpool_object *object;      /* NULL if the slot is free */
+    ULONG_PTR                 generation;  /* bumped each time the slot is used */
+};
+
+/* work queue, each worker thread prefers one queue and steals from the others */
+struct threadpool_queue
+{
+    CRITICAL_SECTION        cs;
+    /* objects with pending callbacks, locked via .cs */
+    struct list             items;
+    /* simple callbacks pushed without taking .cs, moved to .items by the workers */
+    struct threadpool_object * volatile inbox;
+};
+
+/* idle worker thread, parked in the pool */
+struct threadpool_worker
+{
+    struct list             entry;
+    LONG                    wakeup;
+};
 
 /* internal threadpool representation */
 struct threadpool
@@ -123,14 +154,25 @@ struct threadpool
     LONG                    objcount;
     BOOL                    shutdown;
     CRITICAL_SECTION        cs;
-    /* pool of work items, locked via .cs */
-    struct list             pool;
-    RTL_CONDITION_VARIABLE  update_event;
+    /* work queues, allocated with the pool */
+    struct threadpool_queue *queues;
+    unsigned int            num_queues;
+    LONG                    next_queue;
+    LONG                    num_queued;
     /* information about worker threads, locked via .cs */
     int                     max_workers;
     int                     min_workers;
     int                     num_workers;
-    int                     num_busy_workers;
+    LONG                    num_busy_workers;
+    struct list             idle_workers;
+    LONG                    num_idle_workers;
+    LONG                    next_worker;
+    /* completion port of the I/O objects, locked via .cs */
+    HANDLE                  io_port;
+    int                     num_io_objects;
+    BOOL                    io_thread_running;
+    struct io_slot          *io_slots;
+    unsigned int            io_slots_size;
 };
 
 enum threadpool_objtype
@@ -138,7 +180,14 @@ enum threadpool_objtype
     TP_OBJECT_TYPE_SIMPLE,
     TP_OBJECT_TYPE_WORK,
     TP_OBJECT_TYPE_TIMER,
-    TP_OBJECT_TYPE_WAIT
+    TP_OBJECT_TYPE_WAIT,
+    TP_OBJECT_TYPE_IO
+};
+
+struct io_completion
+{
+    IO_STATUS_BLOCK         iosb;
+    ULONG_PTR               cvalue;
 };
 
 /* internal threadpool object representation */
@@ -158,7 +207,9 @@ struct threadpool_object
     /* information about the group, locked via .group->cs */
     struct list             group_entry;
     BOOL                    is_group_member;
-    /* information about the pool, locked via .pool->cs */
+    /* information about the pool, locked via .queue->cs */
+    struct threadpool_queue *queue;
+    struct threadpool_object *inbox_next;
     struct list             pool_entry;
     RTL_CONDITION_VARIABLE  finished_event;
     RTL_CONDITION_VARIABLE  group_finished_event;
@@ -198,7 +249,23 @@ struct threadpool_object
             struct list     wait_entry;
             ULONGLONG       timeout;
             HANDLE          handle;
+            /* wait completion packet, only used in the port bucket */
+            HANDLE          packet;
+            BOOL            packet_pending;
+            ULONG_PTR       packet_seq;
         } wait;
+        struct
+        {
+            PTP_IO_CALLBACK callback;
+            void          (CALLBACK *destroy)(void *);  /* called with the userdata on destruction */
+            ULONG_PTR       key;  /* completion key, 0 until the file is associated */
+            /* information about the I/O object, locked via .queue->cs */
+            unsigned int    pending_count;
+            unsigned int    completion_head;
+            unsigned int    completion_count;
+            unsigned int    completion_max;
+            struct io_completion *completions;
+        } io;
     } u;
 };
 
@@ -265,12 +332,14 @@ static struct
     CRITICAL_SECTION        cs;
     LONG                    num_buckets;
     struct list             buckets;
+    struct waitqueue_bucket *port_bucket;
 }
 waitqueue =
 {
     { &waitqueue_debug, -1, 0, 0, 0, 0 },       /* cs */
     0,                                          /* num_buckets */
-    LIST_INIT( waitqueue.buckets )              /* buckets */
+    LIST_INIT( waitqueue.buckets ),             /* buckets */
+    NULL                                        /* port_bucket */
 };
 
 static RTL_CRITICAL_SECTION_DEBUG waitqueue_debug =
@@ -280,6 +349,11 @@ static RTL_CRITICAL_SECTION_DEBUG waitqueue_debug =
       0, 0, { (DWORD_PTR)(__FILE__ ": waitqueue.cs") }
 };
 
+/* A bucket either waits for up to MAXIMUM_WAITQUEUE_OBJECTS handles in
+ * its thread, or is the port bucket, where the server queues a wait
+ * completion packet to .port for each signaled object. The port bucket
+ * has no limit on the number of objects, and keeps .waiting sorted by
+ * timeout. */
 struct waitqueue_bucket
 {
     struct list             bucket_entry;
@@ -287,6 +361,7 @@ struct waitqueue_bucket
     struct list             reserved;
     struct list             waiting;
     HANDLE                  update_event;
+    HANDLE                  port;
 };
 
 static inline struct threadpool *impl_from_TP_POOL( TP_POOL *pool )
@@ -315,6 +390,13 @@ static inline struct threadpool_object *impl_from_TP_WAIT( TP_WAIT *wait )
     return object;
 }
 
+static inline struct threadpool_object *impl_from_TP_IO( TP_IO *io )
+{
+    struct threadpool_object *object = (struct threadpool_object *)io;
+    assert( object->type == TP_OBJECT_TYPE_IO );
+    return object;
+}
+
 static inline struct threadpool_group *impl_from_TP_CLEANUP_GROUP( TP_CLEANUP_GROUP *group )
 {
     return (struct threadpool_group *)group;
@@ -329,6 +411,7 @@ static void CALLBACK threadpool_worker_proc( void *param );
 static void tp_object_submit( struct threadpool_object *object, BOOL signaled );
 static void tp_object_shutdown( struct threadpool_object *object );
 static BOOL tp_object_release( struct threadpool_object *object );
+static BOOL tp_threadpool_release( struct threadpool *pool );
 static struct threadpool *default_threadpool = NULL;
 
 static inline LONG interlocked_inc( PLONG dest )
@@ -1504,23 +1587,246 @@ static void CALLBACK waitqueue_thread_proc( void *param )
 }
 
 /***********************************************************************
- *           tp_waitqueue_lock    (internal)
+ *           tp_waitqueue_cancel_packet    (internal)
+ *
+ * Cancels the wait completion packet of a wait object in the port bucket.
+ * Returns TRUE if the caller has to release the reference held for the
+ * packet, otherwise the packet was already dequeued and the port thread
+ * releases it. Caller must hold the waitqueue lock.
  */
-static NTSTATUS tp_waitqueue_lock( struct threadpool_object *wait )
+static BOOL tp_waitqueue_cancel_packet( struct threadpool_object *wait )
 {
-    struct waitqueue_bucket *bucket;
+    if (!wait->u.wait.packet_pending)
+        return FALSE;
+
+    wait->u.wait.packet_pending = FALSE;
+    return NtCancelWaitCompletionPacket( wait->u.wait.packet, TRUE ) == STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           tp_waitqueue_port_wait    (internal)
+ *
+ * Adds a wait object to the waiting list of the port bucket, and asks
+ * the server to queue its packet once the handle is signaled. Caller
+ * must hold the waitqueue lock.
+ */
+static NTSTATUS tp_waitqueue_port_wait( struct waitqueue_bucket *bucket, struct threadpool_object *wait )
+{
+    struct threadpool_object *other;
+    struct list *ptr;
     NTSTATUS status;
-    HANDLE thread;
-    assert( wait->type == TP_OBJECT_TYPE_WAIT );
 
-    wait->u.wait.signaled       = 0;
-    wait->u.wait.bucket         = NULL;
-    wait->u.wait.wait_pending   = FALSE;
-    wait->u.wait.timeout        = 0;
-    wait->u.wait.handle         = INVALID_HANDLE_VALUE;
+    /* Keep the list sorted by timeout, new waits usually go to the end. */
+    for (ptr = bucket->waiting.prev; ptr != &bucket->waiting; ptr = ptr->prev)
+    {
+        other = LIST_ENTRY( ptr, struct threadpool_object, u.wait.wait_entry );
+        if (other->u.wait.timeout <= wait->u.wait.timeout) break;
+    }
+    list_add_after( ptr, &wait->u.wait.wait_entry );
+
+    /* Wake up the port thread if the next timeout changed. */
+    if (list_head( &bucket->waiting ) == &wait->u.wait.wait_entry &&
+        wait->u.wait.timeout != TIMEOUT_INFINITE)
+        NtSetIoCompletion( bucket->port, 0, 0, STATUS_SUCCESS, 0 );
+
+    /* The packet keeps a reference until it is dequeued or cancelled, the
+     * sequence number identifies packets of a previous wait. */
+    interlocked_inc( &wait->refcount );
+    wait->u.wait.packet_seq++;
+    status = NtAssociateWaitCompletionPacket( wait->u.wait.packet, bucket->port, wait->u.wait.handle,
+                                              wait, NULL, STATUS_SUCCESS, wait->u.wait.packet_seq, NULL );
+    if (status)
+    {
+        /* mutexes are rejected, the caller moves them to a handle bucket */
+        if (status != STATUS_OBJECT_TYPE_MISMATCH)
+            ERR( "failed to wait for handle %p, status %x\n", wait->u.wait.handle, status );
+        interlocked_dec( &wait->refcount );
+        return status;
+    }
+    wait->u.wait.packet_pending = TRUE;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           waitqueue_port_thread_proc    (internal)
+ *
+ * Handles the wait objects of the port bucket. A single thread handles
+ * any number of objects, since the server does the actual waiting.
+ */
+static void CALLBACK waitqueue_port_thread_proc( void *param )
+{
+    FILE_IO_COMPLETION_INFORMATION info[IOQUEUE_BATCH_SIZE];
+    struct threadpool_object *release[IOQUEUE_BATCH_SIZE];
+    struct waitqueue_bucket *bucket = param;
+    struct threadpool_object *wait;
+    LARGE_INTEGER now, timeout;
+    ULONG i, count, num_release;
+    struct list *ptr;
+    NTSTATUS status;
+
+    TRACE( "starting wait queue port thread\n" );
 
     RtlEnterCriticalSection( &waitqueue.cs );
 
+    for (;;)
+    {
+        NtQuerySystemTime( &now );
+        timeout.QuadPart = TIMEOUT_INFINITE;
+
+        /* Submit wait objects that timed out, the list is sorted by timeout. */
+        while ((ptr = list_head( &bucket->waiting )))
+        {
+            wait = LIST_ENTRY( ptr, struct threadpool_object, u.wait.wait_entry );
+            assert( wait->type == TP_OBJECT_TYPE_WAIT );
+            if (wait->u.wait.timeout > now.QuadPart)
+            {
+                timeout.QuadPart = wait->u.wait.timeout;
+                break;
+            }
+
+            /* The owner still holds a reference, this is never the last one. */
+            if (tp_waitqueue_cancel_packet( wait ))
+                interlocked_dec( &wait->refcount );
+            list_remove( &wait->u.wait.wait_entry );
+            list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
+            wait->u.wait.wait_pending = FALSE;
+            tp_object_submit( wait, FALSE );
+        }
+
+        /* Terminate if no new wait objects are created within some amount of time. */
+        if (!bucket->objcount)
+            timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
+
+        RtlLeaveCriticalSection( &waitqueue.cs );
+        status = NtRemoveIoCompletionEx( bucket->port, info, IOQUEUE_BATCH_SIZE, &count, &timeout, FALSE );
+        RtlEnterCriticalSection( &waitqueue.cs );
+
+        if (status == STATUS_TIMEOUT && !bucket->objcount)
+            break;
+        if (status != STATUS_SUCCESS)
+            continue;
+
+        num_release = 0;
+        for (i = 0; i < count; i++)
+        {
+            /* Packets without key only wake up the thread. */
+            if (!(wait = (struct threadpool_object *)info[i].CompletionKey))
+                continue;
+
+            assert( wait->type == TP_OBJECT_TYPE_WAIT );
+            release[num_release++] = wait;
+
+            /* Ignore packets of cancelled or replaced waits. */
+            if (!wait->u.wait.packet_pending ||
+                info[i].IoStatusBlock.Information != wait->u.wait.packet_seq)
+                continue;
+
+            /* Wait object signaled. */
+            assert( wait->u.wait.bucket == bucket );
+            wait->u.wait.packet_pending = FALSE;
+            list_remove( &wait->u.wait.wait_entry );
+            list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
+            wait->u.wait.wait_pending = FALSE;
+            tp_object_submit( wait, TRUE );
+        }
+
+        /* Release the references held for the packets. */
+        if (num_release)
+        {
+            RtlLeaveCriticalSection( &waitqueue.cs );
+            for (i = 0; i < num_release; i++)
+                tp_object_release( release[i] );
+            RtlEnterCriticalSection( &waitqueue.cs );
+        }
+    }
+
+    waitqueue.port_bucket = NULL;
+
+    RtlLeaveCriticalSection( &waitqueue.cs );
+
+    TRACE( "terminating wait queue port thread\n" );
+
+    assert( list_empty( &bucket->reserved ) );
+    assert( list_empty( &bucket->waiting ) );
+    NtClose( bucket->port );
+
+    RtlFreeHeap( GetProcessHeap(), 0, bucket );
+    RtlExitUserThread( 0 );
+}
+
+/***********************************************************************
+ *           tp_waitqueue_port_lock    (internal)
+ *
+ * Assigns a wait object to the port bucket, which is created on first
+ * use. Caller must hold the waitqueue lock.
+ */
+static NTSTATUS tp_waitqueue_port_lock( struct threadpool_object *wait )
+{
+    struct waitqueue_bucket *bucket = waitqueue.port_bucket;
+    NTSTATUS status;
+    HANDLE thread;
+
+    status = NtCreateWaitCompletionPacket( &wait->u.wait.packet, WAIT_COMPLETION_PACKET_ALL_ACCESS, NULL );
+    if (status)
+        return status;
+
+    if (!bucket)
+    {
+        bucket = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*bucket) );
+        if (!bucket)
+        {
+            status = STATUS_NO_MEMORY;
+            goto error;
+        }
+
+        bucket->objcount = 0;
+        list_init( &bucket->reserved );
+        list_init( &bucket->waiting );
+        bucket->update_event = NULL;
+
+        status = NtCreateIoCompletion( &bucket->port, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+        if (status)
+        {
+            RtlFreeHeap( GetProcessHeap(), 0, bucket );
+            goto error;
+        }
+
+        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                      waitqueue_port_thread_proc, bucket, &thread, NULL );
+        if (status)
+        {
+            NtClose( bucket->port );
+            RtlFreeHeap( GetProcessHeap(), 0, bucket );
+            goto error;
+        }
+
+        NtClose( thread );
+        waitqueue.port_bucket = bucket;
+    }
+
+    list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
+    wait->u.wait.bucket = bucket;
+    bucket->objcount++;
+    return STATUS_SUCCESS;
+
+error:
+    NtClose( wait->u.wait.packet );
+    wait->u.wait.packet = NULL;
+    return status;
+}
+
+/***********************************************************************
+ *           tp_waitqueue_handle_lock    (internal)
+ *
+ * Assigns a wait object to a bucket whose thread waits for the handles
+ * itself. Caller must hold the waitqueue lock.
+ */
+static NTSTATUS tp_waitqueue_handle_lock( struct threadpool_object *wait )
+{
+    struct waitqueue_bucket *bucket;
+    NTSTATUS status;
+    HANDLE thread;
+
     /* Try to assign to existing bucket if possible. */
     LIST_FOR_EACH_ENTRY( bucket, &waitqueue.buckets, struct waitqueue_bucket, bucket_entry )
     {
@@ -1530,29 +1836,26 @@ static NTSTATUS tp_waitqueue_lock( struct threadpool_object *wait )
             wait->u.wait.bucket = bucket;
             bucket->objcount++;
 
-            status = STATUS_SUCCESS;
-            goto out;
+            return STATUS_SUCCESS;
         }
     }
 
     /* Create a new bucket and corresponding worker thread. */
     bucket = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*bucket) );
     if (!bucket)
-    {
-        status = STATUS_NO_MEMORY;
-        goto out;
-    }
+        return STATUS_NO_MEMORY;
 
     bucket->objcount = 0;
     list_init( &bucket->reserved );
     list_init( &bucket->waiting );
+    bucket->port = NULL;
 
     status = NtCreateEvent( &bucket->update_event, EVENT_ALL_ACCESS,
                             NULL, SynchronizationEvent, FALSE );
     if (status)
     {
         RtlFreeHeap( GetProcessHeap(), 0, bucket );
-        goto out;
+        return status;
     }
 
     status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
@@ -1573,8 +1876,61 @@ static NTSTATUS tp_waitqueue_lock( struct threadpool_object *wait )
         NtClose( bucket->update_event );
         RtlFreeHeap( GetProcessHeap(), 0, bucket );
     }
+    return status;
+}
+
+/***********************************************************************
+ *           tp_waitqueue_port_fallback    (internal)
+ *
+ * Moves a waiting object from the port bucket to a handle bucket, for
+ * handles that can't be waited for with a wait completion packet, such
+ * as mutexes, which have to be acquired by a waiting thread. Caller must
+ * hold the waitqueue lock.
+ */
+static void tp_waitqueue_port_fallback( struct threadpool_object *wait )
+{
+    struct waitqueue_bucket *port_bucket = wait->u.wait.bucket;
+    NTSTATUS status;
+
+    list_remove( &wait->u.wait.wait_entry );
+    if ((status = tp_waitqueue_handle_lock( wait )))
+    {
+        ERR( "failed to wait for handle %p, status %x\n", wait->u.wait.handle, status );
+        list_add_tail( &port_bucket->waiting, &wait->u.wait.wait_entry );
+        return;
+    }
+    port_bucket->objcount--;
+    NtClose( wait->u.wait.packet );
+    wait->u.wait.packet = NULL;
+
+    list_remove( &wait->u.wait.wait_entry );
+    list_add_tail( &wait->u.wait.bucket->waiting, &wait->u.wait.wait_entry );
+}
+
+/***********************************************************************
+ *           tp_waitqueue_lock    (internal)
+ */
+static NTSTATUS tp_waitqueue_lock( struct threadpool_object *wait )
+{
+    NTSTATUS status;
+    assert( wait->type == TP_OBJECT_TYPE_WAIT );
+
+    wait->u.wait.signaled       = 0;
+    wait->u.wait.bucket         = NULL;
+    wait->u.wait.wait_pending   = FALSE;
+    wait->u.wait.timeout        = 0;
+    wait->u.wait.handle         = INVALID_HANDLE_VALUE;
+    wait->u.wait.packet         = NULL;
+    wait->u.wait.packet_pending = FALSE;
+    wait->u.wait.packet_seq     = 0;
+
+    RtlEnterCriticalSection( &waitqueue.cs );
+
+    /* Prefer the port bucket, fall back to handle buckets if wait
+     * completion packets are not available. */
+    if ((status = tp_waitqueue_port_lock( wait )))
+        status = tp_waitqueue_handle_lock( wait );
 
-out:
     RtlLeaveCriticalSection( &waitqueue.cs );
     return status;
 }
@@ -1584,6 +1940,8 @@ out:
  */
 static void tp_waitqueue_unlock( struct threadpool_object *wait )
 {
+    BOOL release = FALSE;
+
     assert( wait->type == TP_OBJECT_TYPE_WAIT );
 
     RtlEnterCriticalSection( &waitqueue.cs );
@@ -1596,85 +1954,602 @@ static void tp_waitqueue_unlock( struct threadpool_object *wait )
         wait->u.wait.bucket = NULL;
         bucket->objcount--;
 
-        NtSetEvent( bucket->update_event, NULL );
+        if (bucket->port)
+            release = tp_waitqueue_cancel_packet( wait );
+        else
+            NtSetEvent( bucket->update_event, NULL );
     }
     RtlLeaveCriticalSection( &waitqueue.cs );
-}
-
-/***********************************************************************
- *           tp_threadpool_alloc    (internal)
- *
- * Allocates a new threadpool object.
- */
-static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
-{
-    struct threadpool *pool;
-
-    pool = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*pool) );
-    if (!pool)
-        return STATUS_NO_MEMORY;
-
-    pool->refcount              = 1;
-    pool->objcount              = 0;
-    pool->shutdown              = FALSE;
-
-    RtlInitializeCriticalSection( &pool->cs );
-    pool->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": threadpool.cs");
-
-    list_init( &pool->pool );
-    RtlInitializeConditionVariable( &pool->update_event );
-
-    pool->max_workers           = 500;
-    pool->min_workers           = 0;
-    pool->num_workers           = 0;
-    pool->num_busy_workers      = 0;
 
-    TRACE( "allocated threadpool %p\n", pool );
+    if (wait->u.wait.packet)
+    {
+        NtClose( wait->u.wait.packet );
+        wait->u.wait.packet = NULL;
+    }
 
-    *out = pool;
-    return STATUS_SUCCESS;
+    /* The owner still holds a reference, this is never the last one. */
+    if (release)
+        interlocked_dec( &wait->refcount );
 }
 
 /***********************************************************************
- *           tp_threadpool_shutdown    (internal)
+ *           tp_ioqueue_grab_object    (internal)
  *
- * Prepares the shutdown of a threadpool object and notifies all worker
- * threads to terminate (after all remaining work items have been
- * processed).
+ * Finds the I/O object of a completion key, and takes a reference to it
+ * unless it is being destroyed. Caller must hold the pool lock.
  */
-static void tp_threadpool_shutdown( struct threadpool *pool )
+static struct threadpool_object *tp_ioqueue_grab_object( struct threadpool *pool, ULONG_PTR key )
 {
-    assert( pool != default_threadpool );
+    ULONG_PTR index = (key & IOQUEUE_KEY_INDEX_MASK) - 1;
+    struct threadpool_object *io;
+    LONG refcount;
 
-    pool->shutdown = TRUE;
-    RtlWakeAllConditionVariable( &pool->update_event );
+    if (index >= pool->io_slots_size) return NULL;
+    if (!(io = pool->io_slots[index].object) || io->u.io.key != key) return NULL;
+
+    do
+    {
+        if (!(refcount = io->refcount)) return NULL;
+    } while (interlocked_cmpxchg( &io->refcount, refcount + 1, refcount ) != refcount);
+    return io;
 }
 
 /***********************************************************************
- *           tp_threadpool_release    (internal)
+ *           ioqueue_thread_proc    (internal)
  *
- * Releases a reference to a threadpool object.
+ * Dequeues completion packets of the I/O objects of a pool in batches,
+ * and queues the callbacks to the worker threads.
  */
-static BOOL tp_threadpool_release( struct threadpool *pool )
+static void CALLBACK ioqueue_thread_proc( void *param )
 {
-    if (interlocked_dec( &pool->refcount ))
-        return FALSE;
+    FILE_IO_COMPLETION_INFORMATION info[IOQUEUE_BATCH_SIZE];
+    struct threadpool_object *objects[IOQUEUE_BATCH_SIZE];
+    struct threadpool_object *release[IOQUEUE_BATCH_SIZE];
+    struct threadpool *pool = param;
+    struct threadpool_object *io;
+    struct io_completion *completion;
+    LARGE_INTEGER timeout;
+    ULONG i, count, num_release;
+    NTSTATUS status;
 
-    TRACE( "destroying threadpool %p\n", pool );
+    TRACE( "starting I/O completion thread for pool %p\n", pool );
 
-    assert( pool->shutdown );
-    assert( !pool->objcount );
-    assert( list_empty( &pool->pool ) );
+    for (;;)
+    {
+        timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
+        status = NtRemoveIoCompletionEx( pool->io_port, info, IOQUEUE_BATCH_SIZE, &count, &timeout, FALSE );
+        if (status != STATUS_SUCCESS)
+        {
+            if (status != STATUS_TIMEOUT) ERR( "NtRemoveIoCompletionEx failed, status %x\n", status );
 
-    pool->cs.DebugInfo->Spare[0] = 0;
-    RtlDeleteCriticalSection( &pool->cs );
+            /* Terminate when there are no I/O objects left. New objects
+             * start a new thread once .io_thread_running is cleared. */
+            RtlEnterCriticalSection( &pool->cs );
+            if (!pool->num_io_objects)
+            {
+                pool->io_thread_running = FALSE;
+                RtlLeaveCriticalSection( &pool->cs );
+                break;
+            }
+            RtlLeaveCriticalSection( &pool->cs );
+            continue;
+        }
 
-    RtlFreeHeap( GetProcessHeap(), 0, pool );
-    return TRUE;
-}
+        /* The keys are looked up under the pool lock, which keeps the objects
+         * alive until a reference is taken. Packets for destroyed objects can
+         * still arrive, their files stay associated with the port. */
+        RtlEnterCriticalSection( &pool->cs );
+        for (i = 0; i < count; i++)
+            objects[i] = tp_ioqueue_grab_object( pool, info[i].CompletionKey );
+        RtlLeaveCriticalSection( &pool->cs );
 
-/***********************************************************************
- *           tp_threadpool_lock    (internal)
+        num_release = 0;
+        for (i = 0; i < count; i++)
+        {
+            if (!(io = objects[i]))
+            {
+                WARN( "ignoring completion for stale key %lx\n", info[i].CompletionKey );
+                continue;
+            }
+            release[num_release++] = io;
+
+            RtlEnterCriticalSection( &io->queue->cs );
+
+            /* Completions without a matching TpStartAsyncIoOperation are ignored. */
+            if (!io->u.io.pending_count)
+            {
+                WARN( "ignoring unexpected completion for object %p\n", io );
+                RtlLeaveCriticalSection( &io->queue->cs );
+                continue;
+            }
+            /* The reference taken by TpStartAsyncIoOperation now keeps the
+             * object alive, so the lookup reference is never the last one. */
+            io->u.io.pending_count--;
+            interlocked_dec( &io->refcount );
+            if (io->shutdown)
+            {
+                RtlLeaveCriticalSection( &io->queue->cs );
+                continue;
+            }
+
+            if (io->u.io.completion_count == io->u.io.completion_max)
+            {
+                unsigned int new_max = max( io->u.io.completion_max * 2, 4 );
+                struct io_completion *new_completions;
+
+                if (io->u.io.completion_head)
+                {
+                    /* make room by moving the not yet processed completions to the front */
+                    io->u.io.completion_count -= io->u.io.completion_head;
+                    memmove( io->u.io.completions, io->u.io.completions + io->u.io.completion_head,
+                             io->u.io.completion_count * sizeof(*io->u.io.completions) );
+                    io->u.io.completion_head = 0;
+                }
+                else if (!(new_completions = io->u.io.completions ?
+                           RtlReAllocateHeap( GetProcessHeap(), 0, io->u.io.completions,
+                                              new_max * sizeof(*new_completions) ) :
+                           RtlAllocateHeap( GetProcessHeap(), 0, new_max * sizeof(*new_completions) )))
+                {
+                    ERR( "out of memory, dropping completion for object %p\n", io );
+                    RtlLeaveCriticalSection( &io->queue->cs );
+                    continue;
+                }
+                else
+                {
+                    io->u.io.completions    = new_completions;
+                    io->u.io.completion_max = new_max;
+                }
+            }
+
+            completion = &io->u.io.completions[io->u.io.completion_count++];
+            completion->iosb.u.Status   = info[i].IoStatusBlock.u.Status;
+            completion->iosb.Information = info[i].IoStatusBlock.Information;
+            completion->cvalue          = info[i].CompletionValue;
+            tp_object_submit( io, FALSE );
+            RtlLeaveCriticalSection( &io->queue->cs );
+        }
+
+        /* Release the references taken by TpStartAsyncIoOperation or the lookup. */
+        for (i = 0; i < num_release; i++)
+            tp_object_release( release[i] );
+    }
+
+    TRACE( "terminating I/O completion thread for pool %p\n", pool );
+    tp_threadpool_release( pool );
+    RtlExitUserThread( 0 );
+}
+
+/***********************************************************************
+ *           tp_ioqueue_lock    (internal)
+ *
+ * Associates a file with the completion port of the pool of an initialized
+ * I/O object, and makes sure that a thread is dequeuing completion packets.
+ * The completion key is a slot of the pool, so that packets arriving after
+ * the object is destroyed can be told apart.
+ */
+static NTSTATUS tp_ioqueue_lock( struct threadpool_object *io, HANDLE file )
+{
+    struct threadpool *pool = io->pool;
+    FILE_COMPLETION_INFORMATION info;
+    IO_STATUS_BLOCK iosb;
+    NTSTATUS status = STATUS_SUCCESS;
+    struct io_slot *slot = NULL;
+    unsigned int i;
+
+    assert( io->type == TP_OBJECT_TYPE_IO );
+
+    RtlEnterCriticalSection( &pool->cs );
+
+    if (!pool->io_port)
+        status = NtCreateIoCompletion( &pool->io_port, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+
+    if (!status)
+    {
+        for (i = 0; i < pool->io_slots_size; i++)
+            if (!pool->io_slots[i].object) break;
+
+        if (i < pool->io_slots_size)
+            slot = &pool->io_slots[i];
+        else if (pool->io_slots_size >= IOQUEUE_KEY_INDEX_MASK - 1)
+            status = STATUS_NO_MEMORY;
+        else
+        {
+            unsigned int new_size = min( max( pool->io_slots_size * 2, 16 ), IOQUEUE_KEY_INDEX_MASK - 1 );
+            struct io_slot *new_slots = pool->io_slots ?
+                RtlReAllocateHeap( GetProcessHeap(), 0, pool->io_slots, new_size * sizeof(*new_slots) ) :
+                RtlAllocateHeap( GetProcessHeap(), 0, new_size * sizeof(*new_slots) );
+
+            if (!new_slots) status = STATUS_NO_MEMORY;
+            else
+            {
+                memset( new_slots + pool->io_slots_size, 0,
+                        (new_size - pool->io_slots_size) * sizeof(*new_slots) );
+                pool->io_slots      = new_slots;
+                pool->io_slots_size = new_size;
+                slot = &pool->io_slots[i];
+            }
+        }
+    }
+
+    if (!status)
+    {
+        slot->generation++;
+        info.CompletionPort = pool->io_port;
+        info.CompletionKey  = (slot->generation << IOQUEUE_KEY_INDEX_BITS) | (i + 1);
+        status = NtSetInformationFile( file, &iosb, &info, sizeof(info), FileCompletionInformation );
+        if (!status)
+        {
+            io->u.io.key = info.CompletionKey;
+            slot->object = io;
+        }
+    }
+
+    if (!status && !pool->io_thread_running)
+    {
+        HANDLE thread;
+        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                      ioqueue_thread_proc, pool, &thread, NULL );
+        if (status == STATUS_SUCCESS)
+        {
+            interlocked_inc( &pool->refcount );
+            pool->io_thread_running = TRUE;
+            NtClose( thread );
+        }
+        else
+        {
+            slot->object = NULL;
+            io->u.io.key = 0;
+        }
+    }
+
+    if (!status) pool->num_io_objects++;
+
+    RtlLeaveCriticalSection( &pool->cs );
+    return status;
+}
+
+/***********************************************************************
+ *           tp_ioqueue_unlock    (internal)
+ *
+ * Releases the resources of an I/O object. The file stays associated
+ * with the completion port, further packets are ignored since the slot
+ * of the object is freed.
+ */
+static void tp_ioqueue_unlock( struct threadpool_object *io )
+{
+    struct threadpool *pool = io->pool;
+
+    assert( io->type == TP_OBJECT_TYPE_IO );
+
+    if (io->u.io.key)
+    {
+        RtlEnterCriticalSection( &pool->cs );
+        pool->io_slots[(io->u.io.key & IOQUEUE_KEY_INDEX_MASK) - 1].object = NULL;
+        pool->num_io_objects--;
+        RtlLeaveCriticalSection( &pool->cs );
+    }
+
+    RtlFreeHeap( GetProcessHeap(), 0, io->u.io.completions );
+    if (io->u.io.destroy) io->u.io.destroy( io->userdata );
+}
+
+/***********************************************************************
+ *           tp_new_worker_thread    (internal)
+ *
+ * Starts a new worker thread. Caller must hold the pool lock.
+ */
+static NTSTATUS tp_new_worker_thread( struct threadpool *pool )
+{
+    HANDLE thread;
+    NTSTATUS status;
+
+    status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                  threadpool_worker_proc, pool, &thread, NULL );
+    if (status == STATUS_SUCCESS)
+    {
+        interlocked_inc( &pool->refcount );
+        pool->num_workers++;
+        interlocked_inc( &pool->num_busy_workers );
+        NtClose( thread );
+    }
+    return status;
+}
+
+/***********************************************************************
+ *           tp_threadpool_wake_worker    (internal)
+ *
+ * Wakes up the most recently parked worker thread, if any. Only the
+ * selected thread is woken, the others stay asleep. Caller must hold
+ * the pool lock.
+ */
+static BOOL tp_threadpool_wake_worker( struct threadpool *pool )
+{
+    struct threadpool_worker *worker;
+    struct list *ptr;
+
+    if (!(ptr = list_head( &pool->idle_workers )))
+        return FALSE;
+
+    worker = LIST_ENTRY( ptr, struct threadpool_worker, entry );
+    list_remove( &worker->entry );
+    interlocked_dec( &pool->num_idle_workers );
+    worker->wakeup = 1;
+    RtlWakeAddressSingle( &worker->wakeup );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           tp_threadpool_signal    (internal)
+ *
+ * Makes sure that a worker thread will pick up newly queued work,
+ * either by waking a parked thread or by starting a new one.
+ */
+static void tp_threadpool_signal( struct threadpool *pool )
+{
+    /* Nothing to do if a worker is running and will look at the queues before
+     * parking, or if no additional thread may be started. This is the common
+     * case under load and doesn't need the pool lock. The interlocked update
+     * of .num_queued by the caller pairs with the one of .num_idle_workers
+     * in tp_threadpool_park. */
+    if (!pool->num_idle_workers && (pool->num_busy_workers < pool->num_workers ||
+                                    pool->num_workers >= pool->max_workers))
+        return;
+
+    RtlEnterCriticalSection( &pool->cs );
+    if (!tp_threadpool_wake_worker( pool ) &&
+        pool->num_busy_workers >= pool->num_workers && pool->num_workers < pool->max_workers)
+        tp_new_worker_thread( pool );
+    RtlLeaveCriticalSection( &pool->cs );
+}
+
+/***********************************************************************
+ *           tp_threadpool_park    (internal)
+ *
+ * Parks an idle worker thread until new work arrives. Returns FALSE
+ * when the thread should terminate.
+ */
+static BOOL tp_threadpool_park( struct threadpool *pool, struct threadpool_worker *worker )
+{
+    static const LONG zero;
+    LARGE_INTEGER timeout;
+
+    RtlEnterCriticalSection( &pool->cs );
+    if (pool->num_queued)
+    {
+        RtlLeaveCriticalSection( &pool->cs );
+        return TRUE;
+    }
+    if (pool->shutdown)
+        goto terminate;
+
+    worker->wakeup = 0;
+    list_add_head( &pool->idle_workers, &worker->entry );
+    interlocked_inc( &pool->num_idle_workers );
+
+    /* Work queued before we were visible as idle thread. */
+    if (pool->num_queued)
+    {
+        list_remove( &worker->entry );
+        interlocked_dec( &pool->num_idle_workers );
+        RtlLeaveCriticalSection( &pool->cs );
+        return TRUE;
+    }
+    RtlLeaveCriticalSection( &pool->cs );
+
+    /* Wait for new tasks or until the timeout expires. The deadline is absolute,
+     * so that spurious wakeups don't restart the idle timeout. */
+    NtQuerySystemTime( &timeout );
+    timeout.QuadPart += (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * 10000;
+    while (!worker->wakeup)
+    {
+        if (RtlWaitOnAddress( &worker->wakeup, &zero, sizeof(zero), &timeout ) == STATUS_TIMEOUT)
+            break;
+    }
+    if (worker->wakeup)
+        return TRUE;
+
+    /* A thread only terminates when no new tasks are available, and the number
+     * of threads can be decreased without violating the min_workers limit. An
+     * exception is when min_workers == 0, then objcount is used to detect if
+     * the last thread can be terminated. */
+    RtlEnterCriticalSection( &pool->cs );
+    if (worker->wakeup)
+    {
+        RtlLeaveCriticalSection( &pool->cs );
+        return TRUE;
+    }
+    list_remove( &worker->entry );
+    interlocked_dec( &pool->num_idle_workers );
+    if (!pool->num_queued && (pool->num_workers > max( pool->min_workers, 1 ) ||
+        (!pool->min_workers && !pool->objcount)))
+        goto terminate;
+    RtlLeaveCriticalSection( &pool->cs );
+    return TRUE;
+
+terminate:
+    pool->num_workers--;
+    RtlLeaveCriticalSection( &pool->cs );
+    return FALSE;
+}
+
+/***********************************************************************
+ *           tp_queue_flush_inbox    (internal)
+ *
+ * Moves the simple callbacks pushed without locking to the list of
+ * pending objects. Caller must hold the queue lock.
+ */
+static void tp_queue_flush_inbox( struct threadpool_queue *queue )
+{
+    struct threadpool_object *object, *next, *head = NULL;
+
+    if (!queue->inbox) return;
+
+    /* the inbox is a stack, reverse it to keep the submission order */
+    object = interlocked_xchg_ptr( (void **)&queue->inbox, NULL );
+    while (object)
+    {
+        next = object->inbox_next;
+        object->inbox_next = head;
+        head = object;
+        object = next;
+    }
+    for (object = head; object; object = object->inbox_next)
+        list_add_tail( &queue->items, &object->pool_entry );
+}
+
+/***********************************************************************
+ *           tp_threadpool_lock_queue    (internal)
+ *
+ * Returns a locked queue with pending work, starting with the preferred
+ * queue of the worker and stealing from the other ones. Contended
+ * queues are skipped during the first pass.
+ */
+static struct threadpool_queue *tp_threadpool_lock_queue( struct threadpool *pool, unsigned int home )
+{
+    struct threadpool_queue *queue;
+    unsigned int i, pass;
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        for (i = 0; i < pool->num_queues; i++)
+        {
+            queue = &pool->queues[(home + i) % pool->num_queues];
+            if (list_empty( &queue->items ) && !queue->inbox) continue;
+
+            if (!pass && i)
+            {
+                if (!RtlTryEnterCriticalSection( &queue->cs )) continue;
+            }
+            else RtlEnterCriticalSection( &queue->cs );
+
+            tp_queue_flush_inbox( queue );
+            if (!list_empty( &queue->items )) return queue;
+            RtlLeaveCriticalSection( &queue->cs );
+        }
+        if (!pool->num_queued) break;
+    }
+    return NULL;
+}
+
+/***********************************************************************
+ *           tp_threadpool_alloc    (internal)
+ *
+ * Allocates a new threadpool object.
+ */
+static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
+{
+    struct threadpool *pool;
+    unsigned int i;
+
+    pool = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*pool) );
+    if (!pool)
+        return STATUS_NO_MEMORY;
+
+    pool->num_queues = min( max( NtCurrentTeb()->Peb->NumberOfProcessors, 1 ), THREADPOOL_MAX_QUEUES );
+    pool->queues = RtlAllocateHeap( GetProcessHeap(), 0, pool->num_queues * sizeof(*pool->queues) );
+    if (!pool->queues)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, pool );
+        return STATUS_NO_MEMORY;
+    }
+
+    pool->refcount              = 1;
+    pool->objcount              = 0;
+    pool->shutdown              = FALSE;
+
+    RtlInitializeCriticalSection( &pool->cs );
+    pool->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": threadpool.cs");
+
+    for (i = 0; i < pool->num_queues; i++)
+    {
+        struct threadpool_queue *queue = &pool->queues[i];
+
+        RtlInitializeCriticalSectionAndSpinCount( &queue->cs, 1000 );
+        queue->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": threadpool_queue.cs");
+        list_init( &queue->items );
+        queue->inbox = NULL;
+    }
+    pool->next_queue            = 0;
+    pool->num_queued            = 0;
+
+    pool->max_workers           = 500;
+    pool->min_workers           = 0;
+    pool->num_workers           = 0;
+    pool->num_busy_workers      = 0;
+    list_init( &pool->idle_workers );
+    pool->num_idle_workers      = 0;
+    pool->next_worker           = 0;
+    pool->io_port               = 0;
+    pool->num_io_objects        = 0;
+    pool->io_thread_running     = FALSE;
+    pool->io_slots              = NULL;
+    pool->io_slots_size         = 0;
+
+    TRACE( "allocated threadpool %p\n", pool );
+
+    *out = pool;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           tp_threadpool_shutdown    (internal)
+ *
+ * Prepares the shutdown of a threadpool object and notifies all worker
+ * threads to terminate (after all remaining work items have been
+ * processed).
+ */
+static void tp_threadpool_shutdown( struct threadpool *pool )
+{
+    assert( pool != default_threadpool );
+
+    RtlEnterCriticalSection( &pool->cs );
+    pool->shutdown = TRUE;
+    while (tp_threadpool_wake_worker( pool )) /* nothing */;
+    RtlLeaveCriticalSection( &pool->cs );
+}
+
+/***********************************************************************
+ *           tp_threadpool_release    (internal)
+ *
+ * Releases a reference to a threadpool object.
+ */
+static BOOL tp_threadpool_release( struct threadpool *pool )
+{
+    unsigned int i;
+
+    if (interlocked_dec( &pool->refcount ))
+        return FALSE;
+
+    TRACE( "destroying threadpool %p\n", pool );
+
+    assert( pool->shutdown );
+    assert( !pool->objcount );
+    assert( !pool->num_queued );
+    assert( !pool->io_thread_running );
+
+    if (pool->io_port) NtClose( pool->io_port );
+    RtlFreeHeap( GetProcessHeap(), 0, pool->io_slots );
+
+    for (i = 0; i < pool->num_queues; i++)
+    {
+        struct threadpool_queue *queue = &pool->queues[i];
+
+        assert( list_empty( &queue->items ) );
+        assert( !queue->inbox );
+        queue->cs.DebugInfo->Spare[0] = 0;
+        RtlDeleteCriticalSection( &queue->cs );
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, pool->queues );
+
+    pool->cs.DebugInfo->Spare[0] = 0;
+    RtlDeleteCriticalSection( &pool->cs );
+
+    RtlFreeHeap( GetProcessHeap(), 0, pool );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           tp_threadpool_lock    (internal)
  *
  * Acquires a lock on a threadpool, specified with an TP_CALLBACK_ENVIRON
  * block. When the lock is acquired successfully, it is guaranteed that
@@ -1710,18 +2585,7 @@ static NTSTATUS tp_threadpool_lock( struct threadpool **out, TP_CALLBACK_ENVIRON
 
     /* Make sure that the threadpool has at least one thread. */
     if (!pool->num_workers)
-    {
-        HANDLE thread;
-        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
-                                      threadpool_worker_proc, pool, &thread, NULL );
-        if (status == STATUS_SUCCESS)
-        {
-            interlocked_inc( &pool->refcount );
-            pool->num_workers++;
-            pool->num_busy_workers++;
-            NtClose( thread );
-        }
-    }
+        status = tp_new_worker_thread( pool );
 
     /* Keep a reference, and increment objcount to ensure that the
      * last thread doesn't terminate. */
@@ -1836,6 +2700,8 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
     memset( &object->group_entry, 0, sizeof(object->group_entry) );
     object->is_group_member         = FALSE;
 
+    object->queue = &pool->queues[(ULONG)interlocked_inc( &pool->next_queue ) % pool->num_queues];
+    object->inbox_next              = NULL;
     memset( &object->pool_entry, 0, sizeof(object->pool_entry) );
     RtlInitializeConditionVariable( &object->finished_event );
     RtlInitializeConditionVariable( &object->group_finished_event );
@@ -1900,46 +2766,45 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
 static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
 {
     struct threadpool *pool = object->pool;
-    NTSTATUS status = STATUS_UNSUCCESSFUL;
+    struct threadpool_queue *queue = object->queue;
+    struct threadpool_object *head;
 
     assert( !object->shutdown );
     assert( !pool->shutdown );
 
-    RtlEnterCriticalSection( &pool->cs );
+    /* Increment refcount and count the work item before it becomes visible,
+     * so that workers never see .num_queued drop below the queued items. */
+    interlocked_inc( &object->refcount );
+    interlocked_inc( &pool->num_queued );
 
-    /* Start new worker threads if required. */
-    if (pool->num_busy_workers >= pool->num_workers &&
-        pool->num_workers < pool->max_workers)
+    if (object->type == TP_OBJECT_TYPE_SIMPLE)
     {
-        HANDLE thread;
-        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
-                                      threadpool_worker_proc, pool, &thread, NULL );
-        if (status == STATUS_SUCCESS)
+        /* Simple callbacks are submitted exactly once, push them to the inbox
+         * of the queue without locking. */
+        object->num_pending_callbacks = 1;
+        do
         {
-            interlocked_inc( &pool->refcount );
-            pool->num_workers++;
-            pool->num_busy_workers++;
-            NtClose( thread );
+            head = queue->inbox;
+            object->inbox_next = head;
         }
+        while (interlocked_cmpxchg_ptr( (void **)&queue->inbox, object, head ) != head);
     }
+    else
+    {
+        RtlEnterCriticalSection( &queue->cs );
 
-    /* Queue work item and increment refcount. */
-    interlocked_inc( &object->refcount );
-    if (!object->num_pending_callbacks++)
-        list_add_tail( &pool->pool, &object->pool_entry );
+        /* Queue work item. */
+        if (!object->num_pending_callbacks++)
+            list_add_tail( &queue->items, &object->pool_entry );
 
-    /* Count how often the object was signaled. */
-    if (object->type == TP_OBJECT_TYPE_WAIT && signaled)
-        object->u.wait.signaled++;
+        /* Count how often the object was signaled. */
+        if (object->type == TP_OBJECT_TYPE_WAIT && signaled)
+            object->u.wait.signaled++;
 
-    /* No new thread started - wake up one existing thread. */
-    if (status != STATUS_SUCCESS)
-    {
-        assert( pool->num_workers > 0 );
-        RtlWakeConditionVariable( &pool->update_event );
+        RtlLeaveCriticalSection( &queue->cs );
     }
 
-    RtlLeaveCriticalSection( &pool->cs );
+    tp_threadpool_signal( pool );
 }
 
 /***********************************************************************
@@ -1949,20 +2814,24 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
  */
 static void tp_object_cancel( struct threadpool_object *object, BOOL group_cancel, PVOID userdata )
 {
-    struct threadpool *pool = object->pool;
+    struct threadpool_queue *queue = object->queue;
     LONG pending_callbacks = 0;
 
-    RtlEnterCriticalSection( &pool->cs );
+    RtlEnterCriticalSection( &queue->cs );
+    tp_queue_flush_inbox( queue );
     if (object->num_pending_callbacks)
     {
         pending_callbacks = object->num_pending_callbacks;
         object->num_pending_callbacks = 0;
         list_remove( &object->pool_entry );
+        interlocked_xchg_add( &object->pool->num_queued, -pending_callbacks );
 
         if (object->type == TP_OBJECT_TYPE_WAIT)
             object->u.wait.signaled = 0;
+        if (object->type == TP_OBJECT_TYPE_IO)
+            object->u.io.completion_head = object->u.io.completion_count = 0;
     }
-    RtlLeaveCriticalSection( &pool->cs );
+    RtlLeaveCriticalSection( &queue->cs );
 
     /* Execute group cancellation callback if defined, and if this was actually a group cancel. */
     if (pending_callbacks && group_cancel && object->group_cancel_callback)
@@ -1984,20 +2853,20 @@ static void tp_object_cancel( struct threadpool_object *object, BOOL group_cance
  */
 static void tp_object_wait( struct threadpool_object *object, BOOL group_wait )
 {
-    struct threadpool *pool = object->pool;
+    struct threadpool_queue *queue = object->queue;
 
-    RtlEnterCriticalSection( &pool->cs );
+    RtlEnterCriticalSection( &queue->cs );
     if (group_wait)
     {
         while (object->num_pending_callbacks || object->num_running_callbacks)
-            RtlSleepConditionVariableCS( &object->group_finished_event, &pool->cs, NULL );
+            RtlSleepConditionVariableCS( &object->group_finished_event, &queue->cs, NULL );
     }
     else
     {
         while (object->num_pending_callbacks || object->num_associated_callbacks)
-            RtlSleepConditionVariableCS( &object->finished_event, &pool->cs, NULL );
+            RtlSleepConditionVariableCS( &object->finished_event, &queue->cs, NULL );
     }
-    RtlLeaveCriticalSection( &pool->cs );
+    RtlLeaveCriticalSection( &queue->cs );
 }
 
 /***********************************************************************
@@ -2049,6 +2918,9 @@ static BOOL tp_object_release( struct threadpool_object *object )
         tp_group_release( group );
     }
 
+    if (object->type == TP_OBJECT_TYPE_IO)
+        tp_ioqueue_unlock( object );
+
     tp_threadpool_unlock( object->pool );
 
     if (object->race_dll)
@@ -2066,27 +2938,32 @@ static void CALLBACK threadpool_worker_proc( void *param )
     TP_CALLBACK_INSTANCE *callback_instance;
     struct threadpool_instance instance;
     struct threadpool *pool = param;
+    struct threadpool_worker worker;
+    struct threadpool_queue *queue;
     TP_WAIT_RESULT wait_result = 0;
-    LARGE_INTEGER timeout;
-    struct list *ptr;
+    struct io_completion completion;
+    unsigned int home;
     NTSTATUS status;
 
     TRACE( "starting worker thread for pool %p\n", pool );
 
-    RtlEnterCriticalSection( &pool->cs );
-    pool->num_busy_workers--;
+    /* Spread the workers over the queues, each one prefers its own queue. */
+    home = (ULONG)interlocked_inc( &pool->next_worker ) % pool->num_queues;
+    interlocked_dec( &pool->num_busy_workers );
     for (;;)
     {
-        while ((ptr = list_head( &pool->pool )))
+        while ((queue = tp_threadpool_lock_queue( pool, home )))
         {
-            struct threadpool_object *object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
+            struct threadpool_object *object = LIST_ENTRY( list_head( &queue->items ),
+                                                           struct threadpool_object, pool_entry );
             assert( object->num_pending_callbacks > 0 );
 
             /* If further pending callbacks are queued, move the work item to
-             * the end of the pool list. Otherwise remove it from the pool. */
+             * the end of the queue. Otherwise remove it from the queue. */
             list_remove( &object->pool_entry );
             if (--object->num_pending_callbacks)
-                list_add_tail( &pool->pool, &object->pool_entry );
+                list_add_tail( &queue->items, &object->pool_entry );
+            interlocked_dec( &pool->num_queued );
 
             /* For wait objects check if they were signaled or have timed out. */
             if (object->type == TP_OBJECT_TYPE_WAIT)
@@ -2095,11 +2972,20 @@ static void CALLBACK threadpool_worker_proc( void *param )
                 if (wait_result == WAIT_OBJECT_0) object->u.wait.signaled--;
             }
 
+            /* For I/O objects fetch the next completion. */
+            if (object->type == TP_OBJECT_TYPE_IO)
+            {
+                assert( object->u.io.completion_head < object->u.io.completion_count );
+                completion = object->u.io.completions[object->u.io.completion_head++];
+                if (object->u.io.completion_head == object->u.io.completion_count)
+                    object->u.io.completion_head = object->u.io.completion_count = 0;
+            }
+
             /* Leave critical section and do the actual callback. */
             object->num_associated_callbacks++;
             object->num_running_callbacks++;
-            pool->num_busy_workers++;
-            RtlLeaveCriticalSection( &pool->cs );
+            interlocked_inc( &pool->num_busy_workers );
+            RtlLeaveCriticalSection( &queue->cs );
 
             /* Initialize threadpool instance struct. */
             callback_instance = (TP_CALLBACK_INSTANCE *)&instance;
@@ -2152,6 +3038,17 @@ static void CALLBACK threadpool_worker_proc( void *param )
                     break;
                 }
 
+                case TP_OBJECT_TYPE_IO:
+                {
+                    TRACE( "executing I/O callback %p(%p, %p, %#lx, %p, %p)\n",
+                           object->u.io.callback, callback_instance, object->userdata,
+                           completion.cvalue, &completion.iosb, object );
+                    object->u.io.callback( callback_instance, object->userdata,
+                                           (void *)completion.cvalue, &completion.iosb, (TP_IO *)object );
+                    TRACE( "callback %p returned\n", object->u.io.callback );
+                    break;
+                }
+
                 default:
                     assert(0);
                     break;
@@ -2192,8 +3089,8 @@ static void CALLBACK threadpool_worker_proc( void *param )
             }
 
         skip_cleanup:
-            RtlEnterCriticalSection( &pool->cs );
-            pool->num_busy_workers--;
+            interlocked_dec( &pool->num_busy_workers );
+            RtlEnterCriticalSection( &queue->cs );
 
             object->num_running_callbacks--;
             if (!object->num_pending_callbacks && !object->num_running_callbacks)
@@ -2206,28 +3103,14 @@ static void CALLBACK threadpool_worker_proc( void *param )
                     RtlWakeAllConditionVariable( &object->finished_event );
             }
 
+            RtlLeaveCriticalSection( &queue->cs );
             tp_object_release( object );
         }
 
-        /* Shutdown worker thread if requested. */
-        if (pool->shutdown)
+        /* Wait for new tasks, or terminate if requested or idle for too long. */
+        if (!tp_threadpool_park( pool, &worker ))
             break;
-
-        /* Wait for new tasks or until the timeout expires. A thread only terminates
-         * when no new tasks are available, and the number of threads can be
-         * decreased without violating the min_workers limit. An exception is when
-         * min_workers == 0, then objcount is used to detect if the last thread
-         * can be terminated. */
-        timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
-        if (RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout ) == STATUS_TIMEOUT &&
-            !list_head( &pool->pool ) && (pool->num_workers > max( pool->min_workers, 1 ) ||
-            (!pool->min_workers && !pool->objcount)))
-        {
-            break;
-        }
     }
-    pool->num_workers--;
-    RtlLeaveCriticalSection( &pool->cs );
 
     TRACE( "terminating worker thread for pool %p\n", pool );
     tp_threadpool_release( pool );
@@ -2244,6 +3127,82 @@ NTSTATUS WINAPI TpAllocCleanupGroup( TP_CLEANUP_GROUP **out )
     return tp_group_alloc( (struct threadpool_group **)out );
 }
 
+/***********************************************************************
+ *           tp_alloc_io    (internal)
+ */
+static NTSTATUS tp_alloc_io( TP_IO **out, HANDLE file, PTP_IO_CALLBACK callback, PVOID userdata,
+                             void (CALLBACK *destroy)(void *), TP_CALLBACK_ENVIRON *environment )
+{
+    struct threadpool_object *object;
+    struct threadpool *pool;
+    NTSTATUS status;
+
+    object = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*object) );
+    if (!object)
+        return STATUS_NO_MEMORY;
+
+    status = tp_threadpool_lock( &pool, environment );
+    if (status)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    object->type = TP_OBJECT_TYPE_IO;
+    object->u.io.callback           = callback;
+    object->u.io.destroy            = NULL;
+    object->u.io.key                = 0;
+    object->u.io.pending_count      = 0;
+    object->u.io.completion_head    = 0;
+    object->u.io.completion_count   = 0;
+    object->u.io.completion_max     = 0;
+    object->u.io.completions        = NULL;
+
+    tp_object_initialize( object, pool, userdata, environment );
+
+    /* The file is only associated with a fully initialized object. */
+    status = tp_ioqueue_lock( object, file );
+    if (status)
+    {
+        tp_object_shutdown( object );
+        tp_object_release( object );
+        return status;
+    }
+
+    /* From now on the object owns the userdata. */
+    object->u.io.destroy = destroy;
+
+    *out = (TP_IO *)object;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           TpAllocIoCompletion    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocIoCompletion( TP_IO **out, HANDLE file, PTP_IO_CALLBACK callback,
+                                     PVOID userdata, TP_CALLBACK_ENVIRON *environment )
+{
+    TRACE( "%p %p %p %p %p\n", out, file, callback, userdata, environment );
+
+    return tp_alloc_io( out, file, callback, userdata, NULL, environment );
+}
+
+/***********************************************************************
+ *           __wine_tp_alloc_io_completion    (NTDLL.@)
+ *
+ * Same as TpAllocIoCompletion, but the destroy function is called with the
+ * userdata once the object is destroyed, so that a context allocated by
+ * the caller can be freed after the last callback.
+ */
+NTSTATUS CDECL __wine_tp_alloc_io_completion( TP_IO **out, HANDLE file, PTP_IO_CALLBACK callback,
+                                              PVOID userdata, void (CALLBACK *destroy)(void *),
+                                              TP_CALLBACK_ENVIRON *environment )
+{
+    TRACE( "%p %p %p %p %p %p\n", out, file, callback, userdata, destroy, environment );
+
+    return tp_alloc_io( out, file, callback, userdata, destroy, environment );
+}
+
 /***********************************************************************
  *           TpAllocPool    (NTDLL.@)
  */
@@ -2409,18 +3368,7 @@ NTSTATUS WINAPI TpCallbackMayRunLong( TP_CALLBACK_INSTANCE *instance )
     if (pool->num_busy_workers >= pool->num_workers)
     {
         if (pool->num_workers < pool->max_workers)
-        {
-            HANDLE thread;
-            status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
-                                          threadpool_worker_proc, pool, &thread, NULL );
-            if (status == STATUS_SUCCESS)
-            {
-                interlocked_inc( &pool->refcount );
-                pool->num_workers++;
-                pool->num_busy_workers++;
-                NtClose( thread );
-            }
-        }
+            status = tp_new_worker_thread( pool );
         else
         {
             status = STATUS_TOO_MANY_THREADS;
@@ -2494,7 +3442,7 @@ VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
 {
     struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
     struct threadpool_object *object = this->object;
-    struct threadpool *pool;
+    struct threadpool_queue *queue;
 
     TRACE( "%p\n", instance );
 
@@ -2507,17 +3455,38 @@ VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
     if (!this->associated)
         return;
 
-    pool = object->pool;
-    RtlEnterCriticalSection( &pool->cs );
+    queue = object->queue;
+    RtlEnterCriticalSection( &queue->cs );
 
     object->num_associated_callbacks--;
     if (!object->num_pending_callbacks && !object->num_associated_callbacks)
         RtlWakeAllConditionVariable( &object->finished_event );
 
-    RtlLeaveCriticalSection( &pool->cs );
+    RtlLeaveCriticalSection( &queue->cs );
     this->associated = FALSE;
 }
 
+/***********************************************************************
+ *           TpCancelAsyncIoOperation    (NTDLL.@)
+ */
+VOID WINAPI TpCancelAsyncIoOperation( TP_IO *io )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+    BOOL release = FALSE;
+
+    TRACE( "%p\n", io );
+
+    RtlEnterCriticalSection( &this->queue->cs );
+    if (this->u.io.pending_count)
+    {
+        this->u.io.pending_count--;
+        release = TRUE;
+    }
+    RtlLeaveCriticalSection( &this->queue->cs );
+
+    if (release) tp_object_release( this );
+}
+
 /***********************************************************************
  *           TpIsTimerSet    (NTDLL.@)
  */
@@ -2616,6 +3585,19 @@ VOID WINAPI TpReleaseCleanupGroupMembers( TP_CLEANUP_GROUP *group, BOOL cancel_p
     }
 }
 
+/***********************************************************************
+ *           TpReleaseIoCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpReleaseIoCompletion( TP_IO *io )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+
+    TRACE( "%p\n", io );
+
+    tp_object_shutdown( this );
+    tp_object_release( this );
+}
+
 /***********************************************************************
  *           TpReleasePool    (NTDLL.@)
  */
@@ -2697,16 +3679,9 @@ BOOL WINAPI TpSetPoolMinThreads( TP_POOL *pool, DWORD minimum )
 
     while (this->num_workers < minimum)
     {
-        HANDLE thread;
-        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
-                                      threadpool_worker_proc, this, &thread, NULL );
+        status = tp_new_worker_thread( this );
         if (status != STATUS_SUCCESS)
             break;
-
-        interlocked_inc( &this->refcount );
-        this->num_workers++;
-        this->num_busy_workers++;
-        NtClose( thread );
     }
 
     if (status == STATUS_SUCCESS)
@@ -2805,6 +3780,7 @@ VOID WINAPI TpSetWait( TP_WAIT *wait, HANDLE handle, LARGE_INTEGER *timeout )
     struct threadpool_object *this = impl_from_TP_WAIT( wait );
     ULONGLONG timestamp = TIMEOUT_INFINITE;
     BOOL submit_wait = FALSE;
+    BOOL release = FALSE;
 
     TRACE( "%p %p %p\n", wait, handle, timeout );
 
@@ -2818,6 +3794,10 @@ VOID WINAPI TpSetWait( TP_WAIT *wait, HANDLE handle, LARGE_INTEGER *timeout )
         struct waitqueue_bucket *bucket = this->u.wait.bucket;
         list_remove( &this->u.wait.wait_entry );
 
+        /* Cancel the previous wait completion packet. */
+        if (bucket->port)
+            release = tp_waitqueue_cancel_packet( this );
+
         /* Convert relative timeout to absolute timestamp. */
         if (handle && timeout)
         {
@@ -2838,9 +3818,15 @@ VOID WINAPI TpSetWait( TP_WAIT *wait, HANDLE handle, LARGE_INTEGER *timeout )
         /* Add wait object back into one of the queues. */
         if (handle)
         {
-            list_add_tail( &bucket->waiting, &this->u.wait.wait_entry );
             this->u.wait.wait_pending = TRUE;
             this->u.wait.timeout = timestamp;
+            if (!bucket->port)
+                list_add_tail( &bucket->waiting, &this->u.wait.wait_entry );
+            else if (tp_waitqueue_port_wait( bucket, this ) == STATUS_OBJECT_TYPE_MISMATCH)
+            {
+                tp_waitqueue_port_fallback( this );
+                bucket = this->u.wait.bucket;
+            }
         }
         else
         {
@@ -2849,11 +3835,16 @@ VOID WINAPI TpSetWait( TP_WAIT *wait, HANDLE handle, LARGE_INTEGER *timeout )
         }
 
         /* Wake up the wait queue thread. */
-        NtSetEvent( bucket->update_event, NULL );
+        if (!bucket->port)
+            NtSetEvent( bucket->update_event, NULL );
     }
 
     RtlLeaveCriticalSection( &waitqueue.cs );
 
+    /* The caller still holds a reference, this is never the last one. */
+    if (release)
+        interlocked_dec( &this->refcount );
+
     if (submit_wait)
         tp_object_submit( this, FALSE );
 }
@@ -2888,6 +3879,36 @@ NTSTATUS WINAPI TpSimpleTryPost( PTP_SIMPLE_CALLBACK callback, PVOID userdata,
     return STATUS_SUCCESS;
 }
 
+/***********************************************************************
+ *           TpStartAsyncIoOperation    (NTDLL.@)
+ */
+VOID WINAPI TpStartAsyncIoOperation( TP_IO *io )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+
+    TRACE( "%p\n", io );
+
+    /* Each pending operation keeps the object alive until its completion arrives. */
+    RtlEnterCriticalSection( &this->queue->cs );
+    this->u.io.pending_count++;
+    interlocked_inc( &this->refcount );
+    RtlLeaveCriticalSection( &this->queue->cs );
+}
+
+/***********************************************************************
+ *           TpWaitForIoCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpWaitForIoCompletion( TP_IO *io, BOOL cancel_pending )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+
+    TRACE( "%p %d\n", io, cancel_pending );
+
+    if (cancel_pending)
+        tp_object_cancel( this, FALSE, NULL );
+    tp_object_wait( this, FALSE );
+}
+
 /***********************************************************************
  *           TpWaitForTimer    (NTDLL.@)
  */
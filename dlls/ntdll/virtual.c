@@ -41,6 +41,9 @@
 #ifdef HAVE_SYS_SYSINFO_H
 # include <sys/sysinfo.h>
 #endif
+#ifdef HAVE_SYS_STATFS_H
+# include <sys/statfs.h>
+#endif
 #ifdef HAVE_VALGRIND_VALGRIND_H
 # include <valgrind/valgrind.h>
 #endif
@@ -54,6 +57,7 @@
 #include "wine/server.h"
 #include "wine/exception.h"
 #include "wine/list.h"
+#include "wine/rbtree.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
 
@@ -68,6 +72,7 @@ WINE_DECLARE_DEBUG_CHANNEL(module);
 struct file_view
 {
     struct list   entry;       /* Entry in global view list */
+    struct wine_rb_entry tree_entry; /* Entry in global view tree */
     void         *base;        /* Base address */
     size_t        size;        /* Size in bytes */
     HANDLE        mapping;     /* Handle to the file mapping */
@@ -99,6 +104,7 @@ static const BYTE VIRTUAL_Win32Flags[16] =
 };
 
 static struct list views_list = LIST_INIT(views_list);
+static struct wine_rb_tree views_tree;  /* views indexed by address, for fast lookups */
 
 static RTL_CRITICAL_SECTION csVirtual;
 static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
@@ -146,11 +152,19 @@ static const BOOL is_win64 = (sizeof(void *) > sizeof(int));
 
 #define VIRTUAL_HEAP_SIZE (sizeof(void*)*1024*1024)
 
+/* transparent huge pages are 2Mb with 4k base pages; they are larger with the 16k and 64k
+ * base pages of some arm64 kernels, where this alignment doesn't help but is harmless */
+#define HUGE_PAGE_MASK ((UINT_PTR)0x1fffff)
+
+#define HUGETLBFS_MAGIC 0x958458f6
+
 static HANDLE virtual_heap;
 static void *preload_reserve_start;
 static void *preload_reserve_end;
 static BOOL use_locks;
 static BOOL force_exec_prot;  /* whether to force PROT_EXEC on all PROT_READ mmaps */
+static ULONG relocated_pages_saved;  /* image pages shared instead of being relocated */
+static ULONG relocation_time_saved;  /* time saved by not relocating images, in microseconds */
 
 
 /***********************************************************************
@@ -244,6 +258,97 @@ static void VIRTUAL_Dump(void)
 #endif
 
 
+/***********************************************************************
+ *           views tree functions
+ *
+ * The tree is only accessed with the csVirtual section held.
+ */
+static void *views_tree_alloc( size_t size )
+{
+    return RtlAllocateHeap( virtual_heap, 0, size );
+}
+
+static void *views_tree_realloc( void *ptr, size_t size )
+{
+    return RtlReAllocateHeap( virtual_heap, 0, ptr, size );
+}
+
+static void views_tree_free( void *ptr )
+{
+    RtlFreeHeap( virtual_heap, 0, ptr );
+}
+
+/* the key is an address; it matches the view that contains it */
+static int compare_view( const void *addr, const struct wine_rb_entry *entry )
+{
+    const struct file_view *view = WINE_RB_ENTRY_VALUE( entry, struct file_view, tree_entry );
+
+    if ((const char *)addr < (const char *)view->base) return -1;
+    if ((const char *)addr >= (const char *)view->base + view->size) return 1;
+    return 0;
+}
+
+static const struct wine_rb_functions views_tree_functions =
+{
+    views_tree_alloc,
+    views_tree_realloc,
+    views_tree_free,
+    compare_view
+};
+
+
+/***********************************************************************
+ *           find_view_above
+ *
+ * Find the first view that ends above the given address.
+ * The csVirtual section must be held by caller.
+ */
+static struct file_view *find_view_above( const void *addr )
+{
+    struct wine_rb_entry *ptr = views_tree.root;
+    struct file_view *ret = NULL;
+
+    while (ptr)
+    {
+        struct file_view *view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, tree_entry );
+
+        if ((const char *)view->base + view->size <= (const char *)addr) ptr = ptr->right;
+        else
+        {
+            ret = view;
+            ptr = ptr->left;
+        }
+    }
+    return ret;
+}
+
+
+/***********************************************************************
+ *           find_view_below
+ *
+ * Find the last view that starts below the given address.
+ * The csVirtual section must be held by caller.
+ */
+static struct file_view *find_view_below( const void *addr )
+{
+    struct wine_rb_entry *ptr = views_tree.root;
+    struct file_view *ret = NULL;
+
+    while (ptr)
+    {
+        struct file_view *view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, tree_entry );
+
+        if ((const char *)view->base >= (const char *)addr) ptr = ptr->left;
+        else
+        {
+            ret = view;
+            ptr = ptr->right;
+        }
+    }
+    return ret;
+}
+
+
 /***********************************************************************
  *           VIRTUAL_FindView
  *
@@ -258,17 +363,14 @@ static void VIRTUAL_Dump(void)
  */
 static struct file_view *VIRTUAL_FindView( const void *addr, size_t size )
 {
+    struct wine_rb_entry *ptr = wine_rb_get( &views_tree, addr );
     struct file_view *view;
 
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
-    {
-        if (view->base > addr) break;  /* no matching view */
-        if ((const char *)view->base + view->size <= (const char *)addr) continue;
-        if ((const char *)view->base + view->size < (const char *)addr + size) break;  /* size too large */
-        if ((const char *)addr + size < (const char *)addr) break; /* overflow */
-        return view;
-    }
-    return NULL;
+    if (!ptr) return NULL;  /* no matching view */
+    view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, tree_entry );
+    if ((const char *)view->base + view->size < (const char *)addr + size) return NULL;  /* size too large */
+    if ((const char *)addr + size < (const char *)addr) return NULL; /* overflow */
+    return view;
 }
 
 
@@ -291,13 +393,9 @@ static inline UINT_PTR get_mask( ULONG zero_bits )
  */
 static struct file_view *find_view_range( const void *addr, size_t size )
 {
-    struct file_view *view;
+    struct file_view *view = find_view_above( addr );
 
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
-    {
-        if ((const char *)view->base >= (const char *)addr + size) break;
-        if ((const char *)view->base + view->size > (const char *)addr) return view;
-    }
+    if (view && (const char *)view->base < (const char *)addr + size) return view;
     return NULL;
 }
 
@@ -310,15 +408,19 @@ static struct file_view *find_view_range( const void *addr, size_t size )
  */
 static void *find_free_area( void *base, void *end, size_t size, size_t mask, int top_down )
 {
+    struct file_view *first;
     struct list *ptr;
     void *start;
 
+    /* the tree gives the first view that may conflict, the list is then walked from there */
+
     if (top_down)
     {
         start = ROUND_ADDR( (char *)end - size, mask );
         if (start >= end || start < base) return NULL;
 
-        for (ptr = views_list.prev; ptr != &views_list; ptr = ptr->prev)
+        first = find_view_below( (char *)start + size );
+        for (ptr = first ? &first->entry : &views_list; ptr != &views_list; ptr = ptr->prev)
         {
             struct file_view *view = LIST_ENTRY( ptr, struct file_view, entry );
 
@@ -334,7 +436,8 @@ static void *find_free_area( void *base, void *end, size_t size, size_t mask, in
         start = ROUND_ADDR( (char *)base + mask, mask );
         if (start >= end || (char *)end - (char *)start < size) return NULL;
 
-        for (ptr = views_list.next; ptr != &views_list; ptr = ptr->next)
+        first = find_view_above( start );
+        for (ptr = first ? &first->entry : &views_list; ptr != &views_list; ptr = ptr->next)
         {
             struct file_view *view = LIST_ENTRY( ptr, struct file_view, entry );
 
@@ -382,13 +485,16 @@ static void add_reserved_area( void *addr, size_t size )
 static void remove_reserved_area( void *addr, size_t size )
 {
     struct file_view *view;
+    struct list *ptr;
 
     TRACE( "removing %p-%p\n", addr, (char *)addr + size );
     wine_mmap_remove_reserved_area( addr, size, 0 );
 
     /* unmap areas not covered by an existing view */
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
+    if (!(view = find_view_above( addr ))) return;
+    for (ptr = &view->entry; ptr != &views_list; ptr = ptr->next)
     {
+        view = LIST_ENTRY( ptr, struct file_view, entry );
         if ((char *)view->base >= (char *)addr + size)
         {
             munmap( addr, size );
@@ -439,6 +545,7 @@ static inline void unmap_area( void *addr, size_t size )
 static void delete_view( struct file_view *view ) /* [in] View */
 {
     if (!(view->protect & VPROT_SYSTEM)) unmap_area( view->base, view->size );
+    wine_rb_remove( &views_tree, view->base );
     list_remove( &view->entry );
     if (view->mapping) close_handle( view->mapping );
     RtlFreeHeap( virtual_heap, 0, view );
@@ -452,8 +559,7 @@ static void delete_view( struct file_view *view ) /* [in] View */
  */
 static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t size, unsigned int vprot )
 {
-    struct file_view *view;
-    struct list *ptr;
+    struct file_view *view, *next;
     int unix_prot = VIRTUAL_GetUnixProt( vprot );
 
     assert( !((UINT_PTR)base & page_mask) );
@@ -474,43 +580,27 @@ static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t siz
     view->protect = vprot;
     memset( view->prot, vprot, size >> page_shift );
 
-    /* Insert it in the linked list */
-
-    LIST_FOR_EACH( ptr, &views_list )
-    {
-        struct file_view *next = LIST_ENTRY( ptr, struct file_view, entry );
-        if (next->base > base) break;
-    }
-    list_add_before( ptr, &view->entry );
-
-    /* Check for overlapping views. This can happen if the previous view
+    /* Check for overlapping views. This can happen if a previous view
      * was a system view that got unmapped behind our back. In that case
      * we recover by simply deleting it. */
 
-    if ((ptr = list_prev( &views_list, &view->entry )) != NULL)
+    while ((next = find_view_range( base, size )))
     {
-        struct file_view *prev = LIST_ENTRY( ptr, struct file_view, entry );
-        if ((char *)prev->base + prev->size > (char *)base)
-        {
-            TRACE( "overlapping prev view %p-%p for %p-%p\n",
-                   prev->base, (char *)prev->base + prev->size,
-                   base, (char *)base + view->size );
-            assert( prev->protect & VPROT_SYSTEM );
-            delete_view( prev );
-        }
+        TRACE( "overlapping view %p-%p for %p-%p\n",
+               next->base, (char *)next->base + next->size, base, (char *)base + size );
+        assert( next->protect & VPROT_SYSTEM );
+        delete_view( next );
     }
-    if ((ptr = list_next( &views_list, &view->entry )) != NULL)
+
+    /* Insert it in the tree and in the linked list */
+
+    if (wine_rb_put( &views_tree, base, &view->tree_entry ))
     {
-        struct file_view *next = LIST_ENTRY( ptr, struct file_view, entry );
-        if ((char *)base + view->size > (char *)next->base)
-        {
-            TRACE( "overlapping next view %p-%p for %p-%p\n",
-                   next->base, (char *)next->base + next->size,
-                   base, (char *)base + view->size );
-            assert( next->protect & VPROT_SYSTEM );
-            delete_view( next );
-        }
+        RtlFreeHeap( virtual_heap, 0, view );
+        return STATUS_NO_MEMORY;
     }
+    if ((next = find_view_above( (char *)base + size ))) list_add_before( &next->entry, &view->entry );
+    else list_add_tail( &views_list, &view->entry );
 
     *view_ret = view;
     VIRTUAL_DEBUG_DUMP_VIEW( view );
@@ -915,6 +1005,52 @@ done:
 }
 
 
+/***********************************************************************
+ *           get_huge_page_mask
+ *
+ * Return the huge page mask of a section backed by real huge pages, or 0.
+ * Such sections live on hugetlbfs, whose block size is the huge page size.
+ */
+static UINT_PTR get_huge_page_mask( int fd )
+{
+#if defined(__linux__) && defined(HAVE_SYS_STATFS_H)
+    struct statfs stfs;
+
+    if (!fstatfs( fd, &stfs ) && (unsigned int)stfs.f_type == HUGETLBFS_MAGIC && stfs.f_bsize > page_size)
+        return stfs.f_bsize - 1;
+#endif
+    return 0;
+}
+
+
+/***********************************************************************
+ *           want_huge_pages
+ *
+ * Check if transparent huge pages should be requested for a view of an
+ * anonymous section. This is always done for SEC_LARGE_PAGES sections that
+ * couldn't get real huge pages, and for other large sections if the
+ * WINEHUGEPAGES environment variable is set.
+ */
+static BOOL want_huge_pages( unsigned int sec_flags, SIZE_T size )
+{
+#ifdef MADV_HUGEPAGE
+    static int use_huge_pages = -1;
+
+    if (sec_flags & (SEC_FILE | SEC_IMAGE | SEC_RESERVE)) return FALSE;
+    if (size <= HUGE_PAGE_MASK) return FALSE;
+    if (sec_flags & SEC_LARGE_PAGES) return TRUE;
+    if (use_huge_pages == -1)
+    {
+        const char *env = getenv( "WINEHUGEPAGES" );
+        use_huge_pages = env && atoi( env );
+    }
+    return use_huge_pages;
+#else
+    return FALSE;
+#endif
+}
+
+
 /***********************************************************************
  *           get_committed_size
  *
@@ -1287,6 +1423,172 @@ static NTSTATUS map_image( HANDLE hmapping, int fd, char *base, SIZE_T total_siz
 }
 
 
+/***********************************************************************
+ *           get_relocated_pages
+ *
+ * Build the sorted list of the image pages modified by the base relocations.
+ */
+static ULONG get_relocated_pages( void *module, SIZE_T size, ULONG *pages )
+{
+    IMAGE_NT_HEADERS *nt = RtlImageNtHeader( module );
+    const IMAGE_DATA_DIRECTORY *relocs = &nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+    const IMAGE_BASE_RELOCATION *rel, *end;
+    ULONG i, rva, count = 0, nb_pages = size >> page_shift;
+    BYTE *used;
+
+    if (!relocs->Size || !relocs->VirtualAddress) return 0;
+    if (!(used = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, nb_pages ))) return 0;
+
+    rel = (const IMAGE_BASE_RELOCATION *)((char *)module + relocs->VirtualAddress);
+    end = (const IMAGE_BASE_RELOCATION *)((const char *)rel + relocs->Size);
+    while (rel < end - 1 && rel->SizeOfBlock)
+    {
+        const USHORT *type_offset = (const USHORT *)(rel + 1);
+        ULONG nb_fixups = (rel->SizeOfBlock - sizeof(*rel)) / sizeof(USHORT);
+
+        for (i = 0; i < nb_fixups; i++)
+        {
+            if ((type_offset[i] >> 12) == IMAGE_REL_BASED_ABSOLUTE) continue;
+            /* a fixup may straddle a page boundary */
+            rva = rel->VirtualAddress + (type_offset[i] & 0xfff);
+            if ((rva >> page_shift) < nb_pages) used[rva >> page_shift] = 1;
+            rva += sizeof(ULONGLONG) - 1;
+            if ((rva >> page_shift) < nb_pages) used[rva >> page_shift] = 1;
+        }
+        rel = (const IMAGE_BASE_RELOCATION *)((const char *)rel + rel->SizeOfBlock);
+    }
+
+    for (i = 0; i < nb_pages; i++) if (used[i]) pages[count++] = i << page_shift;
+    RtlFreeHeap( GetProcessHeap(), 0, used );
+    return count;
+}
+
+
+/***********************************************************************
+ *           virtual_map_relocated_image
+ *
+ * Replace the pages of an image that need base relocations by the pages
+ * already relocated at the same address by another process, so that they
+ * remain shared copy-on-write between all the processes using them.
+ * Returns STATUS_NOT_FOUND if the image has to be relocated by the caller.
+ */
+NTSTATUS virtual_map_relocated_image( HANDLE mapping, void *module, SIZE_T size )
+{
+    struct file_view *view;
+    ULONG *pages, count = 0, hits = 0, time = 0, i, j;
+    HANDLE file = 0;
+    int unix_fd, needs_close;
+    sigset_t sigset;
+    NTSTATUS status;
+
+    if (!(pages = RtlAllocateHeap( GetProcessHeap(), 0, (size >> page_shift) * sizeof(*pages) )))
+        return STATUS_NOT_FOUND;
+
+    SERVER_START_REQ( get_image_relocation )
+    {
+        req->handle = wine_server_obj_handle( mapping );
+        req->base   = wine_server_client_ptr( module );
+        wine_server_set_reply( req, pages, (size >> page_shift) * sizeof(*pages) );
+        if (!(status = wine_server_call( req )))
+        {
+            file  = wine_server_ptr_handle( reply->file );
+            hits  = reply->hits;
+            time  = reply->time;
+            count = wine_server_reply_size( reply ) / sizeof(*pages);
+        }
+    }
+    SERVER_END_REQ;
+    if (status) goto done;
+
+    if ((status = server_get_unix_fd( file, FILE_READ_DATA, &unix_fd, &needs_close, NULL, NULL )))
+    {
+        close_handle( file );
+        goto done;
+    }
+
+    server_enter_uninterrupted_section( &csVirtual, &sigset );
+
+    if (!(view = VIRTUAL_FindView( module, size )) || view->base != module) status = STATUS_NOT_FOUND;
+    for (i = 0; i < count && !status; i++) if (pages[i] >= size) status = STATUS_NOT_FOUND;
+
+    for (i = 0; i < count && !status; i = j)
+    {
+        BYTE vprot = view->prot[pages[i] >> page_shift];
+        SIZE_T map_size;
+
+        /* map contiguous pages with the same protections at once */
+        for (j = i + 1; j < count; j++)
+            if (pages[j] != pages[j - 1] + page_size || view->prot[pages[j] >> page_shift] != vprot) break;
+        map_size = (SIZE_T)(j - i) << page_shift;
+
+        /* always map private copies, the pages must not be modified through a shared mapping */
+        status = map_file_into_view( view, unix_fd, pages[i], map_size, pages[i],
+                                     VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY, FALSE );
+        if (!status) VIRTUAL_SetProt( view, (char *)module + pages[i], map_size, vprot );
+    }
+
+    if (!status)
+    {
+        relocated_pages_saved += count;
+        relocation_time_saved += time;
+        TRACE_(module)( "mapped %u relocated pages of %p, reused %u times, saved %u us "
+                        "(process total %u pages, %u us)\n", count, module, hits, time,
+                        relocated_pages_saved, relocation_time_saved );
+    }
+    server_leave_uninterrupted_section( &csVirtual, &sigset );
+    /* the fd is cached with the handle, so the handle can only be closed once the pages are mapped */
+    if (needs_close) close( unix_fd );
+    close_handle( file );
+    RtlFreeHeap( GetProcessHeap(), 0, pages );
+    return status;
+
+done:
+    RtlFreeHeap( GetProcessHeap(), 0, pages );
+    return STATUS_NOT_FOUND;
+}
+
+
+/***********************************************************************
+ *           virtual_add_relocated_image
+ *
+ * Store the pages of an image that has just been relocated, so that
+ * other processes mapping it at the same address can share them.
+ */
+void virtual_add_relocated_image( HANDLE mapping, void *module, SIZE_T size, ULONG time )
+{
+    ULONG *pages, count, i;
+    char *data;
+    NTSTATUS status;
+
+    if (!(pages = RtlAllocateHeap( GetProcessHeap(), 0, (size >> page_shift) * sizeof(*pages) ))) return;
+    if (!(count = get_relocated_pages( module, size, pages ))) goto done;
+    if (!(data = RtlAllocateHeap( GetProcessHeap(), 0, (SIZE_T)count << page_shift ))) goto done;
+
+    for (i = 0; i < count; i++)
+        if (virtual_uninterrupted_read_memory( (char *)module + pages[i], data + ((SIZE_T)i << page_shift),
+                                               page_size ) != page_size) break;
+    if (i == count)
+    {
+        SERVER_START_REQ( add_image_relocation )
+        {
+            req->handle     = wine_server_obj_handle( mapping );
+            req->base       = wine_server_client_ptr( module );
+            req->time       = time;
+            req->pages_size = count * sizeof(*pages);
+            wine_server_add_data( req, pages, count * sizeof(*pages) );
+            wine_server_add_data( req, data, (SIZE_T)count << page_shift );
+            status = wine_server_call( req );
+        }
+        SERVER_END_REQ;
+        if (!status)
+            TRACE_(module)( "stored %u relocated pages of %p, relocation took %u us\n", count, module, time );
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, data );
+done:
+    RtlFreeHeap( GetProcessHeap(), 0, pages );
+}
+
+
 /* callback for wine_mmap_enum_reserved_areas to allocate space for the virtual heap */
 static int alloc_virtual_heap( void *base, size_t size, void *arg )
 {
@@ -1336,6 +1638,11 @@ void virtual_init(void)
     assert( heap_base != (void *)-1 );
     virtual_heap = RtlCreateHeap( HEAP_NO_SERIALIZE, heap_base, VIRTUAL_HEAP_SIZE,
                                   VIRTUAL_HEAP_SIZE, NULL, NULL );
+    if (wine_rb_init( &views_tree, &views_tree_functions ))
+    {
+        ERR( "failed to initialize the views tree\n" );
+        exit(1);
+    }
     create_view( &heap_view, heap_base, VIRTUAL_HEAP_SIZE, VPROT_COMMITTED | VPROT_READ | VPROT_WRITE );
 
     /* make the DOS area accessible (except the low 64K) to hide bugs in broken apps like Excel 2003 */
@@ -2311,30 +2618,22 @@ NTSTATUS WINAPI NtQueryVirtualMemory( HANDLE process, LPCVOID addr,
     /* Find the view containing the address */
 
     server_enter_uninterrupted_section( &csVirtual, &sigset );
-    ptr = list_head( &views_list );
-    for (;;)
+    view = find_view_above( base );
+    if (view && (char *)view->base <= base)
     {
-        if (!ptr)
-        {
-            size = (char *)working_set_limit - alloc_base;
-            view = NULL;
-            break;
-        }
-        view = LIST_ENTRY( ptr, struct file_view, entry );
-        if ((char *)view->base > base)
-        {
-            size = (char *)view->base - alloc_base;
-            view = NULL;
-            break;
-        }
-        if ((char *)view->base + view->size > base)
+        alloc_base = view->base;
+        size = view->size;
+    }
+    else
+    {
+        /* the free area starts at the end of the previous view */
+        if ((ptr = view ? list_prev( &views_list, &view->entry ) : list_tail( &views_list )))
         {
-            alloc_base = view->base;
-            size = view->size;
-            break;
+            struct file_view *prev = LIST_ENTRY( ptr, struct file_view, entry );
+            alloc_base = (char *)prev->base + prev->size;
         }
-        alloc_base = (char *)view->base + view->size;
-        ptr = list_next( &views_list, ptr );
+        size = (view ? (char *)view->base : (char *)working_set_limit) - alloc_base;
+        view = NULL;
     }
 
     /* Fill the info structure */
@@ -2534,7 +2833,7 @@ NTSTATUS WINAPI NtMapViewOfSection( HANDLE handle, HANDLE process, PVOID *addr_p
     NTSTATUS res;
     mem_size_t full_size;
     ACCESS_MASK access;
-    SIZE_T size, mask = get_mask( zero_bits );
+    SIZE_T size, mask = get_mask( zero_bits ), huge_mask = 0;
     int unix_handle = -1, needs_close;
     unsigned int map_vprot, vprot, sec_flags;
     struct file_view *view;
@@ -2688,6 +2987,23 @@ NTSTATUS WINAPI NtMapViewOfSection( HANDLE handle, HANDLE process, PVOID *addr_p
     }
     if (!(size = ROUND_SIZE( 0, size ))) goto done;  /* wrap-around */
 
+    if ((sec_flags & SEC_LARGE_PAGES) && !(sec_flags & (SEC_FILE | SEC_IMAGE)))
+    {
+        if ((huge_mask = get_huge_page_mask( unix_handle )))
+        {
+            if ((offset.QuadPart & huge_mask) || ((UINT_PTR)*addr_ptr & huge_mask))
+            {
+                res = STATUS_MAPPED_ALIGNMENT;
+                goto done;
+            }
+            size = (size + huge_mask) & ~huge_mask;
+            mask |= huge_mask;
+        }
+        else WARN( "no huge pages available for section %p\n", handle );
+    }
+    /* align the view so that it can be covered with transparent huge pages */
+    if (!huge_mask && !*addr_ptr && want_huge_pages( sec_flags, size )) mask |= HUGE_PAGE_MASK;
+
     /* Reserve a properly aligned area */
 
     server_enter_uninterrupted_section( &csVirtual, &sigset );
@@ -2709,6 +3025,9 @@ NTSTATUS WINAPI NtMapViewOfSection( HANDLE handle, HANDLE process, PVOID *addr_p
     res = map_file_into_view( view, unix_handle, 0, size, offset.QuadPart, vprot, !dup_mapping );
     if (res == STATUS_SUCCESS)
     {
+#ifdef MADV_HUGEPAGE
+        if (!huge_mask && want_huge_pages( sec_flags, size )) madvise( view->base, size, MADV_HUGEPAGE );
+#endif
         *addr_ptr = view->base;
         *size_ptr = size;
         view->mapping = dup_mapping;
@@ -59,6 +59,15 @@ static RTL_CRITICAL_SECTION vcomp_section = { &critsect_debug, -1, 0, 0, 0, 0 };
 #define VCOMP_DYNAMIC_FLAGS_GUIDED      0x03
 #define VCOMP_DYNAMIC_FLAGS_INCREMENT   0x40
 
+/* number of pauses before a waiting thread goes to sleep */
+#define VCOMP_SPIN_COUNT                4000
+
+/* the dynamic loop state holds a busy flag, the loop generation and the next iteration */
+#define VCOMP_DYNAMIC_GEN_MASK          0x3fffffff
+#define VCOMP_DYNAMIC_STATE(gen, next)  (((LONG64)((gen) & VCOMP_DYNAMIC_GEN_MASK) << 32) | (unsigned int)(next))
+#define VCOMP_DYNAMIC_GEN(state)        ((unsigned int)((state) >> 32) & VCOMP_DYNAMIC_GEN_MASK)
+#define VCOMP_DYNAMIC_BUSY              ((LONG64)1 << 62)
+
 struct vcomp_thread_data
 {
     struct vcomp_team_data  *team;
@@ -69,7 +78,7 @@ struct vcomp_thread_data
 
     /* only used for concurrent tasks */
     struct list             entry;
-    CONDITION_VARIABLE      cond;
+    LONG                    sleeping;
 
     /* single */
     unsigned int            single;
@@ -86,9 +95,8 @@ struct vcomp_thread_data
 
 struct vcomp_team_data
 {
-    CONDITION_VARIABLE      cond;
     int                     num_threads;
-    int                     finished_threads;
+    LONG                    finished_threads;
 
     /* callback arguments */
     int                     nargs;
@@ -96,8 +104,9 @@ struct vcomp_team_data
     __ms_va_list            valist;
 
     /* barrier */
-    unsigned int            barrier;
-    int                     barrier_count;
+    LONG                    barrier;
+    LONG                    barrier_count;
+    LONG                    barrier_sleepers;
 };
 
 struct vcomp_task_data
@@ -111,7 +120,7 @@ struct vcomp_task_data
     int                     section_index;
 
     /* dynamic */
-    unsigned int            dynamic;
+    LONG64 DECLSPEC_ALIGN(8) dynamic_state;
     unsigned int            dynamic_first;
     unsigned int            dynamic_last;
     unsigned int            dynamic_iterations;
@@ -334,6 +343,46 @@ static short interlocked_xchg_add16(short *dest, short incr)
 
 #endif  /* __GNUC__ */
 
+static inline void small_pause(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__( "rep;nop" : : : "memory" );
+#else
+    __asm__ __volatile__( "" : : : "memory" );
+#endif
+}
+
+/* spin for a while on multiprocessor systems, then sleep until *ptr changes */
+static void vcomp_wait_for_change(LONG volatile *ptr, LONG value, LONG volatile *sleepers)
+{
+    int i;
+
+    if (vcomp_max_threads > 1)
+    {
+        for (i = 0; i < VCOMP_SPIN_COUNT; i++)
+        {
+            if (*ptr != value) return;
+            small_pause();
+        }
+    }
+
+    if (sleepers) InterlockedIncrement(sleepers);
+    while (*ptr == value)
+        WaitOnAddress(ptr, &value, sizeof(value), INFINITE);
+    if (sleepers) InterlockedDecrement(sleepers);
+}
+
+static inline LONG64 vcomp_get_dynamic_state(struct vcomp_task_data *task_data)
+{
+    return InterlockedCompareExchange64(&task_data->dynamic_state, 0, 0);
+}
+
+/* generations wrap around, so compare them as signed numbers of the mask width */
+static inline BOOL vcomp_dynamic_gen_is_newer(unsigned int gen, LONG64 state)
+{
+    return (int)((gen - VCOMP_DYNAMIC_GEN(state)) << 2) > 0;
+}
+
 static inline struct vcomp_thread_data *vcomp_get_thread_data(void)
 {
     return (struct vcomp_thread_data *)TlsGetValue(vcomp_context_tls);
@@ -362,7 +411,7 @@ static struct vcomp_thread_data *vcomp_init_thread_data(void)
 
     data->task.single           = 0;
     data->task.section          = 0;
-    data->task.dynamic          = 0;
+    data->task.dynamic_state    = 0;
 
     thread_data = &data->thread;
     thread_data->team           = NULL;
@@ -809,26 +858,24 @@ void CDECL _vcomp_flush(void)
 void CDECL _vcomp_barrier(void)
 {
     struct vcomp_team_data *team_data = vcomp_init_thread_data()->team;
+    LONG barrier;
 
     TRACE("()\n");
 
     if (!team_data)
         return;
 
-    EnterCriticalSection(&vcomp_section);
-    if (++team_data->barrier_count >= team_data->num_threads)
+    /* the barrier can't move on before this thread arrived */
+    barrier = team_data->barrier;
+    if (InterlockedIncrement(&team_data->barrier_count) >= team_data->num_threads)
     {
-        team_data->barrier++;
-        team_data->barrier_count = 0;
-        WakeAllConditionVariable(&team_data->cond);
+        InterlockedExchange(&team_data->barrier_count, 0);
+        InterlockedIncrement(&team_data->barrier);
+        if (team_data->barrier_sleepers)
+            WakeByAddressAll((void *)&team_data->barrier);
     }
     else
-    {
-        unsigned int barrier = team_data->barrier;
-        while (team_data->barrier == barrier)
-            SleepConditionVariableCS(&team_data->cond, &vcomp_section, INFINITE);
-    }
-    LeaveCriticalSection(&vcomp_section);
+        vcomp_wait_for_change(&team_data->barrier, barrier, &team_data->barrier_sleepers);
 }
 
 void CDECL _vcomp_set_num_threads(int num_threads)
@@ -854,20 +901,19 @@ int CDECL _vcomp_single_begin(int flags)
 {
     struct vcomp_thread_data *thread_data = vcomp_init_thread_data();
     struct vcomp_task_data *task_data = thread_data->task;
-    int ret = FALSE;
+    unsigned int single;
 
     TRACE("(%x): semi-stub\n", flags);
 
-    EnterCriticalSection(&vcomp_section);
     thread_data->single++;
-    if ((int)(thread_data->single - task_data->single) > 0)
+    single = task_data->single;
+    while ((int)(thread_data->single - single) > 0)
     {
-        task_data->single = thread_data->single;
-        ret = TRUE;
+        unsigned int prev = InterlockedCompareExchange((LONG *)&task_data->single, thread_data->single, single);
+        if (prev == single) return TRUE;
+        single = prev;
     }
-    LeaveCriticalSection(&vcomp_section);
-
-    return ret;
+    return FALSE;
 }
 
 void CDECL _vcomp_single_end(void)
@@ -1042,6 +1088,7 @@ void CDECL _vcomp_for_dynamic_init(unsigned int flags, unsigned int first, unsig
     int num_threads = team_data ? team_data->num_threads : 1;
     int thread_num = thread_data->thread_num;
     unsigned int type = flags & ~VCOMP_DYNAMIC_FLAGS_INCREMENT;
+    LONG64 state;
 
     TRACE("(%u, %u, %u, %d, %u)\n", flags, first, last, step, chunksize);
 
@@ -1087,19 +1134,28 @@ void CDECL _vcomp_for_dynamic_init(unsigned int flags, unsigned int first, unsig
             type = VCOMP_DYNAMIC_FLAGS_GUIDED;
         }
 
-        EnterCriticalSection(&vcomp_section);
         thread_data->dynamic++;
         thread_data->dynamic_type = type;
-        if ((int)(thread_data->dynamic - task_data->dynamic) > 0)
+
+        /* the first thread marks the loop busy while it fills in the loop data */
+        state = vcomp_get_dynamic_state(task_data);
+        while (vcomp_dynamic_gen_is_newer(thread_data->dynamic, state))
         {
-            task_data->dynamic              = thread_data->dynamic;
-            task_data->dynamic_first        = first;
-            task_data->dynamic_last         = last;
-            task_data->dynamic_iterations   = iterations;
-            task_data->dynamic_step         = step;
-            task_data->dynamic_chunksize    = chunksize;
+            LONG64 busy = VCOMP_DYNAMIC_STATE(thread_data->dynamic, 0) | VCOMP_DYNAMIC_BUSY;
+            LONG64 prev = InterlockedCompareExchange64(&task_data->dynamic_state, busy, state);
+            if (prev == state)
+            {
+                task_data->dynamic_first        = first;
+                task_data->dynamic_last         = last;
+                task_data->dynamic_iterations   = iterations;
+                task_data->dynamic_step         = step;
+                task_data->dynamic_chunksize    = chunksize;
+                InterlockedCompareExchange64(&task_data->dynamic_state,
+                                             VCOMP_DYNAMIC_STATE(thread_data->dynamic, 0), busy);
+                break;
+            }
+            state = prev;
         }
-        LeaveCriticalSection(&vcomp_section);
     }
 }
 
@@ -1122,26 +1178,42 @@ int CDECL _vcomp_for_dynamic_next(unsigned int *begin, unsigned int *end)
     else if (thread_data->dynamic_type == VCOMP_DYNAMIC_FLAGS_CHUNKED ||
              thread_data->dynamic_type == VCOMP_DYNAMIC_FLAGS_GUIDED)
     {
-        unsigned int iterations = 0;
-        EnterCriticalSection(&vcomp_section);
-        if (thread_data->dynamic == task_data->dynamic &&
-            task_data->dynamic_iterations != 0)
+        LONG64 state = vcomp_get_dynamic_state(task_data);
+
+        for (;;)
         {
-            iterations = min(task_data->dynamic_iterations, task_data->dynamic_chunksize);
+            unsigned int next = (unsigned int)state, remaining, iterations;
+            LONG64 prev;
+
+            if (VCOMP_DYNAMIC_GEN(state) != (thread_data->dynamic & VCOMP_DYNAMIC_GEN_MASK))
+                return 0;
+            if (state & VCOMP_DYNAMIC_BUSY)
+            {
+                small_pause();
+                state = vcomp_get_dynamic_state(task_data);
+                continue;
+            }
+
+            /* a newer loop only starts once this one is exhausted, so the
+             * loop data is only stale if the claim below fails */
+            if (next >= task_data->dynamic_iterations)
+                return 0;
+            remaining  = task_data->dynamic_iterations - next;
+            iterations = min(remaining, task_data->dynamic_chunksize);
             if (thread_data->dynamic_type == VCOMP_DYNAMIC_FLAGS_GUIDED &&
-                task_data->dynamic_iterations > num_threads * task_data->dynamic_chunksize)
+                remaining > num_threads * task_data->dynamic_chunksize)
             {
-                iterations = (task_data->dynamic_iterations + num_threads - 1) / num_threads;
+                iterations = (remaining + num_threads - 1) / num_threads;
             }
-            *begin = task_data->dynamic_first;
-            *end   = task_data->dynamic_first + (iterations - 1) * task_data->dynamic_step;
-            task_data->dynamic_iterations -= iterations;
-            task_data->dynamic_first      += iterations * task_data->dynamic_step;
-            if (!task_data->dynamic_iterations)
+            *begin = task_data->dynamic_first + next * task_data->dynamic_step;
+            *end   = *begin + (iterations - 1) * task_data->dynamic_step;
+            if (iterations == remaining)
                 *end = task_data->dynamic_last;
+
+            prev = InterlockedCompareExchange64(&task_data->dynamic_state, state + iterations, state);
+            if (prev == state) return 1;
+            state = prev;
         }
-        LeaveCriticalSection(&vcomp_section);
-        return iterations != 0;
     }
 
     return 0;
@@ -1160,28 +1232,49 @@ static DWORD WINAPI _vcomp_fork_worker(void *param)
 
     TRACE("starting worker thread for %p\n", thread_data);
 
-    EnterCriticalSection(&vcomp_section);
     for (;;)
     {
-        struct vcomp_team_data *team = thread_data->team;
+        struct vcomp_team_data *team = *(struct vcomp_team_data * volatile *)&thread_data->team;
+        void *no_team = NULL;
+        int i;
+
         if (team != NULL)
         {
-            LeaveCriticalSection(&vcomp_section);
+            int num_threads = team->num_threads;
+
             _vcomp_fork_call_wrapper(team->wrapper, team->nargs, team->valist);
-            EnterCriticalSection(&vcomp_section);
 
+            EnterCriticalSection(&vcomp_section);
             thread_data->team = NULL;
             list_remove(&thread_data->entry);
             list_add_tail(&vcomp_idle_threads, &thread_data->entry);
-            if (++team->finished_threads >= team->num_threads)
-                WakeAllConditionVariable(&team->cond);
+            LeaveCriticalSection(&vcomp_section);
+
+            /* the team may be gone as soon as the last thread finished */
+            if (InterlockedIncrement(&team->finished_threads) >= num_threads)
+                WakeByAddressAll(&team->finished_threads);
         }
 
-        if (!SleepConditionVariableCS(&thread_data->cond, &vcomp_section, 5000) &&
-            GetLastError() == ERROR_TIMEOUT && !thread_data->team)
+        /* stay hot for a while in case the next parallel region follows */
+        if (vcomp_max_threads > 1)
         {
-            break;
+            for (i = 0; i < VCOMP_SPIN_COUNT; i++)
+            {
+                if (*(void * volatile *)&thread_data->team) break;
+                small_pause();
+            }
+            if (i < VCOMP_SPIN_COUNT) continue;
+        }
+
+        InterlockedExchange(&thread_data->sleeping, TRUE);
+        if (!WaitOnAddress(&thread_data->team, &no_team, sizeof(no_team), 5000) &&
+            GetLastError() == ERROR_TIMEOUT)
+        {
+            EnterCriticalSection(&vcomp_section);
+            if (!thread_data->team) break;
+            LeaveCriticalSection(&vcomp_section);
         }
+        InterlockedExchange(&thread_data->sleeping, FALSE);
     }
     list_remove(&thread_data->entry);
     LeaveCriticalSection(&vcomp_section);
@@ -1214,7 +1307,6 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
     else
         num_threads = vcomp_num_threads;
 
-    InitializeConditionVariable(&team_data.cond);
     team_data.num_threads       = 1;
     team_data.finished_threads  = 0;
     team_data.nargs             = nargs;
@@ -1222,10 +1314,11 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
     __ms_va_start(team_data.valist, wrapper);
     team_data.barrier           = 0;
     team_data.barrier_count     = 0;
+    team_data.barrier_sleepers  = 0;
 
     task_data.single            = 0;
     task_data.section           = 0;
-    task_data.dynamic           = 0;
+    task_data.dynamic_state     = 0;
 
     thread_data.team            = &team_data;
     thread_data.task            = &task_data;
@@ -1237,18 +1330,18 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
     thread_data.dynamic         = 1;
     thread_data.dynamic_type    = 0;
     list_init(&thread_data.entry);
-    InitializeConditionVariable(&thread_data.cond);
+    thread_data.sleeping        = FALSE;
 
     if (num_threads > 1)
     {
+        struct vcomp_thread_data *data;
         struct list *ptr;
         EnterCriticalSection(&vcomp_section);
 
         /* reuse existing threads (if any) */
         while (team_data.num_threads < num_threads && (ptr = list_head(&vcomp_idle_threads)))
         {
-            struct vcomp_thread_data *data = LIST_ENTRY(ptr, struct vcomp_thread_data, entry);
-            data->team          = &team_data;
+            data = LIST_ENTRY(ptr, struct vcomp_thread_data, entry);
             data->task          = &task_data;
             data->thread_num    = team_data.num_threads++;
             data->parallel      = thread_data.parallel;
@@ -1259,20 +1352,18 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
             data->dynamic_type  = 0;
             list_remove(&data->entry);
             list_add_tail(&thread_data.entry, &data->entry);
-            WakeAllConditionVariable(&data->cond);
         }
 
         /* spawn additional threads */
         while (team_data.num_threads < num_threads)
         {
-            struct vcomp_thread_data *data;
             HMODULE module;
             HANDLE thread;
 
             data = HeapAlloc(GetProcessHeap(), 0, sizeof(*data));
             if (!data) break;
 
-            data->team          = &team_data;
+            data->team          = NULL;
             data->task          = &task_data;
             data->thread_num    = team_data.num_threads;
             data->parallel      = thread_data.parallel;
@@ -1281,7 +1372,7 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
             data->section       = 1;
             data->dynamic       = 1;
             data->dynamic_type  = 0;
-            InitializeConditionVariable(&data->cond);
+            data->sleeping      = FALSE;
 
             thread = CreateThread(NULL, 0, _vcomp_fork_worker, data, 0, NULL);
             if (!thread)
@@ -1297,6 +1388,13 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
             CloseHandle(thread);
         }
 
+        /* the team is only set once it is complete, the threads may be spinning on it */
+        LIST_FOR_EACH_ENTRY(data, &thread_data.entry, struct vcomp_thread_data, entry)
+        {
+            InterlockedExchangePointer((void **)&data->team, &team_data);
+            if (data->sleeping) WakeByAddressAll(&data->team);
+        }
+
         LeaveCriticalSection(&vcomp_section);
     }
 
@@ -1307,13 +1405,13 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
 
     if (team_data.num_threads > 1)
     {
-        EnterCriticalSection(&vcomp_section);
+        LONG finished = InterlockedIncrement(&team_data.finished_threads);
 
-        team_data.finished_threads++;
-        while (team_data.finished_threads < team_data.num_threads)
-            SleepConditionVariableCS(&team_data.cond, &vcomp_section, INFINITE);
-
-        LeaveCriticalSection(&vcomp_section);
+        while (finished < team_data.num_threads)
+        {
+            vcomp_wait_for_change(&team_data.finished_threads, finished, NULL);
+            finished = team_data.finished_threads;
+        }
         assert(list_empty(&thread_data.entry));
     }
 
@@ -1250,6 +1250,51 @@ static void test_vcomp_for_dynamic_init(void)
     pomp_set_num_threads(max_threads);
 }
 
+static void CDECL parallel_for_cb(LONG *sum)
+{
+    unsigned int begin, end, i;
+    LONG local = 0;
+
+    p_vcomp_for_dynamic_init(VCOMP_DYNAMIC_FLAGS_CHUNKED | VCOMP_DYNAMIC_FLAGS_INCREMENT, 0, 99, 1, 3);
+    while (p_vcomp_for_dynamic_next(&begin, &end))
+    {
+        for (i = begin; i <= end; i++)
+            local += i;
+    }
+    InterlockedExchangeAdd(sum, local);
+    p_vcomp_barrier();
+}
+
+static void test_parallel_for_overhead(void)
+{
+    int max_threads = pomp_get_max_threads();
+    int i, j, threads;
+    DWORD ticks;
+    LONG sum;
+
+    for (threads = 1; threads <= 8; threads *= 2)
+    {
+        pomp_set_num_threads(threads);
+
+        ticks = GetTickCount();
+        for (i = 0; i < 1000; i++)
+        {
+            sum = 0;
+            p_vcomp_fork(TRUE, 1, parallel_for_cb, &sum);
+            if (sum != 4950) break;
+            for (j = 0; j < 4; j++)
+                parallel_for_cb(&sum);
+            if (sum != 5 * 4950) break;
+        }
+        ticks = GetTickCount() - ticks;
+        ok(i == 1000, "%d threads: got sum %d in region %d\n", threads, sum, i);
+        if (winetest_interactive)
+            trace("%d threads: 1000 parallel regions in %u ms\n", threads, ticks);
+    }
+
+    pomp_set_num_threads(max_threads);
+}
+
 static void CDECL master_cb(HANDLE semaphore)
 {
     int num_threads = pomp_get_num_threads();
@@ -1883,6 +1928,7 @@ START_TEST(vcomp)
     test_vcomp_for_static_simple_init();
     test_vcomp_for_static_init();
     test_vcomp_for_dynamic_init();
+    test_parallel_for_overhead();
     test_vcomp_master_begin();
     test_vcomp_single_begin();
     test_vcomp_enter_critsect();
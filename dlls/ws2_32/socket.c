@@ -26,6 +26,7 @@
  * clients and servers (www.winsite.com got a lot of those).
  */
 
+#define _GNU_SOURCE  /* for recvmmsg and sendmmsg */
 #include "config.h"
 #include "wine/port.h"
 
@@ -67,6 +68,9 @@
 #ifdef HAVE_SYS_SOCKET_H
 #include <sys/socket.h>
 #endif
+#ifdef HAVE_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+#endif
 #ifdef HAVE_NETINET_IN_H
 # include <netinet/in.h>
 #endif
@@ -128,9 +132,15 @@
 #ifdef HAVE_SYS_POLL_H
 # include <sys/poll.h>
 #endif
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
 #ifdef HAVE_SYS_TIME_H
 # include <sys/time.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 
 #define NONAMELESSUNION
 #define NONAMELESSSTRUCT
@@ -158,6 +168,7 @@
 #include "wine/debug.h"
 #include "wine/exception.h"
 #include "wine/unicode.h"
+#include "wine/list.h"
 
 #if defined(linux) && !defined(IP_UNICAST_IF)
 #define IP_UNICAST_IF 50
@@ -520,16 +531,17 @@ struct ws2_accept_async
 
 struct ws2_transmitfile_async
 {
-    struct ws2_async_io   io;
-    char                  *buffer;
-    HANDLE                file;
-    DWORD                 file_read;
-    DWORD                 file_bytes;
-    DWORD                 bytes_per_send;
-    TRANSMIT_FILE_BUFFERS buffers;
-    DWORD                 flags;
-    LARGE_INTEGER         offset;
-    struct ws2_async      write;
+    struct ws2_async_io       io;
+    char                     *buffer;
+    TRANSMIT_PACKETS_ELEMENT *elements;   /* elements to send (head, file and tail for TransmitFile) */
+    DWORD                     count;
+    DWORD                     current;    /* element currently being sent */
+    DWORD                     file_read;  /* bytes of the current file element sent so far */
+    DWORD                     bytes_per_send;
+    DWORD                     flags;
+    BOOL                      use_sendfile;
+    LARGE_INTEGER             offset;
+    struct ws2_async          write;
 };
 
 static struct ws2_async_io *async_io_freelist;
@@ -590,6 +602,7 @@ struct per_thread_data
     int se_len;
     int pe_len;
     char ntoa_buffer[16]; /* 4*3 digits + 3 '.' + 1 '\0' */
+    struct poll_set *poll_set;
 };
 
 /* internal: routing description information */
@@ -613,6 +626,7 @@ int WSAIOCTL_GetInterfaceCount(void);
 int WSAIOCTL_GetInterfaceName(int intNumber, char *intName);
 
 static void WS_AddCompletion( SOCKET sock, ULONG_PTR CompletionValue, NTSTATUS CompletionStatus, ULONG Information );
+static void WS2_rio_close_socket( SOCKET s );
 
 #define MAP_OPTION(opt) { WS_##opt, opt }
 
@@ -1025,6 +1039,7 @@ static inline DWORD NtStatusToWSAError( const DWORD status )
     case STATUS_CONNECTION_DISCONNECTED:    wserr = WSAENOTCONN;           break;
     case STATUS_CONNECTION_RESET:           wserr = WSAECONNRESET;         break;
     case STATUS_CONNECTION_ABORTED:         wserr = WSAECONNABORTED;       break;
+    case STATUS_HANDLES_CLOSED:
     case STATUS_CANCELLED:                  wserr = WSA_OPERATION_ABORTED; break;
     case STATUS_ADDRESS_ALREADY_ASSOCIATED: wserr = WSAEADDRINUSE;         break;
     case STATUS_IO_TIMEOUT:
@@ -1148,6 +1163,181 @@ static int _get_fd_type(int fd)
     return sock_type;
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+
+/* Persistent per-thread epoll set used by WSAPoll.  The set owns a dup of
+ * the unix fd of each socket it watches, so that repeated calls with the
+ * same sockets don't have to look them up and register them again; only
+ * the entries whose events changed are updated.  Sockets closed with
+ * closesocket are removed from all the sets; the others are checked
+ * against the current fd of the handle on every call, since the socket
+ * may have been closed with CloseHandle and the handle reused. */
+
+#define POLL_SET_HASH_SIZE 256
+
+struct poll_entry
+{
+    struct list        entry;       /* entry in the set list */
+    struct list        hash_entry;  /* entry in the hash bucket */
+    SOCKET             socket;
+    int                fd;          /* unix fd owned by the set */
+    dev_t              dev;         /* device and inode of the fd */
+    ino_t              ino;
+    int                events;      /* unix events registered with epoll */
+    unsigned int       generation;  /* last call the socket was polled in */
+    ULONG              index;       /* index in the WSAPOLLFD array of that call */
+};
+
+struct poll_set
+{
+    struct list         entry;      /* entry in poll_sets */
+    CRITICAL_SECTION    cs;
+    int                 epoll_fd;
+    unsigned int        generation;
+    struct list         entries;
+    struct list         hash[POLL_SET_HASH_SIZE];
+    struct epoll_event *events;
+    ULONG               events_size;
+    int                 wake_fd[2]; /* pipe to wake up the waiting thread */
+    WSAPOLLFD          *wfds;       /* array of the current call while waiting */
+    int                 closed;     /* sockets closed while waiting */
+};
+
+static struct list poll_sets = LIST_INIT( poll_sets );
+
+static CRITICAL_SECTION poll_set_cs;
+static CRITICAL_SECTION_DEBUG poll_set_cs_debug =
+{
+    0, 0, &poll_set_cs,
+    { &poll_set_cs_debug.ProcessLocksList, &poll_set_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": poll_set_cs") }
+};
+static CRITICAL_SECTION poll_set_cs = { &poll_set_cs_debug, -1, 0, 0, 0, 0 };
+
+static inline struct list *poll_set_bucket( struct poll_set *set, SOCKET s )
+{
+    return &set->hash[(s >> 2) % POLL_SET_HASH_SIZE];
+}
+
+static struct poll_entry *poll_set_find( struct poll_set *set, SOCKET s )
+{
+    struct poll_entry *entry;
+
+    LIST_FOR_EACH_ENTRY( entry, poll_set_bucket( set, s ), struct poll_entry, hash_entry )
+        if (entry->socket == s) return entry;
+    return NULL;
+}
+
+/* caller must hold the set lock */
+static void poll_set_remove( struct poll_set *set, struct poll_entry *entry )
+{
+    epoll_ctl( set->epoll_fd, EPOLL_CTL_DEL, entry->fd, NULL );
+    close( entry->fd );
+    list_remove( &entry->entry );
+    list_remove( &entry->hash_entry );
+    HeapFree( GetProcessHeap(), 0, entry );
+}
+
+static struct poll_set *create_poll_set(void)
+{
+    struct epoll_event ev;
+    struct poll_set *set;
+    unsigned int i;
+
+    if (!(set = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*set) ))) return NULL;
+    if ((set->epoll_fd = epoll_create( 128 )) == -1)
+    {
+        HeapFree( GetProcessHeap(), 0, set );
+        return NULL;
+    }
+    if (pipe( set->wake_fd ) == -1)
+    {
+        close( set->epoll_fd );
+        HeapFree( GetProcessHeap(), 0, set );
+        return NULL;
+    }
+    fcntl( set->epoll_fd, F_SETFD, FD_CLOEXEC );
+    for (i = 0; i < 2; i++)
+    {
+        fcntl( set->wake_fd[i], F_SETFD, FD_CLOEXEC );
+        fcntl( set->wake_fd[i], F_SETFL, O_NONBLOCK );
+    }
+    /* socket handles are never 0, so that identifies the wake up pipe */
+    ev.events = EPOLLIN;
+    ev.data.u64 = 0;
+    epoll_ctl( set->epoll_fd, EPOLL_CTL_ADD, set->wake_fd[0], &ev );
+    InitializeCriticalSection( &set->cs );
+    set->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": poll_set.cs");
+    list_init( &set->entries );
+    for (i = 0; i < POLL_SET_HASH_SIZE; i++) list_init( &set->hash[i] );
+
+    EnterCriticalSection( &poll_set_cs );
+    list_add_tail( &poll_sets, &set->entry );
+    LeaveCriticalSection( &poll_set_cs );
+    return set;
+}
+
+static void free_poll_set( struct poll_set *set )
+{
+    struct poll_entry *entry, *next;
+
+    if (!set) return;
+
+    EnterCriticalSection( &poll_set_cs );
+    list_remove( &set->entry );
+    LeaveCriticalSection( &poll_set_cs );
+
+    LIST_FOR_EACH_ENTRY_SAFE( entry, next, &set->entries, struct poll_entry, entry )
+        poll_set_remove( set, entry );
+    close( set->epoll_fd );
+    close( set->wake_fd[0] );
+    close( set->wake_fd[1] );
+    set->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection( &set->cs );
+    HeapFree( GetProcessHeap(), 0, set->events );
+    HeapFree( GetProcessHeap(), 0, set );
+}
+
+/* remove a socket that is being closed from all the poll sets */
+static void poll_sets_remove_socket( SOCKET s )
+{
+    struct poll_set *set;
+    struct poll_entry *entry;
+
+    EnterCriticalSection( &poll_set_cs );
+    LIST_FOR_EACH_ENTRY( set, &poll_sets, struct poll_set, entry )
+    {
+        EnterCriticalSection( &set->cs );
+        if ((entry = poll_set_find( set, s )))
+        {
+            /* a thread waiting on the socket gets POLLNVAL for it */
+            if (set->wfds && entry->generation == set->generation)
+            {
+                set->wfds[entry->index].revents = WS_POLLNVAL;
+                set->closed++;
+                write( set->wake_fd[1], "", 1 );
+            }
+            poll_set_remove( set, entry );
+        }
+        LeaveCriticalSection( &set->cs );
+    }
+    LeaveCriticalSection( &poll_set_cs );
+}
+
+#else  /* HAVE_SYS_EPOLL_H */
+
+struct poll_set;
+
+static inline void free_poll_set( struct poll_set *set )
+{
+}
+
+static inline void poll_sets_remove_socket( SOCKET s )
+{
+}
+
+#endif  /* HAVE_SYS_EPOLL_H */
+
 static struct per_thread_data *get_per_thread_data(void)
 {
     struct per_thread_data * ptb = NtCurrentTeb()->WinSockData;
@@ -1173,6 +1363,7 @@ static void free_per_thread_data(void)
     ptb->he_buffer = NULL;
     ptb->se_buffer = NULL;
     ptb->pe_buffer = NULL;
+    free_poll_set( ptb->poll_set );
 
     HeapFree( GetProcessHeap(), 0, ptb );
     NtCurrentTeb()->WinSockData = NULL;
@@ -2659,6 +2850,7 @@ SOCKET WINAPI WS_accept(SOCKET s, struct WS_sockaddr *addr, int *addrlen32)
                 return SOCKET_ERROR;
             }
             TRACE("\taccepted %04lx\n", as);
+            WS2_rio_close_socket(as);
             return as;
         }
         if (is_blocking && status == STATUS_CANT_WAIT)
@@ -2834,6 +3026,101 @@ static NTSTATUS WS2_ReadFile(HANDLE hFile, PIO_STATUS_BLOCK io_status, char* buf
     return status;
 }
 
+/***********************************************************************
+ *     WS2_transmitfile_setelement      (INTERNAL)
+ *
+ * Make the given element the current one of a TransmitFile/TransmitPackets operation.
+ */
+static void WS2_transmitfile_setelement( struct ws2_transmitfile_async *wsa, DWORD index )
+{
+    wsa->current   = index;
+    wsa->file_read = 0;
+    if (index < wsa->count && (wsa->elements[index].dwElFlags & TP_ELEMENT_FILE))
+        wsa->offset = wsa->elements[index].u.s.nFileOffset;
+}
+
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H)
+/***********************************************************************
+ *     WS2_transmitfile_sendfile        (INTERNAL)
+ *
+ * Send a file element directly from the file to the socket, without
+ * copying the data through a user space buffer.
+ *
+ * Returns STATUS_NOT_SUPPORTED when the file and socket combination
+ * cannot be used with sendfile, in which case the caller falls back to
+ * reading the file.
+ */
+static NTSTATUS WS2_transmitfile_sendfile( int fd, struct ws2_transmitfile_async *wsa,
+                                           TRANSMIT_PACKETS_ELEMENT *element )
+{
+    IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)wsa->write.user_overlapped;
+    NTSTATUS status = STATUS_PENDING;
+    int file_fd;
+    off_t pos;
+
+    if (wsa->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
+    {
+        pos = wsa->offset.QuadPart;
+        if (pos != wsa->offset.QuadPart) return STATUS_NOT_SUPPORTED;
+    }
+
+    if ((status = wine_server_handle_to_fd( element->u.s.hFile, FILE_READ_DATA, &file_fd, NULL )))
+        return status;
+
+    for (;;)
+    {
+        DWORD count = wsa->bytes_per_send;
+        ssize_t n;
+
+        /* when the size of the transfer is limited ensure that we don't go past that limit */
+        if (element->cLength)
+        {
+            if (wsa->file_read >= element->cLength)
+            {
+                status = STATUS_END_OF_FILE;
+                break;
+            }
+            count = min( count, element->cLength - wsa->file_read );
+        }
+
+        if (wsa->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
+            n = sendfile( fd, file_fd, &pos, count );
+        else
+            n = sendfile( fd, file_fd, NULL, count );
+
+        if (n > 0)
+        {
+            if (wsa->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
+                wsa->offset.QuadPart = pos;
+            wsa->file_read += n;
+            if (iosb) iosb->Information += n;
+            continue;
+        }
+        if (!n)
+            status = STATUS_END_OF_FILE;
+        else if (errno == EINTR)
+            continue;
+        else if (errno == EAGAIN)
+            status = STATUS_PENDING;
+        else if ((errno == EINVAL || errno == ENOSYS) && !wsa->file_read)
+            status = STATUS_NOT_SUPPORTED;
+        else
+            status = wsaErrStatus();
+        break;
+    }
+
+    wine_server_release_fd( element->u.s.hFile, file_fd );
+
+    if (status == STATUS_END_OF_FILE)
+    {
+        /* continue on to the next element */
+        WS2_transmitfile_setelement( wsa, wsa->current + 1 );
+        status = STATUS_PENDING;
+    }
+    return status;
+}
+#endif
+
 /***********************************************************************
  *     WS2_transmitfile_getbuffer       (INTERNAL)
  *
@@ -2845,236 +3132,1219 @@ static NTSTATUS WS2_transmitfile_getbuffer( int fd, struct ws2_transmitfile_asyn
     if (wsa->write.first_iovec < wsa->write.n_iovecs)
         return STATUS_PENDING;
 
-    /* process the header (if applicable) */
-    if (wsa->buffers.Head)
-    {
-        wsa->write.first_iovec       = 0;
-        wsa->write.n_iovecs          = 1;
-        wsa->write.iovec[0].iov_base = wsa->buffers.Head;
-        wsa->write.iovec[0].iov_len  = wsa->buffers.HeadLength;
-        wsa->buffers.Head            = NULL;
-        return STATUS_PENDING;
-    }
+    wsa->write.first_iovec = 0;
+    wsa->write.n_iovecs    = 0;
 
-    /* process the main file */
-    if (wsa->file)
+    while (wsa->current < wsa->count)
     {
-        DWORD bytes_per_send = wsa->bytes_per_send;
-        IO_STATUS_BLOCK iosb;
-        NTSTATUS status;
+        TRANSMIT_PACKETS_ELEMENT *element = &wsa->elements[wsa->current];
 
-        iosb.Information = 0;
-        /* when the size of the transfer is limited ensure that we don't go past that limit */
-        if (wsa->file_bytes != 0)
-            bytes_per_send = min(bytes_per_send, wsa->file_bytes - wsa->file_read);
-        status = WS2_ReadFile( wsa->file, &iosb, wsa->buffer, bytes_per_send, &wsa->offset );
-        if (wsa->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
-            wsa->offset.QuadPart += iosb.Information;
-        if (status == STATUS_END_OF_FILE)
-            wsa->file = NULL; /* continue on to the footer */
-        else if (status != STATUS_SUCCESS)
-            return status;
-        else
+        /* process a memory buffer (the TransmitFile header and footer) */
+        if (element->dwElFlags & TP_ELEMENT_MEMORY)
+        {
+            WS2_transmitfile_setelement( wsa, wsa->current + 1 );
+            if (!element->cLength) continue;
+
+            wsa->write.n_iovecs          = 1;
+            wsa->write.iovec[0].iov_base = element->u.pBuffer;
+            wsa->write.iovec[0].iov_len  = element->cLength;
+            return STATUS_PENDING;
+        }
+
+        /* process a file */
+        if (element->dwElFlags & TP_ELEMENT_FILE)
         {
+            DWORD bytes_per_send = wsa->bytes_per_send;
+            IO_STATUS_BLOCK iosb;
+            NTSTATUS status;
+
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H)
+            if (wsa->use_sendfile)
+            {
+                status = WS2_transmitfile_sendfile( fd, wsa, element );
+                if (status != STATUS_NOT_SUPPORTED)
+                    return status;
+                TRACE("sendfile not supported, falling back to read\n");
+                wsa->use_sendfile = FALSE;
+            }
+#endif
+
+            iosb.Information = 0;
+            /* when the size of the transfer is limited ensure that we don't go past that limit */
+            if (element->cLength != 0)
+                bytes_per_send = min(bytes_per_send, element->cLength - wsa->file_read);
+            status = WS2_ReadFile( element->u.s.hFile, &iosb, wsa->buffer, bytes_per_send, &wsa->offset );
+            if (wsa->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
+                wsa->offset.QuadPart += iosb.Information;
+            if (status == STATUS_END_OF_FILE)
+            {
+                /* continue on to the next element */
+                WS2_transmitfile_setelement( wsa, wsa->current + 1 );
+                continue;
+            }
+            if (status != STATUS_SUCCESS)
+                return status;
+
             if (iosb.Information)
             {
-                wsa->write.first_iovec       = 0;
                 wsa->write.n_iovecs          = 1;
                 wsa->write.iovec[0].iov_base = wsa->buffer;
                 wsa->write.iovec[0].iov_len  = iosb.Information;
                 wsa->file_read += iosb.Information;
             }
 
-            if (wsa->file_bytes != 0 && wsa->file_read >= wsa->file_bytes)
-                wsa->file = NULL;
+            if (element->cLength != 0 && wsa->file_read >= element->cLength)
+                WS2_transmitfile_setelement( wsa, wsa->current + 1 );
+
+            return STATUS_PENDING;
+        }
+
+        /* nothing to send for a plain end-of-packet marker */
+        WS2_transmitfile_setelement( wsa, wsa->current + 1 );
+    }
+
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *     WS2_transmitfile_base            (INTERNAL)
+ *
+ * Shared implementation for both synchronous and asynchronous TransmitFile.
+ */
+static NTSTATUS WS2_transmitfile_base( int fd, struct ws2_transmitfile_async *wsa )
+{
+    NTSTATUS status;
+
+    status = WS2_transmitfile_getbuffer( fd, wsa );
+    if (status == STATUS_PENDING && wsa->write.first_iovec < wsa->write.n_iovecs)
+    {
+        IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)wsa->write.user_overlapped;
+        int n;
+
+        n = WS2_send( fd, &wsa->write, convert_flags(wsa->write.flags) );
+        if (n >= 0)
+        {
+            if (iosb) iosb->Information += n;
+        }
+        else if (errno != EAGAIN)
+            return wsaErrStatus();
+    }
+
+    return status;
+}
+
+/***********************************************************************
+ *     WS2_async_transmitfile           (INTERNAL)
+ *
+ * Asynchronous callback for overlapped TransmitFile operations.
+ */
+static NTSTATUS WS2_async_transmitfile( void *user, IO_STATUS_BLOCK *iosb,
+                                        NTSTATUS status, void **apc, void **arg )
+{
+    struct ws2_transmitfile_async *wsa = user;
+    int fd;
+
+    if (status == STATUS_ALERTED)
+    {
+        if (!(status = wine_server_handle_to_fd( wsa->write.hSocket, FILE_WRITE_DATA, &fd, NULL )))
+        {
+            status = WS2_transmitfile_base( fd, wsa );
+            wine_server_release_fd( wsa->write.hSocket, fd );
+        }
+        if (status == STATUS_PENDING)
+            return status;
+    }
+
+    iosb->u.Status = status;
+    release_async_io( &wsa->io );
+    return status;
+}
+
+/***********************************************************************
+ *     WS2_transmitfile_alloc           (INTERNAL)
+ *
+ * Allocate the state of a TransmitFile/TransmitPackets operation, with room
+ * for the given number of elements and a bytes_per_send sized buffer.
+ */
+static struct ws2_transmitfile_async *WS2_transmitfile_alloc( SOCKET s, DWORD count, DWORD bytes_per_send,
+                                                              LPOVERLAPPED overlapped, DWORD flags )
+{
+    struct ws2_transmitfile_async *wsa;
+
+    if (!(wsa = (struct ws2_transmitfile_async *)alloc_async_io( sizeof(*wsa) + count * sizeof(*wsa->elements)
+                                                                 + bytes_per_send )))
+        return NULL;
+
+    wsa->elements              = (TRANSMIT_PACKETS_ELEMENT *)(wsa + 1);
+    wsa->buffer                = (char *)(wsa->elements + count);
+    wsa->count                 = count;
+    wsa->current               = 0;
+    wsa->file_read             = 0;
+    wsa->bytes_per_send        = bytes_per_send;
+    wsa->flags                 = flags;
+    wsa->use_sendfile          = TRUE;
+    wsa->offset.QuadPart       = FILE_USE_FILE_POINTER_POSITION;
+    wsa->write.hSocket         = SOCKET2HANDLE(s);
+    wsa->write.addr            = NULL;
+    wsa->write.addrlen.val     = 0;
+    wsa->write.flags           = 0;
+    wsa->write.lpFlags         = &wsa->flags;
+    wsa->write.control         = NULL;
+    wsa->write.n_iovecs        = 0;
+    wsa->write.first_iovec     = 0;
+    wsa->write.user_overlapped = overlapped;
+    return wsa;
+}
+
+/***********************************************************************
+ *     WS2_transmitfile_run             (INTERNAL)
+ *
+ * Start a TransmitFile/TransmitPackets operation, either queuing it for
+ * overlapped completion or sending everything before returning.
+ */
+static BOOL WS2_transmitfile_run( SOCKET s, int fd, struct ws2_transmitfile_async *wsa,
+                                  LPOVERLAPPED overlapped )
+{
+    NTSTATUS status;
+
+    WS2_transmitfile_setelement( wsa, 0 );
+
+    if (overlapped)
+    {
+        IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)overlapped;
+
+        iosb->u.Status = STATUS_PENDING;
+        iosb->Information = 0;
+        SERVER_START_REQ( register_async )
+        {
+            req->type           = ASYNC_TYPE_WRITE;
+            req->async.handle   = wine_server_obj_handle( SOCKET2HANDLE(s) );
+            req->async.event    = wine_server_obj_handle( overlapped->hEvent );
+            req->async.callback = wine_server_client_ptr( WS2_async_transmitfile );
+            req->async.iosb     = wine_server_client_ptr( iosb );
+            req->async.arg      = wine_server_client_ptr( wsa );
+            status = wine_server_call( req );
+        }
+        SERVER_END_REQ;
+
+        if(status != STATUS_PENDING) HeapFree( GetProcessHeap(), 0, wsa );
+        release_sock_fd( s, fd );
+        WSASetLastError( NtStatusToWSAError(status) );
+        return FALSE;
+    }
+
+    do
+    {
+        status = WS2_transmitfile_base( fd, wsa );
+        if (status == STATUS_PENDING)
+        {
+            /* block here */
+            do_block(fd, POLLOUT, -1);
+            _sync_sock_state(s); /* let wineserver notice connection */
+        }
+    }
+    while (status == STATUS_PENDING);
+    release_sock_fd( s, fd );
+
+    if (status != STATUS_SUCCESS)
+        WSASetLastError( NtStatusToWSAError(status) );
+    HeapFree( GetProcessHeap(), 0, wsa );
+    return (status == STATUS_SUCCESS);
+}
+
+/***********************************************************************
+ *     TransmitFile
+ */
+static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE h, DWORD file_bytes, DWORD bytes_per_send,
+                                     LPOVERLAPPED overlapped, LPTRANSMIT_FILE_BUFFERS buffers,
+                                     DWORD flags )
+{
+    union generic_unix_sockaddr uaddr;
+    unsigned int uaddrlen = sizeof(uaddr);
+    struct ws2_transmitfile_async *wsa;
+    TRANSMIT_PACKETS_ELEMENT *element;
+    int fd;
+
+    TRACE("(%lx, %p, %d, %d, %p, %p, %d)\n", s, h, file_bytes, bytes_per_send, overlapped,
+            buffers, flags );
+
+    fd = get_sock_fd( s, FILE_WRITE_DATA, NULL );
+    if (fd == -1)
+    {
+        WSASetLastError( WSAENOTSOCK );
+        return FALSE;
+    }
+    if (getpeername( fd, &uaddr.addr, &uaddrlen ) != 0)
+    {
+        release_sock_fd( s, fd );
+        WSASetLastError( WSAENOTCONN );
+        return FALSE;
+    }
+    if (flags)
+        FIXME("Flags are not currently supported (0x%x).\n", flags);
+
+    if (h && GetFileType( h ) != FILE_TYPE_DISK)
+    {
+        FIXME("Non-disk file handles are not currently supported.\n");
+        release_sock_fd( s, fd );
+        WSASetLastError( WSAEOPNOTSUPP );
+        return FALSE;
+    }
+
+    /* set reasonable defaults when requested */
+    if (!bytes_per_send)
+        bytes_per_send = (1 << 16); /* Depends on OS version: PAGE_SIZE, 2*PAGE_SIZE, or 2^16 */
+
+    if (!(wsa = WS2_transmitfile_alloc( s, 3, bytes_per_send, overlapped, flags )))
+    {
+        release_sock_fd( s, fd );
+        WSASetLastError( WSAEFAULT );
+        return FALSE;
+    }
+
+    /* describe the header, file and footer as TransmitPackets elements */
+    element = wsa->elements;
+    memset( element, 0, 3 * sizeof(*element) );
+    if (buffers && buffers->Head)
+    {
+        element->dwElFlags = TP_ELEMENT_MEMORY;
+        element->cLength   = buffers->HeadLength;
+        element->u.pBuffer = buffers->Head;
+        element++;
+    }
+    if (h)
+    {
+        element->dwElFlags   = TP_ELEMENT_FILE;
+        element->cLength     = file_bytes;
+        element->u.s.hFile   = h;
+        if (overlapped)
+        {
+            element->u.s.nFileOffset.u.LowPart  = overlapped->u.s.Offset;
+            element->u.s.nFileOffset.u.HighPart = overlapped->u.s.OffsetHigh;
+        }
+        else
+            element->u.s.nFileOffset.QuadPart = FILE_USE_FILE_POINTER_POSITION;
+        element++;
+    }
+    if (buffers && buffers->Tail)
+    {
+        element->dwElFlags = TP_ELEMENT_MEMORY;
+        element->cLength   = buffers->TailLength;
+        element->u.pBuffer = buffers->Tail;
+        element++;
+    }
+    wsa->count = element - wsa->elements;
+
+    return WS2_transmitfile_run( s, fd, wsa, overlapped );
+}
+
+/***********************************************************************
+ *     TransmitPackets
+ */
+static BOOL WINAPI WS2_TransmitPackets( SOCKET s, LPTRANSMIT_PACKETS_ELEMENT elements, DWORD count,
+                                        DWORD send_size, LPOVERLAPPED overlapped, DWORD flags )
+{
+    union generic_unix_sockaddr uaddr;
+    unsigned int uaddrlen = sizeof(uaddr);
+    struct ws2_transmitfile_async *wsa;
+    DWORD i;
+    int fd;
+
+    TRACE("(%lx, %p, %d, %d, %p, %d)\n", s, elements, count, send_size, overlapped, flags );
+
+    fd = get_sock_fd( s, FILE_WRITE_DATA, NULL );
+    if (fd == -1)
+    {
+        WSASetLastError( WSAENOTSOCK );
+        return FALSE;
+    }
+    if (getpeername( fd, &uaddr.addr, &uaddrlen ) != 0)
+    {
+        release_sock_fd( s, fd );
+        WSASetLastError( WSAENOTCONN );
+        return FALSE;
+    }
+    if (count && !elements)
+    {
+        release_sock_fd( s, fd );
+        WSASetLastError( WSAEFAULT );
+        return FALSE;
+    }
+    if (flags)
+        FIXME("Flags are not currently supported (0x%x).\n", flags);
+
+    for (i = 0; i < count; i++)
+    {
+        DWORD type = elements[i].dwElFlags & (TP_ELEMENT_MEMORY | TP_ELEMENT_FILE);
+
+        if (type == (TP_ELEMENT_MEMORY | TP_ELEMENT_FILE) ||
+            (elements[i].dwElFlags & ~(TP_ELEMENT_MEMORY | TP_ELEMENT_FILE | TP_ELEMENT_EOP)))
+        {
+            release_sock_fd( s, fd );
+            WSASetLastError( WSAEINVAL );
+            return FALSE;
+        }
+        if (type == TP_ELEMENT_FILE && GetFileType( elements[i].u.s.hFile ) != FILE_TYPE_DISK)
+        {
+            FIXME("Non-disk file handles are not currently supported.\n");
+            release_sock_fd( s, fd );
+            WSASetLastError( WSAEOPNOTSUPP );
+            return FALSE;
+        }
+    }
+
+    /* set reasonable defaults when requested */
+    if (!send_size)
+        send_size = (1 << 16);
+
+    if (!(wsa = WS2_transmitfile_alloc( s, count, send_size, overlapped, flags )))
+    {
+        release_sock_fd( s, fd );
+        WSASetLastError( WSAEFAULT );
+        return FALSE;
+    }
+
+    memcpy( wsa->elements, elements, count * sizeof(*elements) );
+    for (i = 0; i < count; i++)
+    {
+        /* an offset of -1 means the current file position */
+        if ((wsa->elements[i].dwElFlags & TP_ELEMENT_FILE) && wsa->elements[i].u.s.nFileOffset.QuadPart == -1)
+            wsa->elements[i].u.s.nFileOffset.QuadPart = FILE_USE_FILE_POINTER_POSITION;
+    }
+
+    return WS2_transmitfile_run( s, fd, wsa, overlapped );
+}
+
+/***********************************************************************
+ *     Registered I/O
+ *
+ * Request queues keep the posted requests of a socket in a ring, and the
+ * results are stored in user mode completion queues.  Buffers are checked
+ * once when they are registered, requests only check their offset and
+ * length.  The socket is read and written in batches with recvmmsg and
+ * sendmmsg, and an async is only queued when the socket isn't ready.
+ * Sends on stream sockets are done one at a time, since a partial write
+ * would make sendmmsg go on with the next requests.
+ */
+
+#define RIO_BATCH_SIZE  32
+
+struct ws2_rio_buffer
+{
+    char                        *data;
+    DWORD                        length;
+};
+
+struct ws2_rio_cq
+{
+    CRITICAL_SECTION             cs;
+    RIORESULT                   *results;   /* ring of completed requests */
+    DWORD                        size;
+    DWORD                        head;      /* index of the oldest result */
+    DWORD                        count;     /* number of results in the ring */
+    DWORD                        reserved;  /* slots reserved by the request queues */
+    RIO_NOTIFICATION_COMPLETION  notify;
+    BOOL                         armed;     /* RIONotify was called and hasn't fired yet */
+    BOOL                         closed;    /* closed while request queues still use it */
+};
+
+struct ws2_rio_request
+{
+    RIO_BUF                      data;
+    RIO_BUF                      addr;      /* remote address, BufferId is NULL if not used */
+    ULONG                        done;      /* bytes already sent on a stream socket */
+    DWORD                        flags;
+    PVOID                        context;
+};
+
+struct ws2_rio_queue
+{
+    struct ws2_rio_rq           *rq;
+    struct ws2_rio_cq           *cq;
+    struct ws2_rio_request      *requests;  /* ring of outstanding requests */
+    ULONG                        size;
+    ULONG                        head;
+    ULONG                        count;
+    ULONG                        committed; /* requests which may be started, the others were deferred */
+    BOOL                         async;     /* an async is queued to wait for the socket */
+    IO_STATUS_BLOCK              iosb;
+};
+
+struct ws2_rio_rq
+{
+    struct list                  entry;     /* entry in rio_request_queues */
+    CRITICAL_SECTION             cs;
+    SOCKET                       socket;
+    ULONGLONG                    context;
+    BOOL                         stream;    /* the socket is a stream socket */
+    BOOL                         closed;    /* the socket has been closed */
+    struct ws2_rio_queue         queue[2];  /* receive and send queues */
+};
+
+static struct list rio_request_queues = LIST_INIT( rio_request_queues );
+
+static CRITICAL_SECTION rio_cs;
+static CRITICAL_SECTION_DEBUG rio_cs_debug =
+{
+    0, 0, &rio_cs,
+    { &rio_cs_debug.ProcessLocksList, &rio_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": rio_cs") }
+};
+static CRITICAL_SECTION rio_cs = { &rio_cs_debug, -1, 0, 0, 0, 0 };
+
+static NTSTATUS WS2_async_rio( void *user, IO_STATUS_BLOCK *iosb, NTSTATUS status, void **apc, void **arg );
+
+/* check that a RIO_BUF lies within its registered buffer, and return its data */
+static char *WS2_rio_buf_data( const RIO_BUF *buf )
+{
+    const struct ws2_rio_buffer *buffer = (const struct ws2_rio_buffer *)buf->BufferId;
+
+    if (!buffer || buf->BufferId == RIO_INVALID_BUFFERID) return NULL;
+    if (buf->Offset > buffer->length || buf->Length > buffer->length - buf->Offset) return NULL;
+    return buffer->data + buf->Offset;
+}
+
+static void WS2_rio_fire_notification( struct ws2_rio_cq *cq )
+{
+    if (cq->notify.Type == RIO_EVENT_COMPLETION)
+        SetEvent( cq->notify.u.Event.EventHandle );
+    else
+        PostQueuedCompletionStatus( cq->notify.u.Iocp.IocpHandle, 0, (ULONG_PTR)cq->notify.u.Iocp.CompletionKey,
+                                    cq->notify.u.Iocp.Overlapped );
+}
+
+/* complete the oldest request of a queue; caller must hold the request queue lock */
+static void WS2_rio_complete( struct ws2_rio_queue *queue, LONG status, ULONG bytes )
+{
+    struct ws2_rio_request *req = &queue->requests[queue->head];
+    struct ws2_rio_cq *cq = queue->cq;
+    BOOL fire = FALSE;
+
+    EnterCriticalSection( &cq->cs );
+    if (cq->count < cq->size)
+    {
+        RIORESULT *result = &cq->results[(cq->head + cq->count) % cq->size];
+
+        result->Status           = status;
+        result->BytesTransferred = bytes;
+        result->SocketContext    = queue->rq->context;
+        result->RequestContext   = (ULONG_PTR)req->context;
+        cq->count++;
+    }
+    else ERR( "completion queue %p overflow\n", cq );
+    if (cq->armed && !cq->closed && !(req->flags & RIO_MSG_DONT_NOTIFY))
+    {
+        cq->armed = FALSE;
+        fire = TRUE;
+    }
+    LeaveCriticalSection( &cq->cs );
+
+    queue->head = (queue->head + 1) % queue->size;
+    queue->count--;
+    if (queue->committed) queue->committed--;
+
+    if (fire) WS2_rio_fire_notification( cq );
+}
+
+/* run as many committed requests as the socket allows; caller must hold the request queue lock */
+static NTSTATUS WS2_rio_process( struct ws2_rio_queue *queue, int fd )
+{
+    BOOL is_send = (queue == &queue->rq->queue[1]);
+    union generic_unix_sockaddr addrs[RIO_BATCH_SIZE];
+    struct iovec iov[RIO_BATCH_SIZE];
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+    struct mmsghdr msgs[RIO_BATCH_SIZE];
+#else
+    struct { struct msghdr msg_hdr; unsigned int msg_len; } msgs[RIO_BATCH_SIZE];
+#endif
+    unsigned int i, count;
+    int ret;
+
+    while (queue->committed)
+    {
+        count = min( queue->committed, (is_send && queue->rq->stream) ? 1 : RIO_BATCH_SIZE );
+        for (i = 0; i < count; i++)
+        {
+            struct ws2_rio_request *req = &queue->requests[(queue->head + i) % queue->size];
+            char *addr;
+
+            memset( &msgs[i], 0, sizeof(msgs[i]) );
+            iov[i].iov_base = WS2_rio_buf_data( &req->data ) + req->done;
+            iov[i].iov_len  = req->data.Length - req->done;
+            msgs[i].msg_hdr.msg_iov    = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            if (!(addr = WS2_rio_buf_data( &req->addr ))) continue;
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            if (!is_send)
+                msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+            else if (!(msgs[i].msg_hdr.msg_namelen = ws_sockaddr_ws2u( (struct WS_sockaddr *)addr,
+                                                                        req->addr.Length, &addrs[i] )))
+            {
+                /* fail the request once the ones before it are done */
+                count = i;
+                if (!i) WS2_rio_complete( queue, WSAEFAULT, 0 );
+                break;
+            }
+        }
+        if (!count) continue;
+
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+        if (is_send)
+            ret = sendmmsg( fd, msgs, count, MSG_DONTWAIT );
+        else
+            ret = recvmmsg( fd, msgs, count, MSG_DONTWAIT, NULL );
+#else
+        for (ret = 0; ret < count; ret++)
+        {
+            int n = is_send ? sendmsg( fd, &msgs[ret].msg_hdr, MSG_DONTWAIT )
+                            : recvmsg( fd, &msgs[ret].msg_hdr, MSG_DONTWAIT );
+            if (n == -1)
+            {
+                if (!ret) ret = -1;
+                break;
+            }
+            msgs[ret].msg_len = n;
+        }
+#endif
+        if (ret == -1)
+        {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) return STATUS_PENDING;
+            WS2_rio_complete( queue, wsaErrno(), 0 );
+            continue;
+        }
+
+        for (i = 0; i < ret; i++)
+        {
+            struct ws2_rio_request *req = &queue->requests[queue->head];
+
+            if (is_send && msgs[i].msg_len < iov[i].iov_len)
+            {
+                /* partial write on a stream socket, the rest is sent when it's writable again */
+                req->done += msgs[i].msg_len;
+                return STATUS_PENDING;
+            }
+            if (!is_send && req->addr.BufferId && msgs[i].msg_hdr.msg_namelen)
+            {
+                int len = req->addr.Length;
+                ws_sockaddr_u2ws( &addrs[i].addr, (struct WS_sockaddr *)WS2_rio_buf_data( &req->addr ), &len );
+            }
+            WS2_rio_complete( queue, 0, req->done + msgs[i].msg_len );
+        }
+    }
+    return STATUS_SUCCESS;
+}
+
+/* complete all the outstanding requests of a queue with an error */
+static void WS2_rio_abort( struct ws2_rio_queue *queue, LONG status )
+{
+    queue->committed = queue->count;
+    while (queue->count) WS2_rio_complete( queue, status, 0 );
+}
+
+static void WS2_rio_free_cq( struct ws2_rio_cq *cq )
+{
+    cq->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection( &cq->cs );
+    HeapFree( GetProcessHeap(), 0, cq->results );
+    HeapFree( GetProcessHeap(), 0, cq );
+}
+
+static void WS2_rio_free_rq( struct ws2_rio_rq *rq )
+{
+    unsigned int i;
+    BOOL free_cq;
+
+    for (i = 0; i < 2; i++)
+    {
+        struct ws2_rio_cq *cq = rq->queue[i].cq;
+
+        EnterCriticalSection( &cq->cs );
+        cq->reserved -= rq->queue[i].size;
+        free_cq = cq->closed && !cq->reserved;
+        LeaveCriticalSection( &cq->cs );
+        /* the completion queue was closed while this request queue used it */
+        if (free_cq) WS2_rio_free_cq( cq );
+        HeapFree( GetProcessHeap(), 0, rq->queue[i].requests );
+    }
+    rq->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection( &rq->cs );
+    HeapFree( GetProcessHeap(), 0, rq );
+}
+
+/* start the committed requests of a queue, or wait for the socket if it isn't ready */
+static void WS2_rio_start( struct ws2_rio_queue *queue )
+{
+    struct ws2_rio_rq *rq = queue->rq;
+    NTSTATUS status = STATUS_SUCCESS;
+    BOOL is_send = (queue == &rq->queue[1]);
+    async_data_t async;
+    int fd;
+
+    if (queue->async || !queue->committed) return;
+
+    if ((fd = get_sock_fd( rq->socket, is_send ? FILE_WRITE_DATA : FILE_READ_DATA, NULL )) == -1)
+    {
+        WS2_rio_abort( queue, WSAENOTSOCK );
+        return;
+    }
+    status = WS2_rio_process( queue, fd );
+    release_sock_fd( rq->socket, fd );
+    if (status != STATUS_PENDING) return;
+
+    /* queued outside of the lock, the async may run right away on another thread */
+    queue->async = TRUE;
+    LeaveCriticalSection( &rq->cs );
+
+    memset( &async, 0, sizeof(async) );
+    async.handle   = wine_server_obj_handle( SOCKET2HANDLE(rq->socket) );
+    async.callback = wine_server_client_ptr( WS2_async_rio );
+    async.iosb     = wine_server_client_ptr( &queue->iosb );
+    async.arg      = wine_server_client_ptr( queue );
+    status = wine_server_register_async( is_send ? ASYNC_TYPE_WRITE : ASYNC_TYPE_READ, &async );
+    if (is_send) _enable_event( SOCKET2HANDLE(rq->socket), FD_WRITE, 0, 0 );
+    else _enable_event( SOCKET2HANDLE(rq->socket), FD_READ, 0, 0 );
+
+    EnterCriticalSection( &rq->cs );
+    if (status != STATUS_PENDING)
+    {
+        queue->async = FALSE;
+        WS2_rio_abort( queue, NtStatusToWSAError( status ) );
+    }
+}
+
+/* abort a request queue whose socket has been closed; caller must hold rio_cs */
+static void WS2_rio_close_rq( struct ws2_rio_rq *rq )
+{
+    BOOL free_rq;
+
+    list_remove( &rq->entry );
+    list_init( &rq->entry );
+
+    EnterCriticalSection( &rq->cs );
+    rq->closed = TRUE;
+    if (!rq->queue[0].async) WS2_rio_abort( &rq->queue[0], WSA_OPERATION_ABORTED );
+    if (!rq->queue[1].async) WS2_rio_abort( &rq->queue[1], WSA_OPERATION_ABORTED );
+    free_rq = !rq->queue[0].async && !rq->queue[1].async;
+    LeaveCriticalSection( &rq->cs );
+    /* otherwise the last async frees it when it gets cancelled */
+    if (free_rq) WS2_rio_free_rq( rq );
+}
+
+/***********************************************************************
+ *     WS2_async_rio                    (INTERNAL)
+ *
+ * Handler for the asyncs of the registered I/O request queues.
+ */
+static NTSTATUS WS2_async_rio( void *user, IO_STATUS_BLOCK *iosb, NTSTATUS status, void **apc, void **arg )
+{
+    struct ws2_rio_queue *queue = user;
+    struct ws2_rio_rq *rq = queue->rq;
+    BOOL is_send = (queue == &rq->queue[1]);
+    BOOL free_rq;
+    int fd;
+
+    if (status == STATUS_HANDLES_CLOSED)
+    {
+        /* the socket may have been closed with CloseHandle instead of closesocket */
+        EnterCriticalSection( &rio_cs );
+        if (!list_empty( &rq->entry )) WS2_rio_close_rq( rq );
+        LeaveCriticalSection( &rio_cs );
+    }
+
+    EnterCriticalSection( &rq->cs );
+    if (status == STATUS_ALERTED)
+    {
+        if (!(status = wine_server_handle_to_fd( SOCKET2HANDLE(rq->socket), is_send ? FILE_WRITE_DATA : FILE_READ_DATA,
+                                                 &fd, NULL )))
+        {
+            status = WS2_rio_process( queue, fd );
+            wine_server_release_fd( SOCKET2HANDLE(rq->socket), fd );
+        }
+        if (status == STATUS_PENDING)
+        {
+            _enable_event( SOCKET2HANDLE(rq->socket), is_send ? FD_WRITE : FD_READ, 0, 0 );
+            LeaveCriticalSection( &rq->cs );
+            return status;
+        }
+    }
+    if (status) WS2_rio_abort( queue, NtStatusToWSAError( status ) );
+    queue->async = FALSE;
+    iosb->u.Status = status;
+    iosb->Information = 0;
+
+    free_rq = rq->closed && !rq->queue[0].async && !rq->queue[1].async;
+    LeaveCriticalSection( &rq->cs );
+    if (free_rq) WS2_rio_free_rq( rq );
+    return status;
+}
+
+/* abort the request queues of a socket that is being closed, or of a socket that
+ * was closed with CloseHandle and whose handle value is being reused */
+static void WS2_rio_close_socket( SOCKET s )
+{
+    struct ws2_rio_rq *rq, *next;
+
+    if (list_empty( &rio_request_queues )) return;
+
+    EnterCriticalSection( &rio_cs );
+    LIST_FOR_EACH_ENTRY_SAFE( rq, next, &rio_request_queues, struct ws2_rio_rq, entry )
+        if (rq->socket == s) WS2_rio_close_rq( rq );
+    LeaveCriticalSection( &rio_cs );
+}
+
+/* queue a request on a request queue */
+static BOOL WS2_rio_post( RIO_RQ queue_handle, BOOL is_send, PRIO_BUF data, ULONG count,
+                          PRIO_BUF addr, DWORD flags, PVOID context )
+{
+    struct ws2_rio_rq *rq = (struct ws2_rio_rq *)queue_handle;
+    struct ws2_rio_queue *queue;
+    struct ws2_rio_request *req;
+
+    if (!rq)
+    {
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+    if (flags & ~(RIO_MSG_DONT_NOTIFY | RIO_MSG_DEFER | RIO_MSG_WAITALL | RIO_MSG_COMMIT_ONLY) ||
+        ((flags & RIO_MSG_COMMIT_ONLY) && (flags & ~RIO_MSG_COMMIT_ONLY)) ||
+        (!(flags & RIO_MSG_COMMIT_ONLY) && (count > 1 || (count && !WS2_rio_buf_data( data )))) ||
+        (addr && addr->BufferId && !WS2_rio_buf_data( addr )))
+    {
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+    if (flags & RIO_MSG_WAITALL) FIXME( "RIO_MSG_WAITALL not supported\n" );
+
+    queue = &rq->queue[is_send];
+    EnterCriticalSection( &rq->cs );
+    if (!(flags & RIO_MSG_COMMIT_ONLY))
+    {
+        if (queue->count == queue->size)
+        {
+            LeaveCriticalSection( &rq->cs );
+            SetLastError( WSAENOBUFS );
+            return FALSE;
+        }
+        req = &queue->requests[(queue->head + queue->count) % queue->size];
+        memset( req, 0, sizeof(*req) );
+        if (count) req->data = *data;
+        if (addr) req->addr = *addr;
+        req->flags   = flags;
+        req->context = context;
+        queue->count++;
+    }
+    if (!(flags & RIO_MSG_DEFER))
+    {
+        queue->committed = queue->count;
+        WS2_rio_start( queue );
+    }
+    LeaveCriticalSection( &rq->cs );
+    return TRUE;
+}
+
+/***********************************************************************
+ *     RIORegisterBuffer
+ */
+static RIO_BUFFERID WINAPI WS2_RIORegisterBuffer( PCHAR data, DWORD length )
+{
+    struct ws2_rio_buffer *buffer;
+
+    TRACE( "(%p, %u)\n", data, length );
+
+    if (!data || IsBadWritePtr( data, length ))
+    {
+        SetLastError( WSAEFAULT );
+        return RIO_INVALID_BUFFERID;
+    }
+    if (!(buffer = HeapAlloc( GetProcessHeap(), 0, sizeof(*buffer) )))
+    {
+        SetLastError( WSAENOBUFS );
+        return RIO_INVALID_BUFFERID;
+    }
+    buffer->data   = data;
+    buffer->length = length;
+    return (RIO_BUFFERID)buffer;
+}
+
+/***********************************************************************
+ *     RIODeregisterBuffer
+ */
+static void WINAPI WS2_RIODeregisterBuffer( RIO_BUFFERID id )
+{
+    TRACE( "(%p)\n", id );
+
+    if (id && id != RIO_INVALID_BUFFERID) HeapFree( GetProcessHeap(), 0, id );
+}
+
+/***********************************************************************
+ *     RIOCreateCompletionQueue
+ */
+static RIO_CQ WINAPI WS2_RIOCreateCompletionQueue( DWORD size, PRIO_NOTIFICATION_COMPLETION notify )
+{
+    struct ws2_rio_cq *cq;
+
+    TRACE( "(%u, %p)\n", size, notify );
+
+    if (!size || size > RIO_MAX_CQ_SIZE ||
+        (notify && notify->Type != RIO_EVENT_COMPLETION && notify->Type != RIO_IOCP_COMPLETION))
+    {
+        SetLastError( WSAEINVAL );
+        return RIO_INVALID_CQ;
+    }
+    if (!(cq = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cq) )) ||
+        !(cq->results = HeapAlloc( GetProcessHeap(), 0, size * sizeof(*cq->results) )))
+    {
+        HeapFree( GetProcessHeap(), 0, cq );
+        SetLastError( WSAENOBUFS );
+        return RIO_INVALID_CQ;
+    }
+    InitializeCriticalSection( &cq->cs );
+    cq->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": ws2_rio_cq.cs");
+    cq->size = size;
+    if (notify) cq->notify = *notify;
+    return (RIO_CQ)cq;
+}
+
+/***********************************************************************
+ *     RIOCloseCompletionQueue
+ */
+static void WINAPI WS2_RIOCloseCompletionQueue( RIO_CQ cq_handle )
+{
+    struct ws2_rio_cq *cq = (struct ws2_rio_cq *)cq_handle;
+
+    TRACE( "(%p)\n", cq );
+
+    if (!cq) return;
+    EnterCriticalSection( &cq->cs );
+    if (cq->reserved)
+    {
+        /* freed along with the last request queue using it */
+        WARN( "completion queue %p still used by request queues\n", cq );
+        cq->closed = TRUE;
+        LeaveCriticalSection( &cq->cs );
+        return;
+    }
+    LeaveCriticalSection( &cq->cs );
+    WS2_rio_free_cq( cq );
+}
+
+/***********************************************************************
+ *     RIOResizeCompletionQueue
+ */
+static BOOL WINAPI WS2_RIOResizeCompletionQueue( RIO_CQ cq_handle, DWORD size )
+{
+    struct ws2_rio_cq *cq = (struct ws2_rio_cq *)cq_handle;
+    RIORESULT *results;
+    DWORD i;
+
+    TRACE( "(%p, %u)\n", cq, size );
+
+    if (!cq || !size || size > RIO_MAX_CQ_SIZE)
+    {
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+    EnterCriticalSection( &cq->cs );
+    if (size < cq->reserved || size < cq->count)
+    {
+        LeaveCriticalSection( &cq->cs );
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+    if (!(results = HeapAlloc( GetProcessHeap(), 0, size * sizeof(*results) )))
+    {
+        LeaveCriticalSection( &cq->cs );
+        SetLastError( WSAENOBUFS );
+        return FALSE;
+    }
+    for (i = 0; i < cq->count; i++) results[i] = cq->results[(cq->head + i) % cq->size];
+    HeapFree( GetProcessHeap(), 0, cq->results );
+    cq->results = results;
+    cq->size    = size;
+    cq->head    = 0;
+    LeaveCriticalSection( &cq->cs );
+    return TRUE;
+}
+
+/***********************************************************************
+ *     RIOCreateRequestQueue
+ */
+static RIO_RQ WINAPI WS2_RIOCreateRequestQueue( SOCKET s, ULONG max_recv, ULONG max_recv_buffers,
+                                                ULONG max_send, ULONG max_send_buffers,
+                                                RIO_CQ recv_cq, RIO_CQ send_cq, PVOID context )
+{
+    struct ws2_rio_cq *cqs[2] = { (struct ws2_rio_cq *)recv_cq, (struct ws2_rio_cq *)send_cq };
+    ULONG sizes[2] = { max_recv, max_send };
+    struct ws2_rio_rq *rq;
+    unsigned int i;
+    int fd, type;
+
+    TRACE( "(%04lx, %u, %u, %u, %u, %p, %p, %p)\n", s, max_recv, max_recv_buffers, max_send,
+           max_send_buffers, recv_cq, send_cq, context );
+
+    if ((fd = get_sock_fd( s, 0, NULL )) == -1)
+    {
+        SetLastError( WSAENOTSOCK );
+        return RIO_INVALID_RQ;
+    }
+    type = _get_fd_type( fd );
+    release_sock_fd( s, fd );
+
+    if (!recv_cq || !send_cq || cqs[0]->closed || cqs[1]->closed || !max_recv || !max_send || max_recv_buffers != 1 || max_send_buffers != 1)
+    {
+        SetLastError( WSAEINVAL );
+        return RIO_INVALID_RQ;
+    }
+
+    /* each outstanding request needs a slot in its completion queue */
+    for (i = 0; i < 2; i++)
+    {
+        EnterCriticalSection( &cqs[i]->cs );
+        if (cqs[i]->reserved + sizes[i] > cqs[i]->size || cqs[i]->reserved + sizes[i] < sizes[i])
+        {
+            LeaveCriticalSection( &cqs[i]->cs );
+            if (i)
+            {
+                EnterCriticalSection( &cqs[0]->cs );
+                cqs[0]->reserved -= sizes[0];
+                LeaveCriticalSection( &cqs[0]->cs );
+            }
+            SetLastError( WSAENOBUFS );
+            return RIO_INVALID_RQ;
+        }
+        cqs[i]->reserved += sizes[i];
+        LeaveCriticalSection( &cqs[i]->cs );
+    }
+
+    if (!(rq = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*rq) )) ||
+        !(rq->queue[0].requests = HeapAlloc( GetProcessHeap(), 0, max_recv * sizeof(struct ws2_rio_request) )) ||
+        !(rq->queue[1].requests = HeapAlloc( GetProcessHeap(), 0, max_send * sizeof(struct ws2_rio_request) )))
+    {
+        if (rq)
+        {
+            HeapFree( GetProcessHeap(), 0, rq->queue[0].requests );
+            HeapFree( GetProcessHeap(), 0, rq );
+        }
+        for (i = 0; i < 2; i++)
+        {
+            EnterCriticalSection( &cqs[i]->cs );
+            cqs[i]->reserved -= sizes[i];
+            LeaveCriticalSection( &cqs[i]->cs );
+        }
+        SetLastError( WSAENOBUFS );
+        return RIO_INVALID_RQ;
+    }
+    InitializeCriticalSection( &rq->cs );
+    rq->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": ws2_rio_rq.cs");
+    rq->socket  = s;
+    rq->context = (ULONG_PTR)context;
+    rq->stream  = (type == SOCK_STREAM);
+    for (i = 0; i < 2; i++)
+    {
+        rq->queue[i].rq   = rq;
+        rq->queue[i].cq   = cqs[i];
+        rq->queue[i].size = sizes[i];
+    }
+
+    EnterCriticalSection( &rio_cs );
+    list_add_tail( &rio_request_queues, &rq->entry );
+    LeaveCriticalSection( &rio_cs );
+    return (RIO_RQ)rq;
+}
+
+/***********************************************************************
+ *     RIOResizeRequestQueue
+ */
+static BOOL WINAPI WS2_RIOResizeRequestQueue( RIO_RQ rq_handle, DWORD max_recv, DWORD max_send )
+{
+    struct ws2_rio_rq *rq = (struct ws2_rio_rq *)rq_handle;
+    ULONG sizes[2] = { max_recv, max_send };
+    struct ws2_rio_request *requests[2];
+    unsigned int i, j;
+
+    TRACE( "(%p, %u, %u)\n", rq, max_recv, max_send );
+
+    if (!rq || !max_recv || !max_send)
+    {
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+
+    EnterCriticalSection( &rq->cs );
+    for (i = 0; i < 2; i++)
+    {
+        struct ws2_rio_cq *cq = rq->queue[i].cq;
+        BOOL ok;
 
-            return STATUS_PENDING;
+        if (sizes[i] < rq->queue[i].count)
+        {
+            LeaveCriticalSection( &rq->cs );
+            SetLastError( WSAETOOMANYREFS );
+            return FALSE;
+        }
+        EnterCriticalSection( &cq->cs );
+        ok = cq->reserved - rq->queue[i].size + sizes[i] <= cq->size;
+        LeaveCriticalSection( &cq->cs );
+        if (!ok)
+        {
+            LeaveCriticalSection( &rq->cs );
+            SetLastError( WSAENOBUFS );
+            return FALSE;
         }
     }
-
-    /* send the footer (if applicable) */
-    if (wsa->buffers.Tail)
+    requests[0] = HeapAlloc( GetProcessHeap(), 0, max_recv * sizeof(struct ws2_rio_request) );
+    requests[1] = HeapAlloc( GetProcessHeap(), 0, max_send * sizeof(struct ws2_rio_request) );
+    if (!requests[0] || !requests[1])
     {
-        wsa->write.first_iovec       = 0;
-        wsa->write.n_iovecs          = 1;
-        wsa->write.iovec[0].iov_base = wsa->buffers.Tail;
-        wsa->write.iovec[0].iov_len  = wsa->buffers.TailLength;
-        wsa->buffers.Tail            = NULL;
-        return STATUS_PENDING;
+        LeaveCriticalSection( &rq->cs );
+        HeapFree( GetProcessHeap(), 0, requests[0] );
+        HeapFree( GetProcessHeap(), 0, requests[1] );
+        SetLastError( WSAENOBUFS );
+        return FALSE;
     }
+    for (i = 0; i < 2; i++)
+    {
+        struct ws2_rio_queue *queue = &rq->queue[i];
 
-    return STATUS_SUCCESS;
+        for (j = 0; j < queue->count; j++)
+            requests[i][j] = queue->requests[(queue->head + j) % queue->size];
+        HeapFree( GetProcessHeap(), 0, queue->requests );
+        EnterCriticalSection( &queue->cq->cs );
+        queue->cq->reserved = queue->cq->reserved - queue->size + sizes[i];
+        LeaveCriticalSection( &queue->cq->cs );
+        queue->requests = requests[i];
+        queue->size     = sizes[i];
+        queue->head     = 0;
+    }
+    LeaveCriticalSection( &rq->cs );
+    return TRUE;
 }
 
 /***********************************************************************
- *     WS2_transmitfile_base            (INTERNAL)
- *
- * Shared implementation for both synchronous and asynchronous TransmitFile.
+ *     RIOReceive
  */
-static NTSTATUS WS2_transmitfile_base( int fd, struct ws2_transmitfile_async *wsa )
+static BOOL WINAPI WS2_RIOReceive( RIO_RQ rq, PRIO_BUF data, ULONG count, DWORD flags, PVOID context )
 {
-    NTSTATUS status;
+    TRACE( "(%p, %p, %u, %#x, %p)\n", rq, data, count, flags, context );
 
-    status = WS2_transmitfile_getbuffer( fd, wsa );
-    if (status == STATUS_PENDING)
-    {
-        IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)wsa->write.user_overlapped;
-        int n;
+    return WS2_rio_post( rq, FALSE, data, count, NULL, flags, context );
+}
 
-        n = WS2_send( fd, &wsa->write, convert_flags(wsa->write.flags) );
-        if (n >= 0)
-        {
-            if (iosb) iosb->Information += n;
-        }
-        else if (errno != EAGAIN)
-            return wsaErrStatus();
-    }
+/***********************************************************************
+ *     RIOReceiveEx
+ */
+static int WINAPI WS2_RIOReceiveEx( RIO_RQ rq, PRIO_BUF data, ULONG count, PRIO_BUF local_addr,
+                                    PRIO_BUF remote_addr, PRIO_BUF control, PRIO_BUF flags_buf,
+                                    DWORD flags, PVOID context )
+{
+    TRACE( "(%p, %p, %u, %p, %p, %p, %p, %#x, %p)\n", rq, data, count, local_addr, remote_addr,
+           control, flags_buf, flags, context );
 
-    return status;
+    if (local_addr || control || flags_buf)
+        FIXME( "local address, control and flags buffers not supported\n" );
+
+    return WS2_rio_post( rq, FALSE, data, count, remote_addr, flags, context );
 }
 
 /***********************************************************************
- *     WS2_async_transmitfile           (INTERNAL)
- *
- * Asynchronous callback for overlapped TransmitFile operations.
+ *     RIOSend
  */
-static NTSTATUS WS2_async_transmitfile( void *user, IO_STATUS_BLOCK *iosb,
-                                        NTSTATUS status, void **apc, void **arg )
+static BOOL WINAPI WS2_RIOSend( RIO_RQ rq, PRIO_BUF data, ULONG count, DWORD flags, PVOID context )
 {
-    struct ws2_transmitfile_async *wsa = user;
-    int fd;
-
-    if (status == STATUS_ALERTED)
-    {
-        if (!(status = wine_server_handle_to_fd( wsa->write.hSocket, FILE_WRITE_DATA, &fd, NULL )))
-        {
-            status = WS2_transmitfile_base( fd, wsa );
-            wine_server_release_fd( wsa->write.hSocket, fd );
-        }
-        if (status == STATUS_PENDING)
-            return status;
-    }
+    TRACE( "(%p, %p, %u, %#x, %p)\n", rq, data, count, flags, context );
 
-    iosb->u.Status = status;
-    release_async_io( &wsa->io );
-    return status;
+    return WS2_rio_post( rq, TRUE, data, count, NULL, flags, context );
 }
 
 /***********************************************************************
- *     TransmitFile
+ *     RIOSendEx
  */
-static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE h, DWORD file_bytes, DWORD bytes_per_send,
-                                     LPOVERLAPPED overlapped, LPTRANSMIT_FILE_BUFFERS buffers,
-                                     DWORD flags )
+static BOOL WINAPI WS2_RIOSendEx( RIO_RQ rq, PRIO_BUF data, ULONG count, PRIO_BUF local_addr,
+                                  PRIO_BUF remote_addr, PRIO_BUF control, PRIO_BUF flags_buf,
+                                  DWORD flags, PVOID context )
 {
-    union generic_unix_sockaddr uaddr;
-    unsigned int uaddrlen = sizeof(uaddr);
-    struct ws2_transmitfile_async *wsa;
-    NTSTATUS status;
-    int fd;
+    TRACE( "(%p, %p, %u, %p, %p, %p, %p, %#x, %p)\n", rq, data, count, local_addr, remote_addr,
+           control, flags_buf, flags, context );
 
-    TRACE("(%lx, %p, %d, %d, %p, %p, %d)\n", s, h, file_bytes, bytes_per_send, overlapped,
-            buffers, flags );
+    if (local_addr || control || flags_buf)
+        FIXME( "local address, control and flags buffers not supported\n" );
 
-    fd = get_sock_fd( s, FILE_WRITE_DATA, NULL );
-    if (fd == -1)
-    {
-        WSASetLastError( WSAENOTSOCK );
-        return FALSE;
-    }
-    if (getpeername( fd, &uaddr.addr, &uaddrlen ) != 0)
-    {
-        release_sock_fd( s, fd );
-        WSASetLastError( WSAENOTCONN );
-        return FALSE;
-    }
-    if (flags)
-        FIXME("Flags are not currently supported (0x%x).\n", flags);
+    return WS2_rio_post( rq, TRUE, data, count, remote_addr, flags, context );
+}
 
-    if (h && GetFileType( h ) != FILE_TYPE_DISK)
-    {
-        FIXME("Non-disk file handles are not currently supported.\n");
-        release_sock_fd( s, fd );
-        WSASetLastError( WSAEOPNOTSUPP );
-        return FALSE;
-    }
+/***********************************************************************
+ *     RIODequeueCompletion
+ */
+static ULONG WINAPI WS2_RIODequeueCompletion( RIO_CQ cq_handle, PRIORESULT results, ULONG size )
+{
+    struct ws2_rio_cq *cq = (struct ws2_rio_cq *)cq_handle;
+    ULONG i, count;
 
-    /* set reasonable defaults when requested */
-    if (!bytes_per_send)
-        bytes_per_send = (1 << 16); /* Depends on OS version: PAGE_SIZE, 2*PAGE_SIZE, or 2^16 */
+    TRACE( "(%p, %p, %u)\n", cq, results, size );
 
-    if (!(wsa = (struct ws2_transmitfile_async *)alloc_async_io( sizeof(*wsa) + bytes_per_send )))
+    if (!cq || !results)
     {
-        release_sock_fd( s, fd );
-        WSASetLastError( WSAEFAULT );
-        return FALSE;
+        SetLastError( WSAEINVAL );
+        return RIO_CORRUPT_CQ;
     }
-    if (buffers)
-        wsa->buffers = *buffers;
-    else
-        memset(&wsa->buffers, 0x0, sizeof(wsa->buffers));
-    wsa->buffer                = (char *)(wsa + 1);
-    wsa->file                  = h;
-    wsa->file_read             = 0;
-    wsa->file_bytes            = file_bytes;
-    wsa->bytes_per_send        = bytes_per_send;
-    wsa->flags                 = flags;
-    wsa->offset.QuadPart       = FILE_USE_FILE_POINTER_POSITION;
-    wsa->write.hSocket         = SOCKET2HANDLE(s);
-    wsa->write.addr            = NULL;
-    wsa->write.addrlen.val     = 0;
-    wsa->write.flags           = 0;
-    wsa->write.lpFlags         = &wsa->flags;
-    wsa->write.control         = NULL;
-    wsa->write.n_iovecs        = 0;
-    wsa->write.first_iovec     = 0;
-    wsa->write.user_overlapped = overlapped;
-    if (overlapped)
-    {
-        IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)overlapped;
-        int status;
 
-        wsa->offset.u.LowPart  = overlapped->u.s.Offset;
-        wsa->offset.u.HighPart = overlapped->u.s.OffsetHigh;
-        iosb->u.Status = STATUS_PENDING;
-        iosb->Information = 0;
-        SERVER_START_REQ( register_async )
-        {
-            req->type           = ASYNC_TYPE_WRITE;
-            req->async.handle   = wine_server_obj_handle( SOCKET2HANDLE(s) );
-            req->async.event    = wine_server_obj_handle( overlapped->hEvent );
-            req->async.callback = wine_server_client_ptr( WS2_async_transmitfile );
-            req->async.iosb     = wine_server_client_ptr( iosb );
-            req->async.arg      = wine_server_client_ptr( wsa );
-            status = wine_server_call( req );
-        }
-        SERVER_END_REQ;
+    EnterCriticalSection( &cq->cs );
+    count = min( size, cq->count );
+    for (i = 0; i < count; i++) results[i] = cq->results[(cq->head + i) % cq->size];
+    cq->head   = (cq->head + count) % cq->size;
+    cq->count -= count;
+    LeaveCriticalSection( &cq->cs );
+    return count;
+}
 
-        if(status != STATUS_PENDING) HeapFree( GetProcessHeap(), 0, wsa );
-        release_sock_fd( s, fd );
-        WSASetLastError( NtStatusToWSAError(status) );
-        return FALSE;
-    }
+/***********************************************************************
+ *     RIONotify
+ */
+static INT WINAPI WS2_RIONotify( RIO_CQ cq_handle )
+{
+    struct ws2_rio_cq *cq = (struct ws2_rio_cq *)cq_handle;
+    BOOL fire;
 
-    do
+    TRACE( "(%p)\n", cq );
+
+    if (!cq || !cq->notify.Type) return WSAEINVAL;
+
+    EnterCriticalSection( &cq->cs );
+    if (cq->armed)
     {
-        status = WS2_transmitfile_base( fd, wsa );
-        if (status == STATUS_PENDING)
-        {
-            /* block here */
-            do_block(fd, POLLOUT, -1);
-            _sync_sock_state(s); /* let wineserver notice connection */
-        }
+        LeaveCriticalSection( &cq->cs );
+        return WSAEALREADY;
     }
-    while (status == STATUS_PENDING);
-    release_sock_fd( s, fd );
+    if (cq->notify.Type == RIO_EVENT_COMPLETION && cq->notify.u.Event.NotifyReset)
+        ResetEvent( cq->notify.u.Event.EventHandle );
+    /* the notification fires right away if there are results already */
+    fire = cq->count != 0;
+    cq->armed = !fire;
+    LeaveCriticalSection( &cq->cs );
 
-    if (status != STATUS_SUCCESS)
-        WSASetLastError( NtStatusToWSAError(status) );
-    HeapFree( GetProcessHeap(), 0, wsa );
-    return (status == STATUS_SUCCESS);
+    if (fire) WS2_rio_fire_notification( cq );
+    return ERROR_SUCCESS;
 }
 
+static const RIO_EXTENSION_FUNCTION_TABLE rio_function_table =
+{
+    sizeof(RIO_EXTENSION_FUNCTION_TABLE),
+    WS2_RIOReceive,
+    WS2_RIOReceiveEx,
+    WS2_RIOSend,
+    WS2_RIOSendEx,
+    WS2_RIOCloseCompletionQueue,
+    WS2_RIOCreateCompletionQueue,
+    WS2_RIOCreateRequestQueue,
+    WS2_RIODequeueCompletion,
+    WS2_RIODeregisterBuffer,
+    WS2_RIONotify,
+    WS2_RIORegisterBuffer,
+    WS2_RIOResizeCompletionQueue,
+    WS2_RIOResizeRequestQueue
+};
+
 /***********************************************************************
  *     GetAcceptExSockaddrs
  */
@@ -3320,8 +4590,12 @@ int WINAPI WS_closesocket(SOCKET s)
         if (fd >= 0)
         {
             release_sock_fd(s, fd);
+            poll_sets_remove_socket(s);
             if (CloseHandle(SOCKET2HANDLE(s)))
+            {
+                WS2_rio_close_socket(s);
                 res = 0;
+            }
         }
         else
             SetLastError(WSAENOTSOCK);
@@ -4805,7 +6079,8 @@ INT WINAPI WSAIoctl(SOCKET s, DWORD code, LPVOID in_buff, DWORD in_size, LPVOID
         }
         else if ( IsEqualGUID(&transmitpackets_guid, in_buff) )
         {
-            FIXME("SIO_GET_EXTENSION_FUNCTION_POINTER: unimplemented TransmitPackets\n");
+            *(LPFN_TRANSMITPACKETS *)out_buff = WS2_TransmitPackets;
+            break;
         }
         else if ( IsEqualGUID(&wsarecvmsg_guid, in_buff) )
         {
@@ -4823,6 +6098,25 @@ INT WINAPI WSAIoctl(SOCKET s, DWORD code, LPVOID in_buff, DWORD in_size, LPVOID
         status = WSAEOPNOTSUPP;
         break;
    }
+   case WS_SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER:
+   {
+        static const GUID multiple_rio_guid = WSAID_MULTIPLE_RIO;
+
+        if (in_buff && in_size >= sizeof(GUID) && IsEqualGUID(&multiple_rio_guid, in_buff))
+        {
+            if (!out_buff || out_size < sizeof(RIO_EXTENSION_FUNCTION_TABLE))
+            {
+                status = WSAEFAULT;
+                break;
+            }
+            memcpy(out_buff, &rio_function_table, sizeof(rio_function_table));
+            total = sizeof(rio_function_table);
+            break;
+        }
+        FIXME("SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER %s: stub\n", debugstr_guid(in_buff));
+        status = WSAEOPNOTSUPP;
+        break;
+   }
    case WS_SIO_KEEPALIVE_VALS:
    {
         struct tcp_keepalive *k;
@@ -5291,6 +6585,170 @@ int WINAPI WS_select(int nfds, WS_fd_set *ws_readfds,
     return ret;
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+
+/* update the thread poll set for the sockets of a WSAPoll call */
+/* returns FALSE if the set can't be used for this call */
+static BOOL poll_set_update( struct poll_set *set, WSAPOLLFD *wfds, ULONG count )
+{
+    struct poll_entry *entry, *next;
+    struct epoll_event ev;
+    unsigned int generation = ++set->generation;
+    ULONG i;
+
+    for (i = 0; i < count; i++)
+    {
+        int fd, events = convert_poll_w2u( wfds[i].events );
+        struct stat st;
+
+        wfds[i].revents = 0;
+        entry = poll_set_find( set, wfds[i].fd );
+        /* the same socket more than once, let poll() sort it out */
+        if (entry && entry->generation == generation) return FALSE;
+
+        if ((fd = get_sock_fd( wfds[i].fd, 0, NULL )) == -1)
+        {
+            if (entry) poll_set_remove( set, entry );
+            wfds[i].revents = WS_POLLNVAL;
+            continue;
+        }
+        if (fstat( fd, &st ) == -1)
+        {
+            release_sock_fd( wfds[i].fd, fd );
+            return FALSE;
+        }
+        if (entry && (entry->dev != st.st_dev || entry->ino != st.st_ino))
+        {
+            /* the handle now refers to another socket */
+            poll_set_remove( set, entry );
+            entry = NULL;
+        }
+
+        if (entry)
+        {
+            release_sock_fd( wfds[i].fd, fd );
+            if (entry->events != events)
+            {
+                ev.events = events;
+                ev.data.u64 = entry->socket;
+                if (epoll_ctl( set->epoll_fd, EPOLL_CTL_MOD, entry->fd, &ev ) == -1) return FALSE;
+                entry->events = events;
+            }
+        }
+        else
+        {
+            if (!(entry = HeapAlloc( GetProcessHeap(), 0, sizeof(*entry) )))
+            {
+                release_sock_fd( wfds[i].fd, fd );
+                return FALSE;
+            }
+            ev.events = events;
+            ev.data.u64 = wfds[i].fd;
+            if (epoll_ctl( set->epoll_fd, EPOLL_CTL_ADD, fd, &ev ) == -1)
+            {
+                release_sock_fd( wfds[i].fd, fd );
+                HeapFree( GetProcessHeap(), 0, entry );
+                return FALSE;
+            }
+            entry->socket = wfds[i].fd;
+            entry->fd     = fd;
+            entry->dev    = st.st_dev;
+            entry->ino    = st.st_ino;
+            entry->events = events;
+            list_add_tail( &set->entries, &entry->entry );
+            list_add_tail( poll_set_bucket( set, entry->socket ), &entry->hash_entry );
+        }
+        entry->generation = generation;
+        entry->index = i;
+    }
+
+    /* drop the sockets that are no longer polled */
+    LIST_FOR_EACH_ENTRY_SAFE( entry, next, &set->entries, struct poll_entry, entry )
+        if (entry->generation != generation) poll_set_remove( set, entry );
+
+    if (set->events_size < count + 1)
+    {
+        struct epoll_event *events;
+
+        if (!(events = HeapAlloc( GetProcessHeap(), 0, (count + 1) * sizeof(*events) ))) return FALSE;
+        HeapFree( GetProcessHeap(), 0, set->events );
+        set->events = events;
+        set->events_size = count + 1;
+    }
+    return TRUE;
+}
+
+/* wait on the thread poll set; returns -2 if it can't be used */
+static int poll_set_wait( WSAPOLLFD *wfds, ULONG count, int timeout )
+{
+    struct per_thread_data *ptb = get_per_thread_data();
+    struct poll_set *set;
+    struct poll_entry *entry;
+    DWORD end = GetTickCount() + timeout;
+    int i, n, err, ret = 0;
+
+    if (!ptb->poll_set && !(ptb->poll_set = create_poll_set())) return -2;
+    set = ptb->poll_set;
+
+    EnterCriticalSection( &set->cs );
+    if (!poll_set_update( set, wfds, count ))
+    {
+        LeaveCriticalSection( &set->cs );
+        return -2;
+    }
+    set->wfds = wfds;
+    set->closed = 0;
+    LeaveCriticalSection( &set->cs );
+
+    for (;;)
+    {
+        BOOL done = FALSE;
+
+        n = epoll_wait( set->epoll_fd, set->events, count + 1, timeout );
+        err = errno;
+        if (!n || (n == -1 && err != EINTR)) done = TRUE;
+        else if (timeout > 0 && (timeout = end - GetTickCount()) <= 0) done = TRUE;
+
+        EnterCriticalSection( &set->cs );
+        for (i = 0; i < n; i++)
+        {
+            if (!set->events[i].data.u64)
+            {
+                char buffer[16];
+                while (read( set->wake_fd[0], buffer, sizeof(buffer) ) > 0);
+                continue;
+            }
+            /* ignore the sockets closed by another thread while waiting */
+            if (!(entry = poll_set_find( set, set->events[i].data.u64 ))) continue;
+            if (entry->generation != set->generation) continue;
+            wfds[entry->index].revents = convert_poll_u2w( set->events[i].events );
+            ret++;
+        }
+        ret += set->closed;
+        set->closed = 0;
+        if (ret) done = TRUE;
+        if (done) set->wfds = NULL;
+        LeaveCriticalSection( &set->cs );
+        if (done) break;
+    }
+
+    if (n == -1 && err != EINTR)
+    {
+        errno = err;
+        return -1;
+    }
+    return ret;
+}
+
+#else  /* HAVE_SYS_EPOLL_H */
+
+static inline int poll_set_wait( WSAPOLLFD *wfds, ULONG count, int timeout )
+{
+    return -2;
+}
+
+#endif  /* HAVE_SYS_EPOLL_H */
+
 /***********************************************************************
  *     WSAPoll
  */
@@ -5310,6 +6768,12 @@ int WINAPI WSAPoll(WSAPOLLFD *wfds, ULONG count, int timeout)
         return SOCKET_ERROR;
     }
 
+    if ((ret = poll_set_wait(wfds, count, timeout)) != -2)
+    {
+        if (ret == -1) SetLastError(wsaErrno());
+        return ret;
+    }
+
     if (!(ufds = HeapAlloc(GetProcessHeap(), 0, count * sizeof(ufds[0]))))
     {
         SetLastError(WSAENOBUFS);
@@ -5344,6 +6808,9 @@ int WINAPI WSAPoll(WSAPOLLFD *wfds, ULONG count, int timeout)
 static void WS_AddCompletion( SOCKET sock, ULONG_PTR CompletionValue, NTSTATUS CompletionStatus,
                               ULONG Information )
 {
+    /* the skip mode is cached along with the socket fd */
+    if (wine_server_skip_completion( SOCKET2HANDLE(sock), CompletionStatus )) return;
+
     SERVER_START_REQ( add_fd_completion )
     {
         req->handle      = wine_server_obj_handle( SOCKET2HANDLE(sock) );
@@ -5469,21 +6936,20 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
 
         if (n == -1 || n < totalLength)
         {
+            async_data_t async;
+
             iosb->u.Status = STATUS_PENDING;
             iosb->Information = n == -1 ? 0 : n;
 
-            SERVER_START_REQ( register_async )
-            {
-                req->type           = ASYNC_TYPE_WRITE;
-                req->async.handle   = wine_server_obj_handle( wsa->hSocket );
-                req->async.callback = wine_server_client_ptr( WS2_async_send );
-                req->async.iosb     = wine_server_client_ptr( iosb );
-                req->async.arg      = wine_server_client_ptr( wsa );
-                req->async.event    = wine_server_obj_handle( lpCompletionRoutine ? 0 : lpOverlapped->hEvent );
-                req->async.cvalue   = cvalue;
-                err = wine_server_call( req );
-            }
-            SERVER_END_REQ;
+            memset( &async, 0, sizeof(async) );
+            async.handle   = wine_server_obj_handle( wsa->hSocket );
+            async.callback = wine_server_client_ptr( WS2_async_send );
+            async.iosb     = wine_server_client_ptr( iosb );
+            async.arg      = wine_server_client_ptr( wsa );
+            async.event    = wine_server_obj_handle( lpCompletionRoutine ? 0 : lpOverlapped->hEvent );
+            async.cvalue   = cvalue;
+            /* handled in-process when possible, without a server round trip per operation */
+            err = wine_server_register_async( ASYNC_TYPE_WRITE, &async );
 
             /* Enable the event only after starting the async. The server will deliver it as soon as
                the async is done. */
@@ -7161,6 +8627,7 @@ SOCKET WINAPI WSASocketW(int af, int type, int protocol,
     if (ret)
     {
         TRACE("\tcreated %04lx\n", ret );
+        WS2_rio_close_socket(ret);
         if (ipxptype > 0)
             set_ipx_packettype(ret, ipxptype);
        return ret;
@@ -7570,21 +9037,20 @@ static int WS2_recv_base( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
 
             if (n == -1)
             {
+                async_data_t async;
+
                 iosb->u.Status = STATUS_PENDING;
                 iosb->Information = 0;
 
-                SERVER_START_REQ( register_async )
-                {
-                    req->type           = ASYNC_TYPE_READ;
-                    req->async.handle   = wine_server_obj_handle( wsa->hSocket );
-                    req->async.callback = wine_server_client_ptr( WS2_async_recv );
-                    req->async.iosb     = wine_server_client_ptr( iosb );
-                    req->async.arg      = wine_server_client_ptr( wsa );
-                    req->async.event    = wine_server_obj_handle( lpCompletionRoutine ? 0 : lpOverlapped->hEvent );
-                    req->async.cvalue   = cvalue;
-                    err = wine_server_call( req );
-                }
-                SERVER_END_REQ;
+                memset( &async, 0, sizeof(async) );
+                async.handle   = wine_server_obj_handle( wsa->hSocket );
+                async.callback = wine_server_client_ptr( WS2_async_recv );
+                async.iosb     = wine_server_client_ptr( iosb );
+                async.arg      = wine_server_client_ptr( wsa );
+                async.event    = wine_server_obj_handle( lpCompletionRoutine ? 0 : lpOverlapped->hEvent );
+                async.cvalue   = cvalue;
+                /* handled in-process when possible, without a server round trip per operation */
+                err = wine_server_register_async( ASYNC_TYPE_READ, &async );
 
                 if (err != STATUS_PENDING) HeapFree( GetProcessHeap(), 0, wsa );
                 SetLastError(NtStatusToWSAError( err ));
@@ -6705,6 +6705,29 @@ todo_wine
        "fdWrite socket events incorrect\n");
     closesocket(fdWrite);
 
+    /* Poll the same sockets again with different events */
+    ok(!tcp_socketpair(&fdRead, &fdWrite), "creating socket pair failed\n");
+    POLL_CLEAR();
+    POLL_SET(fdRead, POLLIN);
+    ret = pWSAPoll(fds, ix, 0);
+    ok(ret == 0, "expected 0, got %d\n", ret);
+    POLL_CLEAR();
+    POLL_SET(fdRead, POLLIN | POLLOUT);
+    ret = pWSAPoll(fds, ix, 0);
+    ok(ret == 1, "expected 1, got %d\n", ret);
+    ok(POLL_ISSET(fdRead, POLLWRNORM), "fdRead socket events incorrect\n");
+    POLL_CLEAR();
+    POLL_SET(fdRead, POLLIN);
+    POLL_SET(fdWrite, POLLIN);
+    ret = send(fdWrite, "1234", 4, 0);
+    ok(ret == 4, "expected 4, got %d\n", ret);
+    ret = pWSAPoll(fds, ix, poll_timeout);
+    ok(ret == 1, "expected 1, got %d\n", ret);
+    ok(fds[0].revents == POLLRDNORM, "got events %#x\n", fds[0].revents);
+    ok(!fds[1].revents, "got events %#x\n", fds[1].revents);
+    closesocket(fdRead);
+    closesocket(fdWrite);
+
     /* Close the socket currently being polled in a thread */
     ok(!tcp_socketpair(&fdRead, &fdWrite), "creating socket pair failed\n");
     thread_handle = CreateThread(NULL, 0, SelectCloseThread, &fdWrite, 0, &id);
@@ -6724,7 +6747,6 @@ todo_wine
     POLL_SET(fdWrite, POLLIN);
     ret = pWSAPoll(fds, ix, poll_timeout);
     ok(ret == 1, "expected 1, got %d\n", ret);
-todo_wine
     ok(POLL_ISSET(fdWrite, POLLNVAL), "fdWrite socket events incorrect\n");
     WaitForSingleObject (thread_handle, 1000);
     closesocket(fdRead);
@@ -8177,6 +8199,181 @@ cleanup:
     closesocket(server);
 }
 
+static void test_TransmitPackets(void)
+{
+    GUID transmitPacketsGuid = WSAID_TRANSMITPACKETS;
+    LPFN_TRANSMITPACKETS pTransmitPackets = NULL;
+    TRANSMIT_PACKETS_ELEMENT elements[5];
+    char header_msg[] = "hello world";
+    char footer_msg[] = "goodbye!!!";
+    char path[MAX_PATH], filename[MAX_PATH];
+    char data[1000], buf[1100];
+    SOCKET client, dest;
+    HANDLE file;
+    DWORD num_bytes, err, i;
+    int iret, len;
+    BOOL bret;
+
+    if (tcp_socketpair(&client, &dest))
+    {
+        skip("failed to create sockets\n");
+        return;
+    }
+    iret = WSAIoctl(client, SIO_GET_EXTENSION_FUNCTION_POINTER, &transmitPacketsGuid, sizeof(transmitPacketsGuid),
+                    &pTransmitPackets, sizeof(pTransmitPackets), &num_bytes, NULL, NULL);
+    if (iret)
+    {
+        skip("WSAIoctl failed to get TransmitPackets with ret %d + errno %d\n", iret, WSAGetLastError());
+        closesocket(client);
+        closesocket(dest);
+        return;
+    }
+
+    for (i = 0; i < sizeof(data); i++) data[i] = i * 7;
+    GetTempPathA(MAX_PATH, path);
+    GetTempFileNameA(path, "tp", 0, filename);
+    file = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                       FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "CreateFile failed, error %u\n", GetLastError());
+    bret = WriteFile(file, data, sizeof(data), &num_bytes, NULL);
+    ok(bret && num_bytes == sizeof(data), "WriteFile failed, error %u\n", GetLastError());
+
+    /* Test TransmitPackets with an invalid socket */
+    bret = pTransmitPackets(INVALID_SOCKET, NULL, 0, 0, NULL, 0);
+    err = WSAGetLastError();
+    ok(!bret, "TransmitPackets succeeded unexpectedly.\n");
+    ok(err == WSAENOTSOCK, "TransmitPackets triggered unexpected errno (%d != %d)\n", err, WSAENOTSOCK);
+
+    /* Test an element that is both a memory buffer and a file */
+    memset(elements, 0, sizeof(elements));
+    elements[0].dwElFlags = TP_ELEMENT_MEMORY | TP_ELEMENT_FILE;
+    elements[0].cLength = sizeof(header_msg);
+    elements[0].pBuffer = header_msg;
+    bret = pTransmitPackets(client, elements, 1, 0, NULL, 0);
+    err = WSAGetLastError();
+    ok(!bret, "TransmitPackets succeeded unexpectedly.\n");
+    ok(err == WSAEINVAL, "TransmitPackets triggered unexpected errno (%d != %d)\n", err, WSAEINVAL);
+
+    /* Test a mix of memory buffers and file ranges */
+    memset(elements, 0, sizeof(elements));
+    elements[0].dwElFlags = TP_ELEMENT_MEMORY;
+    elements[0].cLength = sizeof(header_msg);
+    elements[0].pBuffer = header_msg;
+    elements[1].dwElFlags = TP_ELEMENT_FILE;
+    elements[1].cLength = 100;
+    elements[1].nFileOffset.QuadPart = 10;
+    elements[1].hFile = file;
+    elements[2].dwElFlags = TP_ELEMENT_EOP;
+    elements[3].dwElFlags = TP_ELEMENT_FILE | TP_ELEMENT_EOP;
+    elements[3].cLength = 0; /* up to the end of the file */
+    elements[3].nFileOffset.QuadPart = 900;
+    elements[3].hFile = file;
+    elements[4].dwElFlags = TP_ELEMENT_MEMORY | TP_ELEMENT_EOP;
+    elements[4].cLength = sizeof(footer_msg);
+    elements[4].pBuffer = footer_msg;
+    /* use a small send size to exercise the chunking */
+    bret = pTransmitPackets(client, elements, 5, 32, NULL, 0);
+    ok(bret, "TransmitPackets failed, error %d\n", WSAGetLastError());
+
+    len = 0;
+    while (len < sizeof(header_msg) + 200 + sizeof(footer_msg))
+    {
+        iret = recv(dest, buf + len, sizeof(buf) - len, 0);
+        ok(iret > 0, "recv returned %d, error %d\n", iret, WSAGetLastError());
+        if (iret <= 0) break;
+        len += iret;
+    }
+    ok(len == sizeof(header_msg) + 200 + sizeof(footer_msg), "got %d bytes\n", len);
+    ok(!memcmp(buf, header_msg, sizeof(header_msg)), "TransmitPackets header buffer did not match!\n");
+    ok(!memcmp(buf + sizeof(header_msg), data + 10, 100), "TransmitPackets first file range did not match!\n");
+    ok(!memcmp(buf + sizeof(header_msg) + 100, data + 900, 100),
+       "TransmitPackets second file range did not match!\n");
+    ok(!memcmp(buf + sizeof(header_msg) + 200, footer_msg, sizeof(footer_msg)),
+       "TransmitPackets footer buffer did not match!\n");
+
+    CloseHandle(file);
+    closesocket(client);
+    closesocket(dest);
+}
+
+static void test_TransmitFile_throughput(void)
+{
+    static const DWORD file_size = 16 * 1024 * 1024;
+    GUID transmitFileGuid = WSAID_TRANSMITFILE;
+    LPFN_TRANSMITFILE pTransmitFile = NULL;
+    char path[MAX_PATH], filename[MAX_PATH];
+    DWORD num_bytes, err, total = 0, ticks, sent;
+    WSAOVERLAPPED ov;
+    SOCKET client, dest;
+    HANDLE file;
+    char *buf;
+    BOOL bret;
+    int iret;
+
+    if (tcp_socketpair(&client, &dest))
+    {
+        skip("failed to create sockets\n");
+        return;
+    }
+    iret = WSAIoctl(client, SIO_GET_EXTENSION_FUNCTION_POINTER, &transmitFileGuid, sizeof(transmitFileGuid),
+                    &pTransmitFile, sizeof(pTransmitFile), &num_bytes, NULL, NULL);
+    if (iret)
+    {
+        skip("WSAIoctl failed to get TransmitFile with ret %d + errno %d\n", iret, WSAGetLastError());
+        closesocket(client);
+        closesocket(dest);
+        return;
+    }
+
+    buf = HeapAlloc(GetProcessHeap(), 0, 1 << 16);
+    memset(buf, 'x', 1 << 16);
+    GetTempPathA(MAX_PATH, path);
+    GetTempFileNameA(path, "tf", 0, filename);
+    file = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                       FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "CreateFile failed, error %u\n", GetLastError());
+    while (total < file_size)
+    {
+        bret = WriteFile(file, buf, 1 << 16, &num_bytes, NULL);
+        ok(bret, "WriteFile failed, error %u\n", GetLastError());
+        if (!bret) break;
+        total += num_bytes;
+    }
+
+    memset(&ov, 0, sizeof(ov));
+    ov.hEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+    ticks = GetTickCount();
+    bret = pTransmitFile(client, file, 0, 0, &ov, NULL, 0);
+    err = WSAGetLastError();
+    ok(!bret, "TransmitFile succeeded unexpectedly.\n");
+    ok(err == ERROR_IO_PENDING, "TransmitFile triggered unexpected errno (%d != %d)\n", err, ERROR_IO_PENDING);
+
+    total = 0;
+    while (total < file_size)
+    {
+        iret = recv(dest, buf, 1 << 16, 0);
+        ok(iret > 0, "recv returned %d, error %d\n", iret, WSAGetLastError());
+        if (iret <= 0) break;
+        total += iret;
+    }
+    ok(total == file_size, "received %u bytes\n", total);
+
+    iret = WaitForSingleObject(ov.hEvent, 10000);
+    ok(iret == WAIT_OBJECT_0, "Overlapped TransmitFile failed.\n");
+    ticks = GetTickCount() - ticks;
+    WSAGetOverlappedResult(client, &ov, &sent, FALSE, NULL);
+    ok(sent == file_size, "Overlapped TransmitFile sent an unexpected number of bytes (%d != %d).\n",
+       sent, file_size);
+    if (winetest_interactive)
+        trace("TransmitFile sent %u bytes in %u ms\n", sent, ticks);
+
+    CloseHandle(ov.hEvent);
+    CloseHandle(file);
+    HeapFree(GetProcessHeap(), 0, buf);
+    closesocket(client);
+    closesocket(dest);
+}
+
 static void test_getpeername(void)
 {
     SOCKET sock;
@@ -9215,6 +9412,273 @@ static void test_completion_port(void)
     CloseHandle(previous_port);
 }
 
+static void test_overlapped_recv_queue(void)
+{
+    char buffers[3][4], data[] = "aaaabbbbcccc", c = 'x';
+    WSAOVERLAPPED ov[3], *olp;
+    DWORD num_bytes, flags, ticks;
+    HANDLE io_port;
+    SOCKET src, dest;
+    ULONG_PTR key;
+    WSABUF bufs;
+    int i, iret;
+    BOOL bret;
+
+    if (tcp_socketpair(&src, &dest))
+    {
+        skip("failed to create sockets\n");
+        return;
+    }
+    io_port = CreateIoCompletionPort((HANDLE)dest, NULL, 125, 0);
+    ok(io_port != NULL, "failed to create completion port %u\n", GetLastError());
+
+    /* pending receives are completed in the order they were queued */
+    memset(ov, 0, sizeof(ov));
+    for (i = 0; i < 3; i++)
+    {
+        bufs.len = sizeof(buffers[i]);
+        bufs.buf = buffers[i];
+        flags = 0;
+        SetLastError(0xdeadbeef);
+        iret = WSARecv(dest, &bufs, 1, &num_bytes, &flags, &ov[i], NULL);
+        ok(iret == SOCKET_ERROR, "WSARecv returned %d\n", iret);
+        ok(GetLastError() == ERROR_IO_PENDING, "Last error was %d\n", GetLastError());
+    }
+
+    iret = send(src, data, 12, 0);
+    ok(iret == 12, "send returned %d\n", iret);
+
+    for (i = 0; i < 3; i++)
+    {
+        key = 0xdeadbeef;
+        num_bytes = 0xdeadbeef;
+        olp = NULL;
+        bret = GetQueuedCompletionStatus(io_port, &num_bytes, &key, &olp, 1000);
+        ok(bret, "GetQueuedCompletionStatus failed, error %u\n", GetLastError());
+        ok(key == 125, "Key is %lu\n", key);
+        ok(num_bytes == 4, "Number of bytes received is %u\n", num_bytes);
+        ok(olp == &ov[i], "got overlapped %p, expected %p\n", olp, &ov[i]);
+        ok(!memcmp(buffers[i], data + 4 * i, 4), "got wrong data for receive %d\n", i);
+    }
+
+    /* cancelling a pending receive queues a completion */
+    bufs.len = sizeof(buffers[0]);
+    bufs.buf = buffers[0];
+    flags = 0;
+    SetLastError(0xdeadbeef);
+    iret = WSARecv(dest, &bufs, 1, &num_bytes, &flags, &ov[0], NULL);
+    ok(iret == SOCKET_ERROR, "WSARecv returned %d\n", iret);
+    ok(GetLastError() == ERROR_IO_PENDING, "Last error was %d\n", GetLastError());
+
+    bret = CancelIo((HANDLE)dest);
+    ok(bret, "CancelIo failed, error %u\n", GetLastError());
+
+    SetLastError(0xdeadbeef);
+    olp = NULL;
+    bret = GetQueuedCompletionStatus(io_port, &num_bytes, &key, &olp, 1000);
+    ok(!bret, "GetQueuedCompletionStatus succeeded\n");
+    ok(GetLastError() == ERROR_OPERATION_ABORTED, "Last error was %d\n", GetLastError());
+    ok(olp == &ov[0], "got overlapped %p, expected %p\n", olp, &ov[0]);
+
+    /* round trips through the completion port */
+    ticks = GetTickCount();
+    for (i = 0; i < 1000; i++)
+    {
+        bufs.len = 1;
+        bufs.buf = buffers[0];
+        flags = 0;
+        iret = WSARecv(dest, &bufs, 1, &num_bytes, &flags, &ov[0], NULL);
+        if (iret && GetLastError() != ERROR_IO_PENDING) break;
+        if (send(src, &c, 1, 0) != 1) break;
+        if (!GetQueuedCompletionStatus(io_port, &num_bytes, &key, &olp, 1000)) break;
+    }
+    ticks = GetTickCount() - ticks;
+    ok(i == 1000, "overlapped receive %d failed, error %u\n", i, GetLastError());
+    if (winetest_interactive)
+        trace("%d overlapped receives in %u ms\n", i, ticks);
+
+    closesocket(src);
+    closesocket(dest);
+    CloseHandle(io_port);
+
+    /* without an event or a completion port, the socket handle is signaled */
+    if (tcp_socketpair(&src, &dest))
+    {
+        skip("failed to create sockets\n");
+        return;
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+        memset(&ov[0], 0, sizeof(ov[0]));
+        bufs.len = sizeof(buffers[0]);
+        bufs.buf = buffers[0];
+        flags = 0;
+        SetLastError(0xdeadbeef);
+        iret = WSARecv(dest, &bufs, 1, &num_bytes, &flags, &ov[0], NULL);
+        ok(iret == SOCKET_ERROR, "WSARecv returned %d\n", iret);
+        ok(GetLastError() == ERROR_IO_PENDING, "Last error was %d\n", GetLastError());
+
+        /* the signal left by the previous receive has been reset */
+        iret = WaitForSingleObject((HANDLE)dest, 0);
+        ok(iret == WAIT_TIMEOUT, "%d: wait returned %d\n", i, iret);
+
+        iret = send(src, data, 4, 0);
+        ok(iret == 4, "send returned %d\n", iret);
+
+        num_bytes = 0xdeadbeef;
+        bret = GetOverlappedResult((HANDLE)dest, &ov[0], &num_bytes, TRUE);
+        ok(bret, "%d: GetOverlappedResult failed, error %u\n", i, GetLastError());
+        ok(num_bytes == 4, "%d: Number of bytes received is %u\n", i, num_bytes);
+        ok(!memcmp(buffers[0], data, 4), "%d: got wrong data\n", i);
+    }
+
+    closesocket(src);
+    closesocket(dest);
+}
+
+static void test_registered_io(void)
+{
+    static const GUID rio_guid = WSAID_MULTIPLE_RIO;
+    char buffer[64], data[] = "registered";
+    RIO_EXTENSION_FUNCTION_TABLE rio;
+    RIO_NOTIFICATION_COMPLETION notify;
+    RIO_BUFFERID id;
+    RIORESULT results[4];
+    RIO_BUF buf;
+    RIO_CQ cq;
+    RIO_RQ rq;
+    SOCKET src, dest;
+    HANDLE event;
+    DWORD size, ret;
+    ULONG count;
+    BOOL bret;
+    int iret;
+
+    if (tcp_socketpair(&src, &dest))
+    {
+        skip("failed to create sockets\n");
+        return;
+    }
+
+    memset(&rio, 0, sizeof(rio));
+    size = 0xdeadbeef;
+    iret = WSAIoctl(dest, SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER, (void *)&rio_guid, sizeof(rio_guid),
+                    &rio, sizeof(rio), &size, NULL, NULL);
+    if (iret)
+    {
+        win_skip("registered I/O not supported, error %d\n", WSAGetLastError());
+        closesocket(src);
+        closesocket(dest);
+        return;
+    }
+    ok(size == sizeof(rio), "got size %u\n", size);
+    ok(rio.cbSize == sizeof(rio), "got cbSize %u\n", rio.cbSize);
+
+    SetLastError(0xdeadbeef);
+    iret = WSAIoctl(dest, SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER, (void *)&rio_guid, sizeof(rio_guid),
+                    &rio, 4, &size, NULL, NULL);
+    ok(iret == SOCKET_ERROR, "WSAIoctl returned %d\n", iret);
+    ok(WSAGetLastError() == WSAEFAULT, "got error %d\n", WSAGetLastError());
+
+    id = rio.RIORegisterBuffer(buffer, sizeof(buffer));
+    ok(id != RIO_INVALID_BUFFERID, "RIORegisterBuffer failed, error %d\n", WSAGetLastError());
+
+    event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    memset(&notify, 0, sizeof(notify));
+    notify.Type = RIO_EVENT_COMPLETION;
+    notify.Event.EventHandle = event;
+    notify.Event.NotifyReset = TRUE;
+    cq = rio.RIOCreateCompletionQueue(4, &notify);
+    ok(cq != RIO_INVALID_CQ, "RIOCreateCompletionQueue failed, error %d\n", WSAGetLastError());
+
+    /* the request queue needs room in its completion queues */
+    SetLastError(0xdeadbeef);
+    rq = rio.RIOCreateRequestQueue(dest, 4, 1, 4, 1, cq, cq, (void *)0x1234);
+    ok(rq == RIO_INVALID_RQ, "RIOCreateRequestQueue succeeded\n");
+    ok(WSAGetLastError() == WSAENOBUFS, "got error %d\n", WSAGetLastError());
+
+    rq = rio.RIOCreateRequestQueue(dest, 2, 1, 2, 1, cq, cq, (void *)0x1234);
+    ok(rq != RIO_INVALID_RQ, "RIOCreateRequestQueue failed, error %d\n", WSAGetLastError());
+
+    count = rio.RIODequeueCompletion(cq, results, 4);
+    ok(!count, "got %u results\n", count);
+
+    /* buffers are checked against the registered range */
+    buf.BufferId = id;
+    buf.Offset = 60;
+    buf.Length = 8;
+    SetLastError(0xdeadbeef);
+    bret = rio.RIOReceive(rq, &buf, 1, 0, (void *)0x1);
+    ok(!bret, "RIOReceive succeeded\n");
+    ok(WSAGetLastError() == WSAEINVAL, "got error %d\n", WSAGetLastError());
+
+    buf.Offset = 16;
+    buf.Length = sizeof(data) - 1;
+    bret = rio.RIOReceive(rq, &buf, 1, 0, (void *)0x5678);
+    ok(bret, "RIOReceive failed, error %d\n", WSAGetLastError());
+
+    iret = rio.RIONotify(cq);
+    ok(!iret, "RIONotify returned %d\n", iret);
+    iret = rio.RIONotify(cq);
+    ok(iret == WSAEALREADY, "RIONotify returned %d\n", iret);
+
+    iret = send(src, data, sizeof(data) - 1, 0);
+    ok(iret == sizeof(data) - 1, "send returned %d\n", iret);
+
+    ret = WaitForSingleObject(event, 1000);
+    ok(!ret, "wait returned %u\n", ret);
+    count = rio.RIODequeueCompletion(cq, results, 4);
+    ok(count == 1, "got %u results\n", count);
+    ok(!results[0].Status, "got status %d\n", results[0].Status);
+    ok(results[0].BytesTransferred == sizeof(data) - 1, "got %u bytes\n", results[0].BytesTransferred);
+    ok(results[0].SocketContext == 0x1234, "got socket context %s\n", wine_dbgstr_longlong(results[0].SocketContext));
+    ok(results[0].RequestContext == 0x5678, "got request context %s\n", wine_dbgstr_longlong(results[0].RequestContext));
+    ok(!memcmp(buffer + 16, data, sizeof(data) - 1), "got wrong data\n");
+
+    /* deferred sends are only started when committed */
+    memcpy(buffer, data, sizeof(data) - 1);
+    buf.Offset = 0;
+    bret = rio.RIOSend(rq, &buf, 1, RIO_MSG_DEFER, (void *)0x9abc);
+    ok(bret, "RIOSend failed, error %d\n", WSAGetLastError());
+    count = rio.RIODequeueCompletion(cq, results, 4);
+    ok(!count, "got %u results\n", count);
+    bret = rio.RIOSend(rq, NULL, 0, RIO_MSG_COMMIT_ONLY, NULL);
+    ok(bret, "RIOSend failed, error %d\n", WSAGetLastError());
+
+    iret = rio.RIONotify(cq);
+    ok(!iret, "RIONotify returned %d\n", iret);
+    ret = WaitForSingleObject(event, 1000);
+    ok(!ret, "wait returned %u\n", ret);
+    count = rio.RIODequeueCompletion(cq, results, 4);
+    ok(count == 1, "got %u results\n", count);
+    ok(results[0].BytesTransferred == sizeof(data) - 1, "got %u bytes\n", results[0].BytesTransferred);
+    ok(results[0].RequestContext == 0x9abc, "got request context %s\n", wine_dbgstr_longlong(results[0].RequestContext));
+    memset(buffer + 32, 0, sizeof(data));
+    iret = recv(src, buffer + 32, sizeof(data) - 1, 0);
+    ok(iret == sizeof(data) - 1, "recv returned %d\n", iret);
+    ok(!memcmp(buffer + 32, data, sizeof(data) - 1), "got wrong data\n");
+
+    /* closing the socket aborts the pending receives */
+    buf.Offset = 16;
+    bret = rio.RIOReceive(rq, &buf, 1, 0, (void *)0xdef0);
+    ok(bret, "RIOReceive failed, error %d\n", WSAGetLastError());
+    closesocket(dest);
+    iret = rio.RIONotify(cq);
+    ok(!iret, "RIONotify returned %d\n", iret);
+    ret = WaitForSingleObject(event, 1000);
+    ok(!ret, "wait returned %u\n", ret);
+    count = rio.RIODequeueCompletion(cq, results, 4);
+    ok(count == 1, "got %u results\n", count);
+    ok(results[0].Status == WSA_OPERATION_ABORTED, "got status %d\n", results[0].Status);
+    ok(results[0].RequestContext == 0xdef0, "got request context %s\n", wine_dbgstr_longlong(results[0].RequestContext));
+
+    rio.RIOCloseCompletionQueue(cq);
+    rio.RIODeregisterBuffer(id);
+    CloseHandle(event);
+    closesocket(src);
+}
+
 static void test_address_list_query(void)
 {
     SOCKET_ADDRESS_LIST *address_list;
@@ -9702,6 +10166,8 @@ START_TEST( sock )
 
     test_ipv6only();
     test_TransmitFile();
+    test_TransmitPackets();
+    test_TransmitFile_throughput();
     test_GetAddrInfoW();
     test_getaddrinfo();
     test_AcceptEx();
@@ -9719,6 +10185,8 @@ START_TEST( sock )
     test_WSAAsyncGetServByName();
 
     test_completion_port();
+    test_overlapped_recv_queue();
+    test_registered_io();
     test_address_list_query();
 
     /* this is an io heavy test, do it at the end so the kernel doesn't start dropping packets */
@@ -423,6 +423,35 @@ typedef union
     } keyed_event;
 } select_op_t;
 
+
+struct fast_sync_object
+{
+    int          value;
+    int          count;
+    int          max;
+    int          abandoned;
+    int          waiters;
+    int          __pad[3];
+};
+
+
+
+#define FAST_SYNC_SERVER_WAIT 0x80000000
+
+
+
+#define FAST_SYNC_EVENT_SIGNALED 0x00000001
+#define FAST_SYNC_EVENT_PULSE    0x00000002
+
+enum fast_sync_type
+{
+    FAST_SYNC_NONE,
+    FAST_SYNC_AUTO_EVENT,
+    FAST_SYNC_MANUAL_EVENT,
+    FAST_SYNC_SEMAPHORE,
+    FAST_SYNC_MUTEX
+};
+
 enum apc_type
 {
     APC_NONE,
@@ -709,6 +738,15 @@ struct rawinput_device
     user_handle_t  target;
 };
 
+struct completion_msg
+{
+    apc_param_t    ckey;
+    apc_param_t    cvalue;
+    apc_param_t    information;
+    unsigned int   status;
+    int            __pad;
+};
+
 
 
 
@@ -1393,6 +1431,22 @@ struct open_semaphore_reply
 
 
 
+struct get_fast_sync_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct get_fast_sync_reply
+{
+    struct reply_header __header;
+    unsigned int index;
+    int          type;
+    unsigned int access;
+    char __pad_20[4];
+};
+
+
+
 struct create_file_request
 {
     struct request_header __header;
@@ -1401,14 +1455,18 @@ struct create_file_request
     int          create;
     unsigned int options;
     unsigned int attrs;
+    int          unix_fd;
     /* VARARG(objattr,object_attributes); */
     /* VARARG(filename,string); */
+    char __pad_36[4];
 };
 struct create_file_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    int          cacheable;
+    unsigned int access;
+    unsigned int options;
 };
 
 
@@ -1475,6 +1533,8 @@ struct get_handle_fd_reply
     int          cacheable;
     unsigned int access;
     unsigned int options;
+    unsigned int comp_flags;
+    char __pad_28[4];
 };
 enum server_fd_type
 {
@@ -2249,6 +2309,41 @@ struct add_mapping_committed_range_reply
 };
 
 
+
+struct get_image_relocation_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+    client_ptr_t base;
+};
+struct get_image_relocation_reply
+{
+    struct reply_header __header;
+    obj_handle_t file;
+    unsigned int hits;
+    unsigned int time;
+    /* VARARG(pages,uints); */
+    char __pad_20[4];
+};
+
+
+
+struct add_image_relocation_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+    client_ptr_t base;
+    unsigned int time;
+    data_size_t  pages_size;
+    /* VARARG(pages,uints,pages_size); */
+    /* VARARG(data,bytes); */
+};
+struct add_image_relocation_reply
+{
+    struct reply_header __header;
+};
+
+
 #define SNAP_PROCESS    0x00000001
 #define SNAP_THREAD     0x00000002
 
@@ -2459,6 +2554,8 @@ struct create_key_reply
     struct reply_header __header;
     obj_handle_t hkey;
     int          created;
+    unsigned int key_id;
+    char __pad_20[4];
 };
 
 
@@ -2474,7 +2571,7 @@ struct open_key_reply
 {
     struct reply_header __header;
     obj_handle_t hkey;
-    char __pad_12[4];
+    unsigned int key_id;
 };
 
 
@@ -2555,6 +2652,8 @@ struct get_key_value_reply
     struct reply_header __header;
     int          type;
     data_size_t  total;
+    unsigned int key_id;
+    unsigned int generation;
     /* VARARG(data,bytes); */
 };
 
@@ -5104,6 +5203,19 @@ struct remove_completion_reply
 
 
 
+struct remove_completions_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct remove_completions_reply
+{
+    struct reply_header __header;
+    /* VARARG(msgs,completion_msgs); */
+};
+
+
+
 struct query_completion_request
 {
     struct request_header __header;
@@ -5118,6 +5230,56 @@ struct query_completion_reply
 
 
 
+struct create_wait_completion_packet_request
+{
+    struct request_header __header;
+    unsigned int access;
+    /* VARARG(objattr,object_attributes); */
+};
+struct create_wait_completion_packet_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    char __pad_12[4];
+};
+
+
+
+struct associate_wait_completion_packet_request
+{
+    struct request_header __header;
+    obj_handle_t  packet;
+    obj_handle_t  completion;
+    obj_handle_t  target;
+    apc_param_t   ckey;
+    apc_param_t   cvalue;
+    apc_param_t   information;
+    unsigned int  status;
+    char __pad_52[4];
+};
+struct associate_wait_completion_packet_reply
+{
+    struct reply_header __header;
+    int           signaled;
+    char __pad_12[4];
+};
+
+
+
+struct cancel_wait_completion_packet_request
+{
+    struct request_header __header;
+    obj_handle_t  packet;
+    int           remove_signaled;
+    char __pad_20[4];
+};
+struct cancel_wait_completion_packet_reply
+{
+    struct reply_header __header;
+};
+
+
+
 struct set_completion_info_request
 {
     struct request_header __header;
@@ -5140,7 +5302,7 @@ struct add_fd_completion_request
     apc_param_t    cvalue;
     apc_param_t    information;
     unsigned int   status;
-    char __pad_36[4];
+    int            async;
 };
 struct add_fd_completion_reply
 {
@@ -5149,6 +5311,36 @@ struct add_fd_completion_reply
 
 
 
+struct set_fd_signaled_request
+{
+    struct request_header __header;
+    obj_handle_t   handle;
+    int            signaled;
+    char __pad_20[4];
+};
+struct set_fd_signaled_reply
+{
+    struct reply_header __header;
+};
+
+
+
+struct set_fd_completion_mode_request
+{
+    struct request_header __header;
+    obj_handle_t   handle;
+    unsigned int   flags;
+    char __pad_20[4];
+};
+struct set_fd_completion_mode_reply
+{
+    struct reply_header __header;
+    unsigned int   flags;
+    char __pad_12[4];
+};
+
+
+
 struct set_fd_disp_info_request
 {
     struct request_header __header;
@@ -5452,6 +5644,7 @@ enum request
     REQ_release_semaphore,
     REQ_query_semaphore,
     REQ_open_semaphore,
+    REQ_get_fast_sync,
     REQ_create_file,
     REQ_open_file_object,
     REQ_alloc_file_handle,
@@ -5497,6 +5690,8 @@ enum request
     REQ_get_mapping_info,
     REQ_get_mapping_committed_range,
     REQ_add_mapping_committed_range,
+    REQ_get_image_relocation,
+    REQ_add_image_relocation,
     REQ_create_snapshot,
     REQ_next_process,
     REQ_next_thread,
@@ -5665,9 +5860,15 @@ enum request
     REQ_open_completion,
     REQ_add_completion,
     REQ_remove_completion,
+    REQ_remove_completions,
     REQ_query_completion,
+    REQ_create_wait_completion_packet,
+    REQ_associate_wait_completion_packet,
+    REQ_cancel_wait_completion_packet,
     REQ_set_completion_info,
     REQ_add_fd_completion,
+    REQ_set_fd_signaled,
+    REQ_set_fd_completion_mode,
     REQ_set_fd_disp_info,
     REQ_set_fd_name_info,
     REQ_get_window_layered_info,
@@ -5732,6 +5933,7 @@ union generic_request
     struct release_semaphore_request release_semaphore_request;
     struct query_semaphore_request query_semaphore_request;
     struct open_semaphore_request open_semaphore_request;
+    struct get_fast_sync_request get_fast_sync_request;
     struct create_file_request create_file_request;
     struct open_file_object_request open_file_object_request;
     struct alloc_file_handle_request alloc_file_handle_request;
@@ -5777,6 +5979,8 @@ union generic_request
     struct get_mapping_info_request get_mapping_info_request;
     struct get_mapping_committed_range_request get_mapping_committed_range_request;
     struct add_mapping_committed_range_request add_mapping_committed_range_request;
+    struct get_image_relocation_request get_image_relocation_request;
+    struct add_image_relocation_request add_image_relocation_request;
     struct create_snapshot_request create_snapshot_request;
     struct next_process_request next_process_request;
     struct next_thread_request next_thread_request;
@@ -5945,9 +6149,15 @@ union generic_request
     struct open_completion_request open_completion_request;
     struct add_completion_request add_completion_request;
     struct remove_completion_request remove_completion_request;
+    struct remove_completions_request remove_completions_request;
     struct query_completion_request query_completion_request;
+    struct create_wait_completion_packet_request create_wait_completion_packet_request;
+    struct associate_wait_completion_packet_request associate_wait_completion_packet_request;
+    struct cancel_wait_completion_packet_request cancel_wait_completion_packet_request;
     struct set_completion_info_request set_completion_info_request;
     struct add_fd_completion_request add_fd_completion_request;
+    struct set_fd_signaled_request set_fd_signaled_request;
+    struct set_fd_completion_mode_request set_fd_completion_mode_request;
     struct set_fd_disp_info_request set_fd_disp_info_request;
     struct set_fd_name_info_request set_fd_name_info_request;
     struct get_window_layered_info_request get_window_layered_info_request;
@@ -6010,6 +6220,7 @@ union generic_reply
     struct release_semaphore_reply release_semaphore_reply;
     struct query_semaphore_reply query_semaphore_reply;
     struct open_semaphore_reply open_semaphore_reply;
+    struct get_fast_sync_reply get_fast_sync_reply;
     struct create_file_reply create_file_reply;
     struct open_file_object_reply open_file_object_reply;
     struct alloc_file_handle_reply alloc_file_handle_reply;
@@ -6055,6 +6266,8 @@ union generic_reply
     struct get_mapping_info_reply get_mapping_info_reply;
     struct get_mapping_committed_range_reply get_mapping_committed_range_reply;
     struct add_mapping_committed_range_reply add_mapping_committed_range_reply;
+    struct get_image_relocation_reply get_image_relocation_reply;
+    struct add_image_relocation_reply add_image_relocation_reply;
     struct create_snapshot_reply create_snapshot_reply;
     struct next_process_reply next_process_reply;
     struct next_thread_reply next_thread_reply;
@@ -6223,9 +6436,15 @@ union generic_reply
     struct open_completion_reply open_completion_reply;
     struct add_completion_reply add_completion_reply;
     struct remove_completion_reply remove_completion_reply;
+    struct remove_completions_reply remove_completions_reply;
     struct query_completion_reply query_completion_reply;
+    struct create_wait_completion_packet_reply create_wait_completion_packet_reply;
+    struct associate_wait_completion_packet_reply associate_wait_completion_packet_reply;
+    struct cancel_wait_completion_packet_reply cancel_wait_completion_packet_reply;
     struct set_completion_info_reply set_completion_info_reply;
     struct add_fd_completion_reply add_fd_completion_reply;
+    struct set_fd_signaled_reply set_fd_signaled_reply;
+    struct set_fd_completion_mode_reply set_fd_completion_mode_reply;
     struct set_fd_disp_info_reply set_fd_disp_info_reply;
     struct set_fd_name_info_reply set_fd_name_info_reply;
     struct get_window_layered_info_reply get_window_layered_info_reply;
@@ -6245,6 +6464,6 @@ union generic_reply
     struct terminate_job_reply terminate_job_reply;
 };
 
-#define SERVER_PROTOCOL_VERSION 507
+#define SERVER_PROTOCOL_VERSION 518
 
 #endif /* __WINE_WINE_SERVER_PROTOCOL_H */
@@ -18,6 +18,9 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
  */
 
+#include "config.h"
+#include "wine/port.h"
+
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -319,7 +322,8 @@ void async_set_result( struct object *obj, unsigned int status, apc_param_t tota
             thread_queue_apc( async->thread, NULL, &data );
         }
         if (async->event) set_event( async->event );
-        else if (async->queue->fd) set_fd_signaled( async->queue->fd, 1 );
+        else if (async->queue->fd && !fd_skip_set_event( async->queue->fd ))
+            set_fd_signaled( async->queue->fd, 1 );
         async->signaled = 1;
         wake_up( &async->obj, 0 );
     }
@@ -41,6 +41,7 @@
 #include "object.h"
 #include "file.h"
 #include "handle.h"
+#include "thread.h"
 #include "request.h"
 
 
@@ -86,8 +87,59 @@ struct comp_msg
     apc_param_t   cvalue;
     apc_param_t   information;
     unsigned int  status;
+    struct wait_completion_packet *packet;  /* packet that queued the message */
 };
 
+struct wait_completion_packet
+{
+    struct object       obj;
+    struct thread_wait *wait;         /* pending wait on the target object */
+    struct completion  *completion;   /* port, only referenced while waiting */
+    struct comp_msg    *msg;          /* message queued to the port */
+    apc_param_t         ckey;
+    apc_param_t         cvalue;
+    apc_param_t         information;
+    unsigned int        status;
+};
+
+static void wait_packet_dump( struct object *obj, int verbose );
+static struct object_type *wait_packet_get_type( struct object *obj );
+static unsigned int wait_packet_map_access( struct object *obj, unsigned int access );
+static void wait_packet_destroy( struct object *obj );
+
+static const struct object_ops wait_packet_ops =
+{
+    sizeof(struct wait_completion_packet), /* size */
+    wait_packet_dump,          /* dump */
+    wait_packet_get_type,      /* get_type */
+    no_add_queue,              /* add_queue */
+    NULL,                      /* remove_queue */
+    NULL,                      /* signaled */
+    NULL,                      /* satisfied */
+    no_signal,                 /* signal */
+    no_get_fd,                 /* get_fd */
+    wait_packet_map_access,    /* map_access */
+    default_get_sd,            /* get_sd */
+    default_set_sd,            /* set_sd */
+    no_lookup_name,            /* lookup_name */
+    directory_link_name,       /* link_name */
+    default_unlink_name,       /* unlink_name */
+    no_open_file,              /* open_file */
+    no_close_handle,           /* close_handle */
+    wait_packet_destroy        /* destroy */
+};
+
+/* free a message removed from the queue */
+static void free_comp_msg( struct comp_msg *msg )
+{
+    if (msg->packet)
+    {
+        msg->packet->msg = NULL;
+        msg->packet->completion = NULL;
+    }
+    free( msg );
+}
+
 static void completion_destroy( struct object *obj)
 {
     struct completion *completion = (struct completion *) obj;
@@ -95,7 +147,7 @@ static void completion_destroy( struct object *obj)
 
     LIST_FOR_EACH_ENTRY_SAFE( tmp, next, &completion->queue, struct comp_msg, queue_entry )
     {
-        free( tmp );
+        free_comp_msg( tmp );
     }
 }
 
@@ -153,22 +205,96 @@ struct completion *get_completion_obj( struct process *process, obj_handle_t han
     return (struct completion *) get_handle_obj( process, handle, access, &completion_ops );
 }
 
-void add_completion( struct completion *completion, apc_param_t ckey, apc_param_t cvalue,
-                     unsigned int status, apc_param_t information )
+static struct comp_msg *queue_completion( struct completion *completion, apc_param_t ckey, apc_param_t cvalue,
+                                          unsigned int status, apc_param_t information )
 {
     struct comp_msg *msg = mem_alloc( sizeof( *msg ) );
 
     if (!msg)
-        return;
+        return NULL;
 
     msg->ckey = ckey;
     msg->cvalue = cvalue;
     msg->status = status;
     msg->information = information;
+    msg->packet = NULL;
 
     list_add_tail( &completion->queue, &msg->queue_entry );
     completion->depth++;
     wake_up( &completion->obj, 1 );
+    return msg;
+}
+
+void add_completion( struct completion *completion, apc_param_t ckey, apc_param_t cvalue,
+                     unsigned int status, apc_param_t information )
+{
+    queue_completion( completion, ckey, cvalue, status, information );
+}
+
+static void wait_packet_dump( struct object *obj, int verbose )
+{
+    struct wait_completion_packet *packet = (struct wait_completion_packet *)obj;
+
+    assert( obj->ops == &wait_packet_ops );
+    fprintf( stderr, "WaitCompletionPacket waiting=%d queued=%d\n", packet->wait != NULL, packet->msg != NULL );
+}
+
+static struct object_type *wait_packet_get_type( struct object *obj )
+{
+    static const WCHAR name[] = {'W','a','i','t','C','o','m','p','l','e','t','i','o','n','P','a','c','k','e','t'};
+    static const struct unicode_str str = { name, sizeof(name) };
+    return get_object_type( &str );
+}
+
+static unsigned int wait_packet_map_access( struct object *obj, unsigned int access )
+{
+    if (access & GENERIC_READ)    access |= STANDARD_RIGHTS_READ;
+    if (access & GENERIC_WRITE)   access |= STANDARD_RIGHTS_WRITE | WAIT_COMPLETION_PACKET_MODIFY_STATE;
+    if (access & GENERIC_EXECUTE) access |= STANDARD_RIGHTS_EXECUTE;
+    if (access & GENERIC_ALL)     access |= STANDARD_RIGHTS_ALL | WAIT_COMPLETION_PACKET_MODIFY_STATE;
+    return access & ~(GENERIC_READ | GENERIC_WRITE | GENERIC_EXECUTE | GENERIC_ALL);
+}
+
+/* cancel the pending wait of a packet */
+static void wait_packet_cancel_wait( struct wait_completion_packet *packet )
+{
+    remove_callback_wait( packet->wait );
+    packet->wait = NULL;
+    release_object( packet->completion );
+    packet->completion = NULL;
+}
+
+/* remove the message queued by a packet from its port */
+static void wait_packet_remove_msg( struct wait_completion_packet *packet )
+{
+    list_remove( &packet->msg->queue_entry );
+    packet->completion->depth--;
+    free_comp_msg( packet->msg );
+}
+
+static void wait_packet_destroy( struct object *obj )
+{
+    struct wait_completion_packet *packet = (struct wait_completion_packet *)obj;
+
+    if (packet->wait) wait_packet_cancel_wait( packet );
+    if (packet->msg) packet->msg->packet = NULL;
+}
+
+/* the target object of a packet was signaled, queue it to the port */
+static void wait_packet_signaled( void *private, unsigned int status )
+{
+    struct wait_completion_packet *packet = private;
+    struct completion *completion = packet->completion;
+
+    /* the queued message is freed when the port is destroyed, so the port
+     * doesn't need to be referenced any longer */
+    packet->wait = NULL;
+    if ((packet->msg = queue_completion( completion, packet->ckey, packet->cvalue,
+                                         packet->status, packet->information )))
+        packet->msg->packet = packet;
+    else
+        packet->completion = NULL;
+    release_object( completion );
 }
 
 /* create a completion */
@@ -234,7 +360,39 @@ DECL_HANDLER(remove_completion)
         reply->cvalue = msg->cvalue;
         reply->status = msg->status;
         reply->information = msg->information;
-        free( msg );
+        free_comp_msg( msg );
+    }
+
+    release_object( completion );
+}
+
+/* get multiple completions from completion port queue */
+DECL_HANDLER(remove_completions)
+{
+    struct completion* completion = get_completion_obj( current->process, req->handle, IO_COMPLETION_MODIFY_STATE );
+    struct completion_msg *msgs;
+    struct comp_msg *msg;
+    unsigned int i, count;
+
+    if (!completion) return;
+
+    count = min( completion->depth, get_reply_max_size() / sizeof(*msgs) );
+    if (!count)
+        set_error( STATUS_PENDING );
+    else if ((msgs = set_reply_data_size( count * sizeof(*msgs) )))
+    {
+        for (i = 0; i < count; i++)
+        {
+            msg = LIST_ENTRY( list_head( &completion->queue ), struct comp_msg, queue_entry );
+            list_remove( &msg->queue_entry );
+            msgs[i].ckey        = msg->ckey;
+            msgs[i].cvalue      = msg->cvalue;
+            msgs[i].information = msg->information;
+            msgs[i].status      = msg->status;
+            msgs[i].__pad       = 0;
+            free_comp_msg( msg );
+        }
+        completion->depth -= count;
     }
 
     release_object( completion );
@@ -251,3 +409,107 @@ DECL_HANDLER(query_completion)
 
     release_object( completion );
 }
+
+/* create a wait completion packet */
+DECL_HANDLER(create_wait_completion_packet)
+{
+    struct wait_completion_packet *packet;
+    struct unicode_str name;
+    struct object *root;
+    const struct security_descriptor *sd;
+    const struct object_attributes *objattr = get_req_object_attributes( &sd, &name, &root );
+
+    if (!objattr) return;
+
+    if ((packet = create_named_object( root, &wait_packet_ops, &name, objattr->attributes, sd )))
+    {
+        if (get_error() != STATUS_OBJECT_NAME_EXISTS)
+        {
+            packet->wait       = NULL;
+            packet->completion = NULL;
+            packet->msg        = NULL;
+        }
+        reply->handle = alloc_handle( current->process, packet, req->access, objattr->attributes );
+        release_object( packet );
+    }
+
+    if (root) release_object( root );
+}
+
+/* queue a wait completion packet once an object is signaled */
+DECL_HANDLER(associate_wait_completion_packet)
+{
+    struct wait_completion_packet *packet;
+    struct completion *completion;
+    struct object *target;
+
+    if (!(packet = (struct wait_completion_packet *)get_handle_obj( current->process, req->packet,
+                                                                    WAIT_COMPLETION_PACKET_MODIFY_STATE,
+                                                                    &wait_packet_ops )))
+        return;
+
+    if (packet->wait || packet->msg)
+    {
+        set_error( STATUS_INVALID_PARAMETER_1 );
+        release_object( packet );
+        return;
+    }
+
+    if (!(completion = get_completion_obj( current->process, req->completion, IO_COMPLETION_MODIFY_STATE )))
+    {
+        release_object( packet );
+        return;
+    }
+
+    if ((target = get_handle_obj( current->process, req->target, SYNCHRONIZE, NULL )))
+    {
+        /* a mutex would be owned by the associating thread, not by the one
+         * dequeuing the packet; the client has to wait for it itself */
+        if (is_mutex_object( target )) set_error( STATUS_OBJECT_TYPE_MISMATCH );
+        else
+        {
+            packet->ckey        = req->ckey;
+            packet->cvalue      = req->cvalue;
+            packet->information = req->information;
+            packet->status      = req->status;
+            packet->completion  = (struct completion *)grab_object( completion );
+
+            if ((packet->wait = add_callback_wait( current, target, wait_packet_signaled, packet )))
+            {
+                check_callback_wait( packet->wait );
+                reply->signaled = (packet->msg != NULL);
+            }
+            else
+            {
+                release_object( packet->completion );
+                packet->completion = NULL;
+            }
+        }
+        release_object( target );
+    }
+
+    release_object( completion );
+    release_object( packet );
+}
+
+/* cancel the wait of a wait completion packet */
+DECL_HANDLER(cancel_wait_completion_packet)
+{
+    struct wait_completion_packet *packet;
+
+    if (!(packet = (struct wait_completion_packet *)get_handle_obj( current->process, req->packet,
+                                                                    WAIT_COMPLETION_PACKET_MODIFY_STATE,
+                                                                    &wait_packet_ops )))
+        return;
+
+    if (packet->wait)
+        wait_packet_cancel_wait( packet );
+    else if (packet->msg && req->remove_signaled)
+        wait_packet_remove_msg( packet );
+    else if (packet->msg)
+        set_error( STATUS_PENDING );
+    else
+        set_error( STATUS_CANCELLED );
+
+    release_object( packet );
+}
@@ -22,6 +22,7 @@
 #include "wine/port.h"
 
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -41,22 +42,26 @@ struct event
     struct object  obj;             /* object header */
     int            manual_reset;    /* is it a manual reset event? */
     int            signaled;        /* event has been signaled */
+    unsigned int   fast_sync;       /* index of the shared state, 0 if none */
 };
 
 static void event_dump( struct object *obj, int verbose );
 static struct object_type *event_get_type( struct object *obj );
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int event_map_access( struct object *obj, unsigned int access );
 static int event_signal( struct object *obj, unsigned int access);
+static void event_destroy( struct object *obj );
 
 static const struct object_ops event_ops =
 {
     sizeof(struct event),      /* size */
     event_dump,                /* dump */
     event_get_type,            /* get_type */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    event_add_queue,           /* add_queue */
+    event_remove_queue,        /* remove_queue */
     event_signaled,            /* signaled */
     event_satisfied,           /* satisfied */
     event_signal,              /* signal */
@@ -69,7 +74,7 @@ static const struct object_ops event_ops =
     default_unlink_name,       /* unlink_name */
     no_open_file,              /* open_file */
     no_close_handle,           /* close_handle */
-    no_destroy                 /* destroy */
+    event_destroy              /* destroy */
 };
 
 
@@ -119,6 +124,7 @@ struct event *create_event( struct object *root, const struct unicode_str *name,
             /* initialize it if it didn't already exist */
             event->manual_reset = manual_reset;
             event->signaled     = initial_state;
+            event->fast_sync    = alloc_fast_sync( initial_state != 0, 0 );
         }
     }
     return event;
@@ -129,16 +135,39 @@ struct event *get_event_obj( struct process *process, obj_handle_t handle, unsig
     return (struct event *)get_handle_obj( process, handle, access, &event_ops );
 }
 
+static int is_event_signaled( struct event *event )
+{
+    if (event->fast_sync) return get_fast_sync_value( event->fast_sync ) & FAST_SYNC_EVENT_SIGNALED;
+    return event->signaled;
+}
+
 void pulse_event( struct event *event )
 {
+    if (event->fast_sync)
+    {
+        struct fast_sync_object *obj = get_fast_sync_object( event->fast_sync );
+        int server_wait = obj->value & FAST_SYNC_SERVER_WAIT;
+
+        /* clients sleeping on the shared state notice the pulse counter change; */
+        /* an auto-reset pulse goes to a single client, unless server threads wait */
+        if (!event->manual_reset && !server_wait) interlocked_xchg( &obj->count, 1 );
+        set_fast_sync_event( event->fast_sync, server_wait != 0, 1 );
+        wake_fast_sync( event->fast_sync, event->manual_reset ? INT_MAX : 1 );
+    }
     event->signaled = 1;
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
     event->signaled = 0;
+    if (event->fast_sync) set_fast_sync_event( event->fast_sync, 0, 0 );
 }
 
 void set_event( struct event *event )
 {
+    if (event->fast_sync)
+    {
+        set_fast_sync_event( event->fast_sync, 1, 0 );
+        wake_fast_sync( event->fast_sync, event->manual_reset ? INT_MAX : 1 );
+    }
     event->signaled = 1;
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
@@ -146,15 +175,25 @@ void set_event( struct event *event )
 
 void reset_event( struct event *event )
 {
+    if (event->fast_sync) set_fast_sync_event( event->fast_sync, 0, 0 );
     event->signaled = 0;
 }
 
+int get_event_fast_sync( struct object *obj, unsigned int *index )
+{
+    struct event *event = (struct event *)obj;
+
+    if (obj->ops != &event_ops || !event->fast_sync) return FAST_SYNC_NONE;
+    *index = event->fast_sync;
+    return event->manual_reset ? FAST_SYNC_MANUAL_EVENT : FAST_SYNC_AUTO_EVENT;
+}
+
 static void event_dump( struct object *obj, int verbose )
 {
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
     fprintf( stderr, "Event manual=%d signaled=%d\n",
-             event->manual_reset, event->signaled );
+             event->manual_reset, is_event_signaled( event ));
 }
 
 static struct object_type *event_get_type( struct object *obj )
@@ -164,11 +203,25 @@ static struct object_type *event_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    return fast_sync_add_queue( obj, entry, event->fast_sync );
+}
+
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    fast_sync_remove_queue( obj, entry, event->fast_sync );
+}
+
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
-    return event->signaled;
+    return is_event_signaled( event );
 }
 
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry )
@@ -176,7 +229,7 @@ static void event_satisfied( struct object *obj, struct wait_queue_entry *entry
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
     /* Reset if it's an auto-reset event */
-    if (!event->manual_reset) event->signaled = 0;
+    if (!event->manual_reset) reset_event( event );
 }
 
 static unsigned int event_map_access( struct object *obj, unsigned int access )
@@ -202,6 +255,13 @@ static int event_signal( struct object *obj, unsigned int access )
     return 1;
 }
 
+static void event_destroy( struct object *obj )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    if (event->fast_sync) free_fast_sync( event->fast_sync );
+}
+
 struct keyed_event *create_keyed_event( struct object *root, const struct unicode_str *name,
                                         unsigned int attr, const struct security_descriptor *sd )
 {
@@ -337,7 +397,7 @@ DECL_HANDLER(query_event)
     if (!(event = get_event_obj( current->process, req->handle, EVENT_QUERY_STATE ))) return;
 
     reply->manual_reset = event->manual_reset;
-    reply->state = event->signaled;
+    reply->state = is_event_signaled( event );
 
     release_object( event );
 }
@@ -0,0 +1,232 @@
+/*
+ * Server-side support for synchronization objects in shared memory
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* When enabled with WINEFASTSYNC=1, the state of events, semaphores and
+ * mutexes is kept in a file in the server directory that every client maps.
+ * Clients then signal and acquire these objects with atomic operations and
+ * sleep on the state with futexes, without a server round trip.  As soon as
+ * a thread waits on such an object in the server (multiple object waits,
+ * alertable waits, etc.) the FAST_SYNC_SERVER_WAIT flag is set and clients
+ * fall back to server requests for that object until the wait is over.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+#include <unistd.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "handle.h"
+#include "thread.h"
+#include "request.h"
+
+#define FAST_SYNC_MAX_OBJECTS 65536
+
+static const char fast_sync_file[] = "fast-sync";
+
+static struct fast_sync_object *fast_sync_objects;  /* shared objects, entry 0 is never used */
+static unsigned int fast_sync_used = 1;              /* first never allocated entry */
+static unsigned int *free_entries;                   /* stack of freed entries */
+static unsigned int free_count;
+
+/* create the shared memory area if fast synchronization is enabled */
+void init_fast_sync(void)
+{
+#if defined(__linux__) && defined(__NR_futex) && defined(HAVE_SYS_MMAN_H)
+    const char *env = getenv( "WINEFASTSYNC" );
+    size_t size = FAST_SYNC_MAX_OBJECTS * sizeof(*fast_sync_objects);
+    void *ptr;
+    int fd;
+
+    /* we are in the server directory, remove a leftover from a previous server */
+    unlink( fast_sync_file );
+    if (!env || !atoi( env )) return;
+
+    if ((fd = open( fast_sync_file, O_RDWR | O_CREAT | O_EXCL, 0600 )) == -1)
+    {
+        fprintf( stderr, "wineserver: cannot create %s: %s\n", fast_sync_file, strerror( errno ));
+        return;
+    }
+    if (ftruncate( fd, size ) == -1 ||
+        (ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) == MAP_FAILED)
+    {
+        fprintf( stderr, "wineserver: cannot map %s: %s\n", fast_sync_file, strerror( errno ));
+        close( fd );
+        unlink( fast_sync_file );
+        return;
+    }
+    close( fd );
+    if (!(free_entries = mem_alloc( FAST_SYNC_MAX_OBJECTS * sizeof(*free_entries) )))
+    {
+        munmap( ptr, size );
+        unlink( fast_sync_file );
+        return;
+    }
+    fast_sync_objects = ptr;
+    if (debug_level) fprintf( stderr, "wineserver: fast synchronization enabled\n" );
+#endif
+}
+
+/* allocate a shared object; return 0 if fast synchronization is not available */
+unsigned int alloc_fast_sync( int value, int max )
+{
+    struct fast_sync_object *obj;
+    unsigned int index;
+
+    if (!fast_sync_objects) return 0;
+    if (free_count) index = free_entries[--free_count];
+    else if (fast_sync_used < FAST_SYNC_MAX_OBJECTS) index = fast_sync_used++;
+    else return 0;
+
+    obj = &fast_sync_objects[index];
+    obj->count     = 0;
+    obj->max       = max;
+    obj->abandoned = 0;
+    obj->waiters   = 0;
+    obj->value     = value;
+    return index;
+}
+
+void free_fast_sync( unsigned int index )
+{
+    assert( index && index < fast_sync_used );
+    fast_sync_objects[index].value = 0;
+    free_entries[free_count++] = index;
+}
+
+struct fast_sync_object *get_fast_sync_object( unsigned int index )
+{
+    return &fast_sync_objects[index];
+}
+
+/* return the object value, without the server wait flag */
+int get_fast_sync_value( unsigned int index )
+{
+    return fast_sync_objects[index].value & ~FAST_SYNC_SERVER_WAIT;
+}
+
+/* atomically set the object value, preserving the server wait flag; return the previous value */
+int set_fast_sync_value( unsigned int index, int value )
+{
+    int *ptr = &fast_sync_objects[index].value;
+    int old;
+
+    do old = *ptr;
+    while (interlocked_cmpxchg( ptr, (old & FAST_SYNC_SERVER_WAIT) | value, old ) != old);
+    return old & ~FAST_SYNC_SERVER_WAIT;
+}
+
+/* atomically replace the object value if it matches compare; return the previous value */
+int cmpxchg_fast_sync_value( unsigned int index, int value, int compare )
+{
+    int *ptr = &fast_sync_objects[index].value;
+    int old;
+
+    for (;;)
+    {
+        old = *ptr;
+        if ((old & ~FAST_SYNC_SERVER_WAIT) != compare) return old & ~FAST_SYNC_SERVER_WAIT;
+        if (interlocked_cmpxchg( ptr, (old & FAST_SYNC_SERVER_WAIT) | value, old ) == old)
+            return compare;
+    }
+}
+
+/* atomically set the signaled state of an event, optionally bumping its pulse counter */
+void set_fast_sync_event( unsigned int index, int signaled, int pulse )
+{
+    int *ptr = &fast_sync_objects[index].value;
+    int old, new;
+
+    do
+    {
+        old = *ptr;
+        new = old + (pulse ? FAST_SYNC_EVENT_PULSE : 0);
+        new = (old & FAST_SYNC_SERVER_WAIT) | (new & ~(FAST_SYNC_SERVER_WAIT | FAST_SYNC_EVENT_SIGNALED));
+        if (signaled) new |= FAST_SYNC_EVENT_SIGNALED;
+    } while (interlocked_cmpxchg( ptr, new, old ) != old);
+}
+
+static void set_server_wait( unsigned int index, int set )
+{
+    int *ptr = &fast_sync_objects[index].value;
+    int old, new;
+
+    do
+    {
+        old = *ptr;
+        new = set ? (old | FAST_SYNC_SERVER_WAIT) : (old & ~FAST_SYNC_SERVER_WAIT);
+    } while (interlocked_cmpxchg( ptr, new, old ) != old);
+}
+
+/* wake up client threads sleeping on the object value */
+void wake_fast_sync( unsigned int index, int count )
+{
+#if defined(__linux__) && defined(__NR_futex)
+    if (fast_sync_objects[index].waiters)
+        syscall( __NR_futex, &fast_sync_objects[index].value, 1 /* FUTEX_WAKE */, count, NULL, 0, 0 );
+#endif
+}
+
+/* add a thread to the wait queue of an object with shared state */
+int fast_sync_add_queue( struct object *obj, struct wait_queue_entry *entry, unsigned int index )
+{
+    if (!add_queue( obj, entry )) return 0;
+    if (index) set_server_wait( index, 1 );
+    return 1;
+}
+
+/* remove a thread from the wait queue of an object with shared state */
+void fast_sync_remove_queue( struct object *obj, struct wait_queue_entry *entry, unsigned int index )
+{
+    /* give the object back to the clients once the last server waiter is gone */
+    if (index && list_head( &obj->wait_queue ) == list_tail( &obj->wait_queue ))
+        set_server_wait( index, 0 );
+    remove_queue( obj, entry );
+}
+
+/* retrieve the shared state of an event, semaphore or mutex */
+DECL_HANDLER(get_fast_sync)
+{
+    struct object *obj;
+
+    if (!(obj = get_handle_obj( current->process, req->handle, 0, NULL ))) return;
+
+    if (!(reply->type = get_event_fast_sync( obj, &reply->index )) &&
+        !(reply->type = get_semaphore_fast_sync( obj, &reply->index )))
+        reply->type = get_mutex_fast_sync( obj, &reply->index );
+    reply->access = get_handle_access( current->process, req->handle );
+    release_object( obj );
+}
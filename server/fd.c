@@ -102,6 +102,7 @@
 #include "process.h"
 #include "request.h"
 
+#include "winbase.h"
 #include "winternl.h"
 #include "winioctl.h"
 
@@ -194,6 +195,7 @@ struct fd
     struct async_queue  *wait_q;      /* other async waiters of this fd */
     struct completion   *completion;  /* completion object attached to this fd */
     apc_param_t          comp_key;    /* completion key to set in completion events */
+    unsigned int         comp_flags;  /* completion notification modes (FILE_SKIP_*) */
 };
 
 static void fd_dump( struct object *obj, int verbose );
@@ -846,6 +848,9 @@ static void remove_poll_user( struct fd *fd, int user )
 /* process pending timeouts and return the time until the next timeout, in milliseconds */
 static int get_next_timeout(void)
 {
+    /* run the requests deferred to the worker threads before waiting again */
+    flush_deferred_requests();
+
     if (!list_empty( &timeout_list ))
     {
         struct list expired_list, *ptr;
@@ -1607,6 +1612,7 @@ static struct fd *alloc_fd_object(void)
     fd->write_q    = NULL;
     fd->wait_q     = NULL;
     fd->completion = NULL;
+    fd->comp_flags = 0;
     list_init( &fd->inode_entry );
     list_init( &fd->locks );
 
@@ -1642,6 +1648,7 @@ struct fd *alloc_pseudo_fd( const struct fd_ops *fd_user_ops, struct object *use
     fd->write_q    = NULL;
     fd->wait_q     = NULL;
     fd->completion = NULL;
+    fd->comp_flags = 0;
     fd->no_fd_status = STATUS_BAD_DEVICE_TYPE;
     list_init( &fd->inode_entry );
     list_init( &fd->locks );
@@ -1746,11 +1753,92 @@ char *dup_fd_name( struct fd *root, const char *name )
     return ret;
 }
 
+/* attach a freshly opened unix fd to its inode and check the sharing mode */
+/* the closed_fd structure is always consumed; on failure the caller releases the fd */
+static int init_fd_inode( struct fd *fd, struct closed_fd *closed_fd, int flags, mode_t *mode,
+                          unsigned int access, unsigned int sharing, unsigned int options )
+{
+    struct stat st;
+
+    closed_fd->unix_fd = fd->unix_fd;
+    closed_fd->unlink = 0;
+    closed_fd->unix_name = fd->unix_name;
+    fstat( fd->unix_fd, &st );
+    *mode = st.st_mode;
+
+    /* only bother with an inode for normal files and directories */
+    if (S_ISREG(st.st_mode) || S_ISDIR(st.st_mode))
+    {
+        unsigned int err;
+        struct inode *inode = get_inode( st.st_dev, st.st_ino, fd->unix_fd );
+
+        if (!inode)
+        {
+            /* we can close the fd because there are no others open on the same file,
+             * otherwise we wouldn't have failed to allocate a new inode
+             */
+            free( closed_fd );
+            return 0;
+        }
+        fd->inode = inode;
+        fd->closed = closed_fd;
+        fd->cacheable = !inode->device->removable;
+        list_add_head( &inode->open, &fd->inode_entry );
+
+        /* check directory options */
+        if ((options & FILE_DIRECTORY_FILE) && !S_ISDIR(st.st_mode))
+        {
+            set_error( STATUS_NOT_A_DIRECTORY );
+            return 0;
+        }
+        if ((options & FILE_NON_DIRECTORY_FILE) && S_ISDIR(st.st_mode))
+        {
+            set_error( STATUS_FILE_IS_A_DIRECTORY );
+            return 0;
+        }
+        if ((err = check_sharing( fd, access, sharing, flags, options )))
+        {
+            set_error( err );
+            return 0;
+        }
+
+        /* can't unlink files if we don't have permission to access */
+        if ((options & FILE_DELETE_ON_CLOSE) && !(flags & O_CREAT) &&
+            !(st.st_mode & (S_IWUSR | S_IWGRP | S_IWOTH)))
+        {
+            set_error( STATUS_CANNOT_DELETE );
+            return 0;
+        }
+
+        fd->closed->unlink = (options & FILE_DELETE_ON_CLOSE) != 0;
+        if (flags & O_TRUNC)
+        {
+            if (S_ISDIR(st.st_mode))
+            {
+                set_error( STATUS_OBJECT_NAME_COLLISION );
+                return 0;
+            }
+            ftruncate( fd->unix_fd, 0 );
+        }
+    }
+    else  /* special file */
+    {
+        if (options & FILE_DELETE_ON_CLOSE)  /* we can't unlink special files */
+        {
+            set_error( STATUS_INVALID_PARAMETER );
+            free( closed_fd );
+            return 0;
+        }
+        free( closed_fd );
+        fd->cacheable = 1;
+    }
+    return 1;
+}
+
 /* open() wrapper that returns a struct fd with no fd user set */
 struct fd *open_fd( struct fd *root, const char *name, int flags, mode_t *mode, unsigned int access,
                     unsigned int sharing, unsigned int options )
 {
-    struct stat st;
     struct closed_fd *closed_fd;
     struct fd *fd;
     int root_fd = -1;
@@ -1822,76 +1910,10 @@ struct fd *open_fd( struct fd *root, const char *name, int flags, mode_t *mode,
         }
     }
 
-    closed_fd->unix_fd = fd->unix_fd;
-    closed_fd->unlink = 0;
-    closed_fd->unix_name = fd->unix_name;
-    fstat( fd->unix_fd, &st );
-    *mode = st.st_mode;
-
-    /* only bother with an inode for normal files and directories */
-    if (S_ISREG(st.st_mode) || S_ISDIR(st.st_mode))
+    if (!init_fd_inode( fd, closed_fd, flags, mode, access, sharing, options ))
     {
-        unsigned int err;
-        struct inode *inode = get_inode( st.st_dev, st.st_ino, fd->unix_fd );
-
-        if (!inode)
-        {
-            /* we can close the fd because there are no others open on the same file,
-             * otherwise we wouldn't have failed to allocate a new inode
-             */
-            goto error;
-        }
-        fd->inode = inode;
-        fd->closed = closed_fd;
-        fd->cacheable = !inode->device->removable;
-        list_add_head( &inode->open, &fd->inode_entry );
         closed_fd = NULL;
-
-        /* check directory options */
-        if ((options & FILE_DIRECTORY_FILE) && !S_ISDIR(st.st_mode))
-        {
-            set_error( STATUS_NOT_A_DIRECTORY );
-            goto error;
-        }
-        if ((options & FILE_NON_DIRECTORY_FILE) && S_ISDIR(st.st_mode))
-        {
-            set_error( STATUS_FILE_IS_A_DIRECTORY );
-            goto error;
-        }
-        if ((err = check_sharing( fd, access, sharing, flags, options )))
-        {
-            set_error( err );
-            goto error;
-        }
-
-        /* can't unlink files if we don't have permission to access */
-        if ((options & FILE_DELETE_ON_CLOSE) && !(flags & O_CREAT) &&
-            !(st.st_mode & (S_IWUSR | S_IWGRP | S_IWOTH)))
-        {
-            set_error( STATUS_CANNOT_DELETE );
-            goto error;
-        }
-
-        fd->closed->unlink = (options & FILE_DELETE_ON_CLOSE) != 0;
-        if (flags & O_TRUNC)
-        {
-            if (S_ISDIR(st.st_mode))
-            {
-                set_error( STATUS_OBJECT_NAME_COLLISION );
-                goto error;
-            }
-            ftruncate( fd->unix_fd, 0 );
-        }
-    }
-    else  /* special file */
-    {
-        if (options & FILE_DELETE_ON_CLOSE)  /* we can't unlink special files */
-        {
-            set_error( STATUS_INVALID_PARAMETER );
-            goto error;
-        }
-        free( closed_fd );
-        fd->cacheable = 1;
+        goto error;
     }
     if (root_fd != -1) fchdir( server_dir_fd ); /* go back to the server dir */
     return fd;
@@ -1903,6 +1925,42 @@ error:
     return NULL;
 }
 
+/* create a struct fd for a file the client has already opened itself */
+/* if the function fails the unix fd is closed */
+struct fd *open_client_fd( int unix_fd, const char *name, mode_t *mode, unsigned int access,
+                           unsigned int sharing, unsigned int options )
+{
+    struct closed_fd *closed_fd;
+    struct fd *fd;
+
+    if ((options & FILE_DELETE_ON_CLOSE) && !(access & DELETE))
+    {
+        set_error( STATUS_INVALID_PARAMETER );
+        close( unix_fd );
+        return NULL;
+    }
+    if (!(fd = alloc_fd_object()))
+    {
+        close( unix_fd );
+        return NULL;
+    }
+    fd->options = options;
+    fd->unix_fd = unix_fd;
+    if (!(closed_fd = mem_alloc( sizeof(*closed_fd) )))
+    {
+        release_object( fd );
+        return NULL;
+    }
+    fd->unix_name = dup_fd_name( NULL, name );
+
+    if (!init_fd_inode( fd, closed_fd, 0, mode, access, sharing, options ))
+    {
+        release_object( fd );
+        return NULL;
+    }
+    return fd;
+}
+
 /* create an fd for an anonymous file */
 /* if the function fails the unix fd is closed */
 struct fd *create_anonymous_fd( const struct fd_ops *fd_user_ops, int unix_fd, struct object *user,
@@ -2376,6 +2434,12 @@ struct completion *fd_get_completion( struct fd *fd, apc_param_t *p_key )
     return fd->completion ? (struct completion *)grab_object( fd->completion ) : NULL;
 }
 
+/* check whether completed operations should leave the file handle unsignaled */
+int fd_skip_set_event( struct fd *fd )
+{
+    return (fd->comp_flags & FILE_SKIP_SET_EVENT_ON_HANDLE) != 0;
+}
+
 void fd_copy_completion( struct fd *src, struct fd *dst )
 {
     assert( !dst->completion );
@@ -2446,6 +2510,7 @@ DECL_HANDLER(get_handle_fd)
             reply->type = fd->fd_ops->get_fd_type( fd );
             reply->cacheable = fd->cacheable;
             reply->options = fd->options;
+            reply->comp_flags = fd->comp_flags;
             reply->access = get_handle_access( current->process, req->handle );
             send_client_fd( current->process, unix_fd, req->handle );
         }
@@ -2556,12 +2621,42 @@ DECL_HANDLER(add_fd_completion)
     struct fd *fd = get_handle_fd_obj( current->process, req->handle, 0 );
     if (fd)
     {
-        if (fd->completion)
+        /* the client may not know about the modes yet if it used a stale cached fd */
+        if (fd->completion && (req->async || req->status != STATUS_SUCCESS ||
+                               !(fd->comp_flags & FILE_SKIP_COMPLETION_PORT_ON_SUCCESS)))
             add_completion( fd->completion, fd->comp_key, req->cvalue, req->status, req->information );
         release_object( fd );
     }
 }
 
+/* set the signaled state of a fd, same as queuing or completing a server async without an event */
+DECL_HANDLER(set_fd_signaled)
+{
+    struct fd *fd = get_handle_fd_obj( current->process, req->handle, 0 );
+    if (fd)
+    {
+        if (!req->signaled || !(fd->comp_flags & FILE_SKIP_SET_EVENT_ON_HANDLE))
+            set_fd_signaled( fd, req->signaled );
+        release_object( fd );
+    }
+}
+
+/* set or retrieve the completion notification modes of a fd */
+DECL_HANDLER(set_fd_completion_mode)
+{
+    struct fd *fd = get_handle_fd_obj( current->process, req->handle, 0 );
+    if (fd)
+    {
+        /* modes can only be added, never removed */
+        if (req->flags & ~(FILE_SKIP_COMPLETION_PORT_ON_SUCCESS | FILE_SKIP_SET_EVENT_ON_HANDLE))
+            set_error( STATUS_INVALID_PARAMETER );
+        else
+            fd->comp_flags |= req->flags;
+        reply->flags = fd->comp_flags;
+        release_object( fd );
+    }
+}
+
 /* set fd disposition information */
 DECL_HANDLER(set_fd_disp_info)
 {
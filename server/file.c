@@ -266,6 +266,53 @@ done:
     return obj;
 }
 
+/* open an existing regular file using a unix fd opened by the client */
+/* returns NULL without setting an error if the fd is not suitable */
+static struct object *create_file_from_client_fd( int unix_fd, const char *nameptr, data_size_t len,
+                                                  unsigned int access, unsigned int sharing,
+                                                  unsigned int options, int *cacheable )
+{
+    struct object *obj = NULL;
+    struct stat st;
+    struct fd *fd;
+    int rw_mode, flags;
+    char *name;
+    mode_t mode;
+
+    access = generic_file_map_access( access );
+    if (access & FILE_UNIX_WRITE_ACCESS)
+        rw_mode = (access & FILE_UNIX_READ_ACCESS) ? O_RDWR : O_WRONLY;
+    else
+        rw_mode = O_RDONLY;
+
+    /* the fd must be opened exactly as open_fd() would have done it */
+    if (!len || nameptr[0] != '/' || (options & FILE_DIRECTORY_FILE) ||
+        fstat( unix_fd, &st ) == -1 || !S_ISREG(st.st_mode) ||
+        (flags = fcntl( unix_fd, F_GETFL )) == -1 || (flags & O_ACCMODE) != rw_mode)
+    {
+        close( unix_fd );
+        return NULL;
+    }
+    if (!(flags & O_NONBLOCK)) fcntl( unix_fd, F_SETFL, flags | O_NONBLOCK );
+
+    if (!(name = mem_alloc( len + 1 )))
+    {
+        close( unix_fd );
+        return NULL;
+    }
+    memcpy( name, nameptr, len );
+    name[len] = 0;
+
+    if ((fd = open_client_fd( unix_fd, name, &mode, access, sharing, options )))
+    {
+        obj = create_file_obj( fd, access, mode );
+        *cacheable = !is_fd_removable( fd );
+        release_object( fd );
+    }
+    free( name );
+    return obj;
+}
+
 /* check if two file objects point to the same file */
 int is_same_file( struct file *file1, struct file *file2 )
 {
@@ -724,13 +771,34 @@ DECL_HANDLER(create_file)
 
     name = get_req_data_after_objattr( objattr, &name_len );
 
-    reply->handle = 0;
-    if ((file = create_file( root_fd, name, name_len, req->access, req->sharing,
-                             req->create, req->options, req->attrs, sd )))
+    reply->handle    = 0;
+    reply->cacheable = 0;
+    file = NULL;
+    if (req->unix_fd != -1)
     {
-        reply->handle = alloc_handle( current->process, file, req->access, objattr->attributes );
-        release_object( file );
+        int unix_fd = thread_get_inflight_fd( current, req->unix_fd );
+
+        if (unix_fd != -1 && !root_fd && req->create == FILE_OPEN)
+            file = create_file_from_client_fd( unix_fd, name, name_len, req->access,
+                                               req->sharing, req->options, &reply->cacheable );
+        else if (unix_fd != -1)
+            close( unix_fd );
+        if (get_error()) goto done;
+    }
+    if (!file && !(file = create_file( root_fd, name, name_len, req->access, req->sharing,
+                                       req->create, req->options, req->attrs, sd )))
+        goto done;
+
+    reply->handle = alloc_handle( current->process, file, req->access, objattr->attributes );
+    if (reply->handle)
+    {
+        reply->access  = get_handle_access( current->process, reply->handle );
+        reply->options = req->options;
     }
+    else reply->cacheable = 0;
+    release_object( file );
+
+done:
     if (root_fd) release_object( root_fd );
 }
 
@@ -346,7 +346,11 @@ static void mailslot_queue_async( struct fd *fd, const async_data_t *data, int t
 
 static void mailslot_device_dump( struct object *obj, int verbose )
 {
-    fputs( "Mailslot device\n", stderr );
+    struct mailslot_device *device = (struct mailslot_device *)obj;
+
+    fputs( "Mailslot device ", stderr );
+    dump_namespace( device->mailslots );
+    fputc( '\n', stderr );
 }
 
 static struct object_type *mailslot_device_get_type( struct object *obj )
@@ -389,7 +393,7 @@ static void mailslot_device_destroy( struct object *obj )
     struct mailslot_device *device = (struct mailslot_device*)obj;
     assert( obj->ops == &mailslot_device_ops );
     if (device->fd) release_object( device->fd );
-    free( device->mailslots );
+    free_namespace( device->mailslots );
 }
 
 static enum server_fd_type mailslot_device_get_fd_type( struct fd *fd )
@@ -143,8 +143,10 @@ int main( int argc, char *argv[] )
 
     if (debug_level) fprintf( stderr, "wineserver: starting (pid=%ld)\n", (long) getpid() );
     init_signals();
+    init_fast_sync();
     init_directories();
     init_registry();
+    init_request_workers();
     main_loop();
     return 0;
 }
@@ -18,10 +18,13 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
  */
 
+#define _GNU_SOURCE  /* for memfd_create */
+
 #include "config.h"
 #include "wine/port.h"
 
 #include <assert.h>
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -55,6 +58,21 @@ struct ranges
     } ranges[1];
 };
 
+/* pages of a PE image relocated to a given address, shared between processes */
+struct image_reloc
+{
+    struct list     entry;           /* entry in the mapping relocs list */
+    client_ptr_t    base;            /* address the image was relocated to */
+    mem_size_t      map_size;        /* size of the image, to detect a modified file */
+    unsigned int    file_size;       /* size of the image file */
+    unsigned int    timestamp;       /* time stamp of the image header */
+    struct file    *file;            /* temp file holding the relocated pages */
+    unsigned int   *pages;           /* offsets of the relocated pages in the image */
+    unsigned int    count;           /* number of relocated pages */
+    unsigned int    hits;            /* number of times the pages have been reused */
+    unsigned int    time;            /* time it took to relocate the image, in microseconds */
+};
+
 struct mapping
 {
     struct object   obj;             /* object header */
@@ -64,9 +82,12 @@ struct mapping
     struct fd      *fd;              /* fd for mapped file */
     enum cpu_type   cpu;             /* client CPU (for PE image mapping) */
     pe_image_info_t image;           /* image info (for PE image mapping) */
+    unsigned int    image_timestamp; /* time stamp of the PE header */
     struct ranges  *committed;       /* list of committed ranges in this mapping */
     struct file    *shared_file;     /* temp file for shared PE mapping */
     struct list     shared_entry;    /* entry in global shared PE mappings list */
+    struct list     image_entry;     /* entry in global PE image mappings list */
+    struct list     relocs;          /* relocated pages of this image */
 };
 
 static void mapping_dump( struct object *obj, int verbose );
@@ -113,6 +134,7 @@ static const struct fd_ops mapping_fd_ops =
 };
 
 static struct list shared_list = LIST_INIT(shared_list);
+static struct list image_list = LIST_INIT(image_list);
 
 static size_t page_mask;
 
@@ -160,6 +182,87 @@ static int check_current_dir_for_exec(void)
     return (ret != MAP_FAILED);
 }
 
+#ifdef HAVE_MEMFD_CREATE
+
+/* check if memfd files can be created and mapped with exec permission */
+static int check_memfd_for_exec(void)
+{
+    void *ret = MAP_FAILED;
+    int fd;
+
+    if ((fd = memfd_create( "wine-anonmap", MFD_CLOEXEC )) == -1) return 0;
+    if (!ftruncate( fd, get_page_size() ))
+    {
+        ret = mmap( NULL, get_page_size(), PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0 );
+        if (ret != MAP_FAILED) munmap( ret, get_page_size() );
+    }
+    close( fd );
+    return (ret != MAP_FAILED);
+}
+
+/* create a memory file for anonymous mappings, without touching the file system */
+static int create_memfd( file_pos_t size )
+{
+    static int use_memfd = -1;
+    off_t unix_size = size;
+    int fd;
+
+    if (use_memfd == -1) use_memfd = check_memfd_for_exec();
+    if (!use_memfd || unix_size != size) return -1;
+
+    if ((fd = memfd_create( "wine-anonmap", MFD_CLOEXEC | MFD_ALLOW_SEALING )) == -1) return -1;
+    if (ftruncate( fd, unix_size ) == -1)
+    {
+        close( fd );
+        return -1;
+    }
+    /* views would get SIGBUS if the file could be truncated */
+    fcntl( fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL );
+    return fd;
+}
+
+/* create a memory file backed by huge pages; the size is rounded to the huge page size */
+static int create_large_pages_file( mem_size_t *size )
+{
+#if defined(MFD_HUGETLB) && defined(HAVE_FALLOCATE)
+    struct stat st;
+    mem_size_t huge_mask, new_size;
+    off_t unix_size;
+    int fd;
+
+    if ((fd = memfd_create( "wine-largepages", MFD_CLOEXEC | MFD_HUGETLB )) == -1) return -1;
+    if (fstat( fd, &st ) == -1 || st.st_blksize <= get_page_size()) goto failed;
+
+    huge_mask = st.st_blksize - 1;
+    new_size = (*size + huge_mask) & ~huge_mask;
+    unix_size = new_size;
+    if (unix_size != new_size || ftruncate( fd, unix_size ) == -1) goto failed;
+    /* large pages are never paged out, so reserve them all right away */
+    if (fallocate( fd, 0, 0, unix_size ) == -1) goto failed;
+
+    *size = new_size;
+    return fd;
+
+failed:
+    close( fd );
+#endif
+    return -1;
+}
+
+#else  /* HAVE_MEMFD_CREATE */
+
+static int create_memfd( file_pos_t size )
+{
+    return -1;
+}
+
+static int create_large_pages_file( mem_size_t *size )
+{
+    return -1;
+}
+
+#endif  /* HAVE_MEMFD_CREATE */
+
 /* create a temp file for anonymous mappings */
 static int create_temp_file( file_pos_t size )
 {
@@ -167,6 +270,8 @@ static int create_temp_file( file_pos_t size )
     char tmpfn[] = "anonmap.XXXXXX";
     int fd;
 
+    if ((fd = create_memfd( size )) != -1) return fd;
+
     if (temp_dir_fd == -1)
     {
         temp_dir_fd = server_dir_fd;
@@ -209,6 +314,96 @@ static struct file *get_shared_file( struct mapping *mapping )
     return NULL;
 }
 
+/* find the relocated pages of an image mapped at a given address */
+static struct image_reloc *find_image_reloc( struct mapping *mapping, client_ptr_t base )
+{
+    struct mapping *ptr;
+    struct image_reloc *reloc;
+
+    LIST_FOR_EACH_ENTRY( ptr, &image_list, struct mapping, image_entry )
+    {
+        if (!is_same_file_fd( ptr->fd, mapping->fd )) continue;
+        LIST_FOR_EACH_ENTRY( reloc, &ptr->relocs, struct image_reloc, entry )
+        {
+            /* the file may have been rewritten in place since the pages were relocated */
+            if (reloc->base == base && reloc->map_size == mapping->image.map_size &&
+                reloc->file_size == mapping->image.file_size && reloc->timestamp == mapping->image_timestamp)
+                return reloc;
+        }
+    }
+    return NULL;
+}
+
+/* store the pages of an image relocated by a client into a temp file */
+static void add_image_reloc( struct mapping *mapping, client_ptr_t base, unsigned int time,
+                             const unsigned int *pages, unsigned int count, const char *data )
+{
+    struct image_reloc *reloc;
+    unsigned int i;
+    int unix_fd;
+
+    for (i = 0; i < count; i++)
+    {
+        if ((pages[i] & page_mask) || pages[i] >= mapping->size || (i && pages[i] <= pages[i - 1]))
+        {
+            set_error( STATUS_INVALID_PARAMETER );
+            return;
+        }
+    }
+
+    if (!(reloc = mem_alloc( sizeof(*reloc) ))) return;
+    if (!(reloc->pages = memdup( pages, count * sizeof(*pages) )))
+    {
+        set_error( STATUS_NO_MEMORY );
+        goto error;
+    }
+    if ((unix_fd = create_temp_file( mapping->size )) == -1) goto error;
+    for (i = 0; i < count; i++)
+    {
+        if (pwrite( unix_fd, data + i * (page_mask + 1), page_mask + 1, pages[i] ) != page_mask + 1)
+        {
+            file_set_error();
+            close( unix_fd );
+            goto error;
+        }
+    }
+    if (!(reloc->file = create_file_for_fd( unix_fd, FILE_GENERIC_READ|FILE_GENERIC_WRITE, 0 ))) goto error;
+    reloc->base      = base;
+    reloc->map_size  = mapping->image.map_size;
+    reloc->file_size = mapping->image.file_size;
+    reloc->timestamp = mapping->image_timestamp;
+    reloc->count     = count;
+    reloc->hits      = 0;
+    reloc->time      = time;
+    list_add_tail( &mapping->relocs, &reloc->entry );
+    return;
+
+error:
+    free( reloc->pages );
+    free( reloc );
+}
+
+/* hand over the relocated pages of a destroyed mapping to another mapping of the same image */
+static void release_image_relocs( struct mapping *mapping )
+{
+    struct mapping *ptr;
+    struct image_reloc *reloc, *next;
+
+    LIST_FOR_EACH_ENTRY( ptr, &image_list, struct mapping, image_entry )
+    {
+        if (!is_same_file_fd( ptr->fd, mapping->fd )) continue;
+        list_move_tail( &ptr->relocs, &mapping->relocs );
+        return;
+    }
+    LIST_FOR_EACH_ENTRY_SAFE( reloc, next, &mapping->relocs, struct image_reloc, entry )
+    {
+        list_remove( &reloc->entry );
+        release_object( reloc->file );
+        free( reloc->pages );
+        free( reloc );
+    }
+}
+
 /* return the size of the memory mapping and file range of a given section */
 static inline void get_section_sizes( const IMAGE_SECTION_HEADER *sec, size_t *map_size,
                                       off_t *file_start, size_t *file_size )
@@ -469,6 +664,7 @@ static unsigned int get_image_params( struct mapping *mapping, file_pos_t file_s
     }
     mapping->image.image_charact = nt.FileHeader.Characteristics;
     mapping->image.machine       = nt.FileHeader.Machine;
+    mapping->image_timestamp     = nt.FileHeader.TimeDateStamp;
     mapping->image.zerobits      = 0; /* FIXME */
     mapping->image.gp            = 0; /* FIXME */
     mapping->image.contains_code = 0; /* FIXME */
@@ -489,6 +685,7 @@ static unsigned int get_image_params( struct mapping *mapping, file_pos_t file_s
     if (!build_shared_mapping( mapping, unix_fd, sec, nt.FileHeader.NumberOfSections )) goto error;
 
     if (mapping->shared_file) list_add_head( &shared_list, &mapping->shared_entry );
+    list_add_head( &image_list, &mapping->image_entry );
 
     free( sec );
     return 0;
@@ -522,6 +719,8 @@ static struct object *create_mapping( struct object *root, const struct unicode_
     mapping->fd          = NULL;
     mapping->shared_file = NULL;
     mapping->committed   = NULL;
+    list_init( &mapping->image_entry );
+    list_init( &mapping->relocs );
 
     if (protect & VPROT_READ) access |= FILE_READ_DATA;
     if (protect & VPROT_WRITE) access |= FILE_WRITE_DATA;
@@ -599,7 +798,11 @@ static struct object *create_mapping( struct object *root, const struct unicode_
             mapping->committed->max   = 8;
         }
         mapping->size = (mapping->size + page_mask) & ~((mem_size_t)page_mask);
-        if ((unix_fd = create_temp_file( mapping->size )) == -1) goto error;
+        unix_fd = -1;
+        /* fall back to normal pages if no huge pages are available */
+        if ((flags & SEC_LARGE_PAGES) && !(flags & SEC_RESERVE))
+            unix_fd = create_large_pages_file( &mapping->size );
+        if (unix_fd == -1 && (unix_fd = create_temp_file( mapping->size )) == -1) goto error;
         if (!(mapping->fd = create_anonymous_fd( &mapping_fd_ops, unix_fd, &mapping->obj,
                                                  FILE_SYNCHRONOUS_IO_NONALERT ))) goto error;
         allow_fd_caching( mapping->fd );
@@ -676,6 +879,8 @@ static void mapping_destroy( struct object *obj )
         release_object( mapping->shared_file );
         list_remove( &mapping->shared_entry );
     }
+    list_remove( &mapping->image_entry );
+    if (!list_empty( &mapping->relocs )) release_image_relocs( mapping );
     free( mapping->committed );
 }
 
@@ -802,3 +1007,48 @@ DECL_HANDLER(add_mapping_committed_range)
         release_object( mapping );
     }
 }
+
+/* get the pages of an image already relocated at a given address by another process */
+DECL_HANDLER(get_image_relocation)
+{
+    struct mapping *mapping;
+    struct image_reloc *reloc;
+
+    if (!(mapping = get_mapping_obj( current->process, req->handle, SECTION_QUERY ))) return;
+
+    if (!(mapping->flags & SEC_IMAGE) || mapping->shared_file)
+        set_error( STATUS_NOT_SUPPORTED );
+    else if (!(reloc = find_image_reloc( mapping, req->base )))
+        set_error( STATUS_NOT_FOUND );
+    else if (reloc->count * sizeof(*reloc->pages) > get_reply_max_size())
+        set_error( STATUS_BUFFER_TOO_SMALL );
+    else if ((reply->file = alloc_handle( current->process, reloc->file, GENERIC_READ, 0 )))
+    {
+        reply->hits = ++reloc->hits;
+        reply->time = reloc->time;
+        set_reply_data( reloc->pages, reloc->count * sizeof(*reloc->pages) );
+    }
+    release_object( mapping );
+}
+
+/* store the pages of an image relocated at a given address, for use by other processes */
+DECL_HANDLER(add_image_relocation)
+{
+    struct mapping *mapping;
+    const unsigned int *pages = get_req_data();
+    data_size_t size = get_req_data_size();
+    unsigned int count = req->pages_size / sizeof(*pages);
+
+    if (!(mapping = get_mapping_obj( current->process, req->handle, SECTION_QUERY ))) return;
+
+    if (!(mapping->flags & SEC_IMAGE) || mapping->shared_file)
+        set_error( STATUS_NOT_SUPPORTED );
+    else if (!count || (req->pages_size % sizeof(*pages)) || (req->base & page_mask) ||
+             req->pages_size > size || (size - req->pages_size) / count != page_mask + 1 ||
+             (size - req->pages_size) % count)
+        set_error( STATUS_INVALID_PARAMETER );
+    else if (!find_image_reloc( mapping, req->base ))
+        add_image_reloc( mapping, req->base, req->time, pages, count,
+                         (const char *)get_req_data() + req->pages_size );
+    release_object( mapping );
+}
@@ -42,11 +42,18 @@ struct mutex
     struct thread *owner;           /* mutex owner */
     unsigned int   count;           /* recursion count */
     int            abandoned;       /* has it been abandoned? */
-    struct list    entry;           /* entry in owner thread mutex list */
+    struct list    entry;           /* entry in owner thread mutex list, or in fast mutex list */
+    unsigned int   fast_sync;       /* index of the shared state, 0 if none */
 };
 
+/* mutexes with shared state; their owner, recursion count and abandoned */
+/* flag live in the shared object and can change without the server knowing */
+static struct list fast_mutexes = LIST_INIT( fast_mutexes );
+
 static void mutex_dump( struct object *obj, int verbose );
 static struct object_type *mutex_get_type( struct object *obj );
+static int mutex_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void mutex_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int mutex_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int mutex_map_access( struct object *obj, unsigned int access );
@@ -58,8 +65,8 @@ static const struct object_ops mutex_ops =
     sizeof(struct mutex),      /* size */
     mutex_dump,                /* dump */
     mutex_get_type,            /* get_type */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    mutex_add_queue,           /* add_queue */
+    mutex_remove_queue,        /* remove_queue */
     mutex_signaled,            /* signaled */
     mutex_satisfied,           /* satisfied */
     mutex_signal,              /* signal */
@@ -79,6 +86,13 @@ static const struct object_ops mutex_ops =
 /* grab a mutex for a given thread */
 static void do_grab( struct mutex *mutex, struct thread *thread )
 {
+    if (mutex->fast_sync)
+    {
+        struct fast_sync_object *obj = get_fast_sync_object( mutex->fast_sync );
+        assert( !obj->count || get_fast_sync_value( mutex->fast_sync ) == thread->id );
+        if (!obj->count++) set_fast_sync_value( mutex->fast_sync, thread->id );
+        return;
+    }
     assert( !mutex->count || (mutex->owner == thread) );
 
     if (!mutex->count++)  /* FIXME: avoid wrap-around */
@@ -92,6 +106,14 @@ static void do_grab( struct mutex *mutex, struct thread *thread )
 /* release a mutex once the recursion count is 0 */
 static void do_release( struct mutex *mutex )
 {
+    if (mutex->fast_sync)
+    {
+        assert( !get_fast_sync_object( mutex->fast_sync )->count );
+        set_fast_sync_value( mutex->fast_sync, 0 );
+        wake_fast_sync( mutex->fast_sync, 1 );
+        wake_up( &mutex->obj, 0 );
+        return;
+    }
     assert( !mutex->count );
     /* remove the mutex from the thread list of owned mutexes */
     list_remove( &mutex->entry );
@@ -112,6 +134,8 @@ static struct mutex *create_mutex( struct object *root, const struct unicode_str
             mutex->count = 0;
             mutex->owner = NULL;
             mutex->abandoned = 0;
+            if ((mutex->fast_sync = alloc_fast_sync( 0, 0 )))
+                list_add_tail( &fast_mutexes, &mutex->entry );
             if (owned) do_grab( mutex, current );
         }
     }
@@ -130,13 +154,73 @@ void abandon_mutexes( struct thread *thread )
         mutex->abandoned = 1;
         do_release( mutex );
     }
+
+    LIST_FOR_EACH( ptr, &fast_mutexes )
+    {
+        struct mutex *mutex = LIST_ENTRY( ptr, struct mutex, entry );
+        struct fast_sync_object *obj = get_fast_sync_object( mutex->fast_sync );
+
+        if (get_fast_sync_value( mutex->fast_sync ) != thread->id) continue;
+        obj->count = 0;
+        obj->abandoned = 1;
+        grab_object( mutex );
+        do_release( mutex );
+        release_object( mutex );
+        /* restart at the head of the list since waking up threads can destroy mutexes */
+        ptr = &fast_mutexes;
+    }
+}
+
+/* release the mutex once if it is owned by the current thread */
+static int release_mutex( struct mutex *mutex, unsigned int *prev )
+{
+    if (mutex->fast_sync)
+    {
+        struct fast_sync_object *obj = get_fast_sync_object( mutex->fast_sync );
+
+        if (!obj->count || get_fast_sync_value( mutex->fast_sync ) != current->id)
+        {
+            set_error( STATUS_MUTANT_NOT_OWNED );
+            return 0;
+        }
+        if (prev) *prev = obj->count;
+        if (!--obj->count) do_release( mutex );
+        return 1;
+    }
+    if (!mutex->count || (mutex->owner != current))
+    {
+        set_error( STATUS_MUTANT_NOT_OWNED );
+        return 0;
+    }
+    if (prev) *prev = mutex->count;
+    if (!--mutex->count) do_release( mutex );
+    return 1;
+}
+
+/* check if an object is a mutex, which can only be acquired by a waiting thread */
+int is_mutex_object( struct object *obj )
+{
+    return obj->ops == &mutex_ops;
+}
+
+int get_mutex_fast_sync( struct object *obj, unsigned int *index )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+
+    if (obj->ops != &mutex_ops || !mutex->fast_sync) return FAST_SYNC_NONE;
+    *index = mutex->fast_sync;
+    return FAST_SYNC_MUTEX;
 }
 
 static void mutex_dump( struct object *obj, int verbose )
 {
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
-    fprintf( stderr, "Mutex count=%u owner=%p\n", mutex->count, mutex->owner );
+    if (mutex->fast_sync)
+        fprintf( stderr, "Mutex count=%u owner=%04x\n", get_fast_sync_object( mutex->fast_sync )->count,
+                 get_fast_sync_value( mutex->fast_sync ));
+    else
+        fprintf( stderr, "Mutex count=%u owner=%p\n", mutex->count, mutex->owner );
 }
 
 static struct object_type *mutex_get_type( struct object *obj )
@@ -146,10 +230,30 @@ static struct object_type *mutex_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int mutex_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+    assert( obj->ops == &mutex_ops );
+    return fast_sync_add_queue( obj, entry, mutex->fast_sync );
+}
+
+static void mutex_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+    assert( obj->ops == &mutex_ops );
+    fast_sync_remove_queue( obj, entry, mutex->fast_sync );
+}
+
 static int mutex_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
+
+    if (mutex->fast_sync)
+    {
+        thread_id_t owner = get_fast_sync_value( mutex->fast_sync );
+        return (!owner || owner == get_wait_queue_thread( entry )->id);
+    }
     return (!mutex->count || (mutex->owner == get_wait_queue_thread( entry )));
 }
 
@@ -159,6 +263,12 @@ static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry
     assert( obj->ops == &mutex_ops );
 
     do_grab( mutex, get_wait_queue_thread( entry ));
+    if (mutex->fast_sync)
+    {
+        if (interlocked_xchg( &get_fast_sync_object( mutex->fast_sync )->abandoned, 0 ))
+            make_wait_abandoned( entry );
+        return;
+    }
     if (mutex->abandoned) make_wait_abandoned( entry );
     mutex->abandoned = 0;
 }
@@ -182,13 +292,7 @@ static int mutex_signal( struct object *obj, unsigned int access )
         set_error( STATUS_ACCESS_DENIED );
         return 0;
     }
-    if (!mutex->count || (mutex->owner != current))
-    {
-        set_error( STATUS_MUTANT_NOT_OWNED );
-        return 0;
-    }
-    if (!--mutex->count) do_release( mutex );
-    return 1;
+    return release_mutex( mutex, NULL );
 }
 
 static void mutex_destroy( struct object *obj )
@@ -196,6 +300,12 @@ static void mutex_destroy( struct object *obj )
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
 
+    if (mutex->fast_sync)
+    {
+        list_remove( &mutex->entry );
+        free_fast_sync( mutex->fast_sync );
+        return;
+    }
     if (!mutex->count) return;
     mutex->count = 0;
     do_release( mutex );
@@ -242,12 +352,7 @@ DECL_HANDLER(release_mutex)
     if ((mutex = (struct mutex *)get_handle_obj( current->process, req->handle,
                                                  0, &mutex_ops )))
     {
-        if (!mutex->count || (mutex->owner != current)) set_error( STATUS_MUTANT_NOT_OWNED );
-        else
-        {
-            reply->prev_count = mutex->count;
-            if (!--mutex->count) do_release( mutex );
-        }
+        release_mutex( mutex, &reply->prev_count );
         release_object( mutex );
     }
 }
@@ -260,9 +365,19 @@ DECL_HANDLER(query_mutex)
     if ((mutex = (struct mutex *)get_handle_obj( current->process, req->handle,
                                                  MUTANT_QUERY_STATE, &mutex_ops )))
     {
-        reply->count = mutex->count;
-        reply->owned = (mutex->owner == current);
-        reply->abandoned = mutex->abandoned;
+        if (mutex->fast_sync)
+        {
+            struct fast_sync_object *obj = get_fast_sync_object( mutex->fast_sync );
+            reply->count = obj->count;
+            reply->owned = obj->count && get_fast_sync_value( mutex->fast_sync ) == current->id;
+            reply->abandoned = obj->abandoned;
+        }
+        else
+        {
+            reply->count = mutex->count;
+            reply->owned = (mutex->owner == current);
+            reply->abandoned = mutex->abandoned;
+        }
 
         release_object( mutex );
     }
@@ -43,9 +43,13 @@
 struct namespace
 {
     unsigned int        hash_size;       /* size of hash table */
-    struct list         names[1];        /* array of hash entry lists */
+    unsigned int        min_size;        /* initial size of hash table, it never shrinks below that */
+    unsigned int        count;           /* number of names in the table */
+    struct list        *names;           /* array of hash entry lists */
 };
 
+#define NAMESPACE_MAX_LOAD 2   /* max average number of names per bucket before growing the table */
+
 
 #ifdef DEBUG_OBJECTS
 static struct list object_list = LIST_INIT(object_list);
@@ -113,19 +117,66 @@ void *memdup( const void *data, size_t len )
 
 /*****************************************************************/
 
-static int get_name_hash( const struct namespace *namespace, const WCHAR *name, data_size_t len )
+/* case-insensitive FNV-1a hash of a name, with a final avalanche so that all bits are used */
+unsigned int get_name_hash( const WCHAR *name, data_size_t len )
 {
-    WCHAR hash = 0;
+    unsigned int hash = 2166136261u;
+
     len /= sizeof(WCHAR);
-    while (len--) hash ^= tolowerW(*name++);
-    return hash % namespace->hash_size;
+    while (len--)
+    {
+        WCHAR ch = tolowerW( *name++ );
+        hash = (hash ^ (ch & 0xff)) * 16777619;
+        hash = (hash ^ (ch >> 8)) * 16777619;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    return hash;
+}
+
+/* change the number of buckets of a namespace, keeping the existing entries */
+static void resize_namespace( struct namespace *namespace, unsigned int new_size )
+{
+    struct list *names;
+    unsigned int i;
+
+    if (!(names = malloc( new_size * sizeof(*names) ))) return;  /* keep using the old table */
+    for (i = 0; i < new_size; i++) list_init( &names[i] );
+    for (i = 0; i < namespace->hash_size; i++)
+    {
+        struct list *ptr;
+        while ((ptr = list_head( &namespace->names[i] )))
+        {
+            struct object_name *name = LIST_ENTRY( ptr, struct object_name, entry );
+            list_remove( &name->entry );
+            list_add_tail( &names[name->hash % new_size], &name->entry );
+        }
+    }
+    free( namespace->names );
+    namespace->names = names;
+    namespace->hash_size = new_size;
 }
 
 void namespace_add( struct namespace *namespace, struct object_name *ptr )
 {
-    int hash = get_name_hash( namespace, ptr->name, ptr->len );
+    ptr->hash = get_name_hash( ptr->name, ptr->len );
+    ptr->namespace = namespace;
+    list_add_head( &namespace->names[ptr->hash % namespace->hash_size], &ptr->entry );
+    if (++namespace->count > namespace->hash_size * NAMESPACE_MAX_LOAD)
+        resize_namespace( namespace, namespace->hash_size * 2 + 1 );
+}
+
+void namespace_remove( struct object_name *ptr )
+{
+    struct namespace *namespace = ptr->namespace;
 
-    list_add_head( &namespace->names[hash], &ptr->entry );
+    list_remove( &ptr->entry );
+    if (!namespace) return;
+    ptr->namespace = NULL;
+    /* shrink only when well below the growth threshold to avoid resizing back and forth */
+    if (--namespace->count < namespace->hash_size / 8 && namespace->hash_size / 2 >= namespace->min_size)
+        resize_namespace( namespace, namespace->hash_size / 2 );
 }
 
 /* allocate a name for an object */
@@ -137,6 +188,7 @@ static struct object_name *alloc_name( const struct unicode_str *name )
     {
         ptr->len = name->len;
         ptr->parent = NULL;
+        ptr->namespace = NULL;
         memcpy( ptr->name, name->str, name->len );
     }
     return ptr;
@@ -397,7 +449,8 @@ struct object *grab_object( void *ptr )
 {
     struct object *obj = (struct object *)ptr;
     assert( obj->refcount < INT_MAX );
-    obj->refcount++;
+    /* objects may be grabbed concurrently by the request worker threads */
+    interlocked_xchg_add( (int *)&obj->refcount, 1 );
     return obj;
 }
 
@@ -406,7 +459,7 @@ void release_object( void *ptr )
 {
     struct object *obj = (struct object *)ptr;
     assert( obj->refcount );
-    if (!--obj->refcount)
+    if (interlocked_xchg_add( (int *)&obj->refcount, -1 ) == 1)
     {
         assert( !obj->handle_count );
         /* if the refcount is 0, nobody can be in the wait queue */
@@ -423,14 +476,18 @@ struct object *find_object( const struct namespace *namespace, const struct unic
 {
     const struct list *list;
     struct list *p;
+    unsigned int hash;
 
     if (!name || !name->len) return NULL;
 
-    list = &namespace->names[ get_name_hash( namespace, name->str, name->len ) ];
+    hash = get_name_hash( name->str, name->len );
+    list = &namespace->names[hash % namespace->hash_size];
     LIST_FOR_EACH( p, list )
     {
         const struct object_name *ptr = LIST_ENTRY( p, struct object_name, entry );
         if (ptr->len != name->len) continue;
+        /* the hash is case-insensitive, so it can be used to skip both kinds of compare */
+        if (ptr->hash != hash) continue;
         if (attributes & OBJ_CASE_INSENSITIVE)
         {
             if (!strncmpiW( ptr->name, name->str, name->len/sizeof(WCHAR) ))
@@ -469,15 +526,42 @@ struct namespace *create_namespace( unsigned int hash_size )
     struct namespace *namespace;
     unsigned int i;
 
-    namespace = mem_alloc( sizeof(*namespace) + (hash_size - 1) * sizeof(namespace->names[0]) );
-    if (namespace)
+    if (!(namespace = mem_alloc( sizeof(*namespace) ))) return NULL;
+    if (!(namespace->names = mem_alloc( hash_size * sizeof(namespace->names[0]) )))
     {
-        namespace->hash_size      = hash_size;
-        for (i = 0; i < hash_size; i++) list_init( &namespace->names[i] );
+        free( namespace );
+        return NULL;
     }
+    namespace->hash_size = hash_size;
+    namespace->min_size  = hash_size;
+    namespace->count     = 0;
+    for (i = 0; i < hash_size; i++) list_init( &namespace->names[i] );
     return namespace;
 }
 
+/* free a namespace; it must not contain any names anymore */
+void free_namespace( struct namespace *namespace )
+{
+    if (!namespace) return;
+    free( namespace->names );
+    free( namespace );
+}
+
+/* dump the bucket occupancy of a namespace, to check the quality of the hash function */
+void dump_namespace( const struct namespace *namespace )
+{
+    unsigned int i, used = 0, longest = 0;
+
+    for (i = 0; i < namespace->hash_size; i++)
+    {
+        unsigned int len = list_count( &namespace->names[i] );
+        if (len) used++;
+        if (len > longest) longest = len;
+    }
+    fprintf( stderr, "%u names in %u/%u buckets, longest chain %u",
+             namespace->count, used, namespace->hash_size, longest );
+}
+
 /* functions for unimplemented/default object operations */
 
 struct object_type *no_get_type( struct object *obj )
@@ -642,7 +726,7 @@ int no_link_name( struct object *obj, struct object_name *name, struct object *p
 
 void default_unlink_name( struct object *obj, struct object_name *name )
 {
-    list_remove( &name->entry );
+    namespace_remove( name );
 }
 
 struct object *no_open_file( struct object *obj, unsigned int access, unsigned int sharing,
@@ -31,6 +31,14 @@
 
 #define DEBUG_OBJECTS
 
+/* concurrent requests are run on worker threads, each with its own current thread */
+#if defined(HAVE_PTHREAD_H) && defined(__GNUC__)
+#define USE_REQUEST_WORKERS
+#define SERVER_THREAD_LOCAL __thread
+#else
+#define SERVER_THREAD_LOCAL
+#endif
+
 /* kernel objects */
 
 struct namespace;
@@ -113,6 +121,8 @@ struct object_name
     struct list         entry;           /* entry in the hash list */
     struct object      *obj;             /* object owning this name */
     struct object      *parent;          /* parent object */
+    struct namespace   *namespace;       /* namespace containing the name */
+    unsigned int        hash;            /* case-insensitive hash of the name */
     data_size_t         len;             /* name length in bytes */
     WCHAR               name[1];
 };
@@ -127,7 +137,9 @@ struct wait_queue_entry
 extern void *mem_alloc( size_t size );  /* malloc wrapper */
 extern void *memdup( const void *data, size_t len );
 extern void *alloc_object( const struct object_ops *ops );
+extern unsigned int get_name_hash( const WCHAR *name, data_size_t len );
 extern void namespace_add( struct namespace *namespace, struct object_name *ptr );
+extern void namespace_remove( struct object_name *ptr );
 extern const WCHAR *get_object_name( struct object *obj, data_size_t *len );
 extern WCHAR *get_object_full_name( struct object *obj, data_size_t *ret_len );
 extern void dump_object_name( struct object *obj );
@@ -141,6 +153,8 @@ extern void *open_named_object( struct object *parent, const struct object_ops *
 extern void unlink_named_object( struct object *obj );
 extern void make_object_static( struct object *obj );
 extern struct namespace *create_namespace( unsigned int hash_size );
+extern void free_namespace( struct namespace *namespace );
+extern void dump_namespace( const struct namespace *namespace );
 /* grab/release_object can take any pointer, but you better make sure */
 /* that the thing pointed to starts with a struct object... */
 extern struct object *grab_object( void *obj );
@@ -186,9 +200,31 @@ extern void pulse_event( struct event *event );
 extern void set_event( struct event *event );
 extern void reset_event( struct event *event );
 
+extern int get_event_fast_sync( struct object *obj, unsigned int *index );
+
 /* mutex functions */
 
 extern void abandon_mutexes( struct thread *thread );
+extern int is_mutex_object( struct object *obj );
+extern int get_mutex_fast_sync( struct object *obj, unsigned int *index );
+
+/* semaphore functions */
+
+extern int get_semaphore_fast_sync( struct object *obj, unsigned int *index );
+
+/* fast synchronization functions */
+
+extern void init_fast_sync(void);
+extern unsigned int alloc_fast_sync( int value, int max );
+extern void free_fast_sync( unsigned int index );
+extern struct fast_sync_object *get_fast_sync_object( unsigned int index );
+extern int get_fast_sync_value( unsigned int index );
+extern int set_fast_sync_value( unsigned int index, int value );
+extern int cmpxchg_fast_sync_value( unsigned int index, int value, int compare );
+extern void set_fast_sync_event( unsigned int index, int signaled, int pulse );
+extern void wake_fast_sync( unsigned int index, int count );
+extern int fast_sync_add_queue( struct object *obj, struct wait_queue_entry *entry, unsigned int index );
+extern void fast_sync_remove_queue( struct object *obj, struct wait_queue_entry *entry, unsigned int index );
 
 /* serial functions */
 
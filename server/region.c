@@ -72,6 +72,9 @@ SOFTWARE.
 
 ************************************************************************/
 
+#include "config.h"
+#include "wine/port.h"
+
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
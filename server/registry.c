@@ -34,7 +34,15 @@
 #include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
+#include <signal.h>
 #include <sys/stat.h>
+#include <sys/types.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_WAIT_H
+# include <sys/wait.h>
+#endif
 #include <unistd.h>
 
 #include "ntstatus.h"
@@ -60,6 +68,20 @@ struct notify
     struct process   *process;  /* process in which the hkey is valid */
 };
 
+/* hash index of the subkeys or values of a key, mapping names to array indices */
+struct name_hash
+{
+    unsigned int      mask;        /* number of slots - 1 */
+    unsigned int      count;       /* number of used slots */
+    struct name_slot *slots;       /* open addressing table */
+};
+
+struct name_slot
+{
+    unsigned int      hash;        /* case-insensitive hash of the name */
+    int               index;       /* index in the array, -1 if the slot is empty */
+};
+
 /* a registry key */
 struct key
 {
@@ -75,7 +97,10 @@ struct key
     int               last_value;  /* last in use value */
     int               nb_values;   /* count of allocated values in array */
     struct key_value *values;      /* values array */
+    struct name_hash *subkey_hash; /* hash index of subkeys, only for keys with many subkeys */
+    struct name_hash *value_hash;  /* hash index of values, only for keys with many values */
     unsigned int      flags;       /* flags */
+    unsigned int      id;          /* unique id, used by clients to cache the key values */
     timeout_t         modif;       /* last modification time */
     struct list       notify_list; /* list of notifications */
 };
@@ -100,6 +125,7 @@ struct key_value
 
 #define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
 #define MIN_VALUES   8   /* min. number of allocated values per key */
+#define MIN_HASHED   32  /* min. number of subkeys or values before building a hash index */
 
 #define MAX_NAME_LEN  256    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
@@ -107,6 +133,12 @@ struct key_value
 /* the root of the registry tree */
 static struct key *root_key;
 
+/* generation counters of the keys, shared with the clients to validate their value caches */
+#define KEY_GENERATION_COUNT 65536
+static const char key_generations_file[] = "registry-gen";
+static unsigned int *key_generations;
+static unsigned int next_key_id = 1;
+
 static const timeout_t ticks_1601_to_1970 = (timeout_t)86400 * (369 * 365 + 89) * TICKS_PER_SEC;
 static const timeout_t save_period = 30 * -TICKS_PER_SEC;  /* delay between periodic saves */
 static struct timeout_user *save_timeout_user;  /* saving timer */
@@ -125,8 +157,18 @@ struct save_branch_info
 {
     struct key  *key;
     const char  *path;
+    FILE        *journal;       /* journal of the changes since the last full save */
+    long         journal_size;  /* current size of the journal file */
+    pid_t        compact_pid;   /* process writing a compacted file, or 0 */
+    int          need_save;     /* the journal doesn't contain all the changes */
 };
 
+#define JOURNAL_COMPACT_SIZE (1024 * 1024)  /* journal size that triggers a compaction */
+
+static const char journal_header[] = "WINE REGISTRY Journal 1";
+
+static int save_branch_now( struct save_branch_info *info );
+
 #define MAX_SAVE_BRANCH_INFO 3
 static int save_branch_count;
 static struct save_branch_info save_branch_info[MAX_SAVE_BRANCH_INFO];
@@ -142,6 +184,7 @@ struct file_load_info
     int         line;     /* current input line */
     WCHAR      *tmp;      /* temp buffer to use while parsing input */
     size_t      tmplen;   /* length of temp buffer */
+    int         journal;  /* loading a journal, which can also delete keys and values */
 };
 
 
@@ -188,6 +231,11 @@ static inline int is_wow6432node( const WCHAR *name, unsigned int len )
  * - key names use escapes too in order to support Unicode
  * - the modification time optionally follows the key name
  * - REG_EXPAND_SZ and REG_MULTI_SZ are saved as strings instead of hex
+ *
+ * Changes since the last full save of a branch are appended to a journal file
+ * in the same format, with a different header line and two extensions:
+ * - a "#delete" option deletes the key and all its subkeys
+ * - a "name"=- value line deletes the value
  */
 
 /* dump the full path of a key */
@@ -255,6 +303,22 @@ static void dump_value( const struct key_value *value, FILE *f )
     fputc( '\n', f );
 }
 
+/* dump the header line and options of a key */
+static void dump_key_header( const struct key *key, const struct key *base, FILE *f )
+{
+    fprintf( f, "\n[" );
+    if (key != base) dump_path( key, base, f );
+    fprintf( f, "] %u\n", (unsigned int)((key->modif - ticks_1601_to_1970) / TICKS_PER_SEC) );
+    fprintf( f, "#time=%x%08x\n", (unsigned int)(key->modif >> 32), (unsigned int)key->modif );
+    if (key->class)
+    {
+        fprintf( f, "#class=\"" );
+        dump_strW( key->class, key->classlen / sizeof(WCHAR), f, "\"\"" );
+        fprintf( f, "\"\n" );
+    }
+    if (key->flags & KEY_SYMLINK) fputs( "#link\n", f );
+}
+
 /* save a registry and all its subkeys to a text file */
 static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
 {
@@ -265,22 +329,84 @@ static void save_subkeys( const struct key *key, const struct key *base, FILE *f
     /* keys with no values but subkeys are saved implicitly by saving the subkeys */
     if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
     {
-        fprintf( f, "\n[" );
-        if (key != base) dump_path( key, base, f );
-        fprintf( f, "] %u\n", (unsigned int)((key->modif - ticks_1601_to_1970) / TICKS_PER_SEC) );
-        fprintf( f, "#time=%x%08x\n", (unsigned int)(key->modif >> 32), (unsigned int)key->modif );
-        if (key->class)
-        {
-            fprintf( f, "#class=\"" );
-            dump_strW( key->class, key->classlen / sizeof(WCHAR), f, "\"\"" );
-            fprintf( f, "\"\n" );
-        }
-        if (key->flags & KEY_SYMLINK) fputs( "#link\n", f );
+        dump_key_header( key, base, f );
         for (i = 0; i <= key->last_value; i++) dump_value( &key->values[i], f );
     }
     for (i = 0; i <= key->last_subkey; i++) save_subkeys( key->subkeys[i], base, f );
 }
 
+/* find the saved branch containing a key, if it needs to be journaled */
+static struct save_branch_info *get_journal_branch( const struct key *key )
+{
+    int i;
+
+    if (key->flags & KEY_VOLATILE) return NULL;
+    for ( ; key; key = key->parent)
+        for (i = 0; i < save_branch_count; i++)
+            if (save_branch_info[i].key == key)
+                return save_branch_info[i].journal ? &save_branch_info[i] : NULL;
+    return NULL;
+}
+
+/* finish writing a journal record; on failure fall back to saving the whole branch */
+static void end_journal_record( struct save_branch_info *info )
+{
+    if (!fflush( info->journal ) && (info->journal_size = ftell( info->journal )) != -1) return;
+    fprintf( stderr, "wineserver: failed to write registry journal for %s\n", info->path );
+    fclose( info->journal );
+    info->journal = NULL;
+    info->need_save = 1;
+}
+
+/* append the current state of a key header to the journal */
+static void journal_key( const struct key *key )
+{
+    struct save_branch_info *info = get_journal_branch( key );
+
+    if (!info) return;
+    dump_key_header( key, info->key, info->journal );
+    end_journal_record( info );
+}
+
+/* append a deleted key to the journal */
+static void journal_delete_key( const struct key *key )
+{
+    struct save_branch_info *info = get_journal_branch( key );
+
+    if (!info) return;
+    dump_key_header( key, info->key, info->journal );
+    fputs( "#delete\n", info->journal );
+    end_journal_record( info );
+}
+
+/* append a modified value to the journal */
+static void journal_value( const struct key *key, const struct key_value *value )
+{
+    struct save_branch_info *info = get_journal_branch( key );
+
+    if (!info) return;
+    dump_key_header( key, info->key, info->journal );
+    dump_value( value, info->journal );
+    end_journal_record( info );
+}
+
+/* append a deleted value to the journal */
+static void journal_delete_value( const struct key *key, const struct key_value *value )
+{
+    struct save_branch_info *info = get_journal_branch( key );
+
+    if (!info) return;
+    dump_key_header( key, info->key, info->journal );
+    if (value->namelen)
+    {
+        fputc( '\"', info->journal );
+        dump_strW( value->name, value->namelen / sizeof(WCHAR), info->journal, "\"\"" );
+        fputs( "\"=-\n", info->journal );
+    }
+    else fputs( "@=-\n", info->journal );
+    end_journal_record( info );
+}
+
 static void dump_operation( const struct key *key, const struct key_value *value, const char *op )
 {
     fprintf( stderr, "%s key ", op );
@@ -403,6 +529,117 @@ static int key_close_handle( struct object *obj, struct process *process, obj_ha
     return 1;  /* ok to close */
 }
 
+/* allocate an empty hash index able to hold the given number of names */
+static struct name_hash *alloc_name_hash( unsigned int count )
+{
+    struct name_hash *hash;
+    unsigned int i, size = 64;
+
+    while (size < count * 2) size *= 2;
+    if (!(hash = malloc( sizeof(*hash) ))) return NULL;
+    if (!(hash->slots = malloc( size * sizeof(*hash->slots) )))
+    {
+        free( hash );
+        return NULL;
+    }
+    hash->mask = size - 1;
+    hash->count = 0;
+    for (i = 0; i < size; i++) hash->slots[i].index = -1;
+    return hash;
+}
+
+static void free_name_hash( struct name_hash *hash )
+{
+    if (!hash) return;
+    free( hash->slots );
+    free( hash );
+}
+
+static void name_hash_add_slot( struct name_hash *hash, unsigned int value, int index )
+{
+    unsigned int i = value & hash->mask;
+
+    while (hash->slots[i].index != -1) i = (i + 1) & hash->mask;
+    hash->slots[i].hash  = value;
+    hash->slots[i].index = index;
+    hash->count++;
+}
+
+/* add a name to the hash index; return 0 if the index had to be dropped */
+static int name_hash_add( struct name_hash *hash, unsigned int value, int index )
+{
+    if (hash->count * 4 >= (hash->mask + 1) * 3)  /* grow when 75% full */
+    {
+        struct name_slot *old_slots = hash->slots;
+        unsigned int i, old_size = hash->mask + 1;
+
+        if (!(hash->slots = malloc( old_size * 2 * sizeof(*hash->slots) )))
+        {
+            hash->slots = old_slots;
+            return 0;
+        }
+        hash->mask = old_size * 2 - 1;
+        hash->count = 0;
+        for (i = 0; i <= hash->mask; i++) hash->slots[i].index = -1;
+        for (i = 0; i < old_size; i++)
+            if (old_slots[i].index != -1) name_hash_add_slot( hash, old_slots[i].hash, old_slots[i].index );
+        free( old_slots );
+    }
+    name_hash_add_slot( hash, value, index );
+    return 1;
+}
+
+/* remove the entry for a given array index */
+static void name_hash_remove( struct name_hash *hash, unsigned int value, int index )
+{
+    unsigned int i = value & hash->mask, j, home;
+
+    while (hash->slots[i].index != index)
+    {
+        assert( hash->slots[i].index != -1 );
+        i = (i + 1) & hash->mask;
+    }
+    /* move back the following entries of the probe sequence to fill the hole */
+    for (j = (i + 1) & hash->mask; hash->slots[j].index != -1; j = (j + 1) & hash->mask)
+    {
+        home = hash->slots[j].hash & hash->mask;
+        if (((j - home) & hash->mask) < ((j - i) & hash->mask)) continue;
+        hash->slots[i] = hash->slots[j];
+        i = j;
+    }
+    hash->slots[i].index = -1;
+    hash->count--;
+}
+
+/* adjust the indices at or above a given position after an insertion or removal in the array */
+static void name_hash_shift( struct name_hash *hash, int start, int delta )
+{
+    unsigned int i;
+
+    for (i = 0; i <= hash->mask; i++)
+        if (hash->slots[i].index >= start) hash->slots[i].index += delta;
+}
+
+/* build the subkeys hash index of a key */
+static void build_subkey_hash( struct key *key )
+{
+    int i;
+
+    if (!(key->subkey_hash = alloc_name_hash( key->last_subkey + 1 ))) return;
+    for (i = 0; i <= key->last_subkey; i++)
+        name_hash_add_slot( key->subkey_hash, get_name_hash( key->subkeys[i]->name, key->subkeys[i]->namelen ), i );
+}
+
+/* build the values hash index of a key */
+static void build_value_hash( struct key *key )
+{
+    int i;
+
+    if (!(key->value_hash = alloc_name_hash( key->last_value + 1 ))) return;
+    for (i = 0; i <= key->last_value; i++)
+        name_hash_add_slot( key->value_hash, get_name_hash( key->values[i].name, key->values[i].namelen ), i );
+}
+
 static void key_destroy( struct object *obj )
 {
     int i;
@@ -418,6 +655,8 @@ static void key_destroy( struct object *obj )
         free( key->values[i].data );
     }
     free( key->values );
+    free_name_hash( key->value_hash );
+    free_name_hash( key->subkey_hash );
     for (i = 0; i <= key->last_subkey; i++)
     {
         key->subkeys[i]->parent = NULL;
@@ -490,8 +729,12 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
         key->nb_values   = 0;
         key->last_value  = -1;
         key->values      = NULL;
+        key->subkey_hash = NULL;
+        key->value_hash  = NULL;
         key->modif       = modif;
         key->parent      = NULL;
+        key->id          = next_key_id++;
+        if (!next_key_id) next_key_id++;  /* 0 means no id */
         list_init( &key->notify_list );
         if (name->len && !(key->name = memdup( name->str, name->len )))
         {
@@ -502,6 +745,12 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
     return key;
 }
 
+/* invalidate the values cached by the clients for a key */
+static inline void bump_key_generation( const struct key *key )
+{
+    if (key_generations) key_generations[key->id % KEY_GENERATION_COUNT]++;
+}
+
 /* mark a key and all its parents as dirty (modified) */
 static void make_dirty( struct key *key )
 {
@@ -544,6 +793,7 @@ static void touch_key( struct key *key, unsigned int change )
 
     key->modif = current_time;
     make_dirty( key );
+    bump_key_generation( key );
 
     /* do notifications */
     check_notify( key, change, 1 );
@@ -599,6 +849,16 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
         for (i = ++parent->last_subkey; i > index; i--)
             parent->subkeys[i] = parent->subkeys[i-1];
         parent->subkeys[index] = key;
+        if (parent->subkey_hash)
+        {
+            if (index < parent->last_subkey) name_hash_shift( parent->subkey_hash, index, 1 );
+            if (!name_hash_add( parent->subkey_hash, get_name_hash( key->name, key->namelen ), index ))
+            {
+                free_name_hash( parent->subkey_hash );
+                parent->subkey_hash = NULL;
+            }
+        }
+        else if (parent->last_subkey + 1 >= MIN_HASHED) build_subkey_hash( parent );
         if (is_wow6432node( key->name, key->namelen ) && !is_wow6432node( parent->name, parent->namelen ))
             parent->flags |= KEY_WOW64;
     }
@@ -615,9 +875,15 @@ static void free_subkey( struct key *parent, int index )
     assert( index <= parent->last_subkey );
 
     key = parent->subkeys[index];
+    if (parent->subkey_hash)
+    {
+        name_hash_remove( parent->subkey_hash, get_name_hash( key->name, key->namelen ), index );
+        if (index < parent->last_subkey) name_hash_shift( parent->subkey_hash, index + 1, -1 );
+    }
     for (i = index; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
     parent->last_subkey--;
     key->flags |= KEY_DELETED;
+    bump_key_generation( key );
     key->parent = NULL;
     if (is_wow6432node( key->name, key->namelen )) parent->flags &= ~KEY_WOW64;
     release_object( key );
@@ -641,6 +907,27 @@ static struct key *find_subkey( const struct key *key, const struct unicode_str
     int i, min, max, res;
     data_size_t len;
 
+    if (key->subkey_hash)
+    {
+        const struct name_hash *hash = key->subkey_hash;
+        unsigned int value = get_name_hash( name->str, name->len );
+
+        for (i = value & hash->mask; hash->slots[i].index != -1; i = (i + 1) & hash->mask)
+        {
+            struct key *subkey;
+
+            if (hash->slots[i].hash != value) continue;
+            subkey = key->subkeys[hash->slots[i].index];
+            if (subkey->namelen == name->len &&
+                !memicmpW( subkey->name, name->str, name->len / sizeof(WCHAR) ))
+            {
+                *index = hash->slots[i].index;
+                return subkey;
+            }
+        }
+        /* not found, fall through to find the insertion point */
+    }
+
     min = 0;
     max = key->last_subkey;
     while (min <= max)
@@ -829,6 +1116,8 @@ static struct key *create_key( struct key *key, const struct unicode_str *name,
         if (!(key->class = memdup( class->str, key->classlen ))) key->classlen = 0;
     }
     touch_key( key->parent, REG_NOTIFY_CHANGE_NAME );
+    journal_key( key );
+    journal_key( key->parent );
     grab_object( key );
     return key;
 }
@@ -1000,9 +1289,20 @@ static int delete_key( struct key *key, int recurse )
         if (0 > delete_key(key->subkeys[key->last_subkey], 1))
             return -1;
 
-    for (index = 0; index <= parent->last_subkey; index++)
-        if (parent->subkeys[index] == key) break;
-    assert( index <= parent->last_subkey );
+    if (parent->subkey_hash)
+    {
+        struct unicode_str name;
+
+        name.str = key->name;
+        name.len = key->namelen;
+        find_subkey( parent, &name, &index );
+    }
+    else
+    {
+        for (index = 0; index <= parent->last_subkey; index++)
+            if (parent->subkeys[index] == key) break;
+    }
+    assert( index <= parent->last_subkey && parent->subkeys[index] == key );
 
     /* we can only delete a key that has no subkeys */
     if (key->last_subkey >= 0)
@@ -1012,8 +1312,10 @@ static int delete_key( struct key *key, int recurse )
     }
 
     if (debug_level > 1) dump_operation( key, NULL, "Delete" );
+    journal_delete_key( key );
     free_subkey( parent, index );
     touch_key( parent, REG_NOTIFY_CHANGE_NAME );
+    journal_key( parent );
     return 0;
 }
 
@@ -1048,6 +1350,27 @@ static struct key_value *find_value( const struct key *key, const struct unicode
     int i, min, max, res;
     data_size_t len;
 
+    if (key->value_hash)
+    {
+        const struct name_hash *hash = key->value_hash;
+        unsigned int value = get_name_hash( name->str, name->len );
+
+        for (i = value & hash->mask; hash->slots[i].index != -1; i = (i + 1) & hash->mask)
+        {
+            struct key_value *val;
+
+            if (hash->slots[i].hash != value) continue;
+            val = &key->values[hash->slots[i].index];
+            if (val->namelen == name->len &&
+                !memicmpW( val->name, name->str, name->len / sizeof(WCHAR) ))
+            {
+                *index = hash->slots[i].index;
+                return val;
+            }
+        }
+        /* not found, fall through to find the insertion point */
+    }
+
     min = 0;
     max = key->last_value;
     while (min <= max)
@@ -1091,6 +1414,16 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
     value->namelen = name->len;
     value->len     = 0;
     value->data    = NULL;
+    if (key->value_hash)
+    {
+        if (index < key->last_value) name_hash_shift( key->value_hash, index, 1 );
+        if (!name_hash_add( key->value_hash, get_name_hash( name->str, name->len ), index ))
+        {
+            free_name_hash( key->value_hash );
+            key->value_hash = NULL;
+        }
+    }
+    else if (key->last_value + 1 >= MIN_HASHED) build_value_hash( key );
     return value;
 }
 
@@ -1139,6 +1472,7 @@ static void set_value( struct key *key, const struct unicode_str *name,
     value->len   = len;
     value->data  = ptr;
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
+    journal_value( key, value );
     if (debug_level > 1) dump_operation( key, value, "Set" );
 }
 
@@ -1225,11 +1559,17 @@ static void delete_value( struct key *key, const struct unicode_str *name )
         return;
     }
     if (debug_level > 1) dump_operation( key, value, "Delete" );
+    touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
+    journal_delete_value( key, value );
+    if (key->value_hash)
+    {
+        name_hash_remove( key->value_hash, get_name_hash( value->name, value->namelen ), index );
+        if (index < key->last_value) name_hash_shift( key->value_hash, index + 1, -1 );
+    }
     free( value->name );
     free( value->data );
     for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
     key->last_value--;
-    touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
 
     /* try to shrink the array */
     nb_values = key->nb_values;
@@ -1451,7 +1791,9 @@ static int load_key_option( struct key *key, const char *buffer, struct file_loa
             else if (*p >= 'a' && *p <= 'f') modif = (modif << 4) | (*p - 'a' + 10);
             else break;
         }
-        update_key_time( key, modif );
+        /* journaled keys already exist, their time has to be replaced */
+        if (info->journal) key->modif = modif;
+        else update_key_time( key, modif );
     }
     if (!strncmp( buffer, "#class=", 7 ))
     {
@@ -1536,6 +1878,15 @@ static int load_value( struct key *key, const char *buffer, struct file_load_inf
     struct key_value *value;
 
     if (!(value = parse_value_name( key, buffer, &len, info ))) return 0;
+    if (info->journal && buffer[len] == '-')
+    {
+        struct unicode_str name;
+
+        name.str = value->name;
+        name.len = value->namelen;
+        delete_value( key, &name );
+        return 1;
+    }
     if (!(res = get_data_type( buffer + len, &type, &parse_type ))) goto error;
     buffer += len + res;
 
@@ -1583,6 +1934,7 @@ static int load_value( struct key *key, const char *buffer, struct file_load_inf
     value->data = newptr;
     value->len  = len;
     value->type = type;
+    bump_key_generation( key );
     return 1;
 
  error:
@@ -1635,6 +1987,7 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
     info.len    = 4;
     info.tmplen = 4;
     info.line   = 0;
+    info.journal = 0;
     if (!(info.buffer = mem_alloc( info.len ))) return;
     if (!(info.tmp = mem_alloc( info.tmplen )))
     {
@@ -1642,8 +1995,13 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
         return;
     }
 
-    if ((read_next_line( &info ) != 1) ||
-        strcmp( info.buffer, "WINE REGISTRY Version 2" ))
+    if (read_next_line( &info ) != 1)
+    {
+        set_error( STATUS_NOT_REGISTRY_FILE );
+        goto done;
+    }
+    if (!strcmp( info.buffer, journal_header )) info.journal = 1;
+    else if (strcmp( info.buffer, "WINE REGISTRY Version 2" ))
     {
         set_error( STATUS_NOT_REGISTRY_FILE );
         goto done;
@@ -1671,7 +2029,13 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
             else file_read_error( "Value without key", &info );
             break;
         case '#':   /* option */
-            if (subkey) load_key_option( subkey, p, &info );
+            if (subkey && info.journal && !strcmp( p, "#delete" ))
+            {
+                delete_key( subkey, 1 );
+                release_object( subkey );
+                subkey = NULL;
+            }
+            else if (subkey) load_key_option( subkey, p, &info );
             else if (!load_global_option( p, &info )) goto done;
             break;
         case ';':   /* comment */
@@ -1714,9 +2078,77 @@ static void load_registry( struct key *key, obj_handle_t handle )
     }
 }
 
+/* get the name of the journal file of a branch, or of the journal being compacted */
+static void get_journal_name( const struct save_branch_info *info, int old, char *buffer, size_t size )
+{
+    snprintf( buffer, size, "%s.journal%s", info->path, old ? ".old" : "" );
+}
+
+/* load a journal left by a previous server; return 1 if it contains any records */
+static int load_journal( struct save_branch_info *info, int old )
+{
+    char name[PATH_MAX];
+    FILE *f;
+
+    get_journal_name( info, old, name, sizeof(name) );
+    if (!(f = fopen( name, "r" ))) return 0;
+    /* an empty journal only contains its header line */
+    if (fseek( f, 0, SEEK_END ) || ftell( f ) <= (long)sizeof(journal_header))
+    {
+        fclose( f );
+        return 0;
+    }
+    rewind( f );
+    if (debug_level) fprintf( stderr, "wineserver: replaying registry journal %s\n", name );
+    load_keys( info->key, name, f, 0 );
+    fclose( f );
+    clear_error();
+    return 1;
+}
+
+/* start a new empty journal for a branch */
+static void reset_journal( struct save_branch_info *info )
+{
+    char name[PATH_MAX];
+
+    if (info->journal) fclose( info->journal );
+    get_journal_name( info, 0, name, sizeof(name) );
+    if ((info->journal = fopen( name, "w" )))
+    {
+        fprintf( info->journal, "%s\n", journal_header );
+        if (!fflush( info->journal ) && (info->journal_size = ftell( info->journal )) != -1) return;
+        fclose( info->journal );
+        info->journal = NULL;
+    }
+    /* without a journal, changes are only saved by periodically rewriting the whole branch */
+    unlink( name );
+    info->need_save = 1;
+}
+
+/* keep appending to the journal of a previous server when its changes couldn't be saved */
+static void reopen_journal( struct save_branch_info *info )
+{
+    char name[PATH_MAX];
+
+    /* the replayed changes are only in memory until the whole branch is saved */
+    info->need_save = 1;
+    get_journal_name( info, 0, name, sizeof(name) );
+    if (!(info->journal = fopen( name, "a" ))) return;
+    if (!fseek( info->journal, 0, SEEK_END ) && (info->journal_size = ftell( info->journal )) != -1)
+    {
+        if (info->journal_size) return;
+        fprintf( info->journal, "%s\n", journal_header );
+        if (!fflush( info->journal ) && (info->journal_size = ftell( info->journal )) != -1) return;
+    }
+    fclose( info->journal );
+    info->journal = NULL;
+}
+
 /* load one of the initial registry files */
 static int load_init_registry_from_file( const char *filename, struct key *key )
 {
+    struct save_branch_info *info;
+    int replayed;
     FILE *f;
 
     if ((f = fopen( filename, "r" )))
@@ -1732,9 +2164,24 @@ static int load_init_registry_from_file( const char *filename, struct key *key )
 
     assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
 
-    save_branch_info[save_branch_count].path = filename;
-    save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
+    info = &save_branch_info[save_branch_count++];
+    info->path = filename;
+    info->key = (struct key *)grab_object( key );
+    info->journal = NULL;
+    info->journal_size = 0;
+    info->compact_pid = 0;
+    info->need_save = 0;
     make_object_static( &key->obj );
+
+    /* replay the changes journaled by the previous server, and write them to the main file */
+    replayed = load_journal( info, 1 );
+    replayed |= load_journal( info, 0 );
+    if (replayed)
+    {
+        key->flags |= KEY_DIRTY;
+        if (!save_branch_now( info )) reopen_journal( info );
+    }
+    else reset_journal( info );
     return (f != NULL);
 }
 
@@ -1789,6 +2236,34 @@ unsigned int get_prefix_cpu_mask(void)
     }
 }
 
+/* create the shared generation counters used by the client registry caches */
+static void init_key_generations(void)
+{
+#ifdef HAVE_SYS_MMAN_H
+    size_t size = KEY_GENERATION_COUNT * sizeof(*key_generations);
+    void *ptr;
+    int fd;
+
+    /* we are in the server directory, remove a leftover from a previous server */
+    unlink( key_generations_file );
+    if ((fd = open( key_generations_file, O_RDWR | O_CREAT | O_EXCL, 0600 )) == -1) return;
+    if (ftruncate( fd, size ) != -1 &&
+        (ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) != MAP_FAILED)
+        key_generations = ptr;
+    else
+        unlink( key_generations_file );
+    close( fd );
+#endif
+}
+
+/* return the id of a key if the client may cache its values through this handle */
+static unsigned int get_cacheable_key_id( const struct key *key, obj_handle_t handle )
+{
+    if (!key_generations || !handle) return 0;
+    if (!(get_handle_access( current->process, handle ) & KEY_QUERY_VALUE)) return 0;
+    return key->id;
+}
+
 /* registry initialisation */
 void init_registry(void)
 {
@@ -1862,6 +2337,8 @@ void init_registry(void)
 
     /* go back to the server dir */
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
+
+    init_key_generations();
 }
 
 /* save a registry branch to a file */
@@ -1984,15 +2461,77 @@ done:
     return ret;
 }
 
+/* save a whole branch synchronously, and start a new journal */
+static int save_branch_now( struct save_branch_info *info )
+{
+    char name[PATH_MAX];
+
+    if (!save_branch( info->key, info->path )) return 0;
+    get_journal_name( info, 1, name, sizeof(name) );
+    unlink( name );
+    info->need_save = 0;
+    reset_journal( info );
+    return 1;
+}
+
+/* check whether the compaction process of a branch is still running */
+static int is_compaction_running( struct save_branch_info *info )
+{
+    if (!info->compact_pid) return 0;
+    /* the child may also have been reaped already by the SIGCHLD handler */
+    if (!waitpid( info->compact_pid, NULL, WNOHANG )) return 1;
+    info->compact_pid = 0;
+    return 0;
+}
+
+/* rewrite a branch from a forked process, so that the server doesn't block while saving it */
+static void compact_branch( struct save_branch_info *info )
+{
+    char name[PATH_MAX], old_name[PATH_MAX];
+    struct stat st;
+    pid_t pid;
+
+    get_journal_name( info, 0, name, sizeof(name) );
+    get_journal_name( info, 1, old_name, sizeof(old_name) );
+
+    /* if the previous compaction failed, its journal is still needed until the next save */
+    if (!stat( old_name, &st ) || rename( name, old_name ) == -1) goto failed;
+
+    /* new changes go to a new journal, the child saves everything that is in the old one */
+    reset_journal( info );
+    fflush( stderr );
+    if (!(pid = fork()))
+    {
+        info->key->flags |= KEY_DIRTY;
+        if (save_branch( info->key, info->path ) && !unlink( old_name )) _exit( 0 );
+        _exit( 1 );
+    }
+    if (pid == -1) goto failed;
+    if (debug_level > 1) fprintf( stderr, "wineserver: compacting %s in process %d\n", info->path, (int)pid );
+    info->compact_pid = pid;
+    make_clean( info->key );
+    return;
+
+failed:
+    info->key->flags |= KEY_DIRTY;
+    save_branch_now( info );
+}
+
 /* periodic saving of the registry */
 static void periodic_save( void *arg )
 {
+    struct save_branch_info *info;
     int i;
 
     if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
     for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+    {
+        info = &save_branch_info[i];
+        if (is_compaction_running( info )) continue;
+        if (info->need_save) save_branch_now( info );
+        else if (info->journal_size >= JOURNAL_COMPACT_SIZE) compact_branch( info );
+    }
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
     set_periodic_save_timer();
 }
@@ -2012,7 +2551,17 @@ void flush_registry(void)
     if (fchdir( config_dir_fd ) == -1) return;
     for (i = 0; i < save_branch_count; i++)
     {
-        if (!save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+        struct save_branch_info *info = &save_branch_info[i];
+        char name[PATH_MAX];
+        struct stat st;
+
+        /* make sure the compacted file isn't renamed over the one we are writing */
+        if (info->compact_pid) waitpid( info->compact_pid, NULL, 0 );
+        info->compact_pid = 0;
+        get_journal_name( info, 1, name, sizeof(name) );
+        if (!stat( name, &st )) info->key->flags |= KEY_DIRTY;
+
+        if (!save_branch_now( info ))
         {
             fprintf( stderr, "wineserver: could not save registry branch to %s",
                      save_branch_info[i].path );
@@ -2059,6 +2608,7 @@ DECL_HANDLER(create_key)
                                objattr->attributes, sd, &reply->created )))
         {
             reply->hkey = alloc_handle( current->process, key, access, objattr->attributes );
+            reply->key_id = get_cacheable_key_id( key, reply->hkey );
             release_object( key );
         }
         release_object( parent );
@@ -2075,6 +2625,7 @@ DECL_HANDLER(open_key)
     if (!is_wow64_thread( current )) access = (access & ~KEY_WOW64_32KEY) | KEY_WOW64_64KEY;
 
     reply->hkey = 0;
+    reply->key_id = 0;
     /* NOTE: no access rights are required to open the parent key, only the child key */
     if ((parent = get_parent_hkey_obj( req->parent )))
     {
@@ -2082,6 +2633,7 @@ DECL_HANDLER(open_key)
         if ((key = open_key( parent, &name, access, req->attributes )))
         {
             reply->hkey = alloc_handle( current->process, key, access, req->attributes );
+            reply->key_id = get_cacheable_key_id( key, reply->hkey );
             release_object( key );
         }
         release_object( parent );
@@ -2155,8 +2707,14 @@ DECL_HANDLER(get_key_value)
     struct unicode_str name = get_req_unicode_str();
 
     reply->total = 0;
+    reply->key_id = 0;
     if ((key = get_hkey_obj( req->hkey, KEY_QUERY_VALUE )))
     {
+        if (key_generations)
+        {
+            reply->key_id = key->id;
+            reply->generation = key_generations[key->id % KEY_GENERATION_COUNT];
+        }
         get_value( key, &name, &reply->type, &reply->total );
         release_object( key );
     }
@@ -2215,7 +2773,12 @@ DECL_HANDLER(load_registry)
         int dummy;
         if ((key = create_key( parent, &name, NULL, 0, KEY_WOW64_64KEY, 0, sd, &dummy )))
         {
+            struct save_branch_info *info = get_journal_branch( key );
+
             load_registry( key, req->file );
+            /* the loaded keys are not journaled, save the whole branch */
+            if (info) info->need_save = 1;
+            make_dirty( key );
             release_object( key );
         }
         release_object( parent );
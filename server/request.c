@@ -24,6 +24,9 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 #ifdef HAVE_PWD_H
 #include <pwd.h>
 #endif
@@ -124,8 +127,8 @@ static const struct fd_ops master_socket_fd_ops =
 };
 
 
-struct thread *current = NULL;  /* thread handling the current request */
-unsigned int global_error = 0;  /* global error code for when no thread is current */
+SERVER_THREAD_LOCAL struct thread *current = NULL;  /* thread handling the current request */
+SERVER_THREAD_LOCAL unsigned int global_error = 0;  /* global error code for when no thread is current */
 timeout_t server_start_time = 0;  /* server startup time */
 int server_dir_fd = -1;    /* file descriptor for the server dir */
 int config_dir_fd = -1;    /* file descriptor for the config dir */
@@ -287,32 +290,32 @@ static void send_reply( union generic_reply *reply )
         fatal_protocol_error( current, "reply write: %s\n", strerror( errno ));
 }
 
-/* call a request handler */
-static void call_req_handler( struct thread *thread )
+/* run the handler for the request of the current thread */
+static void run_req_handler( enum request req, union generic_reply *reply )
 {
-    union generic_reply reply;
-    enum request req = thread->req.request_header.req;
-
-    current = thread;
     current->reply_size = 0;
     clear_error();
-    memset( &reply, 0, sizeof(reply) );
+    memset( reply, 0, sizeof(*reply) );
 
     if (debug_level) trace_request();
 
     if (req < REQ_NB_REQUESTS)
-        req_handlers[req]( &current->req, &reply );
+        req_handlers[req]( &current->req, reply );
     else
         set_error( STATUS_NOT_IMPLEMENTED );
+}
 
+/* send the reply once the request handler has run */
+static void finish_request( enum request req, union generic_reply *reply )
+{
     if (current)
     {
         if (current->reply_fd)
         {
-            reply.reply_header.error = current->error;
-            reply.reply_header.reply_size = current->reply_size;
-            if (debug_level) trace_reply( req, &reply );
-            send_reply( &reply );
+            reply->reply_header.error = current->error;
+            reply->reply_header.reply_size = current->reply_size;
+            if (debug_level) trace_reply( req, reply );
+            send_reply( reply );
         }
         else
         {
@@ -323,6 +326,185 @@ static void call_req_handler( struct thread *thread )
     current = NULL;
 }
 
+/* call a request handler */
+static void call_req_handler( struct thread *thread )
+{
+    union generic_reply reply;
+    enum request req = thread->req.request_header.req;
+
+    current = thread;
+    run_req_handler( req, &reply );
+    finish_request( req, &reply );
+}
+
+#ifdef USE_REQUEST_WORKERS
+
+/* Concurrent requests don't modify any server state, so they can be run in
+ * parallel with each other.  They are deferred while the main loop processes
+ * the poll events, and run as a batch on the worker threads before the main
+ * loop waits again; the replies are then sent from the main thread.
+ */
+
+#define MAX_REQUEST_WORKERS   16
+#define MAX_DEFERRED_REQUESTS 256
+
+struct deferred_request
+{
+    struct thread      *thread;  /* thread that sent the request */
+    union generic_reply reply;   /* reply built by the handler */
+};
+
+static unsigned char is_concurrent[REQ_NB_REQUESTS];
+static struct deferred_request deferred_requests[MAX_DEFERRED_REQUESTS];
+static int nb_deferred;          /* number of deferred requests */
+static int next_deferred;        /* next deferred request to run */
+static unsigned int nb_workers;
+static unsigned int worker_wakeups;  /* number of workers to wake for the current batch */
+static unsigned int busy_workers;    /* number of workers still running the current batch */
+static pthread_mutex_t worker_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t worker_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t batch_done_cond = PTHREAD_COND_INITIALIZER;
+
+/* run deferred requests until there are none left in the batch */
+static void run_deferred_requests(void)
+{
+    int i;
+
+    while ((i = interlocked_xchg_add( &next_deferred, 1 )) < nb_deferred)
+    {
+        struct deferred_request *def = &deferred_requests[i];
+
+        if (def->thread->state == TERMINATED) continue;
+        current = def->thread;
+        run_req_handler( def->thread->req.request_header.req, &def->reply );
+        current = NULL;
+    }
+}
+
+static void *request_worker( void *arg )
+{
+    sigset_t sigset;
+
+    /* signals are handled by the main thread */
+    sigfillset( &sigset );
+    pthread_sigmask( SIG_BLOCK, &sigset, NULL );
+
+    pthread_mutex_lock( &worker_mutex );
+    for (;;)
+    {
+        while (!worker_wakeups) pthread_cond_wait( &worker_cond, &worker_mutex );
+        worker_wakeups--;
+        pthread_mutex_unlock( &worker_mutex );
+
+        run_deferred_requests();
+
+        pthread_mutex_lock( &worker_mutex );
+        if (!--busy_workers) pthread_cond_signal( &batch_done_cond );
+    }
+    return NULL;
+}
+
+/* defer a concurrent request to the next batch; return 0 if it has to run at once */
+static int defer_request( struct thread *thread )
+{
+    enum request req = thread->req.request_header.req;
+
+    if (!nb_workers || debug_level) return 0;
+    if (req >= REQ_NB_REQUESTS || !is_concurrent[req]) return 0;
+    if (nb_deferred == MAX_DEFERRED_REQUESTS) return 0;
+    deferred_requests[nb_deferred++].thread = (struct thread *)grab_object( thread );
+    return 1;
+}
+
+/* run the batch of deferred requests and send their replies */
+void flush_deferred_requests(void)
+{
+    int i;
+
+    if (!nb_deferred) return;
+
+    next_deferred = 0;
+    if (nb_deferred > 1)
+    {
+        pthread_mutex_lock( &worker_mutex );
+        busy_workers = worker_wakeups = min( nb_workers, nb_deferred - 1 );
+        pthread_cond_broadcast( &worker_cond );
+        pthread_mutex_unlock( &worker_mutex );
+
+        run_deferred_requests();
+
+        pthread_mutex_lock( &worker_mutex );
+        while (busy_workers) pthread_cond_wait( &batch_done_cond, &worker_mutex );
+        pthread_mutex_unlock( &worker_mutex );
+    }
+    else run_deferred_requests();
+
+    for (i = 0; i < nb_deferred; i++)
+    {
+        struct deferred_request *def = &deferred_requests[i];
+        struct thread *thread = def->thread;
+
+        if (thread->state != TERMINATED)
+        {
+            current = thread;
+            finish_request( thread->req.request_header.req, &def->reply );
+        }
+        free( thread->req_data );
+        thread->req_data = NULL;
+        release_object( thread );
+    }
+    nb_deferred = 0;
+}
+
+/* start the request worker threads */
+void init_request_workers(void)
+{
+    const char *env = getenv( "WINESERVERWORKERS" );
+    long count = -1;
+    unsigned int i;
+    pthread_t id;
+
+    for (i = 0; i < sizeof(concurrent_requests) / sizeof(concurrent_requests[0]); i++)
+        is_concurrent[concurrent_requests[i]] = 1;
+
+    if (env) count = atoi( env );
+#ifdef _SC_NPROCESSORS_ONLN
+    if (count < 0) count = sysconf( _SC_NPROCESSORS_ONLN ) - 1;
+#endif
+    if (count > MAX_REQUEST_WORKERS) count = MAX_REQUEST_WORKERS;
+
+    for (nb_workers = 0; nb_workers < count; nb_workers++)
+        if (pthread_create( &id, NULL, request_worker, NULL )) break;
+
+    if (debug_level) fprintf( stderr, "wineserver: %u request worker threads\n", nb_workers );
+}
+
+#else  /* USE_REQUEST_WORKERS */
+
+static inline int defer_request( struct thread *thread )
+{
+    return 0;
+}
+
+void flush_deferred_requests(void)
+{
+}
+
+void init_request_workers(void)
+{
+}
+
+#endif  /* USE_REQUEST_WORKERS */
+
+/* handle a request once it has been read entirely */
+static void handle_request( struct thread *thread )
+{
+    if (defer_request( thread )) return;
+    call_req_handler( thread );
+    free( thread->req_data );
+    thread->req_data = NULL;
+}
+
 /* read a request from a thread */
 void read_request( struct thread *thread )
 {
@@ -335,7 +517,7 @@ void read_request( struct thread *thread )
         if (!(thread->req_toread = thread->req.request_header.request_size))
         {
             /* no data, handle request at once */
-            call_req_handler( thread );
+            handle_request( thread );
             return;
         }
         if (!(thread->req_data = malloc( thread->req_toread )))
@@ -356,9 +538,7 @@ void read_request( struct thread *thread )
         if (ret <= 0) break;
         if (!(thread->req_toread -= ret))
         {
-            call_req_handler( thread );
-            free( thread->req_data );
-            thread->req_data = NULL;
+            handle_request( thread );
             return;
         }
     }
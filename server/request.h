@@ -53,6 +53,8 @@ extern const void *get_req_data_after_objattr( const struct object_attributes *a
 extern int receive_fd( struct process *process );
 extern int send_client_fd( struct process *process, int fd, obj_handle_t handle );
 extern void read_request( struct thread *thread );
+extern void flush_deferred_requests(void);
+extern void init_request_workers(void);
 extern void write_reply( struct thread *thread );
 extern unsigned int get_tick_count(void);
 extern void open_master_socket(void);
@@ -152,6 +154,7 @@ DECL_HANDLER(create_semaphore);
 DECL_HANDLER(release_semaphore);
 DECL_HANDLER(query_semaphore);
 DECL_HANDLER(open_semaphore);
+DECL_HANDLER(get_fast_sync);
 DECL_HANDLER(create_file);
 DECL_HANDLER(open_file_object);
 DECL_HANDLER(alloc_file_handle);
@@ -197,6 +200,8 @@ DECL_HANDLER(open_mapping);
 DECL_HANDLER(get_mapping_info);
 DECL_HANDLER(get_mapping_committed_range);
 DECL_HANDLER(add_mapping_committed_range);
+DECL_HANDLER(get_image_relocation);
+DECL_HANDLER(add_image_relocation);
 DECL_HANDLER(create_snapshot);
 DECL_HANDLER(next_process);
 DECL_HANDLER(next_thread);
@@ -365,9 +370,15 @@ DECL_HANDLER(create_completion);
 DECL_HANDLER(open_completion);
 DECL_HANDLER(add_completion);
 DECL_HANDLER(remove_completion);
+DECL_HANDLER(remove_completions);
 DECL_HANDLER(query_completion);
+DECL_HANDLER(create_wait_completion_packet);
+DECL_HANDLER(associate_wait_completion_packet);
+DECL_HANDLER(cancel_wait_completion_packet);
 DECL_HANDLER(set_completion_info);
 DECL_HANDLER(add_fd_completion);
+DECL_HANDLER(set_fd_signaled);
+DECL_HANDLER(set_fd_completion_mode);
 DECL_HANDLER(set_fd_disp_info);
 DECL_HANDLER(set_fd_name_info);
 DECL_HANDLER(get_window_layered_info);
@@ -431,6 +442,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_release_semaphore,
     (req_handler)req_query_semaphore,
     (req_handler)req_open_semaphore,
+    (req_handler)req_get_fast_sync,
     (req_handler)req_create_file,
     (req_handler)req_open_file_object,
     (req_handler)req_alloc_file_handle,
@@ -476,6 +488,8 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_mapping_info,
     (req_handler)req_get_mapping_committed_range,
     (req_handler)req_add_mapping_committed_range,
+    (req_handler)req_get_image_relocation,
+    (req_handler)req_add_image_relocation,
     (req_handler)req_create_snapshot,
     (req_handler)req_next_process,
     (req_handler)req_next_thread,
@@ -644,9 +658,15 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_open_completion,
     (req_handler)req_add_completion,
     (req_handler)req_remove_completion,
+    (req_handler)req_remove_completions,
     (req_handler)req_query_completion,
+    (req_handler)req_create_wait_completion_packet,
+    (req_handler)req_associate_wait_completion_packet,
+    (req_handler)req_cancel_wait_completion_packet,
     (req_handler)req_set_completion_info,
     (req_handler)req_add_fd_completion,
+    (req_handler)req_set_fd_signaled,
+    (req_handler)req_set_fd_completion_mode,
     (req_handler)req_set_fd_disp_info,
     (req_handler)req_set_fd_name_info,
     (req_handler)req_get_window_layered_info,
@@ -666,6 +686,17 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_terminate_job,
 };
 
+static const enum request concurrent_requests[] =
+{
+    REQ_get_process_info,
+    REQ_get_thread_info,
+    REQ_get_thread_times,
+    REQ_get_fast_sync,
+    REQ_enum_key,
+    REQ_get_key_value,
+    REQ_enum_key_value,
+};
+
 C_ASSERT( sizeof(affinity_t) == 8 );
 C_ASSERT( sizeof(apc_call_t) == 40 );
 C_ASSERT( sizeof(apc_param_t) == 8 );
@@ -952,14 +983,24 @@ C_ASSERT( FIELD_OFFSET(struct open_semaphore_request, rootdir) == 20 );
 C_ASSERT( sizeof(struct open_semaphore_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct open_semaphore_reply, handle) == 8 );
 C_ASSERT( sizeof(struct open_semaphore_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_request, handle) == 12 );
+C_ASSERT( sizeof(struct get_fast_sync_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_reply, index) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_reply, type) == 12 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_reply, access) == 16 );
+C_ASSERT( sizeof(struct get_fast_sync_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct create_file_request, access) == 12 );
 C_ASSERT( FIELD_OFFSET(struct create_file_request, sharing) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_file_request, create) == 20 );
 C_ASSERT( FIELD_OFFSET(struct create_file_request, options) == 24 );
 C_ASSERT( FIELD_OFFSET(struct create_file_request, attrs) == 28 );
-C_ASSERT( sizeof(struct create_file_request) == 32 );
+C_ASSERT( FIELD_OFFSET(struct create_file_request, unix_fd) == 32 );
+C_ASSERT( sizeof(struct create_file_request) == 40 );
 C_ASSERT( FIELD_OFFSET(struct create_file_reply, handle) == 8 );
-C_ASSERT( sizeof(struct create_file_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct create_file_reply, cacheable) == 12 );
+C_ASSERT( FIELD_OFFSET(struct create_file_reply, access) == 16 );
+C_ASSERT( FIELD_OFFSET(struct create_file_reply, options) == 20 );
+C_ASSERT( sizeof(struct create_file_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct open_file_object_request, access) == 12 );
 C_ASSERT( FIELD_OFFSET(struct open_file_object_request, attributes) == 16 );
 C_ASSERT( FIELD_OFFSET(struct open_file_object_request, rootdir) == 20 );
@@ -984,7 +1025,8 @@ C_ASSERT( FIELD_OFFSET(struct get_handle_fd_reply, type) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_handle_fd_reply, cacheable) == 12 );
 C_ASSERT( FIELD_OFFSET(struct get_handle_fd_reply, access) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_handle_fd_reply, options) == 20 );
-C_ASSERT( sizeof(struct get_handle_fd_reply) == 24 );
+C_ASSERT( FIELD_OFFSET(struct get_handle_fd_reply, comp_flags) == 24 );
+C_ASSERT( sizeof(struct get_handle_fd_reply) == 32 );
 C_ASSERT( FIELD_OFFSET(struct get_directory_cache_entry_request, handle) == 12 );
 C_ASSERT( sizeof(struct get_directory_cache_entry_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_directory_cache_entry_reply, entry) == 8 );
@@ -1243,6 +1285,18 @@ C_ASSERT( FIELD_OFFSET(struct add_mapping_committed_range_request, handle) == 12
 C_ASSERT( FIELD_OFFSET(struct add_mapping_committed_range_request, offset) == 16 );
 C_ASSERT( FIELD_OFFSET(struct add_mapping_committed_range_request, size) == 24 );
 C_ASSERT( sizeof(struct add_mapping_committed_range_request) == 32 );
+C_ASSERT( FIELD_OFFSET(struct get_image_relocation_request, handle) == 12 );
+C_ASSERT( FIELD_OFFSET(struct get_image_relocation_request, base) == 16 );
+C_ASSERT( sizeof(struct get_image_relocation_request) == 24 );
+C_ASSERT( FIELD_OFFSET(struct get_image_relocation_reply, file) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_image_relocation_reply, hits) == 12 );
+C_ASSERT( FIELD_OFFSET(struct get_image_relocation_reply, time) == 16 );
+C_ASSERT( sizeof(struct get_image_relocation_reply) == 24 );
+C_ASSERT( FIELD_OFFSET(struct add_image_relocation_request, handle) == 12 );
+C_ASSERT( FIELD_OFFSET(struct add_image_relocation_request, base) == 16 );
+C_ASSERT( FIELD_OFFSET(struct add_image_relocation_request, time) == 24 );
+C_ASSERT( FIELD_OFFSET(struct add_image_relocation_request, pages_size) == 28 );
+C_ASSERT( sizeof(struct add_image_relocation_request) == 32 );
 C_ASSERT( FIELD_OFFSET(struct create_snapshot_request, attributes) == 12 );
 C_ASSERT( FIELD_OFFSET(struct create_snapshot_request, flags) == 16 );
 C_ASSERT( sizeof(struct create_snapshot_request) == 24 );
@@ -1311,12 +1365,14 @@ C_ASSERT( FIELD_OFFSET(struct create_key_request, options) == 16 );
 C_ASSERT( sizeof(struct create_key_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct create_key_reply, hkey) == 8 );
 C_ASSERT( FIELD_OFFSET(struct create_key_reply, created) == 12 );
-C_ASSERT( sizeof(struct create_key_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct create_key_reply, key_id) == 16 );
+C_ASSERT( sizeof(struct create_key_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct open_key_request, parent) == 12 );
 C_ASSERT( FIELD_OFFSET(struct open_key_request, access) == 16 );
 C_ASSERT( FIELD_OFFSET(struct open_key_request, attributes) == 20 );
 C_ASSERT( sizeof(struct open_key_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct open_key_reply, hkey) == 8 );
+C_ASSERT( FIELD_OFFSET(struct open_key_reply, key_id) == 12 );
 C_ASSERT( sizeof(struct open_key_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct delete_key_request, hkey) == 12 );
 C_ASSERT( sizeof(struct delete_key_request) == 16 );
@@ -1344,7 +1400,9 @@ C_ASSERT( FIELD_OFFSET(struct get_key_value_request, hkey) == 12 );
 C_ASSERT( sizeof(struct get_key_value_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, type) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, total) == 12 );
-C_ASSERT( sizeof(struct get_key_value_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, key_id) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, generation) == 20 );
+C_ASSERT( sizeof(struct get_key_value_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, hkey) == 12 );
 C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, index) == 16 );
 C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, info_class) == 20 );
@@ -2223,10 +2281,30 @@ C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, cvalue) == 16 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, information) == 24 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, status) == 32 );
 C_ASSERT( sizeof(struct remove_completion_reply) == 40 );
+C_ASSERT( FIELD_OFFSET(struct remove_completions_request, handle) == 12 );
+C_ASSERT( sizeof(struct remove_completions_request) == 16 );
+C_ASSERT( sizeof(struct remove_completions_reply) == 8 );
 C_ASSERT( FIELD_OFFSET(struct query_completion_request, handle) == 12 );
 C_ASSERT( sizeof(struct query_completion_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct query_completion_reply, depth) == 8 );
 C_ASSERT( sizeof(struct query_completion_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct create_wait_completion_packet_request, access) == 12 );
+C_ASSERT( sizeof(struct create_wait_completion_packet_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct create_wait_completion_packet_reply, handle) == 8 );
+C_ASSERT( sizeof(struct create_wait_completion_packet_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct associate_wait_completion_packet_request, packet) == 12 );
+C_ASSERT( FIELD_OFFSET(struct associate_wait_completion_packet_request, completion) == 16 );
+C_ASSERT( FIELD_OFFSET(struct associate_wait_completion_packet_request, target) == 20 );
+C_ASSERT( FIELD_OFFSET(struct associate_wait_completion_packet_request, ckey) == 24 );
+C_ASSERT( FIELD_OFFSET(struct associate_wait_completion_packet_request, cvalue) == 32 );
+C_ASSERT( FIELD_OFFSET(struct associate_wait_completion_packet_request, information) == 40 );
+C_ASSERT( FIELD_OFFSET(struct associate_wait_completion_packet_request, status) == 48 );
+C_ASSERT( sizeof(struct associate_wait_completion_packet_request) == 56 );
+C_ASSERT( FIELD_OFFSET(struct associate_wait_completion_packet_reply, signaled) == 8 );
+C_ASSERT( sizeof(struct associate_wait_completion_packet_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct cancel_wait_completion_packet_request, packet) == 12 );
+C_ASSERT( FIELD_OFFSET(struct cancel_wait_completion_packet_request, remove_signaled) == 16 );
+C_ASSERT( sizeof(struct cancel_wait_completion_packet_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct set_completion_info_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_completion_info_request, ckey) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_completion_info_request, chandle) == 24 );
@@ -2235,7 +2313,16 @@ C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, cvalue) == 16 );
 C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, information) == 24 );
 C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, status) == 32 );
+C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, async) == 36 );
 C_ASSERT( sizeof(struct add_fd_completion_request) == 40 );
+C_ASSERT( FIELD_OFFSET(struct set_fd_signaled_request, handle) == 12 );
+C_ASSERT( FIELD_OFFSET(struct set_fd_signaled_request, signaled) == 16 );
+C_ASSERT( sizeof(struct set_fd_signaled_request) == 24 );
+C_ASSERT( FIELD_OFFSET(struct set_fd_completion_mode_request, handle) == 12 );
+C_ASSERT( FIELD_OFFSET(struct set_fd_completion_mode_request, flags) == 16 );
+C_ASSERT( sizeof(struct set_fd_completion_mode_request) == 24 );
+C_ASSERT( FIELD_OFFSET(struct set_fd_completion_mode_reply, flags) == 8 );
+C_ASSERT( sizeof(struct set_fd_completion_mode_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_fd_disp_info_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_fd_disp_info_request, unlink) == 16 );
 C_ASSERT( sizeof(struct set_fd_disp_info_request) == 24 );
@@ -22,6 +22,7 @@
 #include "wine/port.h"
 
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -41,22 +42,26 @@ struct semaphore
     struct object  obj;    /* object header */
     unsigned int   count;  /* current count */
     unsigned int   max;    /* maximum possible count */
+    unsigned int   fast_sync; /* index of the shared state, 0 if none */
 };
 
 static void semaphore_dump( struct object *obj, int verbose );
 static struct object_type *semaphore_get_type( struct object *obj );
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int semaphore_map_access( struct object *obj, unsigned int access );
 static int semaphore_signal( struct object *obj, unsigned int access );
+static void semaphore_destroy( struct object *obj );
 
 static const struct object_ops semaphore_ops =
 {
     sizeof(struct semaphore),      /* size */
     semaphore_dump,                /* dump */
     semaphore_get_type,            /* get_type */
-    add_queue,                     /* add_queue */
-    remove_queue,                  /* remove_queue */
+    semaphore_add_queue,           /* add_queue */
+    semaphore_remove_queue,        /* remove_queue */
     semaphore_signaled,            /* signaled */
     semaphore_satisfied,           /* satisfied */
     semaphore_signal,              /* signal */
@@ -69,7 +74,7 @@ static const struct object_ops semaphore_ops =
     default_unlink_name,           /* unlink_name */
     no_open_file,                  /* open_file */
     no_close_handle,               /* close_handle */
-    no_destroy                     /* destroy */
+    semaphore_destroy              /* destroy */
 };
 
 
@@ -91,14 +96,43 @@ static struct semaphore *create_semaphore( struct object *root, const struct uni
             /* initialize it if it didn't already exist */
             sem->count = initial;
             sem->max   = max;
+            sem->fast_sync = (max <= INT_MAX) ? alloc_fast_sync( initial, max ) : 0;
         }
     }
     return sem;
 }
 
+static unsigned int get_semaphore_count( struct semaphore *sem )
+{
+    if (sem->fast_sync) return get_fast_sync_value( sem->fast_sync );
+    return sem->count;
+}
+
+static int release_fast_semaphore( struct semaphore *sem, unsigned int count,
+                                   unsigned int *prev )
+{
+    unsigned int cur;
+
+    do
+    {
+        cur = get_fast_sync_value( sem->fast_sync );
+        if (prev) *prev = cur;
+        if (cur + count < cur || cur + count > sem->max)
+        {
+            set_error( STATUS_SEMAPHORE_LIMIT_EXCEEDED );
+            return 0;
+        }
+    } while (cmpxchg_fast_sync_value( sem->fast_sync, cur + count, cur ) != cur);
+
+    wake_fast_sync( sem->fast_sync, count );
+    wake_up( &sem->obj, count );
+    return 1;
+}
+
 static int release_semaphore( struct semaphore *sem, unsigned int count,
                               unsigned int *prev )
 {
+    if (sem->fast_sync) return release_fast_semaphore( sem, count, prev );
     if (prev) *prev = sem->count;
     if (sem->count + count < sem->count || sem->count + count > sem->max)
     {
@@ -122,7 +156,7 @@ static void semaphore_dump( struct object *obj, int verbose )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
-    fprintf( stderr, "Semaphore count=%d max=%d\n", sem->count, sem->max );
+    fprintf( stderr, "Semaphore count=%d max=%d\n", get_semaphore_count( sem ), sem->max );
 }
 
 static struct object_type *semaphore_get_type( struct object *obj )
@@ -132,17 +166,41 @@ static struct object_type *semaphore_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    return fast_sync_add_queue( obj, entry, sem->fast_sync );
+}
+
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    fast_sync_remove_queue( obj, entry, sem->fast_sync );
+}
+
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
-    return (sem->count > 0);
+    return (get_semaphore_count( sem ) > 0);
 }
 
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
+    unsigned int cur;
+
     assert( obj->ops == &semaphore_ops );
+    if (sem->fast_sync)
+    {
+        /* clients leave the count alone while we have waiters */
+        cur = get_fast_sync_value( sem->fast_sync );
+        assert( cur );
+        set_fast_sync_value( sem->fast_sync, cur - 1 );
+        return;
+    }
     assert( sem->count );
     sem->count--;
 }
@@ -169,6 +227,22 @@ static int semaphore_signal( struct object *obj, unsigned int access )
     return release_semaphore( sem, 1, NULL );
 }
 
+static void semaphore_destroy( struct object *obj )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    if (sem->fast_sync) free_fast_sync( sem->fast_sync );
+}
+
+int get_semaphore_fast_sync( struct object *obj, unsigned int *index )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+
+    if (obj->ops != &semaphore_ops || !sem->fast_sync) return FAST_SYNC_NONE;
+    *index = sem->fast_sync;
+    return FAST_SYNC_SEMAPHORE;
+}
+
 /* create a semaphore */
 DECL_HANDLER(create_semaphore)
 {
@@ -223,7 +297,7 @@ DECL_HANDLER(query_semaphore)
     if ((sem = (struct semaphore *)get_handle_obj( current->process, req->handle,
                                                    SEMAPHORE_QUERY_STATE, &semaphore_ops )))
     {
-        reply->current = sem->count;
+        reply->current = get_semaphore_count( sem );
         reply->max = sem->max;
         release_object( sem );
     }
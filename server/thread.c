@@ -81,6 +81,8 @@ struct thread_wait
     client_ptr_t            cookie;     /* magic cookie to return to client */
     timeout_t               timeout;
     struct timeout_user    *user;
+    wait_callback_t         callback;   /* callback for waits not blocking a thread */
+    void                   *private;    /* callback data */
     struct wait_queue_entry queues[1];
 };
 
@@ -615,6 +617,8 @@ static int wait_on( const select_op_t *select_op, unsigned int count, struct obj
     wait->cookie  = 0;
     wait->user    = NULL;
     wait->timeout = timeout;
+    wait->callback = NULL;
+    wait->private = NULL;
     wait->abandoned = 0;
     current->wait = wait;
 
@@ -884,6 +888,64 @@ static timeout_t select_on( const select_op_t *select_op, data_size_t op_size, c
     return timeout;
 }
 
+/* start waiting on an object without blocking a thread; the callback is
+ * called once when the object is signaled and the wait satisfied, which
+ * must not depend on the given thread since it doesn't run the callback */
+struct thread_wait *add_callback_wait( struct thread *thread, struct object *obj,
+                                       wait_callback_t callback, void *private )
+{
+    struct thread_wait *wait;
+
+    if (!(wait = mem_alloc( sizeof(*wait) ))) return NULL;
+    wait->next     = NULL;
+    wait->thread   = (struct thread *)grab_object( thread );
+    wait->count    = 1;
+    wait->flags    = 0;
+    wait->select   = SELECT_WAIT;
+    wait->key      = 0;
+    wait->cookie   = 0;
+    wait->user     = NULL;
+    wait->timeout  = TIMEOUT_INFINITE;
+    wait->callback = callback;
+    wait->private  = private;
+    wait->abandoned = 0;
+    wait->queues[0].wait = wait;
+    if (!obj->ops->add_queue( obj, &wait->queues[0] ))
+    {
+        release_object( wait->thread );
+        free( wait );
+        return NULL;
+    }
+    return wait;
+}
+
+/* cancel a wait started with add_callback_wait */
+void remove_callback_wait( struct thread_wait *wait )
+{
+    struct wait_queue_entry *entry = &wait->queues[0];
+
+    assert( wait->callback );
+    entry->obj->ops->remove_queue( entry->obj, entry );
+    release_object( wait->thread );
+    free( wait );
+}
+
+/* satisfy a callback wait if its object is signaled; return 1 if the callback was called */
+int check_callback_wait( struct thread_wait *wait )
+{
+    struct wait_queue_entry *entry = &wait->queues[0];
+    wait_callback_t callback = wait->callback;
+    void *private = wait->private;
+    unsigned int status;
+
+    if (!entry->obj->ops->signaled( entry->obj, entry )) return 0;
+    entry->obj->ops->satisfied( entry->obj, entry );
+    status = wait->abandoned ? STATUS_ABANDONED_WAIT_0 : STATUS_WAIT_0;
+    remove_callback_wait( wait );
+    callback( private, status );
+    return 1;
+}
+
 /* attempt to wake threads sleeping on the object wait queue */
 void wake_up( struct object *obj, int max )
 {
@@ -893,7 +955,9 @@ void wake_up( struct object *obj, int max )
     LIST_FOR_EACH( ptr, &obj->wait_queue )
     {
         struct wait_queue_entry *entry = LIST_ENTRY( ptr, struct wait_queue_entry, entry );
-        if (!(ret = wake_thread( get_wait_queue_thread( entry )))) continue;
+        if (entry->wait->callback) ret = check_callback_wait( entry->wait );
+        else ret = wake_thread( get_wait_queue_thread( entry ));
+        if (!ret) continue;
         if (ret > 0 && max && !--max) break;
         /* restart at the head of the list since a wake up can change the object wait queue */
         ptr = &obj->wait_queue;
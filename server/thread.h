@@ -32,6 +32,9 @@ struct debug_ctx;
 struct debug_event;
 struct msg_queue;
 
+/* called when the object of a callback wait is signaled */
+typedef void (*wait_callback_t)( void *private, unsigned int status );
+
 enum run_state
 {
     RUNNING,    /* running normally */
@@ -97,7 +100,7 @@ struct thread_snapshot
     int             priority;  /* priority class */
 };
 
-extern struct thread *current;
+extern SERVER_THREAD_LOCAL struct thread *current;
 
 /* thread functions */
 
@@ -114,6 +117,10 @@ extern void stop_thread( struct thread *thread );
 extern void stop_thread_if_suspended( struct thread *thread );
 extern int wake_thread( struct thread *thread );
 extern int wake_thread_queue_entry( struct wait_queue_entry *entry );
+extern struct thread_wait *add_callback_wait( struct thread *thread, struct object *obj,
+                                              wait_callback_t callback, void *private );
+extern void remove_callback_wait( struct thread_wait *wait );
+extern int check_callback_wait( struct thread_wait *wait );
 extern int add_queue( struct object *obj, struct wait_queue_entry *entry );
 extern void remove_queue( struct object *obj, struct wait_queue_entry *entry );
 extern void kill_thread( struct thread *thread, int violent_death );
@@ -137,7 +144,7 @@ extern int send_thread_signal( struct thread *thread, int sig );
 extern void get_selector_entry( struct thread *thread, int entry, unsigned int *base,
                                 unsigned int *limit, unsigned char *flags );
 
-extern unsigned int global_error;  /* global error code for when no thread is current */
+extern SERVER_THREAD_LOCAL unsigned int global_error;  /* global error code for when no thread is current */
 
 static inline unsigned int get_error(void)       { return current ? current->error : global_error; }
 static inline void set_error( unsigned int err ) { global_error = err; if (current) current->error = err; }
@@ -407,6 +407,21 @@ static void dump_varargs_ints( const char *prefix, data_size_t size )
     remove_data( size );
 }
 
+static void dump_varargs_uints( const char *prefix, data_size_t size )
+{
+    const unsigned int *data = cur_data;
+    data_size_t len = size / sizeof(*data);
+
+    fprintf( stderr,"%s{", prefix );
+    while (len > 0)
+    {
+        fprintf( stderr, "%08x", *data++ );
+        if (--len) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+    remove_data( size );
+}
+
 static void dump_varargs_uints64( const char *prefix, data_size_t size )
 {
     const unsigned __int64 *data = cur_data;
@@ -422,6 +437,25 @@ static void dump_varargs_uints64( const char *prefix, data_size_t size )
     remove_data( size );
 }
 
+static void dump_varargs_completion_msgs( const char *prefix, data_size_t size )
+{
+    const struct completion_msg *msg = cur_data;
+    data_size_t len = size / sizeof(*msg);
+
+    fprintf( stderr, "%s{", prefix );
+    while (len > 0)
+    {
+        dump_uint64( "{ckey=", &msg->ckey );
+        dump_uint64( ",cvalue=", &msg->cvalue );
+        dump_uint64( ",information=", &msg->information );
+        fprintf( stderr, ",status=%08x}", msg->status );
+        msg++;
+        if (--len) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+    remove_data( size );
+}
+
 static void dump_varargs_apc_result( const char *prefix, data_size_t size )
 {
     const apc_result_t *result = cur_data;
@@ -1693,6 +1727,18 @@ static void dump_open_semaphore_reply( const struct open_semaphore_reply *req )
     fprintf( stderr, " handle=%04x", req->handle );
 }
 
+static void dump_get_fast_sync_request( const struct get_fast_sync_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_fast_sync_reply( const struct get_fast_sync_reply *req )
+{
+    fprintf( stderr, " index=%08x", req->index );
+    fprintf( stderr, ", type=%d", req->type );
+    fprintf( stderr, ", access=%08x", req->access );
+}
+
 static void dump_create_file_request( const struct create_file_request *req )
 {
     fprintf( stderr, " access=%08x", req->access );
@@ -1700,6 +1746,7 @@ static void dump_create_file_request( const struct create_file_request *req )
     fprintf( stderr, ", create=%d", req->create );
     fprintf( stderr, ", options=%08x", req->options );
     fprintf( stderr, ", attrs=%08x", req->attrs );
+    fprintf( stderr, ", unix_fd=%d", req->unix_fd );
     dump_varargs_object_attributes( ", objattr=", cur_size );
     dump_varargs_string( ", filename=", cur_size );
 }
@@ -1707,6 +1754,9 @@ static void dump_create_file_request( const struct create_file_request *req )
 static void dump_create_file_reply( const struct create_file_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", cacheable=%d", req->cacheable );
+    fprintf( stderr, ", access=%08x", req->access );
+    fprintf( stderr, ", options=%08x", req->options );
 }
 
 static void dump_open_file_object_request( const struct open_file_object_request *req )
@@ -1758,6 +1808,7 @@ static void dump_get_handle_fd_reply( const struct get_handle_fd_reply *req )
     fprintf( stderr, ", cacheable=%d", req->cacheable );
     fprintf( stderr, ", access=%08x", req->access );
     fprintf( stderr, ", options=%08x", req->options );
+    fprintf( stderr, ", comp_flags=%08x", req->comp_flags );
 }
 
 static void dump_get_directory_cache_entry_request( const struct get_directory_cache_entry_request *req )
@@ -2231,6 +2282,30 @@ static void dump_add_mapping_committed_range_request( const struct add_mapping_c
     dump_uint64( ", size=", &req->size );
 }
 
+static void dump_get_image_relocation_request( const struct get_image_relocation_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    dump_uint64( ", base=", &req->base );
+}
+
+static void dump_get_image_relocation_reply( const struct get_image_relocation_reply *req )
+{
+    fprintf( stderr, " file=%04x", req->file );
+    fprintf( stderr, ", hits=%08x", req->hits );
+    fprintf( stderr, ", time=%08x", req->time );
+    dump_varargs_uints( ", pages=", cur_size );
+}
+
+static void dump_add_image_relocation_request( const struct add_image_relocation_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    dump_uint64( ", base=", &req->base );
+    fprintf( stderr, ", time=%08x", req->time );
+    fprintf( stderr, ", pages_size=%u", req->pages_size );
+    dump_varargs_uints( ", pages=", min(cur_size,req->pages_size) );
+    dump_varargs_bytes( ", data=", cur_size );
+}
+
 static void dump_create_snapshot_request( const struct create_snapshot_request *req )
 {
     fprintf( stderr, " attributes=%08x", req->attributes );
@@ -2373,6 +2448,7 @@ static void dump_create_key_reply( const struct create_key_reply *req )
 {
     fprintf( stderr, " hkey=%04x", req->hkey );
     fprintf( stderr, ", created=%d", req->created );
+    fprintf( stderr, ", key_id=%08x", req->key_id );
 }
 
 static void dump_open_key_request( const struct open_key_request *req )
@@ -2386,6 +2462,7 @@ static void dump_open_key_request( const struct open_key_request *req )
 static void dump_open_key_reply( const struct open_key_reply *req )
 {
     fprintf( stderr, " hkey=%04x", req->hkey );
+    fprintf( stderr, ", key_id=%08x", req->key_id );
 }
 
 static void dump_delete_key_request( const struct delete_key_request *req )
@@ -2439,6 +2516,8 @@ static void dump_get_key_value_reply( const struct get_key_value_reply *req )
 {
     fprintf( stderr, " type=%d", req->type );
     fprintf( stderr, ", total=%u", req->total );
+    fprintf( stderr, ", key_id=%08x", req->key_id );
+    fprintf( stderr, ", generation=%08x", req->generation );
     dump_varargs_bytes( ", data=", cur_size );
 }
 
@@ -4184,6 +4263,16 @@ static void dump_remove_completion_reply( const struct remove_completion_reply *
     fprintf( stderr, ", status=%08x", req->status );
 }
 
+static void dump_remove_completions_request( const struct remove_completions_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_remove_completions_reply( const struct remove_completions_reply *req )
+{
+    dump_varargs_completion_msgs( " msgs=", cur_size );
+}
+
 static void dump_query_completion_request( const struct query_completion_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4194,6 +4283,39 @@ static void dump_query_completion_reply( const struct query_completion_reply *re
     fprintf( stderr, " depth=%08x", req->depth );
 }
 
+static void dump_create_wait_completion_packet_request( const struct create_wait_completion_packet_request *req )
+{
+    fprintf( stderr, " access=%08x", req->access );
+    dump_varargs_object_attributes( ", objattr=", cur_size );
+}
+
+static void dump_create_wait_completion_packet_reply( const struct create_wait_completion_packet_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_associate_wait_completion_packet_request( const struct associate_wait_completion_packet_request *req )
+{
+    fprintf( stderr, " packet=%04x", req->packet );
+    fprintf( stderr, ", completion=%04x", req->completion );
+    fprintf( stderr, ", target=%04x", req->target );
+    dump_uint64( ", ckey=", &req->ckey );
+    dump_uint64( ", cvalue=", &req->cvalue );
+    dump_uint64( ", information=", &req->information );
+    fprintf( stderr, ", status=%08x", req->status );
+}
+
+static void dump_associate_wait_completion_packet_reply( const struct associate_wait_completion_packet_reply *req )
+{
+    fprintf( stderr, " signaled=%d", req->signaled );
+}
+
+static void dump_cancel_wait_completion_packet_request( const struct cancel_wait_completion_packet_request *req )
+{
+    fprintf( stderr, " packet=%04x", req->packet );
+    fprintf( stderr, ", remove_signaled=%d", req->remove_signaled );
+}
+
 static void dump_set_completion_info_request( const struct set_completion_info_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4207,6 +4329,24 @@ static void dump_add_fd_completion_request( const struct add_fd_completion_reque
     dump_uint64( ", cvalue=", &req->cvalue );
     dump_uint64( ", information=", &req->information );
     fprintf( stderr, ", status=%08x", req->status );
+    fprintf( stderr, ", async=%d", req->async );
+}
+
+static void dump_set_fd_signaled_request( const struct set_fd_signaled_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", signaled=%d", req->signaled );
+}
+
+static void dump_set_fd_completion_mode_request( const struct set_fd_completion_mode_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", flags=%08x", req->flags );
+}
+
+static void dump_set_fd_completion_mode_reply( const struct set_fd_completion_mode_reply *req )
+{
+    fprintf( stderr, " flags=%08x", req->flags );
 }
 
 static void dump_set_fd_disp_info_request( const struct set_fd_disp_info_request *req )
@@ -4395,6 +4535,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_release_semaphore_request,
     (dump_func)dump_query_semaphore_request,
     (dump_func)dump_open_semaphore_request,
+    (dump_func)dump_get_fast_sync_request,
     (dump_func)dump_create_file_request,
     (dump_func)dump_open_file_object_request,
     (dump_func)dump_alloc_file_handle_request,
@@ -4440,6 +4581,8 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_mapping_info_request,
     (dump_func)dump_get_mapping_committed_range_request,
     (dump_func)dump_add_mapping_committed_range_request,
+    (dump_func)dump_get_image_relocation_request,
+    (dump_func)dump_add_image_relocation_request,
     (dump_func)dump_create_snapshot_request,
     (dump_func)dump_next_process_request,
     (dump_func)dump_next_thread_request,
@@ -4608,9 +4751,15 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_request,
     (dump_func)dump_add_completion_request,
     (dump_func)dump_remove_completion_request,
+    (dump_func)dump_remove_completions_request,
     (dump_func)dump_query_completion_request,
+    (dump_func)dump_create_wait_completion_packet_request,
+    (dump_func)dump_associate_wait_completion_packet_request,
+    (dump_func)dump_cancel_wait_completion_packet_request,
     (dump_func)dump_set_completion_info_request,
     (dump_func)dump_add_fd_completion_request,
+    (dump_func)dump_set_fd_signaled_request,
+    (dump_func)dump_set_fd_completion_mode_request,
     (dump_func)dump_set_fd_disp_info_request,
     (dump_func)dump_set_fd_name_info_request,
     (dump_func)dump_get_window_layered_info_request,
@@ -4671,6 +4820,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_release_semaphore_reply,
     (dump_func)dump_query_semaphore_reply,
     (dump_func)dump_open_semaphore_reply,
+    (dump_func)dump_get_fast_sync_reply,
     (dump_func)dump_create_file_reply,
     (dump_func)dump_open_file_object_reply,
     (dump_func)dump_alloc_file_handle_reply,
@@ -4716,6 +4866,8 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_mapping_info_reply,
     (dump_func)dump_get_mapping_committed_range_reply,
     NULL,
+    (dump_func)dump_get_image_relocation_reply,
+    NULL,
     (dump_func)dump_create_snapshot_reply,
     (dump_func)dump_next_process_reply,
     (dump_func)dump_next_thread_reply,
@@ -4884,9 +5036,15 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_reply,
     NULL,
     (dump_func)dump_remove_completion_reply,
+    (dump_func)dump_remove_completions_reply,
     (dump_func)dump_query_completion_reply,
+    (dump_func)dump_create_wait_completion_packet_reply,
+    (dump_func)dump_associate_wait_completion_packet_reply,
+    NULL,
+    NULL,
     NULL,
     NULL,
+    (dump_func)dump_set_fd_completion_mode_reply,
     NULL,
     NULL,
     (dump_func)dump_get_window_layered_info_reply,
@@ -4947,6 +5105,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "release_semaphore",
     "query_semaphore",
     "open_semaphore",
+    "get_fast_sync",
     "create_file",
     "open_file_object",
     "alloc_file_handle",
@@ -4992,6 +5151,8 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "get_mapping_info",
     "get_mapping_committed_range",
     "add_mapping_committed_range",
+    "get_image_relocation",
+    "add_image_relocation",
     "create_snapshot",
     "next_process",
     "next_thread",
@@ -5160,9 +5321,15 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "open_completion",
     "add_completion",
     "remove_completion",
+    "remove_completions",
     "query_completion",
+    "create_wait_completion_packet",
+    "associate_wait_completion_packet",
+    "cancel_wait_completion_packet",
     "set_completion_info",
     "add_fd_completion",
+    "set_fd_signaled",
+    "set_fd_completion_mode",
     "set_fd_disp_info",
     "set_fd_name_info",
     "get_window_layered_info",
@@ -5244,6 +5411,7 @@ static const struct
     { "INVALID_IMAGE_PROTECT",       STATUS_INVALID_IMAGE_PROTECT },
     { "INVALID_IMAGE_WIN_64",        STATUS_INVALID_IMAGE_WIN_64 },
     { "INVALID_PARAMETER",           STATUS_INVALID_PARAMETER },
+    { "INVALID_PARAMETER_1",         STATUS_INVALID_PARAMETER_1 },
     { "INVALID_SECURITY_DESCR",      STATUS_INVALID_SECURITY_DESCR },
     { "IO_TIMEOUT",                  STATUS_IO_TIMEOUT },
     { "KEY_DELETED",                 STATUS_KEY_DELETED },